@@ -43,6 +43,9 @@
 #define PI (3.14159265358979)
 #define PI2 (PI/2)
 
+#define EXPOSURE_TIMEOUT_MARGIN		120
+#define PULSE_TIMEOUT_MARGIN			5
+
 #define DEVICE_PRIVATE_DATA										((agent_private_data *)device->private_data)
 #define CLIENT_PRIVATE_DATA										((agent_private_data *)FILTER_CLIENT_CONTEXT->device->private_data)
 
@@ -130,8 +133,7 @@ static void save_config(indigo_device *device) {
 	indigo_save_property(device, NULL, AGENT_GUIDER_DETECTION_MODE_PROPERTY);
 	indigo_save_property(device, NULL, AGENT_GUIDER_DEC_MODE_PROPERTY);
 	if (DEVICE_CONTEXT->property_save_file_handle) {
-		CONFIG_PROPERTY->state = INDIGO_OK_STATE;
-		close(DEVICE_CONTEXT->property_save_file_handle);
+		CONFIG_PROPERTY->state = indigo_close_config_file(DEVICE_CONTEXT->property_save_file_handle) == INDIGO_OK ? INDIGO_OK_STATE : INDIGO_ALERT_STATE;
 		DEVICE_CONTEXT->property_save_file_handle = 0;
 	} else {
 		CONFIG_PROPERTY->state = INDIGO_ALERT_STATE;
@@ -166,21 +168,23 @@ static indigo_property_state capture_raw_frame(indigo_device *device) {
 			double time = AGENT_GUIDER_SETTINGS_EXPOSURE_ITEM->number.value;
 			local_exposure_property->items[0].number.value = time;
 			indigo_change_property(FILTER_DEVICE_CONTEXT->client, local_exposure_property);
-			for (int i = 0; remote_exposure_property->state != INDIGO_BUSY_STATE && i < 1000 && AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE; i++)
-				indigo_usleep(1000);
-			if (remote_exposure_property->state != INDIGO_BUSY_STATE && AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE) {
+			indigo_filter_wait_result wait = indigo_filter_wait_for_busy_state(device, remote_exposure_property, true, 1, AGENT_START_PROCESS_PROPERTY);
+			if (wait == INDIGO_FILTER_WAIT_TIMEOUT && AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE) {
 				INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't become busy in 1 second");
 				indigo_release_property(local_exposure_property);
 				return INDIGO_ALERT_STATE;
 			}
-			while (remote_exposure_property->state == INDIGO_BUSY_STATE) {
-				if (time > 1) {
-					  indigo_usleep(ONE_SECOND_DELAY);
-					time -= 1;
-				} else {
-					indigo_usleep(10000);
-					time -= 0.01;
-				}
+			if (wait != INDIGO_FILTER_WAIT_DELETED)
+				wait = indigo_filter_wait_for_busy_state(device, remote_exposure_property, false, time + EXPOSURE_TIMEOUT_MARGIN, NULL);
+			if (wait == INDIGO_FILTER_WAIT_DELETED) {
+				INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY deleted");
+				indigo_release_property(local_exposure_property);
+				return INDIGO_ALERT_STATE;
+			}
+			if (wait == INDIGO_FILTER_WAIT_TIMEOUT) {
+				INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't finish in %g seconds", time + EXPOSURE_TIMEOUT_MARGIN);
+				indigo_release_property(local_exposure_property);
+				return INDIGO_ALERT_STATE;
 			}
 			if (remote_exposure_property->state == INDIGO_OK_STATE) {
 				indigo_raw_header *header = (indigo_raw_header *)(remote_image_property->items->blob.value);
@@ -293,10 +297,16 @@ static indigo_property_state pulse_guide(indigo_device *device, double ra, doubl
 					}
 				}
 				indigo_change_property(FILTER_DEVICE_CONTEXT->client, local_guide_property);
-				while (remote_guide_property->state == INDIGO_BUSY_STATE) {
-					indigo_usleep(50000);
-				}
+				indigo_filter_wait_result wait = indigo_filter_wait_for_busy_state(device, remote_guide_property, false, fabs(ra) + PULSE_TIMEOUT_MARGIN, NULL);
 				indigo_release_property(local_guide_property);
+				if (wait == INDIGO_FILTER_WAIT_DELETED) {
+					INDIGO_DRIVER_ERROR(DRIVER_NAME, "GUIDER_GUIDE_RA_PROPERTY deleted");
+					return INDIGO_ALERT_STATE;
+				}
+				if (wait == INDIGO_FILTER_WAIT_TIMEOUT) {
+					INDIGO_DRIVER_ERROR(DRIVER_NAME, "GUIDER_GUIDE_RA_PROPERTY didn't finish in time");
+					return INDIGO_ALERT_STATE;
+				}
 			}
 		}
 	}
@@ -320,10 +330,16 @@ static indigo_property_state pulse_guide(indigo_device *device, double ra, doubl
 					}
 				}
 				indigo_change_property(FILTER_DEVICE_CONTEXT->client, local_guide_property);
-				while (remote_guide_property->state == INDIGO_BUSY_STATE) {
-					indigo_usleep(50000);
-				}
+				indigo_filter_wait_result wait = indigo_filter_wait_for_busy_state(device, remote_guide_property, false, fabs(dec) + PULSE_TIMEOUT_MARGIN, NULL);
 				indigo_release_property(local_guide_property);
+				if (wait == INDIGO_FILTER_WAIT_DELETED) {
+					INDIGO_DRIVER_ERROR(DRIVER_NAME, "GUIDER_GUIDE_DEC_PROPERTY deleted");
+					return INDIGO_ALERT_STATE;
+				}
+				if (wait == INDIGO_FILTER_WAIT_TIMEOUT) {
+					INDIGO_DRIVER_ERROR(DRIVER_NAME, "GUIDER_GUIDE_DEC_PROPERTY didn't finish in time");
+					return INDIGO_ALERT_STATE;
+				}
 			}
 		}
 	}
@@ -722,6 +738,7 @@ static void abort_process(indigo_device *device) {
 			AGENT_START_PROCESS_PROPERTY->state = INDIGO_OK_STATE;
 		else
 			AGENT_GUIDER_STATS_PHASE_ITEM->number.value = FAILED;
+		indigo_filter_wake_waiting(device);
 		indigo_property *abort_property = indigo_init_switch_property(NULL, FILTER_DEVICE_CONTEXT->device_name[INDIGO_FILTER_CCD_INDEX], CCD_ABORT_EXPOSURE_PROPERTY_NAME, NULL, NULL, INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 1);
 		if (abort_property) {
 			indigo_init_switch_item(abort_property->items, CCD_ABORT_EXPOSURE_ITEM_NAME, "", true);
@@ -26,6 +26,9 @@
 #define DRIVER_VERSION 0x0003
 #define DRIVER_NAME	"indigo_agent_imager"
 
+#define EXPOSURE_TIMEOUT_MARGIN		120
+#define FOCUSER_MOVE_TIMEOUT			300
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -130,8 +133,7 @@ static void save_config(indigo_device *device) {
 	indigo_save_property(device, NULL, AGENT_IMAGER_FOCUS_PROPERTY);
 	indigo_save_property(device, NULL, AGENT_IMAGER_DITHERING_PROPERTY);
 	if (DEVICE_CONTEXT->property_save_file_handle) {
-		CONFIG_PROPERTY->state = INDIGO_OK_STATE;
-		close(DEVICE_CONTEXT->property_save_file_handle);
+		CONFIG_PROPERTY->state = indigo_close_config_file(DEVICE_CONTEXT->property_save_file_handle) == INDIGO_OK ? INDIGO_OK_STATE : INDIGO_ALERT_STATE;
 		DEVICE_CONTEXT->property_save_file_handle = 0;
 	} else {
 		CONFIG_PROPERTY->state = INDIGO_ALERT_STATE;
@@ -178,20 +180,20 @@ static indigo_property_state capture_raw_frame(indigo_device *device) {
 		AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = time;
 		indigo_change_number_property_1(FILTER_DEVICE_CONTEXT->client, remote_exposure_property->device, CCD_EXPOSURE_PROPERTY_NAME, CCD_EXPOSURE_ITEM_NAME, time);
 		indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
-		for (int i = 0; remote_exposure_property->state != INDIGO_BUSY_STATE && i < 1000 && AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE; i++)
-			indigo_usleep(1000);
-		if (remote_exposure_property->state != INDIGO_BUSY_STATE && AGENT_ABORT_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE) {
+		indigo_filter_wait_result wait = indigo_filter_wait_for_busy_state(device, remote_exposure_property, true, 1, AGENT_START_PROCESS_PROPERTY);
+		if (wait == INDIGO_FILTER_WAIT_TIMEOUT && AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE) {
 			INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't become busy in 1 second");
 			return INDIGO_ALERT_STATE;
 		}
-		while (remote_exposure_property->state == INDIGO_BUSY_STATE) {
-			if (time > 1) {
-				indigo_usleep(ONE_SECOND_DELAY);
-				time -= 1;
-			} else {
-				indigo_usleep(10000);
-				time -= 0.01;
-			}
+		if (wait != INDIGO_FILTER_WAIT_DELETED)
+			wait = indigo_filter_wait_for_busy_state(device, remote_exposure_property, false, time + EXPOSURE_TIMEOUT_MARGIN, NULL);
+		if (wait == INDIGO_FILTER_WAIT_DELETED) {
+			INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY deleted");
+			return INDIGO_ALERT_STATE;
+		}
+		if (wait == INDIGO_FILTER_WAIT_TIMEOUT) {
+			INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't finish in %g seconds", time + EXPOSURE_TIMEOUT_MARGIN);
+			return INDIGO_ALERT_STATE;
 		}
 		if (remote_exposure_property->state == INDIGO_OK_STATE && AGENT_IMAGER_SELECTION_X_ITEM->number.value >0 && AGENT_IMAGER_SELECTION_X_ITEM->number.value > 0) {
 			indigo_raw_header *header = (indigo_raw_header *)(remote_image_property->items->blob.value);
@@ -237,88 +239,97 @@ static indigo_property_state capture_raw_frame(indigo_device *device) {
 }
 
 static void exposure_batch(indigo_device *device) {
-	indigo_property **cache = FILTER_DEVICE_CONTEXT->device_property_cache;
 	indigo_property *remote_exposure_property = NULL;
 	set_headers(device);
-	for (int j = 0; j < INDIGO_FILTER_MAX_CACHED_PROPERTIES; j++) {
-		if (cache[j] && !strcmp(cache[j]->device, FILTER_DEVICE_CONTEXT->device_name[INDIGO_FILTER_CCD_INDEX]) && !strcmp(cache[j]->name, CCD_EXPOSURE_PROPERTY_NAME)) {
-			remote_exposure_property = cache[j];
-			AGENT_IMAGER_BATCH_PROPERTY->state = INDIGO_BUSY_STATE;
+	remote_exposure_property = indigo_filter_cached_property(device, INDIGO_FILTER_CCD_INDEX, CCD_EXPOSURE_PROPERTY_NAME);
+	if (remote_exposure_property) {
+		AGENT_IMAGER_BATCH_PROPERTY->state = INDIGO_BUSY_STATE;
+		indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
+		int count = AGENT_IMAGER_BATCH_COUNT_ITEM->number.target;
+		for (int i = count; AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE && i != 0; i--) {
+			if (i < 0)
+				i = -1;
+			AGENT_IMAGER_BATCH_COUNT_ITEM->number.value = i;
+			double time = AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.target;
+			AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = time;
+			indigo_change_number_property_1(FILTER_DEVICE_CONTEXT->client, remote_exposure_property->device, CCD_EXPOSURE_PROPERTY_NAME, CCD_EXPOSURE_ITEM_NAME, time);
 			indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
-			int count = AGENT_IMAGER_BATCH_COUNT_ITEM->number.target;
-			for (int i = count; AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE && i != 0; i--) {
-				if (i < 0)
-					i = -1;
-				AGENT_IMAGER_BATCH_COUNT_ITEM->number.value = i;
-				double time = AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.target;
-				AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = time;
-				indigo_change_number_property_1(FILTER_DEVICE_CONTEXT->client, remote_exposure_property->device, CCD_EXPOSURE_PROPERTY_NAME, CCD_EXPOSURE_ITEM_NAME, time);
-				indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
-				
-				for (int i = 0; remote_exposure_property->state != INDIGO_BUSY_STATE && i < 1000; i++)
-					indigo_usleep(1000);
-				if (remote_exposure_property->state != INDIGO_BUSY_STATE) {
-					INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't become busy in 1 second");
+			
+			indigo_filter_wait_result wait = indigo_filter_wait_for_busy_state(device, remote_exposure_property, true, 1, NULL);
+			if (wait == INDIGO_FILTER_WAIT_TIMEOUT) {
+				INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't become busy in 1 second");
+				break;
+			}
+			while (wait == INDIGO_FILTER_WAIT_OK) {
+				if (time > 1) {
+					wait = indigo_filter_wait_for_busy_state(device, remote_exposure_property, false, 1, NULL);
+					if (wait != INDIGO_FILTER_WAIT_TIMEOUT)
+						break;
+					wait = INDIGO_FILTER_WAIT_OK;
+					time -= 1;
+					AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = time;
+					indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
+				} else {
+					wait = indigo_filter_wait_for_busy_state(device, remote_exposure_property, false, time + EXPOSURE_TIMEOUT_MARGIN, NULL);
 					break;
 				}
-				while (remote_exposure_property->state == INDIGO_BUSY_STATE) {
+			}
+			if (wait == INDIGO_FILTER_WAIT_DELETED) {
+				INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY deleted");
+				AGENT_START_PROCESS_PROPERTY->state = INDIGO_ALERT_STATE;
+				break;
+			}
+			if (wait == INDIGO_FILTER_WAIT_TIMEOUT) {
+				INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY didn't finish in time");
+				AGENT_START_PROCESS_PROPERTY->state = INDIGO_ALERT_STATE;
+				break;
+			}
+			AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = 0;
+			indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
+			if (i > 1) {
+				time = AGENT_IMAGER_BATCH_DELAY_ITEM->number.target;
+				if (AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target > 0) {
+					for (int i = 0; i < FILTER_DEVICE_CONTEXT->filter_related_agent_list_property->count; i++) {
+						indigo_item *agent = FILTER_DEVICE_CONTEXT->filter_related_agent_list_property->items + i;
+						if (agent->sw.value && !strncmp(agent->name, "Guider Agent", 12)) {
+							const char *item_names[] = { AGENT_GUIDER_SETTINGS_DITH_X_ITEM_NAME, AGENT_GUIDER_SETTINGS_DITH_Y_ITEM_NAME };
+							double item_values[] = { AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target * (2 * drand48() - 1), AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target * (2 * drand48() - 1) };
+							indigo_change_number_property(FILTER_DEVICE_CONTEXT->client, agent->name, AGENT_GUIDER_SETTINGS_PROPERTY_NAME, 2, item_names, item_values);
+							time = MAX(AGENT_IMAGER_BATCH_DELAY_ITEM->number.target, AGENT_IMAGER_DITHERING_DELAY_ITEM->number.target);
+							break;
+						}
+					}
+				}
+				AGENT_IMAGER_BATCH_DELAY_ITEM->number.value = time;
+				indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
+				while (AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE && time > 0) {
 					if (time > 1) {
 						indigo_usleep(ONE_SECOND_DELAY);
 						time -= 1;
-						AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = time;
+						AGENT_IMAGER_BATCH_DELAY_ITEM->number.value = time;
 						indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
 					} else {
 						indigo_usleep(10000);
 						time -= 0.01;
 					}
 				}
-				AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = 0;
+				AGENT_IMAGER_BATCH_DELAY_ITEM->number.value = 0;
 				indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
-				if (i > 1) {
-					time = AGENT_IMAGER_BATCH_DELAY_ITEM->number.target;
-					if (AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target > 0) {
-						for (int i = 0; i < FILTER_DEVICE_CONTEXT->filter_related_agent_list_property->count; i++) {
-							indigo_item *agent = FILTER_DEVICE_CONTEXT->filter_related_agent_list_property->items + i;
-							if (agent->sw.value && !strncmp(agent->name, "Guider Agent", 12)) {
-								const char *item_names[] = { AGENT_GUIDER_SETTINGS_DITH_X_ITEM_NAME, AGENT_GUIDER_SETTINGS_DITH_Y_ITEM_NAME };
-								double item_values[] = { AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target * (2 * drand48() - 1), AGENT_IMAGER_DITHERING_AGGRESSIVITY_ITEM->number.target * (2 * drand48() - 1) };
-								indigo_change_number_property(FILTER_DEVICE_CONTEXT->client, agent->name, AGENT_GUIDER_SETTINGS_PROPERTY_NAME, 2, item_names, item_values);
-								time = MAX(AGENT_IMAGER_BATCH_DELAY_ITEM->number.target, AGENT_IMAGER_DITHERING_DELAY_ITEM->number.target);
-								break;
-							}
-						}
-					}
-					AGENT_IMAGER_BATCH_DELAY_ITEM->number.value = time;
-					indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
-					while (AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE && time > 0) {
-						if (time > 1) {
-							indigo_usleep(ONE_SECOND_DELAY);
-							time -= 1;
-							AGENT_IMAGER_BATCH_DELAY_ITEM->number.value = time;
-							indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
-						} else {
-							indigo_usleep(10000);
-							time -= 0.01;
-						}
-					}
-					AGENT_IMAGER_BATCH_DELAY_ITEM->number.value = 0;
-					indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
-				}
 			}
-			AGENT_IMAGER_BATCH_COUNT_ITEM->number.value = AGENT_IMAGER_BATCH_COUNT_ITEM->number.target;
-			AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.target;
-			AGENT_IMAGER_BATCH_DELAY_ITEM->number.value = AGENT_IMAGER_BATCH_DELAY_ITEM->number.target;
-			AGENT_IMAGER_BATCH_PROPERTY->state = INDIGO_OK_STATE;
-			indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
-			if (AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-				AGENT_START_PROCESS_PROPERTY->state = INDIGO_OK_STATE;
-			indigo_update_property(device, AGENT_START_PROCESS_PROPERTY, NULL);
-			if (AGENT_START_PROCESS_PROPERTY->state == INDIGO_OK_STATE)
-				indigo_send_message(device, "Batch finished");
-			else
-				indigo_send_message(device, "Batch failed");
-			return;
 		}
+		AGENT_IMAGER_BATCH_COUNT_ITEM->number.value = AGENT_IMAGER_BATCH_COUNT_ITEM->number.target;
+		AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.target;
+		AGENT_IMAGER_BATCH_DELAY_ITEM->number.value = AGENT_IMAGER_BATCH_DELAY_ITEM->number.target;
+		AGENT_IMAGER_BATCH_PROPERTY->state = INDIGO_OK_STATE;
+		indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
+		if (AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+			AGENT_START_PROCESS_PROPERTY->state = INDIGO_OK_STATE;
+		indigo_update_property(device, AGENT_START_PROCESS_PROPERTY, NULL);
+		if (AGENT_START_PROCESS_PROPERTY->state == INDIGO_OK_STATE)
+			indigo_send_message(device, "Batch finished");
+		else
+			indigo_send_message(device, "Batch failed");
+		return;
 	}
 	if (remote_exposure_property == NULL) {
 		INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_EXPOSURE_PROPERTY not found");
@@ -334,63 +345,66 @@ static void exposure_batch(indigo_device *device) {
 }
 
 static void streaming_batch(indigo_device *device) {
-	indigo_property **cache = FILTER_DEVICE_CONTEXT->device_property_cache;
 	indigo_property *remote_streaming_property = NULL;
 	set_headers(device);
-	for (int j = 0; j < INDIGO_FILTER_MAX_CACHED_PROPERTIES; j++) {
-		if (cache[j] && !strcmp(cache[j]->device, FILTER_DEVICE_CONTEXT->device_name[INDIGO_FILTER_CCD_INDEX]) && !strcmp(cache[j]->name, CCD_STREAMING_PROPERTY_NAME)) {
-			remote_streaming_property = cache[j];
-			int exposure_index = -1;
-			int count_index = -1;
-			for (int i = 0; i < remote_streaming_property->count; i++) {
-				if (!strcmp(remote_streaming_property->items[i].name, CCD_STREAMING_EXPOSURE_ITEM_NAME))
-					exposure_index = i;
-				else if (!strcmp(remote_streaming_property->items[i].name, CCD_STREAMING_COUNT_ITEM_NAME))
-					count_index = i;
-			}
-			if (exposure_index == -1 || count_index == -1) {
-				indigo_send_message(device, "%s: CCD_STREAMING_EXPOSURE_ITEM or CCD_STREAMING_COUNT_ITEM not found in CCD_STREAMING_PROPERTY", IMAGER_AGENT_NAME);
-				break;
+	remote_streaming_property = indigo_filter_cached_property(device, INDIGO_FILTER_CCD_INDEX, CCD_STREAMING_PROPERTY_NAME);
+	if (remote_streaming_property) {
+		int exposure_index = -1;
+		int count_index = -1;
+		for (int i = 0; i < remote_streaming_property->count; i++) {
+			if (!strcmp(remote_streaming_property->items[i].name, CCD_STREAMING_EXPOSURE_ITEM_NAME))
+				exposure_index = i;
+			else if (!strcmp(remote_streaming_property->items[i].name, CCD_STREAMING_COUNT_ITEM_NAME))
+				count_index = i;
+		}
+		if (exposure_index == -1 || count_index == -1) {
+			indigo_send_message(device, "%s: CCD_STREAMING_EXPOSURE_ITEM or CCD_STREAMING_COUNT_ITEM not found in CCD_STREAMING_PROPERTY", IMAGER_AGENT_NAME);
+			goto failure;
+		}
+		AGENT_IMAGER_BATCH_PROPERTY->state = INDIGO_BUSY_STATE;
+		indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
+		char const *names[] = { AGENT_IMAGER_BATCH_COUNT_ITEM_NAME, AGENT_IMAGER_BATCH_EXPOSURE_ITEM_NAME };
+		double values[] = { AGENT_IMAGER_BATCH_COUNT_ITEM->number.target, AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.target };
+		indigo_change_number_property(FILTER_DEVICE_CONTEXT->client, remote_streaming_property->device, CCD_STREAMING_PROPERTY_NAME, 2, names, values);
+		indigo_filter_wait_result wait = indigo_filter_wait_for_busy_state(device, remote_streaming_property, true, 1, NULL);
+		if (wait == INDIGO_FILTER_WAIT_TIMEOUT) {
+			INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_STREAMING_PROPERTY didn't become busy in 1 second");
+			goto failure;
+		}
+		while (wait != INDIGO_FILTER_WAIT_DELETED && AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE) {
+			double time = remote_streaming_property->items[exposure_index].number.value;
+			if (time > 1) {
+				AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = time;
+				AGENT_IMAGER_BATCH_COUNT_ITEM->number.value = remote_streaming_property->items[count_index].number.value;
+				indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
+				wait = indigo_filter_wait_for_busy_state(device, remote_streaming_property, false, 1, AGENT_START_PROCESS_PROPERTY);
+			} else {
+				wait = indigo_filter_wait_for_busy_state(device, remote_streaming_property, false, 0.01, AGENT_START_PROCESS_PROPERTY);
 			}
-			AGENT_IMAGER_BATCH_PROPERTY->state = INDIGO_BUSY_STATE;
-			indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
-			char const *names[] = { AGENT_IMAGER_BATCH_COUNT_ITEM_NAME, AGENT_IMAGER_BATCH_EXPOSURE_ITEM_NAME };
-			double values[] = { AGENT_IMAGER_BATCH_COUNT_ITEM->number.target, AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.target };
-			indigo_change_number_property(FILTER_DEVICE_CONTEXT->client, remote_streaming_property->device, CCD_STREAMING_PROPERTY_NAME, 2, names, values);
-			for (int i = 0; remote_streaming_property->state != INDIGO_BUSY_STATE && i < 1000; i++)
-				indigo_usleep(1000);
-			if (remote_streaming_property->state != INDIGO_BUSY_STATE) {
-				INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_STREAMING_PROPERTY didn't become busy in 1 second");
+			if (wait == INDIGO_FILTER_WAIT_OK)
 				break;
-			}
-			while (AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE && remote_streaming_property->state == INDIGO_BUSY_STATE) {
-				double time = remote_streaming_property->items[exposure_index].number.value;
-				if (time > 1) {
-					AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = time;
-					AGENT_IMAGER_BATCH_COUNT_ITEM->number.value = remote_streaming_property->items[count_index].number.value;
-					indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
-					indigo_usleep(ONE_SECOND_DELAY);
-				} else {
-					indigo_usleep(10000);
-				}
-			}
-			AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = 0;
-			indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
-			AGENT_IMAGER_BATCH_COUNT_ITEM->number.value = AGENT_IMAGER_BATCH_COUNT_ITEM->number.target;
-			AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.target;
-			AGENT_IMAGER_BATCH_DELAY_ITEM->number.value = AGENT_IMAGER_BATCH_DELAY_ITEM->number.target;
-			AGENT_IMAGER_BATCH_PROPERTY->state = INDIGO_OK_STATE;
-			indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
-			if (AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
-				AGENT_START_PROCESS_PROPERTY->state = INDIGO_OK_STATE;
-			indigo_update_property(device, AGENT_START_PROCESS_PROPERTY, NULL);
-			if (AGENT_START_PROCESS_PROPERTY->state == INDIGO_OK_STATE)
-				indigo_send_message(device, "Batch finished");
-			else
-				indigo_send_message(device, "Batch failed");
-			return;
 		}
+		if (wait == INDIGO_FILTER_WAIT_DELETED) {
+			INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_STREAMING_PROPERTY deleted");
+			goto failure;
+		}
+		AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = 0;
+		indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
+		AGENT_IMAGER_BATCH_COUNT_ITEM->number.value = AGENT_IMAGER_BATCH_COUNT_ITEM->number.target;
+		AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.value = AGENT_IMAGER_BATCH_EXPOSURE_ITEM->number.target;
+		AGENT_IMAGER_BATCH_DELAY_ITEM->number.value = AGENT_IMAGER_BATCH_DELAY_ITEM->number.target;
+		AGENT_IMAGER_BATCH_PROPERTY->state = INDIGO_OK_STATE;
+		indigo_update_property(device, AGENT_IMAGER_BATCH_PROPERTY, NULL);
+		if (AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE)
+			AGENT_START_PROCESS_PROPERTY->state = INDIGO_OK_STATE;
+		indigo_update_property(device, AGENT_START_PROCESS_PROPERTY, NULL);
+		if (AGENT_START_PROCESS_PROPERTY->state == INDIGO_OK_STATE)
+			indigo_send_message(device, "Batch finished");
+		else
+			indigo_send_message(device, "Batch failed");
+		return;
 	}
+failure:
 	if (remote_streaming_property == NULL) {
 		INDIGO_DRIVER_ERROR(DRIVER_NAME, "CCD_STREAMING_PROPERTY not found");
 	}
@@ -475,9 +489,18 @@ static void autofocus(indigo_device *device) {
 			}
 			indigo_change_number_property_1(FILTER_DEVICE_CONTEXT->client, device_name, FOCUSER_STEPS_PROPERTY_NAME, FOCUSER_STEPS_ITEM_NAME, steps_with_backlash);
 		}
-		indigo_usleep(500000);
-		while (remote_steps_property->state == INDIGO_BUSY_STATE) {
-			indigo_usleep(500000);
+		indigo_filter_wait_result wait = indigo_filter_wait_for_busy_state(device, remote_steps_property, true, 0.5, AGENT_START_PROCESS_PROPERTY);
+		if (wait != INDIGO_FILTER_WAIT_DELETED)
+			wait = indigo_filter_wait_for_busy_state(device, remote_steps_property, false, FOCUSER_MOVE_TIMEOUT, NULL);
+		if (wait == INDIGO_FILTER_WAIT_DELETED) {
+			INDIGO_DRIVER_ERROR(DRIVER_NAME, "FOCUSER_STEPS_PROPERTY deleted");
+			AGENT_START_PROCESS_PROPERTY->state = INDIGO_ALERT_STATE;
+			goto finished;
+		}
+		if (wait == INDIGO_FILTER_WAIT_TIMEOUT) {
+			INDIGO_DRIVER_ERROR(DRIVER_NAME, "FOCUSER_STEPS_PROPERTY didn't finish in %d seconds", FOCUSER_MOVE_TIMEOUT);
+			AGENT_START_PROCESS_PROPERTY->state = INDIGO_ALERT_STATE;
+			goto finished;
 		}
 		last_quality = quality;
 	}
@@ -617,6 +640,7 @@ static void abort_batch(indigo_device *device) {
 	if (AGENT_START_PROCESS_PROPERTY->state == INDIGO_BUSY_STATE) {
 		indigo_change_switch_property_1(FILTER_DEVICE_CONTEXT->client, FILTER_DEVICE_CONTEXT->device_name[INDIGO_FILTER_CCD_INDEX], CCD_ABORT_EXPOSURE_PROPERTY_NAME, CCD_ABORT_EXPOSURE_ITEM_NAME, true);
 		AGENT_START_PROCESS_PROPERTY->state = INDIGO_OK_STATE;
+		indigo_filter_wake_waiting(device);
 		indigo_update_property(device, AGENT_START_PROCESS_PROPERTY, NULL);
 	}
 }
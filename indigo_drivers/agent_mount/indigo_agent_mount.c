@@ -99,8 +99,7 @@ static void save_config(indigo_device *device) {
 	AGENT_HA_TRACKING_LIMIT_ITEM->number.value = tmp_ha_tracking_limit;
 	 AGENT_LOCAL_TIME_LIMIT_ITEM->number.value = tmp_local_time_limit;
 	if (DEVICE_CONTEXT->property_save_file_handle) {
-		CONFIG_PROPERTY->state = INDIGO_OK_STATE;
-		close(DEVICE_CONTEXT->property_save_file_handle);
+		CONFIG_PROPERTY->state = indigo_close_config_file(DEVICE_CONTEXT->property_save_file_handle) == INDIGO_OK ? INDIGO_OK_STATE : INDIGO_ALERT_STATE;
 		DEVICE_CONTEXT->property_save_file_handle = 0;
 	} else {
 		CONFIG_PROPERTY->state = INDIGO_ALERT_STATE;
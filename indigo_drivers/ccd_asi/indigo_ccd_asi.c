@@ -52,6 +52,8 @@
 
 #define ASI_MAX_FORMATS            4
 
+#define STREAMING_BUFFERS          4
+
 #define ASI_VENDOR_ID              0x03c3
 
 #define CCD_ADVANCED_GROUP         "Advanced"
@@ -501,25 +503,30 @@ static void streaming_timer_callback(indigo_device *device) {
 			INDIGO_DRIVER_ERROR(DRIVER_NAME, "ASIStartVideoCapture(%d) = %d", id, res);
 		} else {
 			INDIGO_DRIVER_DEBUG(DRIVER_NAME, "ASIStartVideoCapture(%d) = %d", id, res);
+			// ring buffers hold just the active frame, not the full sensor in RGB24
+			long frame_size = (long)(PRIVATE_DATA->exp_frame_width / PRIVATE_DATA->exp_bin_x) * (PRIVATE_DATA->exp_frame_height / PRIVATE_DATA->exp_bin_y) * PRIVATE_DATA->exp_bpp / 8;
+			indigo_ccd_streaming_start(device, STREAMING_BUFFERS, frame_size + FITS_HEADER_SIZE);
 			while (CCD_STREAMING_COUNT_ITEM->number.value != 0) {
+				unsigned char *buffer = indigo_ccd_streaming_buffer(device);
+				if (buffer == NULL) {
+					res = ASI_ERROR_GENERAL_ERROR;
+					break;
+				}
 				pthread_mutex_lock(&PRIVATE_DATA->usb_mutex);
-				res = ASIGetVideoData(id, PRIVATE_DATA->buffer + FITS_HEADER_SIZE, PRIVATE_DATA->buffer_size, timeout);
+				res = ASIGetVideoData(id, buffer + FITS_HEADER_SIZE, frame_size, timeout);
 				pthread_mutex_unlock(&PRIVATE_DATA->usb_mutex);
 				if (res) {
 					INDIGO_DRIVER_ERROR(DRIVER_NAME, "ASIGetVideoData((%d) = %d", id, res);
 					break;
 				}
 				INDIGO_DRIVER_DEBUG(DRIVER_NAME, "ASIGetVideoData((%d) = %d", id, res);
-				if (color_string) {
-					indigo_process_image(device, PRIVATE_DATA->buffer, (int)(PRIVATE_DATA->exp_frame_width / PRIVATE_DATA->exp_bin_x), (int)(PRIVATE_DATA->exp_frame_height / PRIVATE_DATA->exp_bin_y), PRIVATE_DATA->exp_bpp, true, false, keywords);
-				} else {
-					indigo_process_image(device, PRIVATE_DATA->buffer, (int)(PRIVATE_DATA->exp_frame_width / PRIVATE_DATA->exp_bin_x), (int)(PRIVATE_DATA->exp_frame_height / PRIVATE_DATA->exp_bin_y), PRIVATE_DATA->exp_bpp, true, false, NULL);
-				}
+				indigo_ccd_streaming_queue_frame(device, buffer, (int)(PRIVATE_DATA->exp_frame_width / PRIVATE_DATA->exp_bin_x), (int)(PRIVATE_DATA->exp_frame_height / PRIVATE_DATA->exp_bin_y), PRIVATE_DATA->exp_bpp, true, false, color_string ? keywords : NULL);
 				if (CCD_STREAMING_COUNT_ITEM->number.value > 0)
 					CCD_STREAMING_COUNT_ITEM->number.value -= 1;
 				CCD_STREAMING_PROPERTY->state = INDIGO_BUSY_STATE;
 				indigo_update_property(device, CCD_STREAMING_PROPERTY, NULL);
 			}
+			indigo_ccd_streaming_stop(device);
 			pthread_mutex_lock(&PRIVATE_DATA->usb_mutex);
 			res = ASIStopVideoCapture(id);
 			pthread_mutex_unlock(&PRIVATE_DATA->usb_mutex);
@@ -39,6 +39,8 @@
 
 #define WIDTH               1600
 #define HEIGHT              1200
+#define IMAGE_BUFFER_SIZE   (FITS_HEADER_SIZE + 3 * WIDTH * HEIGHT + 2880)
+#define STREAMING_BUFFERS   4
 #define TEMP_UPDATE         5.0
 #define STARS               30
 #define ECLIPSE							360
@@ -85,9 +87,9 @@ typedef struct {
 	indigo_property *guider_settings_property;
 
 	int star_x[STARS], star_y[STARS], star_a[STARS];
-	char imager_image[FITS_HEADER_SIZE + 3 * WIDTH * HEIGHT + 2880];
-	char guider_image[FITS_HEADER_SIZE + 3 * WIDTH * HEIGHT + 2880];
-	char dslr_image[FITS_HEADER_SIZE + 3 * WIDTH * HEIGHT + 2880];
+	char *imager_image;
+	char *guider_image;
+	char *dslr_image;
 	pthread_mutex_t image_mutex;
 	double target_temperature, current_temperature;
 	int current_slot;
@@ -178,6 +180,128 @@ static void gauss_blur(unsigned short *scl, unsigned short *tcl, int w, int h, d
 	box_blur(scl, tcl, w, h, (sizes[2] - 1) / 2);
 }
 
+static void create_frame(indigo_device *device, char *image, int *width, int *height) {
+	simulator_private_data *private_data = PRIVATE_DATA;
+	unsigned short *raw = (unsigned short *)(image + FITS_HEADER_SIZE);
+	int horizontal_bin = (int)CCD_BIN_HORIZONTAL_ITEM->number.value;
+	int vertical_bin = (int)CCD_BIN_VERTICAL_ITEM->number.value;
+	int frame_left = (int)CCD_FRAME_LEFT_ITEM->number.value / horizontal_bin;
+	int frame_top = (int)CCD_FRAME_TOP_ITEM->number.value / vertical_bin;
+	int frame_width = *width = (int)CCD_FRAME_WIDTH_ITEM->number.value / horizontal_bin;
+	int frame_height = *height = (int)CCD_FRAME_HEIGHT_ITEM->number.value / vertical_bin;
+	int size = frame_width * frame_height;
+	double gain = (CCD_GAIN_ITEM->number.value / 100);
+	int offset = (int)CCD_OFFSET_ITEM->number.value;
+	double gamma = CCD_GAMMA_ITEM->number.value;
+	bool light_frame = CCD_FRAME_TYPE_LIGHT_ITEM->sw.value || CCD_FRAME_TYPE_FLAT_ITEM->sw.value;
+
+	if (device == PRIVATE_DATA->imager && light_frame) {
+		for (int j = 0; j < frame_height; j++) {
+			int jj = (frame_top + j) * vertical_bin;
+			for (int i = 0; i < frame_width; i++) {
+				raw[j * frame_width + i] = indigo_ccd_simulator_raw_image[jj * WIDTH + (frame_left + i) * horizontal_bin] + (rand() & 0x7F);
+			}
+		}
+	} else if (device == PRIVATE_DATA->guider) {
+		for (int j = 0; j < frame_height; j++) {
+			int jj = j * j;
+			for (int i = 0; i < frame_width; i++) {
+				raw[j * frame_width + i] = GUIDER_IMAGE_GRADIENT_ITEM->number.target * sqrt(i * i + jj) + (rand() % (int)GUIDER_IMAGE_NOISE_VAR_ITEM->number.target) + GUIDER_IMAGE_NOISE_FIX_ITEM->number.target;
+			}
+		}
+	} else {
+		for (int i = 0; i < size; i++)
+			raw[i] = (rand() & 0x7F);
+	}
+
+	if (device == PRIVATE_DATA->guider && light_frame) {
+		static time_t start_time = 0;
+		if (start_time == 0)
+			start_time = time(NULL);
+		double ra_offset = GUIDER_IMAGE_PERR_VAL_ITEM->number.target * sin(GUIDER_IMAGE_PERR_SPD_ITEM->number.target * M_PI * ((time(NULL) - start_time) % 360) / 180) + PRIVATE_DATA->guider_ra_offset;
+		double x_offset = ra_offset * GUIDER_COS - PRIVATE_DATA->guider_dec_offset * GUIDER_SIN + PRIVATE_DATA->ao_ra_offset * AO_COS - PRIVATE_DATA->ao_dec_offset * AO_SIN + rand() / (double)RAND_MAX/10 - 0.1;
+		double y_offset = ra_offset * GUIDER_SIN + PRIVATE_DATA->guider_dec_offset * GUIDER_COS + PRIVATE_DATA->ao_ra_offset * AO_SIN + PRIVATE_DATA->ao_dec_offset * AO_COS + rand() / (double)RAND_MAX/10 - 0.1;
+		if (GUIDER_MODE_STARS_ITEM->sw.value) {
+			for (int i = 0; i < STARS; i++) {
+				double center_x = (private_data->star_x[i] + x_offset) / horizontal_bin;
+				if (center_x < 0)
+					center_x += WIDTH;
+				if (center_x >= WIDTH)
+					center_x -= WIDTH;
+				double center_y = (private_data->star_y[i] + y_offset) / vertical_bin;
+				if (center_y < 0)
+					center_y += HEIGHT;
+				if (center_y >= HEIGHT)
+					center_y -= HEIGHT;
+				center_x -= frame_left;
+				center_y -= frame_top;
+				int a = private_data->star_a[i];
+				int xMax = (int)round(center_x) + 4 / horizontal_bin;
+				int yMax = (int)round(center_y) + 4 / vertical_bin;
+				for (int y = yMax - 8 / vertical_bin; y <= yMax; y++) {
+					if (y < 0 || y >= frame_height)
+						continue;
+					int yw = y * frame_width;
+					double yy = center_y - y;
+					for (int x = xMax - 8 / horizontal_bin; x <= xMax; x++) {
+						if (x < 0 || x >= frame_width)
+							continue;
+						double xx = center_x - x;
+						double v = a * exp(-(xx * xx / 4 + yy * yy / 4));
+						raw[yw + x] += (unsigned short)v;
+					}
+				}
+			}
+		} else {
+			double center_x = (WIDTH / 2 + x_offset) / horizontal_bin - frame_left;
+			double center_y = (HEIGHT / 2 + y_offset) / vertical_bin - frame_top;
+			double eclipse_x = (WIDTH / 2 + PRIVATE_DATA->eclipse + x_offset) / horizontal_bin - frame_left;
+			double eclipse_y = (HEIGHT / 2 + PRIVATE_DATA->eclipse + y_offset) / vertical_bin - frame_top;
+			for (int y = 0; y <= HEIGHT / vertical_bin; y++) {
+				if (y < 0 || y >= frame_height)
+					continue;
+				int yw = y * frame_width;
+				double yy = (center_y - y) * vertical_bin;
+				double eclipse_yy = (eclipse_y - y) * vertical_bin;
+				for (int x = 0; x <= WIDTH / horizontal_bin; x++) {
+					if (x < 0 || x >= frame_width)
+						continue;
+					double xx = (center_x - x) * horizontal_bin;
+					double eclipse_xx = (eclipse_x - x) * horizontal_bin;
+					double value = 500000 * exp(-((xx * xx + yy * yy) / 20000.0));
+					if (GUIDER_MODE_ECLIPSE_ITEM->sw.value && eclipse_xx*eclipse_xx+eclipse_yy*eclipse_yy < 50000)
+						value = 0;
+					if (value < 65535)
+						raw[yw + x] += (unsigned short)value;
+					else
+						raw[yw + x] = 65535;
+				}
+			}
+			if (GUIDER_MODE_ECLIPSE_ITEM->sw.value) {
+				PRIVATE_DATA->eclipse++;
+				if (PRIVATE_DATA->eclipse > ECLIPSE)
+					PRIVATE_DATA->eclipse = -ECLIPSE;
+			}
+
+		}
+	}
+	for (int i = 0; i < size; i++) {
+		double value = raw[i] - offset;
+		if (value < 0)
+			value = 0;
+		value = gain * pow(value, gamma);
+		if (value > 65535)
+			value = 65535;
+		raw[i] = (unsigned short)value;
+	}
+	if (private_data->current_position != 0) {
+		unsigned short *tmp = malloc(2 * size);
+		gauss_blur(raw, tmp, frame_width, frame_height, private_data->current_position);
+		memcpy(raw, tmp, 2 * size);
+		free(tmp);
+	}
+}
+
 static void exposure_timer_callback(indigo_device *device) {
 	pthread_mutex_lock(&PRIVATE_DATA->image_mutex);
 	if (CCD_EXPOSURE_PROPERTY->state == INDIGO_BUSY_STATE) {
@@ -185,6 +309,7 @@ static void exposure_timer_callback(indigo_device *device) {
 		indigo_update_property(device, CCD_EXPOSURE_PROPERTY, NULL);
 		simulator_private_data *private_data = PRIVATE_DATA;
 		if (device == PRIVATE_DATA->dslr) {
+			private_data->dslr_image = indigo_writable_blob_buffer(private_data->dslr_image, IMAGE_BUFFER_SIZE);
 			unsigned char *raw = (unsigned char *)(private_data->dslr_image+FITS_HEADER_SIZE);
 			int size = WIDTH * HEIGHT * 3;
 			for (int i = 0; i < size; i++) {
@@ -196,125 +321,14 @@ static void exposure_timer_callback(indigo_device *device) {
 			}
 			indigo_process_image(device, private_data->dslr_image, WIDTH, HEIGHT, 24, true, true, NULL);
 		} else {
-			unsigned short *raw = (unsigned short *)((device == PRIVATE_DATA->guider ? private_data->guider_image : private_data->imager_image) + FITS_HEADER_SIZE);
-			int horizontal_bin = (int)CCD_BIN_HORIZONTAL_ITEM->number.value;
-			int vertical_bin = (int)CCD_BIN_VERTICAL_ITEM->number.value;
-			int frame_left = (int)CCD_FRAME_LEFT_ITEM->number.value / horizontal_bin;
-			int frame_top = (int)CCD_FRAME_TOP_ITEM->number.value / vertical_bin;
-			int frame_width = (int)CCD_FRAME_WIDTH_ITEM->number.value / horizontal_bin;
-			int frame_height = (int)CCD_FRAME_HEIGHT_ITEM->number.value / vertical_bin;
-			int size = frame_width * frame_height;
-			double gain = (CCD_GAIN_ITEM->number.value / 100);
-			int offset = (int)CCD_OFFSET_ITEM->number.value;
-			double gamma = CCD_GAMMA_ITEM->number.value;
-			bool light_frame = CCD_FRAME_TYPE_LIGHT_ITEM->sw.value || CCD_FRAME_TYPE_FLAT_ITEM->sw.value;
-
-			if (device == PRIVATE_DATA->imager && light_frame) {
-				for (int j = 0; j < frame_height; j++) {
-					int jj = (frame_top + j) * vertical_bin;
-					for (int i = 0; i < frame_width; i++) {
-						raw[j * frame_width + i] = indigo_ccd_simulator_raw_image[jj * WIDTH + (frame_left + i) * horizontal_bin] + (rand() & 0x7F);
-					}
-				}
-			} else if (device == PRIVATE_DATA->guider) {
-				for (int j = 0; j < frame_height; j++) {
-					int jj = j * j;
-					for (int i = 0; i < frame_width; i++) {
-						raw[j * frame_width + i] = GUIDER_IMAGE_GRADIENT_ITEM->number.target * sqrt(i * i + jj) + (rand() % (int)GUIDER_IMAGE_NOISE_VAR_ITEM->number.target) + GUIDER_IMAGE_NOISE_FIX_ITEM->number.target;
-					}
-				}
-			} else {
-				for (int i = 0; i < size; i++)
-					raw[i] = (rand() & 0x7F);
-			}
-
-			if (device == PRIVATE_DATA->guider && light_frame) {
-				static time_t start_time = 0;
-				if (start_time == 0)
-					start_time = time(NULL);
-				double ra_offset = GUIDER_IMAGE_PERR_VAL_ITEM->number.target * sin(GUIDER_IMAGE_PERR_SPD_ITEM->number.target * M_PI * ((time(NULL) - start_time) % 360) / 180) + PRIVATE_DATA->guider_ra_offset;
-				double x_offset = ra_offset * GUIDER_COS - PRIVATE_DATA->guider_dec_offset * GUIDER_SIN + PRIVATE_DATA->ao_ra_offset * AO_COS - PRIVATE_DATA->ao_dec_offset * AO_SIN + rand() / (double)RAND_MAX/10 - 0.1;
-				double y_offset = ra_offset * GUIDER_SIN + PRIVATE_DATA->guider_dec_offset * GUIDER_COS + PRIVATE_DATA->ao_ra_offset * AO_SIN + PRIVATE_DATA->ao_dec_offset * AO_COS + rand() / (double)RAND_MAX/10 - 0.1;
-				if (GUIDER_MODE_STARS_ITEM->sw.value) {
-					for (int i = 0; i < STARS; i++) {
-						double center_x = (private_data->star_x[i] + x_offset) / horizontal_bin;
-						if (center_x < 0)
-							center_x += WIDTH;
-						if (center_x >= WIDTH)
-							center_x -= WIDTH;
-						double center_y = (private_data->star_y[i] + y_offset) / vertical_bin;
-						if (center_y < 0)
-							center_y += HEIGHT;
-						if (center_y >= HEIGHT)
-							center_y -= HEIGHT;
-						center_x -= frame_left;
-						center_y -= frame_top;
-						int a = private_data->star_a[i];
-						int xMax = (int)round(center_x) + 4 / horizontal_bin;
-						int yMax = (int)round(center_y) + 4 / vertical_bin;
-						for (int y = yMax - 8 / vertical_bin; y <= yMax; y++) {
-							if (y < 0 || y >= frame_height)
-								continue;
-							int yw = y * frame_width;
-							double yy = center_y - y;
-							for (int x = xMax - 8 / horizontal_bin; x <= xMax; x++) {
-								if (x < 0 || x >= frame_width)
-									continue;
-								double xx = center_x - x;
-								double v = a * exp(-(xx * xx / 4 + yy * yy / 4));
-								raw[yw + x] += (unsigned short)v;
-							}
-						}
-					}
-				} else {
-					double center_x = (WIDTH / 2 + x_offset) / horizontal_bin - frame_left;
-					double center_y = (HEIGHT / 2 + y_offset) / vertical_bin - frame_top;
-					double eclipse_x = (WIDTH / 2 + PRIVATE_DATA->eclipse + x_offset) / horizontal_bin - frame_left;
-					double eclipse_y = (HEIGHT / 2 + PRIVATE_DATA->eclipse + y_offset) / vertical_bin - frame_top;
-					for (int y = 0; y <= HEIGHT / vertical_bin; y++) {
-						if (y < 0 || y >= frame_height)
-							continue;
-						int yw = y * frame_width;
-						double yy = (center_y - y) * vertical_bin;
-						double eclipse_yy = (eclipse_y - y) * vertical_bin;
-						for (int x = 0; x <= WIDTH / horizontal_bin; x++) {
-							if (x < 0 || x >= frame_width)
-								continue;
-							double xx = (center_x - x) * horizontal_bin;
-							double eclipse_xx = (eclipse_x - x) * horizontal_bin;
-							double value = 500000 * exp(-((xx * xx + yy * yy) / 20000.0));
-							if (GUIDER_MODE_ECLIPSE_ITEM->sw.value && eclipse_xx*eclipse_xx+eclipse_yy*eclipse_yy < 50000)
-								value = 0;
-							if (value < 65535)
-								raw[yw + x] += (unsigned short)value;
-							else
-								raw[yw + x] = 65535;
-						}
-					}
-					if (GUIDER_MODE_ECLIPSE_ITEM->sw.value) {
-						PRIVATE_DATA->eclipse++;
-						if (PRIVATE_DATA->eclipse > ECLIPSE)
-							PRIVATE_DATA->eclipse = -ECLIPSE;
-					}
-
-				}
-			}
-			for (int i = 0; i < size; i++) {
-				double value = raw[i] - offset;
-				if (value < 0)
-					value = 0;
-				value = gain * pow(value, gamma);
-				if (value > 65535)
-					value = 65535;
-				raw[i] = (unsigned short)value;
-			}
-			if (private_data->current_position != 0) {
-				unsigned short *tmp = malloc(2 * size);
-				gauss_blur(raw, tmp, frame_width, frame_height, private_data->current_position);
-				memcpy(raw, tmp, 2 * size);
-				free(tmp);
-			}
-			indigo_process_image(device, device == PRIVATE_DATA->guider ? private_data->guider_image : private_data->imager_image, frame_width, frame_height, 16, true, true, NULL);
+			if (device == PRIVATE_DATA->guider)
+				private_data->guider_image = indigo_writable_blob_buffer(private_data->guider_image, IMAGE_BUFFER_SIZE);
+			else
+				private_data->imager_image = indigo_writable_blob_buffer(private_data->imager_image, IMAGE_BUFFER_SIZE);
+			char *image = device == PRIVATE_DATA->guider ? private_data->guider_image : private_data->imager_image;
+			int frame_width, frame_height;
+			create_frame(device, image, &frame_width, &frame_height);
+			indigo_process_image(device, image, frame_width, frame_height, 16, true, true, NULL);
 		}
 		CCD_EXPOSURE_PROPERTY->state = INDIGO_OK_STATE;
 		indigo_update_property(device, CCD_EXPOSURE_PROPERTY, NULL);
@@ -322,6 +336,32 @@ static void exposure_timer_callback(indigo_device *device) {
 	pthread_mutex_unlock(&PRIVATE_DATA->image_mutex);
 }
 
+static void streaming_timer_callback(indigo_device *device) {
+	if (indigo_ccd_streaming_start(device, STREAMING_BUFFERS, IMAGE_BUFFER_SIZE)) {
+		while (IS_CONNECTED && CCD_STREAMING_COUNT_ITEM->number.value != 0 && CCD_STREAMING_PROPERTY->state == INDIGO_BUSY_STATE) {
+			char *image = indigo_ccd_streaming_buffer(device);
+			int frame_width, frame_height;
+			pthread_mutex_lock(&PRIVATE_DATA->image_mutex);
+			create_frame(device, image, &frame_width, &frame_height);
+			pthread_mutex_unlock(&PRIVATE_DATA->image_mutex);
+			if (CCD_STREAMING_EXPOSURE_ITEM->number.value > 0)
+				indigo_usleep((unsigned int)(CCD_STREAMING_EXPOSURE_ITEM->number.value * ONE_SECOND_DELAY));
+			indigo_ccd_streaming_queue_frame(device, image, frame_width, frame_height, 16, true, true, NULL);
+			if (CCD_STREAMING_COUNT_ITEM->number.value > 0)
+				CCD_STREAMING_COUNT_ITEM->number.value -= 1;
+			indigo_update_property(device, CCD_STREAMING_PROPERTY, NULL);
+		}
+		indigo_ccd_streaming_stop(device);
+		if (CCD_STREAMING_PROPERTY->state == INDIGO_BUSY_STATE) {
+			CCD_STREAMING_PROPERTY->state = INDIGO_OK_STATE;
+			indigo_update_property(device, CCD_STREAMING_PROPERTY, NULL);
+		}
+	} else {
+		CCD_STREAMING_PROPERTY->state = INDIGO_ALERT_STATE;
+		indigo_update_property(device, CCD_STREAMING_PROPERTY, "Streaming failed");
+	}
+}
+
 static void ccd_temperature_callback(indigo_device *device) {
 	double diff = PRIVATE_DATA->current_temperature - PRIVATE_DATA->target_temperature;
 	if (diff > 0) {
@@ -451,6 +491,8 @@ static indigo_result ccd_attach(indigo_device *device) {
 			CCD_INFO_PIXEL_WIDTH_ITEM->number.value = 5.2;
 			CCD_INFO_PIXEL_HEIGHT_ITEM->number.value = 5.2;
 			CCD_INFO_BITS_PER_PIXEL_ITEM->number.value = 16;
+			// -------------------------------------------------------------------------------- CCD_STREAMING
+			CCD_STREAMING_PROPERTY->hidden = false;
 			// -------------------------------------------------------------------------------- CCD_GAIN, CCD_OFFSET, CCD_GAMMA
 			CCD_GAIN_PROPERTY->hidden = CCD_OFFSET_PROPERTY->hidden = CCD_GAMMA_PROPERTY->hidden = false;
 			// -------------------------------------------------------------------------------- CCD_IMAGE
@@ -551,13 +593,23 @@ static indigo_result ccd_change_property(indigo_device *device, indigo_client *c
 		}
 	} else if (indigo_property_match(CCD_EXPOSURE_PROPERTY, property)) {
 		// -------------------------------------------------------------------------------- CCD_EXPOSURE
-		if (CCD_EXPOSURE_PROPERTY->state == INDIGO_BUSY_STATE)
+		if (CCD_EXPOSURE_PROPERTY->state == INDIGO_BUSY_STATE || CCD_STREAMING_PROPERTY->state == INDIGO_BUSY_STATE)
 			return INDIGO_OK;
 		indigo_property_copy_values(CCD_EXPOSURE_PROPERTY, property, false);
 		indigo_use_shortest_exposure_if_bias(device);
 		CCD_EXPOSURE_PROPERTY->state = INDIGO_BUSY_STATE;
 		indigo_update_property(device, CCD_EXPOSURE_PROPERTY, NULL);
 		PRIVATE_DATA->exposure_timer = indigo_set_timer(device, CCD_EXPOSURE_ITEM->number.value > 0 ? CCD_EXPOSURE_ITEM->number.value : 0.1, exposure_timer_callback);
+	} else if (indigo_property_match(CCD_STREAMING_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- CCD_STREAMING
+		if (CCD_EXPOSURE_PROPERTY->state == INDIGO_BUSY_STATE || CCD_STREAMING_PROPERTY->state == INDIGO_BUSY_STATE)
+			return INDIGO_OK;
+		indigo_property_copy_values(CCD_STREAMING_PROPERTY, property, false);
+		indigo_use_shortest_exposure_if_bias(device);
+		CCD_STREAMING_PROPERTY->state = INDIGO_BUSY_STATE;
+		indigo_update_property(device, CCD_STREAMING_PROPERTY, NULL);
+		PRIVATE_DATA->exposure_timer = indigo_set_timer(device, 0, streaming_timer_callback);
+		return INDIGO_OK;
 	} else if (indigo_property_match(CCD_ABORT_EXPOSURE_PROPERTY, property)) {
 		// -------------------------------------------------------------------------------- CCD_ABORT_EXPOSURE
 		indigo_property_copy_values(CCD_ABORT_EXPOSURE_PROPERTY, property, false);
@@ -1116,6 +1168,10 @@ indigo_result indigo_ccd_simulator(indigo_driver_action action, indigo_driver_in
 			pthread_mutex_init(&private_data->image_mutex, NULL);
 			assert(private_data != NULL);
 			memset(private_data, 0, sizeof(simulator_private_data));
+			// shared buffers are passed to BLOB cache without copying
+			private_data->imager_image = indigo_alloc_shared_blob_buffer(IMAGE_BUFFER_SIZE);
+			private_data->guider_image = indigo_alloc_shared_blob_buffer(IMAGE_BUFFER_SIZE);
+			private_data->dslr_image = indigo_alloc_shared_blob_buffer(IMAGE_BUFFER_SIZE);
 			imager_ccd = malloc(sizeof(indigo_device));
 			assert(imager_ccd != NULL);
 			memcpy(imager_ccd, &imager_camera_template, sizeof(indigo_device));
@@ -1196,6 +1252,9 @@ indigo_result indigo_ccd_simulator(indigo_driver_action action, indigo_driver_in
 			}
 			if (private_data != NULL) {
 				pthread_mutex_destroy(&private_data->image_mutex);
+				indigo_release_blob_buffer(private_data->imager_image);
+				indigo_release_blob_buffer(private_data->guider_image);
+				indigo_release_blob_buffer(private_data->dslr_image);
 				free(private_data);
 				private_data = NULL;
 			}
@@ -22,10 +22,16 @@
 #ifndef __BASE64_H
 #define __BASE64_H
 
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/** Use SIMD kernels if available (true by default), can be switched off for comparison or troubleshooting.
+ */
+extern bool indigo_use_base64_simd;
+
 extern long base64_encode(unsigned char *out, const unsigned char *in, long inlen);
 extern long base64_decode_fast(unsigned char *out, const unsigned char *in, long inlen);
 extern long base64_decode_fast_nl(unsigned char *out, const unsigned char *in, long inlen);
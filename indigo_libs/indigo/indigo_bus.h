@@ -338,6 +338,7 @@ typedef struct {
 	int input;													///< input handle
 	int output;													///< output handle
 	bool web_socket;										///< connection over WebSocket (RFC6455)
+	bool web_socket_deflate;						///< permessage-deflate negotiated for WebSocket (RFC7692)
 	char url_prefix[INDIGO_NAME_SIZE];	///< server url prefix (for BLOB download)
 } indigo_adapter_context;
 
@@ -348,9 +349,31 @@ typedef struct {
 	void *content;            					///< BLOB content
 	long size;              						///< BLOB size
 	char format[INDIGO_NAME_SIZE];  		///< BLOB format, known file type suffix like ".fits" or ".jpeg"
-	pthread_mutex_t mutext;							///< BLOB mutex
+	pthread_mutex_t mutext;							///< BLOB mutex (deprecated, locked while content is replaced or released, use indigo_retain_blob() instead)
+	void *buffer;												///< shared buffer holding content
 } indigo_blob_entry;
 
+/** Client queue statistics (summary of all client queues).
+ */
+typedef struct {
+	int clients;												///< number of clients with queue
+	int pending;												///< messages waiting for delivery
+	int high_water_mark;								///< max number of pending messages in a single queue
+	long queued;												///< messages queued
+	long delivered;											///< messages delivered
+	long coalesced;											///< updates merged into pending update of the same property
+	long stalled;												///< updates coalesced or dropped because queue was full
+} indigo_client_queue_stats;
+
+/** Queue statistics of a single client.
+ */
+typedef struct {
+	char name[INDIGO_NAME_SIZE];				///< client name
+	int pending;												///< messages waiting for delivery
+	int high_water_mark;								///< max number of pending messages
+	long stalled;												///< updates coalesced or dropped because queue was full
+} indigo_client_queue_info;
+
 /** Last diagnostic messages.
  */
 extern char indigo_last_message[];
@@ -471,12 +494,36 @@ extern indigo_property *indigo_resize_property(indigo_property *property, int co
 /** Allocate blob buffer (rounded up to 2880 bytes).
  */
 extern void *indigo_alloc_blob_buffer(long size);
+/** Allocate reference counted shared blob buffer (rounded up to 2880 bytes, reference count is set to 1).
+ If BLOB item value points to shared buffer, BLOB cache keeps reference to it instead of making a copy, so the buffer must not be modified after it is published - use indigo_writable_blob_buffer() before it is reused and indigo_release_blob_buffer() instead of free().
+ */
+extern void *indigo_alloc_shared_blob_buffer(long size);
+/** Get shared blob buffer safe for writing - returns the same buffer if nobody else references it, otherwise releases it and returns new one (content is not preserved).
+ */
+extern void *indigo_writable_blob_buffer(void *buffer, long size);
+/** Add reference to shared blob buffer (pointer can point anywhere inside of the buffer), returns false if it is not shared blob buffer.
+ */
+extern bool indigo_retain_blob_buffer(void *buffer);
+/** Release reference to shared blob buffer (pointer can point anywhere inside of the buffer), buffer is freed when the last reference is released.
+ */
+extern void indigo_release_blob_buffer(void *buffer);
+/** Get file handle backing shared blob buffer (usable with sendfile()) and offset of pointer in it, -1 is returned if buffer is not file backed.
+ Handle is valid only until the last reference to the buffer is released.
+ */
+extern int indigo_blob_buffer_handle(void *buffer, long *offset);
+/** Get item of the property registered by driver for item of the property copy delivered by client queue (e.g. to build BLOB URL), item itself is returned otherwise.
+ */
+extern indigo_item *indigo_registered_blob_item(indigo_property *property, indigo_item *item);
 /** Resize property.
  */
 extern void indigo_release_property(indigo_property *property);
 /** Validate address of item of registered BLOB property.
+ Returned entry can be used just as existence check, it can be released by another thread at any time - use indigo_retain_blob() to access the content.
  */
 extern indigo_blob_entry *indigo_validate_blob(indigo_item *item);
+/** Get snapshot of cached BLOB content with reference to it (mutext is not initialized), content must be released by indigo_release_blob_buffer().
+ */
+extern bool indigo_retain_blob(indigo_item *item, indigo_blob_entry *blob);
 
 /** Initialize text item.
  */
@@ -633,6 +680,22 @@ extern bool indigo_use_blob_caching;
  */
 extern bool indigo_use_strict_locking;
 
+/** Deliver messages to remote clients asynchronously, each client has its own queue and sender thread.
+ */
+extern bool indigo_use_client_queues;
+
+/** Max number of pending messages in client queue, sender is never blocked, when the queue is full, pending update is coalesced or dropped.
+ */
+extern int indigo_client_queue_size;
+
+/** Get summary of client queue statistics.
+ */
+extern void indigo_get_client_queue_stats(indigo_client_queue_stats *stats);
+
+/** Get statistics of individual client queues, returns number of entries filled.
+ */
+extern int indigo_get_client_queue_info(indigo_client_queue_info *info, int max_count);
+
 #ifdef __cplusplus
 }
 #endif
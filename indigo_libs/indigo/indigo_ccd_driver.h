@@ -125,6 +125,50 @@ extern "C" {
  */
 #define CCD_LOCAL_MODE_PREFIX_ITEM        (CCD_LOCAL_MODE_PROPERTY->items+1)
 
+/** CCD_LOCAL_MODE_WRITER property pointer, property is mandatory, property change request is fully handled by indigo_ccd_change_property().
+ */
+#define CCD_LOCAL_MODE_WRITER_PROPERTY    (CCD_CONTEXT->ccd_local_mode_writer_property)
+
+/** CCD_LOCAL_MODE_WRITER.QUEUE property item pointer.
+ */
+#define CCD_LOCAL_MODE_WRITER_QUEUE_ITEM  (CCD_LOCAL_MODE_WRITER_PROPERTY->items+0)
+
+/** CCD_LOCAL_MODE_SYNC property pointer, property is mandatory, property change request is fully handled by indigo_ccd_change_property().
+ */
+#define CCD_LOCAL_MODE_SYNC_PROPERTY      (CCD_CONTEXT->ccd_local_mode_sync_property)
+
+/** CCD_LOCAL_MODE_SYNC.NONE property item pointer.
+ */
+#define CCD_LOCAL_MODE_SYNC_NONE_ITEM     (CCD_LOCAL_MODE_SYNC_PROPERTY->items+0)
+
+/** CCD_LOCAL_MODE_SYNC.DATA property item pointer.
+ */
+#define CCD_LOCAL_MODE_SYNC_DATA_ITEM     (CCD_LOCAL_MODE_SYNC_PROPERTY->items+1)
+
+/** CCD_LOCAL_MODE_SYNC.FULL property item pointer.
+ */
+#define CCD_LOCAL_MODE_SYNC_FULL_ITEM     (CCD_LOCAL_MODE_SYNC_PROPERTY->items+2)
+
+/** CCD_LOCAL_MODE_STATS property pointer, property is mandatory, read-only property.
+ */
+#define CCD_LOCAL_MODE_STATS_PROPERTY     (CCD_CONTEXT->ccd_local_mode_stats_property)
+
+/** CCD_LOCAL_MODE_STATS.PENDING property item pointer.
+ */
+#define CCD_LOCAL_MODE_STATS_PENDING_ITEM (CCD_LOCAL_MODE_STATS_PROPERTY->items+0)
+
+/** CCD_LOCAL_MODE_STATS.WRITTEN property item pointer.
+ */
+#define CCD_LOCAL_MODE_STATS_WRITTEN_ITEM (CCD_LOCAL_MODE_STATS_PROPERTY->items+1)
+
+/** CCD_LOCAL_MODE_STATS.THROUGHPUT property item pointer.
+ */
+#define CCD_LOCAL_MODE_STATS_THROUGHPUT_ITEM (CCD_LOCAL_MODE_STATS_PROPERTY->items+2)
+
+/** CCD_LOCAL_MODE_STATS.LATENCY property item pointer.
+ */
+#define CCD_LOCAL_MODE_STATS_LATENCY_ITEM (CCD_LOCAL_MODE_STATS_PROPERTY->items+3)
+
 /** CCD_EXPOSURE property pointer, property is mandatory, property change request handler should set property items and state and call indigo_ccd_change_property().
  */
 #define CCD_EXPOSURE_PROPERTY             (CCD_CONTEXT->ccd_exposure_property)
@@ -145,6 +189,54 @@ extern "C" {
  */
 #define CCD_STREAMING_COUNT_ITEM          (CCD_STREAMING_PROPERTY->items+1)
 
+/** CCD_STREAMING_STATS property pointer, property is defined together with CCD_STREAMING and fully handled by streaming pipeline.
+ */
+#define CCD_STREAMING_STATS_PROPERTY      (CCD_CONTEXT->ccd_streaming_stats_property)
+
+/** CCD_STREAMING_STATS.CAPTURED property item pointer.
+ */
+#define CCD_STREAMING_STATS_CAPTURED_ITEM (CCD_STREAMING_STATS_PROPERTY->items+0)
+
+/** CCD_STREAMING_STATS.PROCESSED property item pointer.
+ */
+#define CCD_STREAMING_STATS_PROCESSED_ITEM (CCD_STREAMING_STATS_PROPERTY->items+1)
+
+/** CCD_STREAMING_STATS.DROPPED property item pointer.
+ */
+#define CCD_STREAMING_STATS_DROPPED_ITEM  (CCD_STREAMING_STATS_PROPERTY->items+2)
+
+/** CCD_STREAMING_POLICY property pointer, property is defined together with CCD_STREAMING, property change request is fully handled by indigo_ccd_change_property().
+ */
+#define CCD_STREAMING_POLICY_PROPERTY     (CCD_CONTEXT->ccd_streaming_policy_property)
+
+/** CCD_STREAMING_POLICY.DROP_OLDEST property item pointer.
+ */
+#define CCD_STREAMING_POLICY_DROP_OLDEST_ITEM (CCD_STREAMING_POLICY_PROPERTY->items+0)
+
+/** CCD_STREAMING_POLICY.DROP_NEWEST property item pointer.
+ */
+#define CCD_STREAMING_POLICY_DROP_NEWEST_ITEM (CCD_STREAMING_POLICY_PROPERTY->items+1)
+
+/** CCD_STREAMING_MODE property pointer, property is defined together with CCD_STREAMING, property change request is fully handled by indigo_ccd_change_property().
+ */
+#define CCD_STREAMING_MODE_PROPERTY       (CCD_CONTEXT->ccd_streaming_mode_property)
+
+/** CCD_STREAMING_MODE.FRAMES property item pointer.
+ */
+#define CCD_STREAMING_MODE_FRAMES_ITEM    (CCD_STREAMING_MODE_PROPERTY->items+0)
+
+/** CCD_STREAMING_MODE.SER property item pointer.
+ */
+#define CCD_STREAMING_MODE_SER_ITEM       (CCD_STREAMING_MODE_PROPERTY->items+1)
+
+/** CCD_STREAMING_PREVIEW property pointer, property is defined together with CCD_STREAMING, property change request is fully handled by indigo_ccd_change_property().
+ */
+#define CCD_STREAMING_PREVIEW_PROPERTY    (CCD_CONTEXT->ccd_streaming_preview_property)
+
+/** CCD_STREAMING_PREVIEW.INTERVAL property item pointer.
+ */
+#define CCD_STREAMING_PREVIEW_INTERVAL_ITEM (CCD_STREAMING_PREVIEW_PROPERTY->items+0)
+
 /** CCD_ABORT property pointer, property is mandatory, property change request handler should set property items and state and call indigo_ccd_change_property().
  */
 #define CCD_ABORT_EXPOSURE_PROPERTY       (CCD_CONTEXT->ccd_abort_exposure_property)
@@ -297,6 +389,114 @@ extern "C" {
  */
 #define CCD_PREVIEW_IMAGE_ITEM            (CCD_PREVIEW_IMAGE_PROPERTY->items+0)
 
+/** CCD_PREVIEW_SETTINGS property pointer, property is mandatory, visible if preview is enabled, property change request is fully handled by indigo_ccd_change_property().
+ */
+#define CCD_PREVIEW_SETTINGS_PROPERTY     (CCD_CONTEXT->ccd_preview_settings_property)
+
+/** CCD_PREVIEW_SETTINGS.MAX_SIZE property item pointer.
+ */
+#define CCD_PREVIEW_SETTINGS_MAX_SIZE_ITEM (CCD_PREVIEW_SETTINGS_PROPERTY->items+0)
+
+/** CCD_PREVIEW_SETTINGS.LEFT property item pointer.
+ */
+#define CCD_PREVIEW_SETTINGS_LEFT_ITEM    (CCD_PREVIEW_SETTINGS_PROPERTY->items+1)
+
+/** CCD_PREVIEW_SETTINGS.TOP property item pointer.
+ */
+#define CCD_PREVIEW_SETTINGS_TOP_ITEM     (CCD_PREVIEW_SETTINGS_PROPERTY->items+2)
+
+/** CCD_PREVIEW_SETTINGS.WIDTH property item pointer.
+ */
+#define CCD_PREVIEW_SETTINGS_WIDTH_ITEM   (CCD_PREVIEW_SETTINGS_PROPERTY->items+3)
+
+/** CCD_PREVIEW_SETTINGS.HEIGHT property item pointer.
+ */
+#define CCD_PREVIEW_SETTINGS_HEIGHT_ITEM  (CCD_PREVIEW_SETTINGS_PROPERTY->items+4)
+
+/** CCD_PREVIEW_SETTINGS.INTERVAL property item pointer.
+ */
+#define CCD_PREVIEW_SETTINGS_INTERVAL_ITEM (CCD_PREVIEW_SETTINGS_PROPERTY->items+5)
+
+/** CCD_ANALYSIS property pointer, property is mandatory, property change request is fully handled by indigo_ccd_change_property().
+ */
+#define CCD_ANALYSIS_PROPERTY             (CCD_CONTEXT->ccd_analysis_property)
+
+/** CCD_ANALYSIS.ENABLED property item pointer.
+ */
+#define CCD_ANALYSIS_ENABLED_ITEM         (CCD_ANALYSIS_PROPERTY->items+0)
+
+/** CCD_ANALYSIS.DISABLED property item pointer.
+ */
+#define CCD_ANALYSIS_DISABLED_ITEM        (CCD_ANALYSIS_PROPERTY->items+1)
+
+/** CCD_ANALYSIS_SETTINGS property pointer, property is mandatory, visible if analysis is enabled, property change request is fully handled by indigo_ccd_change_property().
+ */
+#define CCD_ANALYSIS_SETTINGS_PROPERTY    (CCD_CONTEXT->ccd_analysis_settings_property)
+
+/** CCD_ANALYSIS_SETTINGS.THRESHOLD property item pointer.
+ */
+#define CCD_ANALYSIS_SETTINGS_THRESHOLD_ITEM (CCD_ANALYSIS_SETTINGS_PROPERTY->items+0)
+
+/** CCD_ANALYSIS_SETTINGS.RADIUS property item pointer.
+ */
+#define CCD_ANALYSIS_SETTINGS_RADIUS_ITEM (CCD_ANALYSIS_SETTINGS_PROPERTY->items+1)
+
+/** CCD_ANALYSIS_SETTINGS.SATURATION property item pointer.
+ */
+#define CCD_ANALYSIS_SETTINGS_SATURATION_ITEM (CCD_ANALYSIS_SETTINGS_PROPERTY->items+2)
+
+/** CCD_ANALYSIS_STATS property pointer, property is mandatory, visible if analysis is enabled, read-only property.
+ */
+#define CCD_ANALYSIS_STATS_PROPERTY       (CCD_CONTEXT->ccd_analysis_stats_property)
+
+/** CCD_ANALYSIS_STATS.MIN property item pointer.
+ */
+#define CCD_ANALYSIS_STATS_MIN_ITEM       (CCD_ANALYSIS_STATS_PROPERTY->items+0)
+
+/** CCD_ANALYSIS_STATS.MAX property item pointer.
+ */
+#define CCD_ANALYSIS_STATS_MAX_ITEM       (CCD_ANALYSIS_STATS_PROPERTY->items+1)
+
+/** CCD_ANALYSIS_STATS.MEAN property item pointer.
+ */
+#define CCD_ANALYSIS_STATS_MEAN_ITEM      (CCD_ANALYSIS_STATS_PROPERTY->items+2)
+
+/** CCD_ANALYSIS_STATS.MEDIAN property item pointer.
+ */
+#define CCD_ANALYSIS_STATS_MEDIAN_ITEM    (CCD_ANALYSIS_STATS_PROPERTY->items+3)
+
+/** CCD_ANALYSIS_STATS.STDDEV property item pointer.
+ */
+#define CCD_ANALYSIS_STATS_STDDEV_ITEM    (CCD_ANALYSIS_STATS_PROPERTY->items+4)
+
+/** CCD_ANALYSIS_STATS.SATURATED property item pointer.
+ */
+#define CCD_ANALYSIS_STATS_SATURATED_ITEM (CCD_ANALYSIS_STATS_PROPERTY->items+5)
+
+/** CCD_ANALYSIS_STATS.STARS property item pointer.
+ */
+#define CCD_ANALYSIS_STATS_STARS_ITEM     (CCD_ANALYSIS_STATS_PROPERTY->items+6)
+
+/** CCD_ANALYSIS_STATS.HFD property item pointer.
+ */
+#define CCD_ANALYSIS_STATS_HFD_ITEM       (CCD_ANALYSIS_STATS_PROPERTY->items+7)
+
+/** CCD_ANALYSIS_STATS.FWHM property item pointer.
+ */
+#define CCD_ANALYSIS_STATS_FWHM_ITEM      (CCD_ANALYSIS_STATS_PROPERTY->items+8)
+
+/** CCD_ANALYSIS_STARS property pointer, property is mandatory, visible if analysis is enabled, read-only property.
+ */
+#define CCD_ANALYSIS_STARS_PROPERTY       (CCD_CONTEXT->ccd_analysis_stars_property)
+
+/** Number of stars listed in CCD_ANALYSIS_STARS.
+ */
+#define CCD_ANALYSIS_MAX_STARS            10
+
+/** Number of CCD_ANALYSIS_STARS items per star (X, Y, HFD, FWHM and FLUX).
+ */
+#define CCD_ANALYSIS_STAR_ITEMS           5
+
 /** CCD_TEMPERATURE property pointer, property change request should be fully handled by device driver.
  */
 #define CCD_TEMPERATURE_PROPERTY          (CCD_CONTEXT->ccd_temperature_property)
@@ -389,14 +589,24 @@ typedef struct {
 	indigo_timer *countdown_timer;								///< countdown timer
 	void *preview_image;													///< preview image buffer
 	unsigned long preview_image_size;												///< preview image buffer size
+	double preview_time;													///< time of the last streamed preview
+	void *streaming;															///< streaming pipeline (private)
+	void *local_writer;														///< local mode writer queue (private)
 	indigo_property *ccd_info_property;           ///< CCD_INFO property pointer
 	indigo_property *ccd_upload_mode_property;    ///< CCD_UPLOAD_MODE property pointer
 	indigo_property *ccd_preview_property;				///< CCD_PREVIEW property pointer
 	indigo_property *ccd_local_mode_property;     ///< CCD_LOCAL_MODE property pointer
+	indigo_property *ccd_local_mode_writer_property; ///< CCD_LOCAL_MODE_WRITER property pointer
+	indigo_property *ccd_local_mode_sync_property; ///< CCD_LOCAL_MODE_SYNC property pointer
+	indigo_property *ccd_local_mode_stats_property; ///< CCD_LOCAL_MODE_STATS property pointer
 	indigo_property *ccd_mode_property;	          ///< CCD_MODE property pointer
 	indigo_property *ccd_read_mode_property;	  	///< CCD_READ_MODE property pointer
 	indigo_property *ccd_exposure_property;       ///< CCD_EXPOSURE property pointer
 	indigo_property *ccd_streaming_property;      ///< CCD_STREAMING property pointer
+	indigo_property *ccd_streaming_stats_property; ///< CCD_STREAMING_STATS property pointer
+	indigo_property *ccd_streaming_policy_property; ///< CCD_STREAMING_POLICY property pointer
+	indigo_property *ccd_streaming_mode_property; ///< CCD_STREAMING_MODE property pointer
+	indigo_property *ccd_streaming_preview_property; ///< CCD_STREAMING_PREVIEW property pointer
 	indigo_property *ccd_abort_exposure_property; ///< CCD_ABORT_EXPOSURE property pointer
 	indigo_property *ccd_frame_property;          ///< CCD_FRAME property pointer
 	indigo_property *ccd_bin_property;            ///< CCD_BIN property pointer
@@ -407,6 +617,11 @@ typedef struct {
 	indigo_property *ccd_image_format_property;   ///< CCD_IMAGE_FORMAT property pointer
 	indigo_property *ccd_image_property;          ///< CCD_IMAGE property pointer
 	indigo_property *ccd_preview_image_property;  ///< CCD_PREVIEW_IMAGE property pointer
+	indigo_property *ccd_preview_settings_property; ///< CCD_PREVIEW_SETTINGS property pointer
+	indigo_property *ccd_analysis_property;       ///< CCD_ANALYSIS property pointer
+	indigo_property *ccd_analysis_settings_property; ///< CCD_ANALYSIS_SETTINGS property pointer
+	indigo_property *ccd_analysis_stats_property; ///< CCD_ANALYSIS_STATS property pointer
+	indigo_property *ccd_analysis_stars_property; ///< CCD_ANALYSIS_STARS property pointer
 	indigo_property *ccd_image_file_property;     ///< CCD_IMAGE_FILE property pointer
 	indigo_property *ccd_temperature_property;    ///< CCD_TEMPERATURE property pointer
 	indigo_property *ccd_cooler_property;         ///< CCD_COOLER property pointer
@@ -460,6 +675,33 @@ typedef struct {
  */
 extern void indigo_process_image(indigo_device *device, void *data, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, indigo_fits_keyword *keywords);
 
+/** Convert raw image in image buffer (starting on data + FITS_HEADER_SIZE offset) to JPEG stretched according to CCD_JPEG_SETTINGS, returned buffer should be freed by caller.
+ */
+extern void indigo_raw_to_jpeg(indigo_device *device, void *data, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, void **data_out, unsigned long *size_out);
+
+/** Minimal number of frame buffers in streaming pipeline.
+ */
+#define INDIGO_CCD_STREAMING_MIN_BUFFERS	3
+
+/** Start streaming pipeline with count preallocated shared frame buffers of given size (including FITS_HEADER_SIZE).
+ Queued frames are processed by indigo_process_image() on a separate thread, so capture loop in the driver is not blocked by image conversion, local save or client upload.
+ If CCD_STREAMING_MODE is SER, frames are appended to a single SER file (local mode) or sent as SER chunks in CCD_IMAGE (client mode) instead.
+ */
+extern bool indigo_ccd_streaming_start(indigo_device *device, int count, long size);
+
+/** Get frame buffer to be filled by the capture loop (image data starting on FITS_HEADER_SIZE offset), NULL if streaming pipeline is not running.
+ */
+extern void *indigo_ccd_streaming_buffer(indigo_device *device);
+
+/** Queue filled frame buffer for processing. If all buffers are in use, the oldest queued or this frame is dropped according to CCD_STREAMING_POLICY.
+ Keywords must be valid until indigo_ccd_streaming_stop() is called.
+ */
+extern void indigo_ccd_streaming_queue_frame(indigo_device *device, void *buffer, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, indigo_fits_keyword *keywords);
+
+/** Wait until all queued frames are processed and release streaming pipeline.
+ */
+extern void indigo_ccd_streaming_stop(indigo_device *device);
+
 /** Process DSLR image in image buffer (starting on data).
  */
 extern void indigo_process_dslr_image(indigo_device *device, void *data, int blobsize, const char *suffix);
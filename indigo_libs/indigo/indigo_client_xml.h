@@ -38,6 +38,10 @@ extern "C" {
 extern indigo_device *indigo_xml_client_adapter(char *name, char *url_prefix, int input, int output);
 extern void indigo_release_xml_device_adapter(indigo_client *client);
 
+/** Release instance of XML wire protocol driver side adapter.
+ */
+extern void indigo_release_xml_client_adapter(indigo_device *device);
+
 #ifdef __cplusplus
 }
 #endif
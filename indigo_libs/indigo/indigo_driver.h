@@ -209,6 +209,7 @@ typedef indigo_result (*driver_entry_point)(indigo_driver_action, indigo_driver_
 typedef struct {
 	int property_save_file_handle;            ///< handle for property save
 	indigo_timer *timers;											///< active timer list
+	bool serialize_timers;										///< timer callbacks of the device never run concurrently
 	indigo_property *connection_property;     ///< CONNECTION property pointer
 	indigo_property *info_property;           ///< INFO property pointer
 	indigo_property *simulation_property;     ///< SIMULATION property pointer
@@ -276,10 +277,15 @@ extern indigo_result indigo_device_change_property(indigo_device *device, indigo
 extern indigo_result indigo_device_detach(indigo_device *device);
 
 /** Open config file.
+ If mode contains O_TRUNC and O_WRONLY or O_RDWR, returned handle belongs to temporary "<file>.tmp" file and the content written by indigo_printf() is buffered,
+ the handle must be closed by indigo_close_config_file() (not by close()), otherwise the content is lost and the previous version of the file is kept.
  */
-
 extern int indigo_open_config_file(char *device_name, int profile, int mode, const char *suffix);
 
+/** Close config file, files opened with O_TRUNC are flushed, synced and atomically renamed over the previous version.
+ */
+extern indigo_result indigo_close_config_file(int handle);
+
 /** Load properties.
  */
 extern indigo_result indigo_load_properties(indigo_device *device, bool default_properties);
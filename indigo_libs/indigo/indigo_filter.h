@@ -35,7 +35,7 @@ extern "C" {
 
 #define INDIGO_FILTER_LIST_COUNT							12
 #define INDIGO_FILTER_MAX_DEVICES							32
-#define INDIGO_FILTER_MAX_CACHED_PROPERTIES		256
+#define INDIGO_FILTER_CACHE_INITIAL_SIZE			64
 	
 #define INDIGO_FILTER_CCD_INDEX								0
 #define INDIGO_FILTER_WHEEL_INDEX							1
@@ -159,6 +159,19 @@ extern "C" {
  */
 #define FILTER_RELATED_AGENT_LIST_PROPERTY		(FILTER_DEVICE_CONTEXT->filter_related_agent_list_property)
 	
+/** Cached remote property entry.
+ Entries are never moved or released before client detach, so the agent can keep the pointer as a stable handle and
+ read device_property (NULL while the remote property is not defined) without another lookup.
+ */
+typedef struct indigo_filter_cache_entry {
+	char device[INDIGO_NAME_SIZE];              ///< remote device name
+	char name[INDIGO_NAME_SIZE];                ///< remote property name
+	unsigned hash;                              ///< hash of device and property name
+	indigo_property *device_property;           ///< remote property or NULL
+	indigo_property *agent_property;            ///< agent side mirror of the remote property or NULL
+	struct indigo_filter_cache_entry *next;     ///< next entry in the same hash bucket
+} indigo_filter_cache_entry;
+
 /** Filter device context structure.
  */
 typedef struct {
@@ -169,10 +182,23 @@ typedef struct {
 	indigo_property *filter_device_list_properties[INDIGO_FILTER_LIST_COUNT];
 	indigo_property *filter_related_device_list_properties[INDIGO_FILTER_LIST_COUNT];
 	indigo_property *filter_related_agent_list_property;
-	indigo_property *device_property_cache[INDIGO_FILTER_MAX_CACHED_PROPERTIES];
-	indigo_property *agent_property_cache[INDIGO_FILTER_MAX_CACHED_PROPERTIES];
+	pthread_mutex_t cache_mutex;
+	pthread_cond_t cache_cond;                  ///< signalled on each update of a cached property
+	indigo_filter_cache_entry **cache;          ///< all cache entries (growable)
+	int cache_count;
+	int cache_size;
+	indigo_filter_cache_entry **cache_index;    ///< hash index over (device, property name)
+	int cache_index_size;
 } indigo_filter_context;
 
+/** Result of indigo_filter_wait_for_busy_state().
+ */
+typedef enum {
+	INDIGO_FILTER_WAIT_OK = 0,                  ///< requested state reached
+	INDIGO_FILTER_WAIT_TIMEOUT,                 ///< timeout expired or process property left busy state
+	INDIGO_FILTER_WAIT_DELETED                  ///< property was deleted (e.g. device disconnected), the pointer must not be used anymore
+} indigo_filter_wait_result;
+
 /** Device attach callback function.
  */
 extern indigo_result indigo_filter_device_attach(indigo_device *device, unsigned version, indigo_device_interface device_interface);
@@ -205,6 +231,17 @@ extern indigo_result indigo_filter_client_detach(indigo_client *client);
 /** Find remote cached property.
  */
 extern indigo_property *indigo_filter_cached_property(indigo_device *device, int index, char *name);
+/** Find remote cached property entry (stable handle, valid until client detach).
+ */
+extern indigo_filter_cache_entry *indigo_filter_cached_property_entry(indigo_device *device, int index, char *name);
+/** Wait until state of cached remote property becomes (busy = true) or stops being (busy = false) busy.
+ Returns INDIGO_FILTER_WAIT_TIMEOUT on timeout (timeout <= 0 waits forever) or if process_property (optional) leaves busy state
+ and INDIGO_FILTER_WAIT_DELETED if the property is deleted, callers must stop using it then.
+ */
+extern indigo_filter_wait_result indigo_filter_wait_for_busy_state(indigo_device *device, indigo_property *property, bool busy, double timeout, indigo_property *process_property);
+/** Wake up all threads waiting in indigo_filter_wait_for_busy_state() to recheck their conditions (e.g. on abort).
+ */
+extern void indigo_filter_wake_waiting(indigo_device *device);
 /** Forward property change to a different device.
  */
 extern indigo_result indigo_filter_forward_change_property(indigo_client *client, indigo_property *property, char *device_name);
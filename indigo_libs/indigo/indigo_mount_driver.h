@@ -458,8 +458,30 @@ typedef struct {
 	double ra, dec;						//  Where user says it is really pointing
 	double raw_ra, raw_dec;		//  Where mount says it is pointing
 	int side_of_pier;					//  East or West DEC slew?
+	double enc_ra, enc_dec;		//  Cached virtual encoder position of ra/dec
+	double raw_enc_ra, raw_enc_dec;	//  Cached virtual encoder position of raw_ra/raw_dec
 } indigo_alignment_point;
 
+/** Number of pointing model terms.
+ */
+
+#define MOUNT_MODEL_TERM_COUNT												7
+
+/** Pointing model structure (IH, ID, CH, NP, MA, ME and TF terms in degrees, fitted from used alignment points).
+ */
+
+typedef struct {
+	int point_count;					//  Number of points in normal equations
+	int term_count;						//  Number of fitted terms
+	double latitude;					//  Latitude the model and cached encoder positions are valid for
+	double cos_latitude, sin_latitude;
+	double normal[MOUNT_MODEL_TERM_COUNT][MOUNT_MODEL_TERM_COUNT];
+	double rhs[MOUNT_MODEL_TERM_COUNT];
+	double sum_squares;
+	double terms[MOUNT_MODEL_TERM_COUNT];
+	double rms;								//  RMS of fit residuals in degrees
+} indigo_pointing_model;
+
 //------------------------------------------------
 /** Mount device context structure.
  */
@@ -467,6 +489,7 @@ typedef struct {
 	indigo_device_context device_context;										///< device context base
 	int alignment_point_count;															///< number of defined alignment points
 	indigo_alignment_point alignment_points[MOUNT_MAX_ALIGNMENT_POINTS]; ///< alignment points
+	indigo_pointing_model pointing_model;										///< pointing model for multi point alignment mode
 	indigo_property *mount_geographic_coordinates_property;	///< MOUNT_GEOGRAPHIC_COORDINATES property pointer
 	indigo_property *mount_info_property;                   ///< MOUNT_INFO property pointer
 	indigo_property *mount_lst_time_property;								///< MOUNT_LST_TIME property pointer
@@ -291,6 +291,127 @@
  */
 #define CCD_PREVIEW_IMAGE_ITEM_NAME           "IMAGE"
 
+/** CCD_PREVIEW_SETTINGS property name.
+ */
+#define CCD_PREVIEW_SETTINGS_PROPERTY_NAME		"CCD_PREVIEW_SETTINGS"
+
+/** CCD_PREVIEW_SETTINGS.MAX_SIZE property item name.
+ */
+#define CCD_PREVIEW_SETTINGS_MAX_SIZE_ITEM_NAME	"MAX_SIZE"
+
+/** CCD_PREVIEW_SETTINGS.LEFT property item name.
+ */
+#define CCD_PREVIEW_SETTINGS_LEFT_ITEM_NAME		"LEFT"
+
+/** CCD_PREVIEW_SETTINGS.TOP property item name.
+ */
+#define CCD_PREVIEW_SETTINGS_TOP_ITEM_NAME		"TOP"
+
+/** CCD_PREVIEW_SETTINGS.WIDTH property item name.
+ */
+#define CCD_PREVIEW_SETTINGS_WIDTH_ITEM_NAME	"WIDTH"
+
+/** CCD_PREVIEW_SETTINGS.HEIGHT property item name.
+ */
+#define CCD_PREVIEW_SETTINGS_HEIGHT_ITEM_NAME	"HEIGHT"
+
+/** CCD_PREVIEW_SETTINGS.INTERVAL property item name.
+ */
+#define CCD_PREVIEW_SETTINGS_INTERVAL_ITEM_NAME	"INTERVAL"
+
+//----------------------------------------------------------------------
+/** CCD_ANALYSIS property name.
+ */
+#define CCD_ANALYSIS_PROPERTY_NAME						"CCD_ANALYSIS"
+
+/** CCD_ANALYSIS.ENABLED property item name.
+ */
+#define CCD_ANALYSIS_ENABLED_ITEM_NAME				"ENABLED"
+
+/** CCD_ANALYSIS.DISABLED property item name.
+ */
+#define CCD_ANALYSIS_DISABLED_ITEM_NAME				"DISABLED"
+
+/** CCD_ANALYSIS_SETTINGS property name.
+ */
+#define CCD_ANALYSIS_SETTINGS_PROPERTY_NAME		"CCD_ANALYSIS_SETTINGS"
+
+/** CCD_ANALYSIS_SETTINGS.THRESHOLD property item name.
+ */
+#define CCD_ANALYSIS_SETTINGS_THRESHOLD_ITEM_NAME	"THRESHOLD"
+
+/** CCD_ANALYSIS_SETTINGS.RADIUS property item name.
+ */
+#define CCD_ANALYSIS_SETTINGS_RADIUS_ITEM_NAME	"RADIUS"
+
+/** CCD_ANALYSIS_SETTINGS.SATURATION property item name.
+ */
+#define CCD_ANALYSIS_SETTINGS_SATURATION_ITEM_NAME	"SATURATION"
+
+/** CCD_ANALYSIS_STATS property name.
+ */
+#define CCD_ANALYSIS_STATS_PROPERTY_NAME			"CCD_ANALYSIS_STATS"
+
+/** CCD_ANALYSIS_STATS.MIN property item name.
+ */
+#define CCD_ANALYSIS_STATS_MIN_ITEM_NAME			"MIN"
+
+/** CCD_ANALYSIS_STATS.MAX property item name.
+ */
+#define CCD_ANALYSIS_STATS_MAX_ITEM_NAME			"MAX"
+
+/** CCD_ANALYSIS_STATS.MEAN property item name.
+ */
+#define CCD_ANALYSIS_STATS_MEAN_ITEM_NAME			"MEAN"
+
+/** CCD_ANALYSIS_STATS.MEDIAN property item name.
+ */
+#define CCD_ANALYSIS_STATS_MEDIAN_ITEM_NAME		"MEDIAN"
+
+/** CCD_ANALYSIS_STATS.STDDEV property item name.
+ */
+#define CCD_ANALYSIS_STATS_STDDEV_ITEM_NAME		"STDDEV"
+
+/** CCD_ANALYSIS_STATS.SATURATED property item name.
+ */
+#define CCD_ANALYSIS_STATS_SATURATED_ITEM_NAME	"SATURATED"
+
+/** CCD_ANALYSIS_STATS.STARS property item name.
+ */
+#define CCD_ANALYSIS_STATS_STARS_ITEM_NAME		"STARS"
+
+/** CCD_ANALYSIS_STATS.HFD property item name.
+ */
+#define CCD_ANALYSIS_STATS_HFD_ITEM_NAME			"HFD"
+
+/** CCD_ANALYSIS_STATS.FWHM property item name.
+ */
+#define CCD_ANALYSIS_STATS_FWHM_ITEM_NAME			"FWHM"
+
+/** CCD_ANALYSIS_STARS property name.
+ */
+#define CCD_ANALYSIS_STARS_PROPERTY_NAME			"CCD_ANALYSIS_STARS"
+
+/** CCD_ANALYSIS_STARS.STAR_x_X property item name.
+ */
+#define CCD_ANALYSIS_STAR_X_ITEM_NAME					"STAR_%d_X"
+
+/** CCD_ANALYSIS_STARS.STAR_x_Y property item name.
+ */
+#define CCD_ANALYSIS_STAR_Y_ITEM_NAME					"STAR_%d_Y"
+
+/** CCD_ANALYSIS_STARS.STAR_x_HFD property item name.
+ */
+#define CCD_ANALYSIS_STAR_HFD_ITEM_NAME				"STAR_%d_HFD"
+
+/** CCD_ANALYSIS_STARS.STAR_x_FWHM property item name.
+ */
+#define CCD_ANALYSIS_STAR_FWHM_ITEM_NAME			"STAR_%d_FWHM"
+
+/** CCD_ANALYSIS_STARS.STAR_x_FLUX property item name.
+ */
+#define CCD_ANALYSIS_STAR_FLUX_ITEM_NAME			"STAR_%d_FLUX"
+
 
 //----------------------------------------------------------------------
 /** CCD_LOCAL_MODE property name.
@@ -305,6 +426,50 @@
  */
 #define CCD_LOCAL_MODE_PREFIX_ITEM_NAME       "PREFIX"
 
+/** CCD_LOCAL_MODE_WRITER property name.
+ */
+#define CCD_LOCAL_MODE_WRITER_PROPERTY_NAME		"CCD_LOCAL_MODE_WRITER"
+
+/** CCD_LOCAL_MODE_WRITER.QUEUE property item name.
+ */
+#define CCD_LOCAL_MODE_WRITER_QUEUE_ITEM_NAME	"QUEUE"
+
+/** CCD_LOCAL_MODE_SYNC property name.
+ */
+#define CCD_LOCAL_MODE_SYNC_PROPERTY_NAME			"CCD_LOCAL_MODE_SYNC"
+
+/** CCD_LOCAL_MODE_SYNC.NONE property item name.
+ */
+#define CCD_LOCAL_MODE_SYNC_NONE_ITEM_NAME		"NONE"
+
+/** CCD_LOCAL_MODE_SYNC.DATA property item name.
+ */
+#define CCD_LOCAL_MODE_SYNC_DATA_ITEM_NAME		"DATA"
+
+/** CCD_LOCAL_MODE_SYNC.FULL property item name.
+ */
+#define CCD_LOCAL_MODE_SYNC_FULL_ITEM_NAME		"FULL"
+
+/** CCD_LOCAL_MODE_STATS property name.
+ */
+#define CCD_LOCAL_MODE_STATS_PROPERTY_NAME		"CCD_LOCAL_MODE_STATS"
+
+/** CCD_LOCAL_MODE_STATS.PENDING property item name.
+ */
+#define CCD_LOCAL_MODE_STATS_PENDING_ITEM_NAME	"PENDING"
+
+/** CCD_LOCAL_MODE_STATS.WRITTEN property item name.
+ */
+#define CCD_LOCAL_MODE_STATS_WRITTEN_ITEM_NAME	"WRITTEN"
+
+/** CCD_LOCAL_MODE_STATS.THROUGHPUT property item name.
+ */
+#define CCD_LOCAL_MODE_STATS_THROUGHPUT_ITEM_NAME	"THROUGHPUT"
+
+/** CCD_LOCAL_MODE_STATS.LATENCY property item name.
+ */
+#define CCD_LOCAL_MODE_STATS_LATENCY_ITEM_NAME	"LATENCY"
+
 //----------------------------------------------------------------------
 /** CCD_EXPOSURE property name.
  */
@@ -328,6 +493,58 @@
  */
 #define CCD_STREAMING_COUNT_ITEM_NAME         "COUNT"
 
+//----------------------------------------------------------------------
+/** CCD_STREAMING_STATS property name.
+ */
+#define CCD_STREAMING_STATS_PROPERTY_NAME     "CCD_STREAMING_STATS"
+
+/** CCD_STREAMING_STATS.CAPTURED property item name.
+ */
+#define CCD_STREAMING_STATS_CAPTURED_ITEM_NAME	"CAPTURED"
+
+/** CCD_STREAMING_STATS.PROCESSED property item name.
+ */
+#define CCD_STREAMING_STATS_PROCESSED_ITEM_NAME	"PROCESSED"
+
+/** CCD_STREAMING_STATS.DROPPED property item name.
+ */
+#define CCD_STREAMING_STATS_DROPPED_ITEM_NAME	"DROPPED"
+
+//----------------------------------------------------------------------
+/** CCD_STREAMING_POLICY property name.
+ */
+#define CCD_STREAMING_POLICY_PROPERTY_NAME    "CCD_STREAMING_POLICY"
+
+/** CCD_STREAMING_POLICY.DROP_OLDEST property item name.
+ */
+#define CCD_STREAMING_POLICY_DROP_OLDEST_ITEM_NAME	"DROP_OLDEST"
+
+/** CCD_STREAMING_POLICY.DROP_NEWEST property item name.
+ */
+#define CCD_STREAMING_POLICY_DROP_NEWEST_ITEM_NAME	"DROP_NEWEST"
+
+//----------------------------------------------------------------------
+/** CCD_STREAMING_MODE property name.
+ */
+#define CCD_STREAMING_MODE_PROPERTY_NAME      "CCD_STREAMING_MODE"
+
+/** CCD_STREAMING_MODE.FRAMES property item name.
+ */
+#define CCD_STREAMING_MODE_FRAMES_ITEM_NAME   "FRAMES"
+
+/** CCD_STREAMING_MODE.SER property item name.
+ */
+#define CCD_STREAMING_MODE_SER_ITEM_NAME      "SER"
+
+//----------------------------------------------------------------------
+/** CCD_STREAMING_PREVIEW property name.
+ */
+#define CCD_STREAMING_PREVIEW_PROPERTY_NAME   "CCD_STREAMING_PREVIEW"
+
+/** CCD_STREAMING_PREVIEW.INTERVAL property item name.
+ */
+#define CCD_STREAMING_PREVIEW_INTERVAL_ITEM_NAME	"INTERVAL"
+
 //----------------------------------------------------------------------
 /** CCD_ABORT_EXPOSURE property name.
  */
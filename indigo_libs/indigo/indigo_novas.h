@@ -36,6 +36,40 @@
 extern double DELTA_T;
 extern double DELTA_UTC_UT1;
 
+/** Observing epoch context, holds everything shared by transformations of coordinates for given time and site.
+ */
+typedef struct {
+	double utc;													///< UTC as seconds since 1970 (with fraction)
+	double jd_ut1, jd_tt, jd_tdb;				///< Julian dates
+	double latitude, longitude, elevation;	///< observing site
+	double lst;													///< local mean sidereal time in hours (as indigo_lst())
+	double earth_position[3], earth_velocity[3];	///< barycentric position (AU) and velocity (AU/day) of geocenter
+	double observer_position[3], observer_velocity[3];	///< barycentric position (AU) and velocity (AU/day) of observer
+	double sun_position[3];							///< barycentric position of Sun (AU)
+	double matrix[3][3];								///< rotation from ICRS to true equator and equinox of date
+	double zenith[3], north[3], west[3];	///< local horizon basis in true equator and equinox of date
+} indigo_epoch;
+
+/** Initialize observing epoch for UTC (seconds since 1970 with fraction, 0 means now) and site.
+ */
+extern void indigo_init_epoch(indigo_epoch *epoch, double utc, double latitude, double longitude, double elevation);
+
+/** Convert J2000 catalog positions (ra in hours, dec in degrees, in place) to geocentric apparent positions, proper motion arrays may be NULL.
+ */
+extern void indigo_epoch_app_stars(const indigo_epoch *epoch, int count, const double *promora, const double *promodec, const double *parallax, const double *rv, double *ra, double *dec);
+
+/** Convert J2000 catalog positions (ra in hours, dec in degrees, in place) to topocentric apparent positions, proper motion arrays may be NULL.
+ */
+extern void indigo_epoch_topo_stars(const indigo_epoch *epoch, int count, const double *promora, const double *promodec, const double *parallax, const double *rv, double *ra, double *dec);
+
+/** Convert equatorial coordinates of date (ra in hours, dec in degrees) to altitude and azimuth in degrees.
+ */
+extern void indigo_epoch_eq2hor(const indigo_epoch *epoch, int count, const double *ra, const double *dec, double *alt, double *az);
+
+/** Convert single J2000 catalog position to geocentric apparent position.
+ */
+extern void indigo_epoch_app_star(const indigo_epoch *epoch, double promora, double promodec, double parallax, double rv, double *ra, double *dec);
+
 extern double indigo_lst(time_t *utc, double longitude);
 extern void indigo_eq2hor(time_t *utc, double latitude, double longitude, double elevation, double ra, double dec, double *alt, double *az);
 extern void indigo_app_star(double promora, double promodec, double parallax, double rv, double *ra, double *dec);
@@ -36,6 +36,14 @@ extern "C" {
  */
 typedef void (*indigo_server_tcp_callback)(int);
 
+/** Prototype of generator for lazily created documents (returns gzip compressed malloc'ed data and its length).
+ */
+typedef unsigned char *(*indigo_server_resource_generator)(unsigned *length);
+
+/** Prototype of handler for documents created for each request from its query string (returns malloc'ed data and its length).
+ */
+typedef unsigned char *(*indigo_server_query_handler)(const char *query, unsigned *length);
+
 /** TCP port to run on.
  */
 extern int indigo_server_tcp_port;
@@ -48,6 +56,14 @@ extern bool indigo_is_ephemeral_port;
  */
 extern void indigo_server_add_resource(const char *path, unsigned char *data, unsigned length, const char *content_type);
 
+/** Add document generated on the first request and cached afterwards.
+ */
+extern void indigo_server_add_generated_resource(const char *path, indigo_server_resource_generator generator, const char *content_type);
+
+/** Add document created for each request from its query string.
+ */
+extern void indigo_server_add_query_resource(const char *path, indigo_server_query_handler handler, const char *content_type);
+
 /** Add file document.
  */
 extern void indigo_server_add_file_resource(const char *path, const char *file_name, const char *content_type);
@@ -44,17 +44,29 @@ typedef void (*indigo_timer_callback)(indigo_device *device);
 typedef struct indigo_timer {
 	indigo_device *device;                    ///< device associated with timer
 	indigo_timer_callback callback;           ///< callback function pointer
-	bool canceled;                            ///< timer is canceled (darwin only)
-	bool scheduled;
-	double delay;
-	bool wake;
-	int timer_id;
-	pthread_cond_t cond;
-	pthread_mutex_t mutex;
-	pthread_t thread;
-	struct indigo_timer *next;
+	bool canceled;                            ///< timer is canceled
+	bool scheduled;                           ///< callback should be (re)executed after delay
+	double delay;                             ///< delay in seconds
+	int timer_id;                             ///< timer number (for tracing)
+	int state;                                ///< free, pending, ready or running
+	long long due;                            ///< monotonic time of execution [ns]
+	int heap_index;                           ///< index in scheduler heap
+	struct indigo_timer *next;                ///< next timer of the device or in free list
+	struct indigo_timer *next_ready;          ///< next timer in ready queue or running list
 } indigo_timer;
 
+/** Timer scheduler statistics.
+ */
+typedef struct {
+	int pending;                              ///< timers waiting for their due time
+	int ready;                                ///< due timers waiting for a worker thread
+	int running;                              ///< callbacks being executed
+	int threads;                              ///< worker threads
+	long executed;                            ///< callbacks executed
+	double average_lag;                       ///< average delay between due time and execution [s]
+	double max_lag;                           ///< max delay between due time and execution [s]
+} indigo_timer_stats;
+
 /* fix timespec so that abs(tv_nsec) < 1s */
 #define SEC_NS    1000000000LL       /* 1 sec in nanoseconds */
 static inline void normalize_timespec(struct timespec *ts) {
@@ -95,6 +107,10 @@ extern bool indigo_cancel_timer(indigo_device *device, indigo_timer **timer);
  */
 extern void indigo_cancel_all_timers(indigo_device *device);
 
+/** Get timer scheduler statistics.
+ */
+extern void indigo_get_timer_stats(indigo_timer_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -46,6 +46,10 @@ extern void indigo_xml_parse(indigo_device *device, indigo_client *client);
  */
 extern char *indigo_xml_escape(char *string);
 
+/** Escape XML string into buffer of INDIGO_VALUE_SIZE bytes provided by caller (reentrant version of indigo_xml_escape()).
+ */
+extern char *indigo_xml_escape_r(char *string, char *buffer);
+
 #ifdef __cplusplus
 }
 #endif
@@ -21,17 +21,242 @@
 
 #include <ctype.h>
 #include <stdint.h>
+#include <pthread.h>
 #include <indigo/indigo_base64.h>
 #include <indigo/indigo_base64_luts.h>
 #include <stdio.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define BASE64_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON) && defined(INDIGO_BASE64_NEON)
+/* NEON kernels are not verified on hardware yet, build with -DINDIGO_BASE64_NEON to enable them */
+#define BASE64_NEON
+#include <arm_neon.h>
+#endif
+
+/* SIMD kernels process the bulk of the data and return number of consumed input bytes,
+ * encoders consume multiples of 3 bytes, decoders multiples of 4 characters and never the last quad (it may contain padding).
+ * Decoders stop at the first block with invalid characters and leave it to scalar code.
+ */
+
+typedef long (*base64_kernel)(unsigned char *out, const unsigned char *in, long inlen);
+
+static long no_kernel(unsigned char *out, const unsigned char *in, long inlen) {
+	return 0;
+}
+
+bool indigo_use_base64_simd = true;
+
+static base64_kernel encode_kernel = no_kernel;
+static base64_kernel decode_kernel = no_kernel;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+
+#ifdef BASE64_X86
+
+__attribute__((target("ssse3"))) static inline __m128i enc_reshuffle_ssse3(__m128i in) {
+	in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+	const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+	const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+	const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+	const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+	return _mm_or_si128(t1, t3);
+}
+
+__attribute__((target("ssse3"))) static inline __m128i enc_translate_ssse3(__m128i in) {
+	const __m128i lut = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+	__m128i indices = _mm_subs_epu8(in, _mm_set1_epi8(51));
+	indices = _mm_sub_epi8(indices, _mm_cmpgt_epi8(in, _mm_set1_epi8(25)));
+	return _mm_add_epi8(in, _mm_shuffle_epi8(lut, indices));
+}
+
+__attribute__((target("ssse3"))) static long encode_ssse3(unsigned char *out, const unsigned char *in, long inlen) {
+	long done = 0;
+	/* 16 bytes are loaded, 12 used */
+	while (inlen - done >= 16) {
+		__m128i str = _mm_loadu_si128((const __m128i *)(in + done));
+		str = enc_translate_ssse3(enc_reshuffle_ssse3(str));
+		_mm_storeu_si128((__m128i *)out, str);
+		out += 16;
+		done += 12;
+	}
+	return done;
+}
+
+__attribute__((target("ssse3"))) static long decode_ssse3(unsigned char *out, const unsigned char *in, long inlen) {
+	const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask_2f = _mm_set1_epi8(0x2F);
+	long done = 0;
+	/* 16 bytes are stored, 12 used, remaining input guarantees enough room in out */
+	while (inlen - done >= 24) {
+		__m128i str = _mm_loadu_si128((const __m128i *)(in + done));
+		const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(str, 4), mask_2f);
+		const __m128i lo_nibbles = _mm_and_si128(str, mask_2f);
+		const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+		const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+		if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())))
+			break;
+		const __m128i eq_2f = _mm_cmpeq_epi8(str, mask_2f);
+		str = _mm_add_epi8(str, _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles)));
+		str = _mm_maddubs_epi16(str, _mm_set1_epi32(0x01400140));
+		str = _mm_madd_epi16(str, _mm_set1_epi32(0x00011000));
+		str = _mm_shuffle_epi8(str, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+		_mm_storeu_si128((__m128i *)out, str);
+		out += 12;
+		done += 16;
+	}
+	return done;
+}
+
+__attribute__((target("avx2"))) static long encode_avx2(unsigned char *out, const unsigned char *in, long inlen) {
+	const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1, 10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+	const __m256i lut = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0, 65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+	long done = 0;
+	/* two 12 byte groups are loaded to separate lanes, last load reads 16 bytes */
+	while (inlen - done >= 28) {
+		__m256i str = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(in + done))), _mm_loadu_si128((const __m128i *)(in + done + 12)), 1);
+		str = _mm256_shuffle_epi8(str, shuffle);
+		const __m256i t0 = _mm256_and_si256(str, _mm256_set1_epi32(0x0FC0FC00));
+		const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		const __m256i t2 = _mm256_and_si256(str, _mm256_set1_epi32(0x003F03F0));
+		const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		str = _mm256_or_si256(t1, t3);
+		__m256i indices = _mm256_subs_epu8(str, _mm256_set1_epi8(51));
+		indices = _mm256_sub_epi8(indices, _mm256_cmpgt_epi8(str, _mm256_set1_epi8(25)));
+		str = _mm256_add_epi8(str, _mm256_shuffle_epi8(lut, indices));
+		_mm256_storeu_si256((__m256i *)out, str);
+		out += 32;
+		done += 24;
+	}
+	return done;
+}
+
+__attribute__((target("avx2"))) static long decode_avx2(unsigned char *out, const unsigned char *in, long inlen) {
+	const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+	const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+	long done = 0;
+	/* 32 bytes are stored, 24 used, remaining input guarantees enough room in out */
+	while (inlen - done >= 48) {
+		__m256i str = _mm256_loadu_si256((const __m256i *)(in + done));
+		const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+		const __m256i lo_nibbles = _mm256_and_si256(str, mask_2f);
+		const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+		const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+		if (!_mm256_testz_si256(lo, hi))
+			break;
+		const __m256i eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+		str = _mm256_add_epi8(str, _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles)));
+		str = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+		str = _mm256_madd_epi16(str, _mm256_set1_epi32(0x00011000));
+		str = _mm256_shuffle_epi8(str, pack);
+		str = _mm256_permutevar8x32_epi32(str, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+		_mm256_storeu_si256((__m256i *)out, str);
+		out += 24;
+		done += 32;
+	}
+	return done;
+}
+
+#endif
+
+#ifdef BASE64_NEON
+
+static long encode_neon(unsigned char *out, const unsigned char *in, long inlen) {
+	const uint8x16x4_t lut = vld1q_u8_x4((const uint8_t *)base64digits);
+	const uint8x16_t mask_3f = vdupq_n_u8(0x3F);
+	long done = 0;
+	while (inlen - done >= 48) {
+		uint8x16x3_t src = vld3q_u8(in + done);
+		uint8x16x4_t dst;
+		dst.val[0] = vshrq_n_u8(src.val[0], 2);
+		dst.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(src.val[1], 4), vshlq_n_u8(src.val[0], 4)), mask_3f);
+		dst.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(src.val[2], 6), vshlq_n_u8(src.val[1], 2)), mask_3f);
+		dst.val[3] = vandq_u8(src.val[2], mask_3f);
+		dst.val[0] = vqtbl4q_u8(lut, dst.val[0]);
+		dst.val[1] = vqtbl4q_u8(lut, dst.val[1]);
+		dst.val[2] = vqtbl4q_u8(lut, dst.val[2]);
+		dst.val[3] = vqtbl4q_u8(lut, dst.val[3]);
+		vst4q_u8(out, dst);
+		out += 64;
+		done += 48;
+	}
+	return done;
+}
+
+/* character -> sextet for characters 0..127, 0xFF for invalid ones */
+static const uint8_t neon_decode_lut[128] = {
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+	255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 62, 255, 255, 255, 63,
+	52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 255, 255, 255, 255, 255, 255,
+	255, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+	15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 255, 255, 255, 255, 255,
+	255, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+	41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 255, 255, 255, 255, 255
+};
+
+static long decode_neon(unsigned char *out, const unsigned char *in, long inlen) {
+	const uint8x16x4_t lut_lo = vld1q_u8_x4(neon_decode_lut);
+	const uint8x16x4_t lut_hi = vld1q_u8_x4(neon_decode_lut + 64);
+	const uint8x16_t offset = vdupq_n_u8(64);
+	long done = 0;
+	while (inlen - done >= 68) {
+		uint8x16x4_t src = vld4q_u8(in + done);
+		uint8x16_t error = vdupq_n_u8(0);
+		for (int i = 0; i < 4; i++) {
+			/* characters >= 128 map to 0 in both lookups, so they are checked separately */
+			uint8x16_t value = vqtbx4q_u8(vqtbl4q_u8(lut_lo, src.val[i]), lut_hi, vsubq_u8(src.val[i], offset));
+			error = vorrq_u8(error, vorrq_u8(value, vandq_u8(src.val[i], vdupq_n_u8(0x80))));
+			src.val[i] = value;
+		}
+		if (vmaxvq_u8(error) > 0x3F)
+			break;
+		uint8x16x3_t dst;
+		dst.val[0] = vorrq_u8(vshlq_n_u8(src.val[0], 2), vshrq_n_u8(src.val[1], 4));
+		dst.val[1] = vorrq_u8(vshlq_n_u8(src.val[1], 4), vshrq_n_u8(src.val[2], 2));
+		dst.val[2] = vorrq_u8(vshlq_n_u8(src.val[2], 6), src.val[3]);
+		vst3q_u8(out, dst);
+		out += 48;
+		done += 64;
+	}
+	return done;
+}
+
+#endif
+
+static void select_kernels(void) {
+#ifdef BASE64_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		encode_kernel = encode_avx2;
+		decode_kernel = decode_avx2;
+	} else if (__builtin_cpu_supports("ssse3")) {
+		encode_kernel = encode_ssse3;
+		decode_kernel = decode_ssse3;
+	}
+#endif
+#ifdef BASE64_NEON
+	encode_kernel = encode_neon;
+	decode_kernel = decode_neon;
+#endif
+}
+
 /* out size should be at least 4*inlen/3 + 4.
  * returns length of out (without trailing NULL).
  */
 long base64_encode(unsigned char *out, const unsigned char *in, long inlen) {
 	uint16_t* b64lut = (uint16_t*)base64lut;
 	long dlen = ((inlen+2)/3)*4; /* 4/3, rounded up */
-	uint16_t* wbuf = (uint16_t*)out;
+	pthread_once(&kernel_once, select_kernels);
+	long done = indigo_use_base64_simd ? encode_kernel(out, in, inlen) : 0;
+	in += done;
+	inlen -= done;
+	uint16_t* wbuf = (uint16_t*)(out + done / 3 * 4);
 
 	for(; inlen > 2; inlen -= 3 ) {
 		uint32_t n = in[0] << 16 | in[1] << 8 | in[2];
@@ -59,7 +284,7 @@ long base64_encode(unsigned char *out, const unsigned char *in, long inlen) {
 
 
 /* base64 should not contain whitespaces.*/
-long base64_decode_fast(unsigned char* out, const unsigned char* in, long inlen) {
+static long decode_scalar(unsigned char* out, const unsigned char* in, long inlen) {
 	long outlen = 0;
 	uint8_t b1, b2, b3;
 	uint16_t s1, s2;
@@ -117,6 +342,11 @@ long base64_decode_fast(unsigned char* out, const unsigned char* in, long inlen)
 	return outlen;
 }
 
+long base64_decode_fast(unsigned char* out, const unsigned char* in, long inlen) {
+	pthread_once(&kernel_once, select_kernels);
+	long done = indigo_use_base64_simd ? decode_kernel(out, in, inlen) : 0;
+	return done / 4 * 3 + decode_scalar(out + done / 4 * 3, in + done, inlen - done);
+}
 
 long base64_decode_fast_nl(unsigned char* out, const unsigned char* in, long inlen) {
 	long outlen = 0;
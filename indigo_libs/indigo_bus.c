@@ -40,6 +40,10 @@
 #include <syslog.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#if defined(INDIGO_LINUX)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
 #endif
 #if defined(INDIGO_WINDOWS)
 #include <io.h>
@@ -53,22 +57,89 @@
 
 #define MAX_DEVICES 256
 #define MAX_CLIENTS 256
-#define MAX_BLOBS	32
+#define MAX_SPARE_BLOB_BUFFERS	2
+// memfd_create() + ftruncate() + mmap() and first touch costs ~18us for 4kB and ~1ms for 1MB (malloc ~0.4us and ~70us),
+// it pays off only for big, recycled buffers downloaded with sendfile(), smaller ones are allocated with malloc()
+#define MIN_FILE_BLOB_BUFFER	(1024 * 1024)
+
+#define DEVICE_HASH_SIZE	256
 
 #define BUFFER_SIZE	1024
 
 static indigo_device *devices[MAX_DEVICES];
+static int device_hash[DEVICE_HASH_SIZE];
+static int remote_devices;
+static int device_next[MAX_DEVICES];
+static int device_count;
 static indigo_client *clients[MAX_CLIENTS];
-static indigo_blob_entry *blobs[MAX_BLOBS];
+static indigo_blob_entry **blobs;
+static int blob_count;
+static int blob_capacity;
+
+typedef struct shared_blob_buffer {
+	void *data;
+	long size;
+	int handle;
+	int references;
+	struct shared_blob_buffer *next;
+} shared_blob_buffer;
+
+static shared_blob_buffer *shared_blob_buffers;
+static shared_blob_buffer *spare_blob_buffers;
+static int spare_blob_buffer_count;
 
 static pthread_mutex_t device_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER;
 static pthread_mutex_t client_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER;
 bool indigo_use_strict_locking = true;
 
 static pthread_mutex_t blob_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t client_queues_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static bool is_started = false;
 
+typedef enum {
+	QUEUE_DEFINE_PROPERTY,
+	QUEUE_UPDATE_PROPERTY,
+	QUEUE_DELETE_PROPERTY,
+	QUEUE_SEND_MESSAGE
+} queue_entry_type;
+
+typedef struct queue_entry {
+	queue_entry_type type;
+	bool has_device;
+	indigo_device device;
+	indigo_property *property;
+	char *message;
+	indigo_item **blob_items;           ///< items of the registered BLOB property, the queued copy has different addresses
+	bool blob_retained;                 ///< BLOB item values are references to shared blob buffers
+	struct queue_entry *next;
+	struct queue_entry *next_blob;      ///< next entry with BLOB property copy
+} queue_entry;
+
+typedef struct {
+	indigo_client *client;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	queue_entry *head;
+	queue_entry *tail;
+	bool running;
+	int pending;
+	int high_water_mark;
+	long queued;
+	long delivered;
+	long coalesced;
+	long stalled;
+} client_queue;
+
+static client_queue *client_queues[MAX_CLIENTS];
+static queue_entry *queued_blobs;
+
+static shared_blob_buffer *find_shared_blob_buffer(void *data, long size);
+static shared_blob_buffer *alloc_shared_blob_buffer(long size);
+static void release_shared_blob_buffer(shared_blob_buffer *buffer);
+static indigo_blob_entry *find_blob_entry(indigo_item *item);
+
 char *indigo_property_type_text[] = {
 	"UNDEFINED",
 	"TEXT",
@@ -111,6 +182,8 @@ bool indigo_reshare_remote_devices = false;
 bool indigo_use_host_suffix = true;
 bool indigo_is_sandboxed = false;
 bool indigo_use_blob_caching = false;
+bool indigo_use_client_queues = false;
+int indigo_client_queue_size = 1024;
 
 const char **indigo_main_argv = NULL;
 int indigo_main_argc = 0;
@@ -313,6 +386,509 @@ void indigo_trace_property(const char *message, indigo_property *property, bool
 	}
 }
 
+static void release_queue_entry(queue_entry *entry) {
+	if (entry->blob_items) {
+		pthread_mutex_lock(&blob_mutex);
+		for (queue_entry **blob = &queued_blobs; *blob; blob = &(*blob)->next_blob) {
+			if (*blob == entry) {
+				*blob = entry->next_blob;
+				break;
+			}
+		}
+		if (entry->blob_retained) {
+			for (int i = 0; i < entry->property->count; i++) {
+				shared_blob_buffer *buffer = find_shared_blob_buffer(entry->property->items[i].blob.value, 0);
+				if (buffer)
+					release_shared_blob_buffer(buffer);
+			}
+		}
+		pthread_mutex_unlock(&blob_mutex);
+		free(entry->blob_items);
+	}
+	if (entry->property)
+		free(entry->property);
+	if (entry->message)
+		free(entry->message);
+	free(entry);
+}
+
+static void *client_queue_worker(client_queue *queue) {
+	indigo_client *client = queue->client;
+	pthread_mutex_lock(&queue->mutex);
+	while (true) {
+		while (queue->running && queue->head == NULL)
+			pthread_cond_wait(&queue->cond, &queue->mutex);
+		if (!queue->running)
+			break;
+		queue_entry *entry = queue->head;
+		if ((queue->head = entry->next) == NULL)
+			queue->tail = NULL;
+		queue->pending--;
+		pthread_mutex_unlock(&queue->mutex);
+		indigo_device *device = entry->has_device ? &entry->device : NULL;
+		switch (entry->type) {
+			case QUEUE_DEFINE_PROPERTY:
+				if (client->define_property != NULL)
+					client->last_result = client->define_property(client, device, entry->property, entry->message);
+				break;
+			case QUEUE_UPDATE_PROPERTY:
+				if (client->update_property != NULL)
+					client->last_result = client->update_property(client, device, entry->property, entry->message);
+				break;
+			case QUEUE_DELETE_PROPERTY:
+				if (client->delete_property != NULL)
+					client->last_result = client->delete_property(client, device, entry->property, entry->message);
+				break;
+			case QUEUE_SEND_MESSAGE:
+				if (client->send_message != NULL)
+					client->last_result = client->send_message(client, device, entry->message);
+				break;
+		}
+		release_queue_entry(entry);
+		pthread_mutex_lock(&queue->mutex);
+		queue->delivered++;
+	}
+	pthread_mutex_unlock(&queue->mutex);
+	return NULL;
+}
+
+static client_queue *start_client_queue(indigo_client *client) {
+	client_queue *queue = malloc(sizeof(client_queue));
+	assert(queue != NULL);
+	memset(queue, 0, sizeof(client_queue));
+	queue->client = client;
+	queue->running = true;
+	pthread_mutex_init(&queue->mutex, NULL);
+	pthread_cond_init(&queue->cond, NULL);
+	if (pthread_create(&queue->thread, NULL, (void *(*)(void *))client_queue_worker, queue) != 0) {
+		INDIGO_ERROR(indigo_error("INDIGO Bus: can't start queue for client %p, using synchronous delivery", client));
+		pthread_cond_destroy(&queue->cond);
+		pthread_mutex_destroy(&queue->mutex);
+		free(queue);
+		return NULL;
+	}
+	return queue;
+}
+
+static void stop_client_queue(client_queue *queue) {
+	pthread_mutex_lock(&queue->mutex);
+	queue->running = false;
+	pthread_cond_broadcast(&queue->cond);
+	pthread_mutex_unlock(&queue->mutex);
+	pthread_join(queue->thread, NULL);
+	queue_entry *entry = queue->head;
+	while (entry) {
+		queue_entry *next = entry->next;
+		release_queue_entry(entry);
+		entry = next;
+	}
+	pthread_cond_destroy(&queue->cond);
+	pthread_mutex_destroy(&queue->mutex);
+	free(queue);
+}
+
+static queue_entry *create_queue_entry(queue_entry_type type, indigo_device *device, indigo_property *property, void **blob_values, const char *message) {
+	queue_entry *entry = malloc(sizeof(queue_entry));
+	assert(entry != NULL);
+	memset(entry, 0, sizeof(queue_entry));
+	entry->type = type;
+	if (device != NULL) {
+		entry->has_device = true;
+		entry->device = *device;
+	}
+	if (property != NULL) {
+		int count = type == QUEUE_DELETE_PROPERTY ? 0 : property->count;
+		entry->property = malloc(sizeof(indigo_property) + count * sizeof(indigo_item));
+		assert(entry->property != NULL);
+		memcpy(entry->property, property, sizeof(indigo_property) + count * sizeof(indigo_item));
+		entry->property->count = count;
+		if (property->type == INDIGO_BLOB_VECTOR && count > 0) {
+			entry->blob_items = malloc(count * sizeof(indigo_item *));
+			assert(entry->blob_items != NULL);
+			for (int i = 0; i < count; i++)
+				entry->blob_items[i] = property->items + i;
+			pthread_mutex_lock(&blob_mutex);
+			// copy keeps reference to the content, driver can reuse its buffer before the update is delivered
+			for (int i = 0; i < count; i++) {
+				indigo_item *item = entry->property->items + i;
+				shared_blob_buffer *buffer = blob_values ? find_shared_blob_buffer(blob_values[i], 0) : NULL;
+				if (buffer) {
+					buffer->references++;
+					item->blob.value = blob_values[i];
+				} else {
+					item->blob.value = NULL;
+					if (blob_values)
+						item->blob.size = 0;
+				}
+			}
+			entry->blob_retained = blob_values != NULL;
+			entry->next_blob = queued_blobs;
+			queued_blobs = entry;
+			pthread_mutex_unlock(&blob_mutex);
+		}
+	}
+	if (message != NULL)
+		entry->message = strdup(message);
+	return entry;
+}
+
+static void remove_queue_entry(client_queue *queue, queue_entry **link) {
+	queue_entry *entry = *link;
+	if ((*link = entry->next) == NULL) {
+		queue->tail = queue->head;
+		while (queue->tail && queue->tail->next)
+			queue->tail = queue->tail->next;
+	}
+	queue->pending--;
+	release_queue_entry(entry);
+}
+
+static bool coalesce_update(client_queue *queue, queue_entry *entry, bool any) {
+	indigo_property *property = entry->property;
+	queue_entry **candidate = NULL;
+	for (queue_entry **link = &queue->head; *link; link = &(*link)->next) {
+		indigo_property *pending = (*link)->property;
+		if (pending == NULL || strcmp(pending->device, property->device))
+			continue;
+		if ((*link)->type == QUEUE_UPDATE_PROPERTY) {
+			if ((any || (*link)->message == NULL) && pending->type == property->type && pending->count == property->count && !strcmp(pending->name, property->name))
+				candidate = link;
+		} else if (*pending->name == 0 || !strcmp(pending->name, property->name)) {
+			candidate = NULL;
+		}
+	}
+	if (candidate == NULL)
+		return false;
+	// newer update takes place of the pending one
+	queue_entry *pending = *candidate;
+	entry->next = pending->next;
+	*candidate = entry;
+	if (queue->tail == pending)
+		queue->tail = entry;
+	release_queue_entry(pending);
+	queue->coalesced++;
+	return true;
+}
+
+static void enqueue(client_queue *queue, queue_entry_type type, indigo_device *device, indigo_property *property, void **blob_values, const char *message) {
+	queue_entry *entry = create_queue_entry(type, device, property, blob_values, message);
+	pthread_mutex_lock(&queue->mutex);
+	// sender is never blocked by slow client, full queue is resolved by coalescing or dropping pending updates
+	bool full = queue->pending >= indigo_client_queue_size;
+	if (type == QUEUE_UPDATE_PROPERTY && (full || (message == NULL && (property->type == INDIGO_NUMBER_VECTOR || property->type == INDIGO_SWITCH_VECTOR))) && coalesce_update(queue, entry, full)) {
+		if (full)
+			queue->stalled++;
+		pthread_mutex_unlock(&queue->mutex);
+		return;
+	}
+	if (full) {
+		// the oldest pending update is dropped, definitions, deletions and messages are always delivered
+		for (queue_entry **link = &queue->head; *link; link = &(*link)->next) {
+			if ((*link)->type == QUEUE_UPDATE_PROPERTY) {
+				remove_queue_entry(queue, link);
+				break;
+			}
+		}
+		queue->stalled++;
+	}
+	if (queue->tail)
+		queue->tail->next = entry;
+	else
+		queue->head = entry;
+	queue->tail = entry;
+	queue->queued++;
+	if (++queue->pending > queue->high_water_mark)
+		queue->high_water_mark = queue->pending;
+	pthread_cond_broadcast(&queue->cond);
+	pthread_mutex_unlock(&queue->mutex);
+}
+
+static void **share_blob_values(indigo_property *property) {
+	void **values = calloc(property->count > 0 ? property->count : 1, sizeof(void *));
+	assert(values != NULL);
+	pthread_mutex_lock(&blob_mutex);
+	for (int i = 0; i < property->count; i++) {
+		indigo_item *item = property->items + i;
+		if (item->blob.value == NULL || item->blob.size <= 0)
+			continue;
+		indigo_blob_entry *entry = indigo_use_blob_caching ? find_blob_entry(item) : NULL;
+		shared_blob_buffer *buffer;
+		if (entry && entry->buffer && entry->size == item->blob.size) {
+			// cache already holds the content
+			buffer = entry->buffer;
+			buffer->references++;
+			values[i] = entry->content;
+		} else if ((buffer = find_shared_blob_buffer(item->blob.value, item->blob.size))) {
+			buffer->references++;
+			values[i] = item->blob.value;
+		} else {
+			buffer = alloc_shared_blob_buffer(item->blob.size);
+			memcpy(buffer->data, item->blob.value, item->blob.size);
+			values[i] = buffer->data;
+		}
+	}
+	pthread_mutex_unlock(&blob_mutex);
+	return values;
+}
+
+static void release_blob_values(indigo_property *property, void **values) {
+	pthread_mutex_lock(&blob_mutex);
+	for (int i = 0; i < property->count; i++) {
+		shared_blob_buffer *buffer = find_shared_blob_buffer(values[i], 0);
+		if (buffer)
+			release_shared_blob_buffer(buffer);
+	}
+	pthread_mutex_unlock(&blob_mutex);
+	free(values);
+}
+
+indigo_item *indigo_registered_blob_item(indigo_property *property, indigo_item *item) {
+	pthread_mutex_lock(&blob_mutex);
+	for (queue_entry *entry = queued_blobs; entry; entry = entry->next_blob) {
+		if (entry->property == property) {
+			item = entry->blob_items[item - property->items];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&blob_mutex);
+	return item;
+}
+
+void indigo_get_client_queue_stats(indigo_client_queue_stats *stats) {
+	memset(stats, 0, sizeof(indigo_client_queue_stats));
+	// client_mutex may be held for a long time by delivery to slow client, so just the queue table is locked
+	pthread_mutex_lock(&client_queues_mutex);
+	for (int i = 0; i < MAX_CLIENTS; i++) {
+		client_queue *queue = client_queues[i];
+		if (queue != NULL) {
+			pthread_mutex_lock(&queue->mutex);
+			stats->clients++;
+			stats->pending += queue->pending;
+			if (queue->high_water_mark > stats->high_water_mark)
+				stats->high_water_mark = queue->high_water_mark;
+			stats->queued += queue->queued;
+			stats->delivered += queue->delivered;
+			stats->coalesced += queue->coalesced;
+			stats->stalled += queue->stalled;
+			pthread_mutex_unlock(&queue->mutex);
+		}
+	}
+	pthread_mutex_unlock(&client_queues_mutex);
+}
+
+int indigo_get_client_queue_info(indigo_client_queue_info *info, int max_count) {
+	int count = 0;
+	pthread_mutex_lock(&client_queues_mutex);
+	for (int i = 0; i < MAX_CLIENTS && count < max_count; i++) {
+		client_queue *queue = client_queues[i];
+		if (queue != NULL) {
+			indigo_client_queue_info *entry = info + count++;
+			strncpy(entry->name, queue->client->name, INDIGO_NAME_SIZE);
+			pthread_mutex_lock(&queue->mutex);
+			entry->pending = queue->pending;
+			entry->high_water_mark = queue->high_water_mark;
+			entry->stalled = queue->stalled;
+			pthread_mutex_unlock(&queue->mutex);
+		}
+	}
+	pthread_mutex_unlock(&client_queues_mutex);
+	return count;
+}
+
+static unsigned device_name_hash(const char *name) {
+	unsigned hash = 2166136261u;
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return hash & (DEVICE_HASH_SIZE - 1);
+}
+
+static int *device_chain(indigo_device *device) {
+	if (*device->name == '@')
+		return &remote_devices;
+	return device_hash + device_name_hash(device->name);
+}
+
+static void add_device_route(int slot) {
+	int *chain = device_chain(devices[slot]);
+	device_next[slot] = *chain;
+	*chain = slot;
+	if (slot >= device_count)
+		device_count = slot + 1;
+}
+
+static void remove_device_route(int slot) {
+	int *chain = device_chain(devices[slot]);
+	while (*chain != -1) {
+		if (*chain == slot) {
+			*chain = device_next[slot];
+			break;
+		}
+		chain = device_next + *chain;
+	}
+	device_next[slot] = -1;
+	devices[slot] = NULL;
+	while (device_count > 0 && devices[device_count - 1] == NULL)
+		device_count--;
+}
+
+static void reset_device_routes() {
+	for (int i = 0; i < DEVICE_HASH_SIZE; i++)
+		device_hash[i] = -1;
+	for (int i = 0; i < MAX_DEVICES; i++)
+		device_next[i] = -1;
+	remote_devices = -1;
+	device_count = 0;
+}
+
+static int route_request(indigo_property *property, int *slots, indigo_device **targets) {
+	int count = 0;
+	if (*property->device == 0) {
+		for (int i = 0; i < device_count; i++) {
+			if (devices[i] != NULL) {
+				slots[count] = i;
+				targets[count++] = devices[i];
+			}
+		}
+		return count;
+	}
+	// without strict locking a device can be detached concurrently, so the slot is checked as well
+	for (int i = device_hash[device_name_hash(property->device)]; i != -1; i = device_next[i]) {
+		indigo_device *device = devices[i];
+		if (device != NULL && !strcmp(property->device, device->name)) {
+			slots[count] = i;
+			targets[count++] = device;
+		}
+	}
+	for (int i = remote_devices; i != -1; i = device_next[i]) {
+		indigo_device *device = devices[i];
+		if (device != NULL && (!indigo_use_host_suffix || strstr(property->device, device->name))) {
+			slots[count] = i;
+			targets[count++] = device;
+		}
+	}
+	return count;
+}
+
+// blob_mutex must be held by the caller of following functions
+
+static indigo_blob_entry *find_blob_entry(indigo_item *item) {
+	for (int j = 0; j < blob_count; j++) {
+		if (blobs[j]->item == item)
+			return blobs[j];
+	}
+	return NULL;
+}
+
+static shared_blob_buffer *find_shared_blob_buffer(void *data, long size) {
+	if (data == NULL)
+		return NULL;
+	for (shared_blob_buffer *buffer = shared_blob_buffers; buffer; buffer = buffer->next) {
+		if ((char *)data >= (char *)buffer->data && (char *)data + size <= (char *)buffer->data + buffer->size)
+			return buffer;
+	}
+	return NULL;
+}
+
+static void free_shared_blob_buffer(shared_blob_buffer *buffer) {
+#if defined(INDIGO_LINUX)
+	if (buffer->handle >= 0) {
+		munmap(buffer->data, buffer->size);
+		close(buffer->handle);
+		free(buffer);
+		return;
+	}
+#endif
+	free(buffer->data);
+	free(buffer);
+}
+
+#if defined(INDIGO_LINUX)
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC	0x0001U
+#endif
+
+static int create_memory_file(const char *name) {
+	// memfd_create() wrapper is missing in glibc < 2.27, buffer falls back to malloc() if the syscall is not available
+#if defined(SYS_memfd_create)
+	return (int)syscall(SYS_memfd_create, name, MFD_CLOEXEC);
+#else
+	return -1;
+#endif
+}
+#endif
+
+static shared_blob_buffer *alloc_shared_blob_buffer(long size) {
+	int mod2880 = size % 2880;
+	if (mod2880)
+		size += 2880 - mod2880;
+	shared_blob_buffer *buffer = NULL;
+	shared_blob_buffer **best = NULL;
+	for (shared_blob_buffer **spare = &spare_blob_buffers; *spare; spare = &(*spare)->next) {
+		if ((*spare)->size >= size && (best == NULL || (*spare)->size < (*best)->size))
+			best = spare;
+	}
+	if (best) {
+		buffer = *best;
+		*best = buffer->next;
+		spare_blob_buffer_count--;
+	} else {
+		buffer = malloc(sizeof(shared_blob_buffer));
+		assert(buffer != NULL);
+		buffer->handle = -1;
+		buffer->data = NULL;
+		buffer->size = size;
+#if defined(INDIGO_LINUX)
+		// memory file backed buffer can be sent with sendfile()
+		if (size >= MIN_FILE_BLOB_BUFFER && (buffer->handle = create_memory_file("indigo_blob")) >= 0) {
+			if (ftruncate(buffer->handle, size) < 0 || (buffer->data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, buffer->handle, 0)) == MAP_FAILED) {
+				close(buffer->handle);
+				buffer->handle = -1;
+				buffer->data = NULL;
+			}
+		}
+#endif
+		if (buffer->data == NULL)
+			buffer->data = malloc(size > 0 ? size : 1);
+		assert(buffer->data != NULL);
+	}
+	buffer->references = 1;
+	buffer->next = shared_blob_buffers;
+	shared_blob_buffers = buffer;
+	return buffer;
+}
+
+static void release_shared_blob_buffer(shared_blob_buffer *buffer) {
+	if (--buffer->references > 0)
+		return;
+	for (shared_blob_buffer **live = &shared_blob_buffers; *live; live = &(*live)->next) {
+		if (*live == buffer) {
+			*live = buffer->next;
+			break;
+		}
+	}
+	if (spare_blob_buffer_count == MAX_SPARE_BLOB_BUFFERS) {
+		// replace the smallest spare buffer if released one is bigger
+		shared_blob_buffer **smallest = &spare_blob_buffers;
+		for (shared_blob_buffer **spare = &spare_blob_buffers; *spare; spare = &(*spare)->next) {
+			if ((*spare)->size < (*smallest)->size)
+				smallest = spare;
+		}
+		if ((*smallest)->size >= buffer->size) {
+			free_shared_blob_buffer(buffer);
+			return;
+		}
+		shared_blob_buffer *replaced = *smallest;
+		*smallest = replaced->next;
+		free_shared_blob_buffer(replaced);
+		spare_blob_buffer_count--;
+	}
+	buffer->next = spare_blob_buffers;
+	spare_blob_buffers = buffer;
+	spare_blob_buffer_count++;
+}
+
 indigo_result indigo_start() {
 	for (int i = 1; i < indigo_main_argc; i++) {
 		if (!strcmp(indigo_main_argv[i], "-v") || !strcmp(indigo_main_argv[i], "--enable-info")) {
@@ -327,8 +903,9 @@ indigo_result indigo_start() {
 	pthread_mutex_lock(&client_mutex);
 	if (!is_started) {
 		memset(devices, 0, MAX_DEVICES * sizeof(indigo_device *));
+		reset_device_routes();
 		memset(clients, 0, MAX_CLIENTS * sizeof(indigo_client *));
-		memset(blobs, 0, MAX_BLOBS * sizeof(indigo_property *));
+		memset(client_queues, 0, MAX_CLIENTS * sizeof(client_queue *));
 		memset(&INDIGO_ALL_PROPERTIES, 0, sizeof(INDIGO_ALL_PROPERTIES));
 		is_started = true;
 	}
@@ -349,6 +926,7 @@ indigo_result indigo_attach_device(indigo_device *device) {
 	for (int i = 0; i < MAX_DEVICES; i++) {
 		if (devices[i] == NULL) {
 			devices[i] = device;
+			add_device_route(i);
 			pthread_mutex_unlock(&device_mutex);
 			if (device->attach != NULL)
 				device->last_result = device->attach(device);
@@ -370,6 +948,12 @@ indigo_result indigo_attach_client(indigo_client *client) {
 	pthread_mutex_lock(&client_mutex);
 	for (int i = 0; i < MAX_CLIENTS; i++) {
 		if (clients[i] == NULL) {
+			if (indigo_use_client_queues && client->is_remote) {
+				client_queue *queue = start_client_queue(client);
+				pthread_mutex_lock(&client_queues_mutex);
+				client_queues[i] = queue;
+				pthread_mutex_unlock(&client_queues_mutex);
+			}
 			clients[i] = client;
 			pthread_mutex_unlock(&client_mutex);
 			if (client->attach != NULL)
@@ -389,7 +973,7 @@ indigo_result indigo_detach_device(indigo_device *device) {
 		if (devices[i] == device) {
 			if (device->detach != NULL)
 				device->last_result = device->detach(device);
-			devices[i] = NULL;
+			remove_device_route(i);
 			pthread_mutex_unlock(&device_mutex);
 			return INDIGO_OK;
 		}
@@ -404,8 +988,14 @@ indigo_result indigo_detach_client(indigo_client *client) {
 	pthread_mutex_lock(&client_mutex);
 	for (int i = 0; i < MAX_CLIENTS; i++) {
 		if (clients[i] == client) {
+			pthread_mutex_lock(&client_queues_mutex);
+			client_queue *queue = client_queues[i];
+			client_queues[i] = NULL;
+			pthread_mutex_unlock(&client_queues_mutex);
 			clients[i] = NULL;
 			pthread_mutex_unlock(&client_mutex);
+			if (queue != NULL)
+				stop_client_queue(queue);
 			if (client->detach != NULL)
 				client->last_result = client->detach(client);
 			return INDIGO_OK;
@@ -421,16 +1011,13 @@ indigo_result indigo_enumerate_properties(indigo_client *client, indigo_property
 	if (indigo_use_strict_locking)
 		pthread_mutex_lock(&device_mutex);
 	INDIGO_TRACE(indigo_trace_property("INDIGO Bus: property enumeration request", property, false, true));
-	for (int i = 0; i < MAX_DEVICES; i++) {
-		indigo_device *device = devices[i];
-		if (device != NULL && device->enumerate_properties != NULL) {
-			bool route = *property->device == 0;
-			route = route || !strcmp(property->device, device->name);
-			route = route || (indigo_use_host_suffix && *device->name == '@' && strstr(property->device, device->name));
-			route = route || (!indigo_use_host_suffix && *device->name == '@');
-			if (route)
-				device->last_result = device->enumerate_properties(device, client, property);
-		}
+	int slots[MAX_DEVICES];
+	indigo_device *targets[MAX_DEVICES];
+	int count = route_request(property, slots, targets);
+	for (int i = 0; i < count; i++) {
+		indigo_device *device = targets[i];
+		if (devices[slots[i]] == device && device->enumerate_properties != NULL)
+			device->last_result = device->enumerate_properties(device, client, property);
 	}
 	if (indigo_use_strict_locking)
 		pthread_mutex_unlock(&device_mutex);
@@ -443,16 +1030,13 @@ indigo_result indigo_change_property(indigo_client *client, indigo_property *pro
 	if (indigo_use_strict_locking)
 		pthread_mutex_lock(&device_mutex);
 	INDIGO_TRACE(indigo_trace_property("INDIGO Bus: property change request", property, false, true));
-	for (int i = 0; i < MAX_DEVICES; i++) {
-		indigo_device *device = devices[i];
-		if (device != NULL && device->change_property != NULL) {
-			bool route = *property->device == 0;
-			route = route || !strcmp(property->device, device->name);
-			route = route || (indigo_use_host_suffix && *device->name == '@' && strstr(property->device, device->name));
-			route = route || (!indigo_use_host_suffix && *device->name == '@');
-			if (route)
-				device->last_result = device->change_property(device, client, property);
-		}
+	int slots[MAX_DEVICES];
+	indigo_device *targets[MAX_DEVICES];
+	int count = route_request(property, slots, targets);
+	for (int i = 0; i < count; i++) {
+		indigo_device *device = targets[i];
+		if (devices[slots[i]] == device && device->change_property != NULL)
+			device->last_result = device->change_property(device, client, property);
 	}
 	if (indigo_use_strict_locking)
 		pthread_mutex_unlock(&device_mutex);
@@ -465,16 +1049,13 @@ indigo_result indigo_enable_blob(indigo_client *client, indigo_property *propert
 	if (indigo_use_strict_locking)
 		pthread_mutex_lock(&device_mutex);
 	INDIGO_TRACE(indigo_trace_property("INDIGO Bus: enable BLOB mode change request", property, false, true));
-	for (int i = 0; i < MAX_DEVICES; i++) {
-		indigo_device *device = devices[i];
-		if (device != NULL && device->enable_blob != NULL) {
-			bool route = *property->device == 0;
-			route = route || !strcmp(property->device, device->name);
-			route = route || (indigo_use_host_suffix && *device->name == '@' && strstr(property->device, device->name));
-			route = route || (!indigo_use_host_suffix && *device->name == '@');
-			if (route)
-				device->last_result = device->enable_blob(device, client, property, mode);
-		}
+	int slots[MAX_DEVICES];
+	indigo_device *targets[MAX_DEVICES];
+	int count = route_request(property, slots, targets);
+	for (int i = 0; i < count; i++) {
+		indigo_device *device = targets[i];
+		if (devices[slots[i]] == device && device->enable_blob != NULL)
+			device->last_result = device->enable_blob(device, client, property, mode);
 	}
 	if (indigo_use_strict_locking)
 		pthread_mutex_unlock(&device_mutex);
@@ -497,7 +1078,9 @@ indigo_result indigo_define_property(indigo_device *device, indigo_property *pro
 		}
 		for (int i = 0; i < MAX_CLIENTS; i++) {
 			indigo_client *client = clients[i];
-			if (client != NULL && client->define_property != NULL)
+			if (client != NULL && client_queues[i] != NULL)
+				enqueue(client_queues[i], QUEUE_DEFINE_PROPERTY, device, property, NULL, format != NULL ? message : NULL);
+			else if (client != NULL && client->define_property != NULL)
 				client->last_result = client->define_property(client, device, property, format != NULL ? message : NULL);
 		}
 	}
@@ -527,41 +1110,62 @@ indigo_result indigo_update_property(indigo_device *device, indigo_property *pro
 			pthread_mutex_lock(&blob_mutex);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = property->items + i;
-				indigo_blob_entry *entry = NULL;
-				int free_index = -1;
-				for (int j = 0; j < MAX_BLOBS; j++) {
-					entry = blobs[j];
-					if (entry && entry->item == item) {
-						break;
+				indigo_blob_entry *entry = find_blob_entry(item);
+				if (entry == NULL) {
+					if (blob_count == blob_capacity) {
+						int capacity = blob_capacity ? 2 * blob_capacity : 32;
+						indigo_blob_entry **tmp = realloc(blobs, capacity * sizeof(indigo_blob_entry *));
+						assert(tmp != NULL);
+						blobs = tmp;
+						blob_capacity = capacity;
 					}
-					if (entry == NULL && free_index == -1)
-						free_index = j;
-					entry = NULL;
-				}
-				if (entry == NULL && free_index >= 0) {
-					blobs[free_index] = entry = malloc(sizeof(indigo_blob_entry));
+					blobs[blob_count++] = entry = malloc(sizeof(indigo_blob_entry));
+					assert(entry != NULL);
 					memset(entry, 0, sizeof(indigo_blob_entry));
 					entry->item = item;
 					pthread_mutex_init(&entry->mutext, NULL);
 				}
-				if (entry) {
-					entry->content = realloc(entry->content, entry->size = item->blob.size);
-					memcpy(entry->content, item->blob.value, entry->size);
-					strcpy(entry->format, item->blob.format);
+				pthread_mutex_lock(&entry->mutext);
+				shared_blob_buffer *old_buffer = entry->buffer;
+				shared_blob_buffer *buffer = find_shared_blob_buffer(item->blob.value, item->blob.size);
+				if (buffer) {
+					// driver handed over shared buffer, just keep reference to it
+					buffer->references++;
+					entry->content = item->blob.value;
 				} else {
-					pthread_mutex_unlock(&blob_mutex);
-					if (indigo_use_strict_locking)
-						pthread_mutex_unlock(&client_mutex);
-					return INDIGO_TOO_MANY_ELEMENTS;
+					if (old_buffer && old_buffer->references == 1 && old_buffer->size >= item->blob.size) {
+						buffer = old_buffer;
+						buffer->references++;
+					} else {
+						buffer = alloc_shared_blob_buffer(item->blob.size);
+					}
+					if (item->blob.size > 0)
+						memcpy(buffer->data, item->blob.value, item->blob.size);
+					entry->content = buffer->data;
 				}
+				entry->buffer = buffer;
+				entry->size = item->blob.size;
+				strcpy(entry->format, item->blob.format);
+				if (old_buffer)
+					release_shared_blob_buffer(old_buffer);
+				pthread_mutex_unlock(&entry->mutext);
 			}
 			pthread_mutex_unlock(&blob_mutex);
 		}
+		void **blob_values = NULL;
 		for (int i = 0; i < MAX_CLIENTS; i++) {
 			indigo_client *client = clients[i];
-			if (client != NULL && client->update_property != NULL)
+			if (client != NULL && client_queues[i] != NULL) {
+				// BLOB items point to driver owned buffers, so queued copy refers to shared buffers with the same content
+				if (blob_values == NULL && property->type == INDIGO_BLOB_VECTOR && property->state == INDIGO_OK_STATE)
+					blob_values = share_blob_values(property);
+				enqueue(client_queues[i], QUEUE_UPDATE_PROPERTY, device, property, blob_values, format != NULL ? message : NULL);
+			} else if (client != NULL && client->update_property != NULL) {
 				client->last_result = client->update_property(client, device, property, format != NULL ? message : NULL);
+			}
 		}
+		if (blob_values)
+			release_blob_values(property, blob_values);
 		property->count = count;
 	}
 	if (indigo_use_strict_locking)
@@ -585,7 +1189,9 @@ indigo_result indigo_delete_property(indigo_device *device, indigo_property *pro
 		}
 		for (int i = 0; i < MAX_CLIENTS; i++) {
 			indigo_client *client = clients[i];
-			if (client != NULL && client->delete_property != NULL)
+			if (client != NULL && client_queues[i] != NULL)
+				enqueue(client_queues[i], QUEUE_DELETE_PROPERTY, device, property, NULL, format != NULL ? message : NULL);
+			else if (client != NULL && client->delete_property != NULL)
 				client->last_result = client->delete_property(client, device, property, format != NULL ? message : NULL);
 		}
 	}
@@ -609,7 +1215,9 @@ indigo_result indigo_send_message(indigo_device *device, const char *format, ...
 	INDIGO_DEBUG(indigo_debug("INDIGO Bus: message sent '%s'", message));
 	for (int i = 0; i < MAX_CLIENTS; i++) {
 		indigo_client *client = clients[i];
-		if (client != NULL && client->send_message != NULL)
+		if (client != NULL && client_queues[i] != NULL)
+			enqueue(client_queues[i], QUEUE_SEND_MESSAGE, device, NULL, NULL, format != NULL ? message : NULL);
+		else if (client != NULL && client->send_message != NULL)
 			client->last_result = client->send_message(client, device, format != NULL ? message : NULL);
 	}
 	if (indigo_use_strict_locking)
@@ -624,6 +1232,12 @@ indigo_result indigo_stop() {
 		is_started = false;
 		for (int i = 0; i < MAX_CLIENTS; i++) {
 			indigo_client *client = clients[i];
+			pthread_mutex_lock(&client_queues_mutex);
+			client_queue *queue = client_queues[i];
+			client_queues[i] = NULL;
+			pthread_mutex_unlock(&client_queues_mutex);
+			if (queue != NULL)
+				stop_client_queue(queue);
 			if (client != NULL && client->detach != NULL)
 				client->last_result = client->detach(client);
 		}
@@ -761,17 +1375,16 @@ void indigo_release_property(indigo_property *property) {
 		pthread_mutex_lock(&blob_mutex);
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = property->items + i;
-			for (int j = 0; j < MAX_BLOBS; j++) {
+			for (int j = 0; j < blob_count; j++) {
 				indigo_blob_entry *entry = blobs[j];
-				if (entry && entry->item == item) {
+				if (entry->item == item) {
 					pthread_mutex_lock(&entry->mutext);
-					if (entry->content) {
-						free(entry->content);
-					}
+					if (entry->buffer)
+						release_shared_blob_buffer(entry->buffer);
 					pthread_mutex_unlock(&entry->mutext);
 					pthread_mutex_destroy(&entry->mutext);
 					free(entry);
-					blobs[j] = NULL;
+					blobs[j] = blobs[--blob_count];
 					break;
 				}
 			}
@@ -782,12 +1395,29 @@ void indigo_release_property(indigo_property *property) {
 }
 
 indigo_blob_entry *indigo_validate_blob(indigo_item *item) {
-	for (int j = 0; j < MAX_BLOBS; j++) {
-		indigo_blob_entry *entry = blobs[j];
-		if (entry && entry->item == item)
-			return entry;
+	pthread_mutex_lock(&blob_mutex);
+	indigo_blob_entry *entry = find_blob_entry(item);
+	pthread_mutex_unlock(&blob_mutex);
+	return entry;
+}
+
+bool indigo_retain_blob(indigo_item *item, indigo_blob_entry *blob) {
+	pthread_mutex_lock(&blob_mutex);
+	indigo_blob_entry *entry = find_blob_entry(item);
+	if (entry == NULL || entry->buffer == NULL) {
+		pthread_mutex_unlock(&blob_mutex);
+		return false;
 	}
-	return NULL;
+	((shared_blob_buffer *)entry->buffer)->references++;
+	// content fields only, copy of pthread_mutex_t is not a valid mutex
+	memset(blob, 0, sizeof(indigo_blob_entry));
+	blob->item = entry->item;
+	blob->content = entry->content;
+	blob->size = entry->size;
+	strncpy(blob->format, entry->format, INDIGO_NAME_SIZE);
+	blob->buffer = entry->buffer;
+	pthread_mutex_unlock(&blob_mutex);
+	return true;
 }
 
 void indigo_init_text_item(indigo_item *item, const char *name, const char *label, const char *format, ...) {
@@ -849,6 +1479,66 @@ void *indigo_alloc_blob_buffer(long size) {
 	return malloc(size);
 }
 
+void *indigo_alloc_shared_blob_buffer(long size) {
+	pthread_mutex_lock(&blob_mutex);
+	shared_blob_buffer *buffer = alloc_shared_blob_buffer(size);
+	pthread_mutex_unlock(&blob_mutex);
+	return buffer->data;
+}
+
+void *indigo_writable_blob_buffer(void *data, long size) {
+	if (data == NULL)
+		return indigo_alloc_shared_blob_buffer(size);
+	pthread_mutex_lock(&blob_mutex);
+	shared_blob_buffer *buffer = find_shared_blob_buffer(data, 0);
+	if (buffer == NULL) {
+		pthread_mutex_unlock(&blob_mutex);
+		indigo_error("%s(): %p is not shared blob buffer", __FUNCTION__, data);
+		return data;
+	}
+	if (buffer->references > 1 || buffer->size < size) {
+		release_shared_blob_buffer(buffer);
+		buffer = alloc_shared_blob_buffer(size);
+	}
+	pthread_mutex_unlock(&blob_mutex);
+	return buffer->data;
+}
+
+int indigo_blob_buffer_handle(void *data, long *offset) {
+	int handle = -1;
+	pthread_mutex_lock(&blob_mutex);
+	shared_blob_buffer *buffer = find_shared_blob_buffer(data, 0);
+	if (buffer && buffer->handle >= 0) {
+		handle = buffer->handle;
+		*offset = (char *)data - (char *)buffer->data;
+	}
+	pthread_mutex_unlock(&blob_mutex);
+	return handle;
+}
+
+bool indigo_retain_blob_buffer(void *data) {
+	if (data == NULL)
+		return false;
+	pthread_mutex_lock(&blob_mutex);
+	shared_blob_buffer *buffer = find_shared_blob_buffer(data, 0);
+	if (buffer)
+		buffer->references++;
+	pthread_mutex_unlock(&blob_mutex);
+	return buffer != NULL;
+}
+
+void indigo_release_blob_buffer(void *data) {
+	if (data == NULL)
+		return;
+	pthread_mutex_lock(&blob_mutex);
+	shared_blob_buffer *buffer = find_shared_blob_buffer(data, 0);
+	if (buffer)
+		release_shared_blob_buffer(buffer);
+	else
+		indigo_error("%s(): %p is not shared blob buffer", __FUNCTION__, data);
+	pthread_mutex_unlock(&blob_mutex);
+}
+
 bool indigo_populate_http_blob_item(indigo_item *blob_item) {
 	char host[BUFFER_SIZE] = {0};
 	int port = 80;
@@ -23,14 +23,21 @@
  \file indigo_ccd_driver.c
  */
 
+#if defined(INDIGO_LINUX)
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <assert.h>
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
 #include <time.h>
+#include <pthread.h>
 #include <math.h>
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -39,6 +46,8 @@
 #include <indigo/indigo_ccd_driver.h>
 #include <indigo/indigo_io.h>
 
+static void local_writer_close(indigo_device *device);
+
 static void countdown_timer_callback(indigo_device *device) {
 	if (CCD_CONTEXT->countdown_enabled && CCD_EXPOSURE_PROPERTY->state == INDIGO_BUSY_STATE && CCD_EXPOSURE_ITEM->number.value >= 1) {
 		CCD_EXPOSURE_ITEM->number.value -= 1;
@@ -104,6 +113,26 @@ indigo_result indigo_ccd_attach(indigo_device *device, unsigned version) {
 				return INDIGO_FAILED;
 			indigo_init_text_item(CCD_LOCAL_MODE_DIR_ITEM, CCD_LOCAL_MODE_DIR_ITEM_NAME, "Directory", "%s/", getenv("HOME"));
 			indigo_init_text_item(CCD_LOCAL_MODE_PREFIX_ITEM, CCD_LOCAL_MODE_PREFIX_ITEM_NAME, "File name prefix", "IMAGE_XXX");
+			// -------------------------------------------------------------------------------- CCD_LOCAL_MODE_WRITER
+			CCD_LOCAL_MODE_WRITER_PROPERTY = indigo_init_number_property(NULL, device->name, CCD_LOCAL_MODE_WRITER_PROPERTY_NAME, CCD_MAIN_GROUP, "Local mode writer", INDIGO_OK_STATE, INDIGO_RW_PERM, 1);
+			if (CCD_LOCAL_MODE_WRITER_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			indigo_init_number_item(CCD_LOCAL_MODE_WRITER_QUEUE_ITEM, CCD_LOCAL_MODE_WRITER_QUEUE_ITEM_NAME, "Images saved in background", 0, 16, 1, 2);
+			// -------------------------------------------------------------------------------- CCD_LOCAL_MODE_SYNC
+			CCD_LOCAL_MODE_SYNC_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_LOCAL_MODE_SYNC_PROPERTY_NAME, CCD_MAIN_GROUP, "Local mode sync", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 3);
+			if (CCD_LOCAL_MODE_SYNC_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			indigo_init_switch_item(CCD_LOCAL_MODE_SYNC_NONE_ITEM, CCD_LOCAL_MODE_SYNC_NONE_ITEM_NAME, "Don't flush", true);
+			indigo_init_switch_item(CCD_LOCAL_MODE_SYNC_DATA_ITEM, CCD_LOCAL_MODE_SYNC_DATA_ITEM_NAME, "Flush data", false);
+			indigo_init_switch_item(CCD_LOCAL_MODE_SYNC_FULL_ITEM, CCD_LOCAL_MODE_SYNC_FULL_ITEM_NAME, "Flush data and metadata", false);
+			// -------------------------------------------------------------------------------- CCD_LOCAL_MODE_STATS
+			CCD_LOCAL_MODE_STATS_PROPERTY = indigo_init_number_property(NULL, device->name, CCD_LOCAL_MODE_STATS_PROPERTY_NAME, CCD_MAIN_GROUP, "Local mode statistics", INDIGO_OK_STATE, INDIGO_RO_PERM, 4);
+			if (CCD_LOCAL_MODE_STATS_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			indigo_init_number_item(CCD_LOCAL_MODE_STATS_PENDING_ITEM, CCD_LOCAL_MODE_STATS_PENDING_ITEM_NAME, "Pending images", 0, 16, 1, 0);
+			indigo_init_number_item(CCD_LOCAL_MODE_STATS_WRITTEN_ITEM, CCD_LOCAL_MODE_STATS_WRITTEN_ITEM_NAME, "Saved images", 0, 1e9, 1, 0);
+			indigo_init_number_item(CCD_LOCAL_MODE_STATS_THROUGHPUT_ITEM, CCD_LOCAL_MODE_STATS_THROUGHPUT_ITEM_NAME, "Throughput (MB/s)", 0, 1e6, 0, 0);
+			indigo_init_number_item(CCD_LOCAL_MODE_STATS_LATENCY_ITEM, CCD_LOCAL_MODE_STATS_LATENCY_ITEM_NAME, "Latency (s)", 0, 1e6, 0, 0);
 			// -------------------------------------------------------------------------------- CCD_MODE
 			CCD_MODE_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_MODE_PROPERTY_NAME, CCD_MAIN_GROUP, "Capture mode", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 64);
 			if (CCD_MODE_PROPERTY == NULL)
@@ -133,6 +162,34 @@ indigo_result indigo_ccd_attach(indigo_device *device, unsigned version) {
 			indigo_init_number_item(CCD_STREAMING_COUNT_ITEM, CCD_STREAMING_COUNT_ITEM_NAME, "Frame count", -1, 100000, 1, -1);
 			strcpy(CCD_EXPOSURE_ITEM->number.format, "%g");
 			CCD_STREAMING_PROPERTY->hidden = true;
+			// -------------------------------------------------------------------------------- CCD_STREAMING_STATS
+			CCD_STREAMING_STATS_PROPERTY = indigo_init_number_property(NULL, device->name, CCD_STREAMING_STATS_PROPERTY_NAME, CCD_MAIN_GROUP, "Streaming statistics", INDIGO_OK_STATE, INDIGO_RO_PERM, 3);
+			if (CCD_STREAMING_STATS_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			indigo_init_number_item(CCD_STREAMING_STATS_CAPTURED_ITEM, CCD_STREAMING_STATS_CAPTURED_ITEM_NAME, "Captured frames", 0, 1e9, 1, 0);
+			indigo_init_number_item(CCD_STREAMING_STATS_PROCESSED_ITEM, CCD_STREAMING_STATS_PROCESSED_ITEM_NAME, "Processed frames", 0, 1e9, 1, 0);
+			indigo_init_number_item(CCD_STREAMING_STATS_DROPPED_ITEM, CCD_STREAMING_STATS_DROPPED_ITEM_NAME, "Dropped frames", 0, 1e9, 1, 0);
+			CCD_STREAMING_STATS_PROPERTY->hidden = true;
+			// -------------------------------------------------------------------------------- CCD_STREAMING_POLICY
+			CCD_STREAMING_POLICY_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_STREAMING_POLICY_PROPERTY_NAME, CCD_MAIN_GROUP, "Streaming overflow", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 2);
+			if (CCD_STREAMING_POLICY_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			indigo_init_switch_item(CCD_STREAMING_POLICY_DROP_OLDEST_ITEM, CCD_STREAMING_POLICY_DROP_OLDEST_ITEM_NAME, "Drop oldest frame", true);
+			indigo_init_switch_item(CCD_STREAMING_POLICY_DROP_NEWEST_ITEM, CCD_STREAMING_POLICY_DROP_NEWEST_ITEM_NAME, "Drop newest frame", false);
+			CCD_STREAMING_POLICY_PROPERTY->hidden = true;
+			// -------------------------------------------------------------------------------- CCD_STREAMING_MODE
+			CCD_STREAMING_MODE_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_STREAMING_MODE_PROPERTY_NAME, CCD_MAIN_GROUP, "Streaming output", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 2);
+			if (CCD_STREAMING_MODE_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			indigo_init_switch_item(CCD_STREAMING_MODE_FRAMES_ITEM, CCD_STREAMING_MODE_FRAMES_ITEM_NAME, "Separate frames", true);
+			indigo_init_switch_item(CCD_STREAMING_MODE_SER_ITEM, CCD_STREAMING_MODE_SER_ITEM_NAME, "SER video", false);
+			CCD_STREAMING_MODE_PROPERTY->hidden = true;
+			// -------------------------------------------------------------------------------- CCD_STREAMING_PREVIEW
+			CCD_STREAMING_PREVIEW_PROPERTY = indigo_init_number_property(NULL, device->name, CCD_STREAMING_PREVIEW_PROPERTY_NAME, CCD_MAIN_GROUP, "SER video preview", INDIGO_OK_STATE, INDIGO_RW_PERM, 1);
+			if (CCD_STREAMING_PREVIEW_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			indigo_init_number_item(CCD_STREAMING_PREVIEW_INTERVAL_ITEM, CCD_STREAMING_PREVIEW_INTERVAL_ITEM_NAME, "Preview every N frames (0 = off)", 0, 10000, 1, 10);
+			CCD_STREAMING_PREVIEW_PROPERTY->hidden = true;
 			// -------------------------------------------------------------------------------- CCD_ABORT_EXPOSURE
 			CCD_ABORT_EXPOSURE_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_ABORT_EXPOSURE_PROPERTY_NAME, CCD_MAIN_GROUP, "Abort exposure", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_AT_MOST_ONE_RULE, 1);
 			if (CCD_ABORT_EXPOSURE_PROPERTY == NULL)
@@ -198,6 +255,69 @@ indigo_result indigo_ccd_attach(indigo_device *device, unsigned version) {
 				return INDIGO_FAILED;
 			CCD_PREVIEW_IMAGE_PROPERTY->hidden = true;
 			indigo_init_blob_item(CCD_PREVIEW_IMAGE_ITEM, CCD_PREVIEW_IMAGE_ITEM_NAME, "Image data");
+			// -------------------------------------------------------------------------------- CCD_PREVIEW_SETTINGS
+			CCD_PREVIEW_SETTINGS_PROPERTY = indigo_init_number_property(NULL, device->name, CCD_PREVIEW_SETTINGS_PROPERTY_NAME, CCD_IMAGE_GROUP, "Preview settings", INDIGO_OK_STATE, INDIGO_RW_PERM, 6);
+			if (CCD_PREVIEW_SETTINGS_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			CCD_PREVIEW_SETTINGS_PROPERTY->hidden = true;
+			indigo_init_number_item(CCD_PREVIEW_SETTINGS_MAX_SIZE_ITEM, CCD_PREVIEW_SETTINGS_MAX_SIZE_ITEM_NAME, "Max size (px, 0 = full)", 0, 65535, 1, 0);
+			indigo_init_number_item(CCD_PREVIEW_SETTINGS_LEFT_ITEM, CCD_PREVIEW_SETTINGS_LEFT_ITEM_NAME, "ROI left (px)", 0, 65535, 1, 0);
+			indigo_init_number_item(CCD_PREVIEW_SETTINGS_TOP_ITEM, CCD_PREVIEW_SETTINGS_TOP_ITEM_NAME, "ROI top (px)", 0, 65535, 1, 0);
+			indigo_init_number_item(CCD_PREVIEW_SETTINGS_WIDTH_ITEM, CCD_PREVIEW_SETTINGS_WIDTH_ITEM_NAME, "ROI width (px, 0 = full)", 0, 65535, 1, 0);
+			indigo_init_number_item(CCD_PREVIEW_SETTINGS_HEIGHT_ITEM, CCD_PREVIEW_SETTINGS_HEIGHT_ITEM_NAME, "ROI height (px, 0 = full)", 0, 65535, 1, 0);
+			indigo_init_number_item(CCD_PREVIEW_SETTINGS_INTERVAL_ITEM, CCD_PREVIEW_SETTINGS_INTERVAL_ITEM_NAME, "Streaming interval (s)", 0, 3600, 0.1, 0);
+			// -------------------------------------------------------------------------------- CCD_ANALYSIS
+			CCD_ANALYSIS_PROPERTY = indigo_init_switch_property(NULL, device->name, CCD_ANALYSIS_PROPERTY_NAME, CCD_IMAGE_GROUP, "Image analysis", INDIGO_OK_STATE, INDIGO_RW_PERM, INDIGO_ONE_OF_MANY_RULE, 2);
+			if (CCD_ANALYSIS_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			indigo_init_switch_item(CCD_ANALYSIS_ENABLED_ITEM, CCD_ANALYSIS_ENABLED_ITEM_NAME, "Enabled", false);
+			indigo_init_switch_item(CCD_ANALYSIS_DISABLED_ITEM, CCD_ANALYSIS_DISABLED_ITEM_NAME, "Disabled", true);
+			// -------------------------------------------------------------------------------- CCD_ANALYSIS_SETTINGS
+			CCD_ANALYSIS_SETTINGS_PROPERTY = indigo_init_number_property(NULL, device->name, CCD_ANALYSIS_SETTINGS_PROPERTY_NAME, CCD_IMAGE_GROUP, "Analysis settings", INDIGO_OK_STATE, INDIGO_RW_PERM, 3);
+			if (CCD_ANALYSIS_SETTINGS_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			CCD_ANALYSIS_SETTINGS_PROPERTY->hidden = true;
+			indigo_init_number_item(CCD_ANALYSIS_SETTINGS_THRESHOLD_ITEM, CCD_ANALYSIS_SETTINGS_THRESHOLD_ITEM_NAME, "Detection threshold (sigma)", 1, 100, 0.5, 5);
+			indigo_init_number_item(CCD_ANALYSIS_SETTINGS_RADIUS_ITEM, CCD_ANALYSIS_SETTINGS_RADIUS_ITEM_NAME, "Star radius (px)", 2, 50, 1, 8);
+			indigo_init_number_item(CCD_ANALYSIS_SETTINGS_SATURATION_ITEM, CCD_ANALYSIS_SETTINGS_SATURATION_ITEM_NAME, "Saturation level (0 = full scale)", 0, 65535, 1, 0);
+			// -------------------------------------------------------------------------------- CCD_ANALYSIS_STATS
+			CCD_ANALYSIS_STATS_PROPERTY = indigo_init_number_property(NULL, device->name, CCD_ANALYSIS_STATS_PROPERTY_NAME, CCD_IMAGE_GROUP, "Image statistics", INDIGO_OK_STATE, INDIGO_RO_PERM, 9);
+			if (CCD_ANALYSIS_STATS_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			CCD_ANALYSIS_STATS_PROPERTY->hidden = true;
+			indigo_init_number_item(CCD_ANALYSIS_STATS_MIN_ITEM, CCD_ANALYSIS_STATS_MIN_ITEM_NAME, "Minimum", 0, 65535, 1, 0);
+			indigo_init_number_item(CCD_ANALYSIS_STATS_MAX_ITEM, CCD_ANALYSIS_STATS_MAX_ITEM_NAME, "Maximum", 0, 65535, 1, 0);
+			indigo_init_number_item(CCD_ANALYSIS_STATS_MEAN_ITEM, CCD_ANALYSIS_STATS_MEAN_ITEM_NAME, "Mean", 0, 65535, 0, 0);
+			indigo_init_number_item(CCD_ANALYSIS_STATS_MEDIAN_ITEM, CCD_ANALYSIS_STATS_MEDIAN_ITEM_NAME, "Median", 0, 65535, 1, 0);
+			indigo_init_number_item(CCD_ANALYSIS_STATS_STDDEV_ITEM, CCD_ANALYSIS_STATS_STDDEV_ITEM_NAME, "Standard deviation", 0, 65535, 0, 0);
+			indigo_init_number_item(CCD_ANALYSIS_STATS_SATURATED_ITEM, CCD_ANALYSIS_STATS_SATURATED_ITEM_NAME, "Saturated samples", 0, 1e9, 1, 0);
+			indigo_init_number_item(CCD_ANALYSIS_STATS_STARS_ITEM, CCD_ANALYSIS_STATS_STARS_ITEM_NAME, "Detected stars", 0, 1e6, 1, 0);
+			indigo_init_number_item(CCD_ANALYSIS_STATS_HFD_ITEM, CCD_ANALYSIS_STATS_HFD_ITEM_NAME, "Median HFD (px)", 0, 100, 0, 0);
+			indigo_init_number_item(CCD_ANALYSIS_STATS_FWHM_ITEM, CCD_ANALYSIS_STATS_FWHM_ITEM_NAME, "Median FWHM (px)", 0, 100, 0, 0);
+			// -------------------------------------------------------------------------------- CCD_ANALYSIS_STARS
+			CCD_ANALYSIS_STARS_PROPERTY = indigo_init_number_property(NULL, device->name, CCD_ANALYSIS_STARS_PROPERTY_NAME, CCD_IMAGE_GROUP, "Detected stars", INDIGO_OK_STATE, INDIGO_RO_PERM, CCD_ANALYSIS_MAX_STARS * CCD_ANALYSIS_STAR_ITEMS);
+			if (CCD_ANALYSIS_STARS_PROPERTY == NULL)
+				return INDIGO_FAILED;
+			CCD_ANALYSIS_STARS_PROPERTY->hidden = true;
+			for (int i = 0; i < CCD_ANALYSIS_MAX_STARS; i++) {
+				indigo_item *item = CCD_ANALYSIS_STARS_PROPERTY->items + i * CCD_ANALYSIS_STAR_ITEMS;
+				char name[32], label[32];
+				sprintf(name, CCD_ANALYSIS_STAR_X_ITEM_NAME, i + 1);
+				sprintf(label, "Star #%d X (px)", i + 1);
+				indigo_init_number_item(item, name, label, 0, 65535, 0, 0);
+				sprintf(name, CCD_ANALYSIS_STAR_Y_ITEM_NAME, i + 1);
+				sprintf(label, "Star #%d Y (px)", i + 1);
+				indigo_init_number_item(item + 1, name, label, 0, 65535, 0, 0);
+				sprintf(name, CCD_ANALYSIS_STAR_HFD_ITEM_NAME, i + 1);
+				sprintf(label, "Star #%d HFD (px)", i + 1);
+				indigo_init_number_item(item + 2, name, label, 0, 100, 0, 0);
+				sprintf(name, CCD_ANALYSIS_STAR_FWHM_ITEM_NAME, i + 1);
+				sprintf(label, "Star #%d FWHM (px)", i + 1);
+				indigo_init_number_item(item + 3, name, label, 0, 100, 0, 0);
+				sprintf(name, CCD_ANALYSIS_STAR_FLUX_ITEM_NAME, i + 1);
+				sprintf(label, "Star #%d flux", i + 1);
+				indigo_init_number_item(item + 4, name, label, 0, 1e12, 0, 0);
+			}
 			// -------------------------------------------------------------------------------- CCD_LOCAL_FILE
 			CCD_IMAGE_FILE_PROPERTY = indigo_init_text_property(NULL, device->name, CCD_IMAGE_FILE_PROPERTY_NAME, CCD_IMAGE_GROUP, "Image file info", INDIGO_OK_STATE, INDIGO_RO_PERM, 1);
 			if (CCD_IMAGE_FILE_PROPERTY == NULL)
@@ -271,6 +391,12 @@ indigo_result indigo_ccd_enumerate_properties(indigo_device *device, indigo_clie
 			indigo_define_property(device, CCD_INFO_PROPERTY, NULL);
 		if (indigo_property_match(CCD_LOCAL_MODE_PROPERTY, property))
 			indigo_define_property(device, CCD_LOCAL_MODE_PROPERTY, NULL);
+		if (indigo_property_match(CCD_LOCAL_MODE_WRITER_PROPERTY, property))
+			indigo_define_property(device, CCD_LOCAL_MODE_WRITER_PROPERTY, NULL);
+		if (indigo_property_match(CCD_LOCAL_MODE_SYNC_PROPERTY, property))
+			indigo_define_property(device, CCD_LOCAL_MODE_SYNC_PROPERTY, NULL);
+		if (indigo_property_match(CCD_LOCAL_MODE_STATS_PROPERTY, property))
+			indigo_define_property(device, CCD_LOCAL_MODE_STATS_PROPERTY, NULL);
 		if (indigo_property_match(CCD_IMAGE_FILE_PROPERTY, property))
 			indigo_define_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
 		if (indigo_property_match(CCD_MODE_PROPERTY, property))
@@ -281,6 +407,14 @@ indigo_result indigo_ccd_enumerate_properties(indigo_device *device, indigo_clie
 			indigo_define_property(device, CCD_EXPOSURE_PROPERTY, NULL);
 		if (indigo_property_match(CCD_STREAMING_PROPERTY, property))
 			indigo_define_property(device, CCD_STREAMING_PROPERTY, NULL);
+		if (indigo_property_match(CCD_STREAMING_STATS_PROPERTY, property))
+			indigo_define_property(device, CCD_STREAMING_STATS_PROPERTY, NULL);
+		if (indigo_property_match(CCD_STREAMING_POLICY_PROPERTY, property))
+			indigo_define_property(device, CCD_STREAMING_POLICY_PROPERTY, NULL);
+		if (indigo_property_match(CCD_STREAMING_MODE_PROPERTY, property))
+			indigo_define_property(device, CCD_STREAMING_MODE_PROPERTY, NULL);
+		if (indigo_property_match(CCD_STREAMING_PREVIEW_PROPERTY, property))
+			indigo_define_property(device, CCD_STREAMING_PREVIEW_PROPERTY, NULL);
 		if (indigo_property_match(CCD_ABORT_EXPOSURE_PROPERTY, property))
 			indigo_define_property(device, CCD_ABORT_EXPOSURE_PROPERTY, NULL);
 		if (indigo_property_match(CCD_FRAME_PROPERTY, property))
@@ -305,6 +439,16 @@ indigo_result indigo_ccd_enumerate_properties(indigo_device *device, indigo_clie
 			indigo_define_property(device, CCD_IMAGE_PROPERTY, NULL);
 		if (indigo_property_match(CCD_PREVIEW_IMAGE_PROPERTY, property))
 			indigo_define_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
+		if (indigo_property_match(CCD_PREVIEW_SETTINGS_PROPERTY, property))
+			indigo_define_property(device, CCD_PREVIEW_SETTINGS_PROPERTY, NULL);
+		if (indigo_property_match(CCD_ANALYSIS_PROPERTY, property))
+			indigo_define_property(device, CCD_ANALYSIS_PROPERTY, NULL);
+		if (indigo_property_match(CCD_ANALYSIS_SETTINGS_PROPERTY, property))
+			indigo_define_property(device, CCD_ANALYSIS_SETTINGS_PROPERTY, NULL);
+		if (indigo_property_match(CCD_ANALYSIS_STATS_PROPERTY, property))
+			indigo_define_property(device, CCD_ANALYSIS_STATS_PROPERTY, NULL);
+		if (indigo_property_match(CCD_ANALYSIS_STARS_PROPERTY, property))
+			indigo_define_property(device, CCD_ANALYSIS_STARS_PROPERTY, NULL);
 		if (indigo_property_match(CCD_COOLER_PROPERTY, property))
 			indigo_define_property(device, CCD_COOLER_PROPERTY, NULL);
 		if (indigo_property_match(CCD_COOLER_POWER_PROPERTY, property))
@@ -334,10 +478,19 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			indigo_define_property(device, CCD_UPLOAD_MODE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_PREVIEW_PROPERTY, NULL);
 			indigo_define_property(device, CCD_LOCAL_MODE_PROPERTY, NULL);
+			indigo_define_property(device, CCD_LOCAL_MODE_WRITER_PROPERTY, NULL);
+			indigo_define_property(device, CCD_LOCAL_MODE_SYNC_PROPERTY, NULL);
+			indigo_define_property(device, CCD_LOCAL_MODE_STATS_PROPERTY, NULL);
 			indigo_define_property(device, CCD_MODE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_READ_MODE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_EXPOSURE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_STREAMING_PROPERTY, NULL);
+			CCD_STREAMING_STATS_PROPERTY->hidden = CCD_STREAMING_POLICY_PROPERTY->hidden = CCD_STREAMING_PROPERTY->hidden;
+			CCD_STREAMING_MODE_PROPERTY->hidden = CCD_STREAMING_PREVIEW_PROPERTY->hidden = CCD_STREAMING_PROPERTY->hidden;
+			indigo_define_property(device, CCD_STREAMING_STATS_PROPERTY, NULL);
+			indigo_define_property(device, CCD_STREAMING_POLICY_PROPERTY, NULL);
+			indigo_define_property(device, CCD_STREAMING_MODE_PROPERTY, NULL);
+			indigo_define_property(device, CCD_STREAMING_PREVIEW_PROPERTY, NULL);
 			indigo_define_property(device, CCD_ABORT_EXPOSURE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_FRAME_PROPERTY, NULL);
 			indigo_define_property(device, CCD_BIN_PROPERTY, NULL);
@@ -349,6 +502,11 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			indigo_define_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_IMAGE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
+			indigo_define_property(device, CCD_PREVIEW_SETTINGS_PROPERTY, NULL);
+			indigo_define_property(device, CCD_ANALYSIS_PROPERTY, NULL);
+			indigo_define_property(device, CCD_ANALYSIS_SETTINGS_PROPERTY, NULL);
+			indigo_define_property(device, CCD_ANALYSIS_STATS_PROPERTY, NULL);
+			indigo_define_property(device, CCD_ANALYSIS_STARS_PROPERTY, NULL);
 			indigo_define_property(device, CCD_COOLER_PROPERTY, NULL);
 			indigo_define_property(device, CCD_COOLER_POWER_PROPERTY, NULL);
 			indigo_define_property(device, CCD_TEMPERATURE_PROPERTY, NULL);
@@ -357,14 +515,23 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			indigo_define_property(device, CCD_RBI_FLUSH_ENABLE_PROPERTY, NULL);
 			indigo_define_property(device, CCD_RBI_FLUSH_PROPERTY, NULL);
 		} else {
+			if (CCD_CONTEXT->local_writer)
+				local_writer_close(device);
 			indigo_delete_property(device, CCD_INFO_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_UPLOAD_MODE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_PREVIEW_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_LOCAL_MODE_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_LOCAL_MODE_WRITER_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_LOCAL_MODE_SYNC_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_LOCAL_MODE_STATS_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_MODE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_READ_MODE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_EXPOSURE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_STREAMING_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_STREAMING_STATS_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_STREAMING_POLICY_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_STREAMING_MODE_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_STREAMING_PREVIEW_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_ABORT_EXPOSURE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_FRAME_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_BIN_PROPERTY, NULL);
@@ -376,6 +543,11 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			indigo_delete_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_IMAGE_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_PREVIEW_SETTINGS_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_ANALYSIS_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_ANALYSIS_SETTINGS_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_ANALYSIS_STATS_PROPERTY, NULL);
+			indigo_delete_property(device, CCD_ANALYSIS_STARS_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_COOLER_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_COOLER_POWER_PROPERTY, NULL);
 			indigo_delete_property(device, CCD_TEMPERATURE_PROPERTY, NULL);
@@ -389,8 +561,13 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 		if (indigo_switch_match(CONFIG_SAVE_ITEM, property)) {
 			indigo_save_property(device, NULL, CCD_MODE_PROPERTY);
 			indigo_save_property(device, NULL, CCD_READ_MODE_PROPERTY);
+			indigo_save_property(device, NULL, CCD_STREAMING_POLICY_PROPERTY);
+			indigo_save_property(device, NULL, CCD_STREAMING_MODE_PROPERTY);
+			indigo_save_property(device, NULL, CCD_STREAMING_PREVIEW_PROPERTY);
 			indigo_save_property(device, NULL, CCD_UPLOAD_MODE_PROPERTY);
 			indigo_save_property(device, NULL, CCD_LOCAL_MODE_PROPERTY);
+			indigo_save_property(device, NULL, CCD_LOCAL_MODE_WRITER_PROPERTY);
+			indigo_save_property(device, NULL, CCD_LOCAL_MODE_SYNC_PROPERTY);
 			indigo_save_property(device, NULL, CCD_FRAME_PROPERTY);
 			indigo_save_property(device, NULL, CCD_BIN_PROPERTY);
 			indigo_save_property(device, NULL, CCD_OFFSET_PROPERTY);
@@ -399,6 +576,8 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			indigo_save_property(device, NULL, CCD_FRAME_TYPE_PROPERTY);
 			indigo_save_property(device, NULL, CCD_FITS_HEADERS_PROPERTY);
 			indigo_save_property(device, NULL, CCD_JPEG_SETTINGS_PROPERTY);
+			indigo_save_property(device, NULL, CCD_PREVIEW_SETTINGS_PROPERTY);
+			indigo_save_property(device, NULL, CCD_ANALYSIS_SETTINGS_PROPERTY);
 			indigo_save_property(device, NULL, CCD_RBI_FLUSH_ENABLE_PROPERTY);
 			indigo_save_property(device, NULL, CCD_RBI_FLUSH_PROPERTY);
 		}
@@ -612,20 +791,66 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 		if (CCD_PREVIEW_ENABLED_ITEM->sw.value) {
 			if (CCD_PREVIEW_IMAGE_PROPERTY->hidden) {
 				CCD_PREVIEW_IMAGE_PROPERTY->hidden = false;
-				if (IS_CONNECTED)
+				CCD_PREVIEW_SETTINGS_PROPERTY->hidden = false;
+				if (IS_CONNECTED) {
 					indigo_define_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
+					indigo_define_property(device, CCD_PREVIEW_SETTINGS_PROPERTY, NULL);
+				}
 			}
 		} else {
 			if (!CCD_PREVIEW_IMAGE_PROPERTY->hidden) {
-				if (IS_CONNECTED)
+				if (IS_CONNECTED) {
 					indigo_delete_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
+					indigo_delete_property(device, CCD_PREVIEW_SETTINGS_PROPERTY, NULL);
+				}
 				CCD_PREVIEW_IMAGE_PROPERTY->hidden = true;
+				CCD_PREVIEW_SETTINGS_PROPERTY->hidden = true;
 			}
 		}
 		CCD_PREVIEW_PROPERTY->state = INDIGO_OK_STATE;
 		if (IS_CONNECTED)
 			indigo_update_property(device, CCD_PREVIEW_PROPERTY, NULL);
 		return INDIGO_OK;
+	} else if (indigo_property_match(CCD_PREVIEW_SETTINGS_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- CCD_PREVIEW_SETTINGS
+		indigo_property_copy_values(CCD_PREVIEW_SETTINGS_PROPERTY, property, false);
+		CCD_PREVIEW_SETTINGS_PROPERTY->state = INDIGO_OK_STATE;
+		if (IS_CONNECTED)
+			indigo_update_property(device, CCD_PREVIEW_SETTINGS_PROPERTY, NULL);
+		return INDIGO_OK;
+	} else if (indigo_property_match(CCD_ANALYSIS_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- CCD_ANALYSIS
+		indigo_property_copy_values(CCD_ANALYSIS_PROPERTY, property, false);
+		if (CCD_ANALYSIS_ENABLED_ITEM->sw.value) {
+			if (CCD_ANALYSIS_SETTINGS_PROPERTY->hidden) {
+				CCD_ANALYSIS_SETTINGS_PROPERTY->hidden = CCD_ANALYSIS_STATS_PROPERTY->hidden = CCD_ANALYSIS_STARS_PROPERTY->hidden = false;
+				if (IS_CONNECTED) {
+					indigo_define_property(device, CCD_ANALYSIS_SETTINGS_PROPERTY, NULL);
+					indigo_define_property(device, CCD_ANALYSIS_STATS_PROPERTY, NULL);
+					indigo_define_property(device, CCD_ANALYSIS_STARS_PROPERTY, NULL);
+				}
+			}
+		} else {
+			if (!CCD_ANALYSIS_SETTINGS_PROPERTY->hidden) {
+				if (IS_CONNECTED) {
+					indigo_delete_property(device, CCD_ANALYSIS_SETTINGS_PROPERTY, NULL);
+					indigo_delete_property(device, CCD_ANALYSIS_STATS_PROPERTY, NULL);
+					indigo_delete_property(device, CCD_ANALYSIS_STARS_PROPERTY, NULL);
+				}
+				CCD_ANALYSIS_SETTINGS_PROPERTY->hidden = CCD_ANALYSIS_STATS_PROPERTY->hidden = CCD_ANALYSIS_STARS_PROPERTY->hidden = true;
+			}
+		}
+		CCD_ANALYSIS_PROPERTY->state = INDIGO_OK_STATE;
+		if (IS_CONNECTED)
+			indigo_update_property(device, CCD_ANALYSIS_PROPERTY, NULL);
+		return INDIGO_OK;
+	} else if (indigo_property_match(CCD_ANALYSIS_SETTINGS_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- CCD_ANALYSIS_SETTINGS
+		indigo_property_copy_values(CCD_ANALYSIS_SETTINGS_PROPERTY, property, false);
+		CCD_ANALYSIS_SETTINGS_PROPERTY->state = INDIGO_OK_STATE;
+		if (IS_CONNECTED)
+			indigo_update_property(device, CCD_ANALYSIS_SETTINGS_PROPERTY, NULL);
+		return INDIGO_OK;
 	} else if (indigo_property_match(CCD_LOCAL_MODE_PROPERTY, property)) {
 		// -------------------------------------------------------------------------------- CCD_IMAGE_LOCAL_MODE
 		indigo_property_copy_values(CCD_LOCAL_MODE_PROPERTY, property, false);
@@ -633,6 +858,20 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 		if (IS_CONNECTED)
 			indigo_update_property(device, CCD_LOCAL_MODE_PROPERTY, NULL);
 		return INDIGO_OK;
+	} else if (indigo_property_match(CCD_LOCAL_MODE_WRITER_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- CCD_LOCAL_MODE_WRITER
+		indigo_property_copy_values(CCD_LOCAL_MODE_WRITER_PROPERTY, property, false);
+		CCD_LOCAL_MODE_WRITER_PROPERTY->state = INDIGO_OK_STATE;
+		if (IS_CONNECTED)
+			indigo_update_property(device, CCD_LOCAL_MODE_WRITER_PROPERTY, NULL);
+		return INDIGO_OK;
+	} else if (indigo_property_match(CCD_LOCAL_MODE_SYNC_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- CCD_LOCAL_MODE_SYNC
+		indigo_property_copy_values(CCD_LOCAL_MODE_SYNC_PROPERTY, property, false);
+		CCD_LOCAL_MODE_SYNC_PROPERTY->state = INDIGO_OK_STATE;
+		if (IS_CONNECTED)
+			indigo_update_property(device, CCD_LOCAL_MODE_SYNC_PROPERTY, NULL);
+		return INDIGO_OK;
 	} else if (indigo_property_match(CCD_FITS_HEADERS_PROPERTY, property)) {
 		// -------------------------------------------------------------------------------- CCD_FITS_HEADERS
 		indigo_property_copy_values(CCD_FITS_HEADERS_PROPERTY, property, false);
@@ -698,6 +937,35 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 			indigo_update_property(device, CCD_RBI_FLUSH_ENABLE_PROPERTY, NULL);
 		}
 		return INDIGO_OK;
+	} else if (indigo_property_match(CCD_STREAMING_POLICY_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- CCD_STREAMING_POLICY
+		indigo_property_copy_values(CCD_STREAMING_POLICY_PROPERTY, property, false);
+		CCD_STREAMING_POLICY_PROPERTY->state = INDIGO_OK_STATE;
+		if (IS_CONNECTED) {
+			indigo_update_property(device, CCD_STREAMING_POLICY_PROPERTY, NULL);
+		}
+		return INDIGO_OK;
+	} else if (indigo_property_match(CCD_STREAMING_MODE_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- CCD_STREAMING_MODE
+		if (CCD_STREAMING_PROPERTY->state == INDIGO_BUSY_STATE) {
+			CCD_STREAMING_MODE_PROPERTY->state = INDIGO_ALERT_STATE;
+			indigo_update_property(device, CCD_STREAMING_MODE_PROPERTY, "Streaming in progress, output can not be changed.");
+			return INDIGO_OK;
+		}
+		indigo_property_copy_values(CCD_STREAMING_MODE_PROPERTY, property, false);
+		CCD_STREAMING_MODE_PROPERTY->state = INDIGO_OK_STATE;
+		if (IS_CONNECTED) {
+			indigo_update_property(device, CCD_STREAMING_MODE_PROPERTY, NULL);
+		}
+		return INDIGO_OK;
+	} else if (indigo_property_match(CCD_STREAMING_PREVIEW_PROPERTY, property)) {
+		// -------------------------------------------------------------------------------- CCD_STREAMING_PREVIEW
+		indigo_property_copy_values(CCD_STREAMING_PREVIEW_PROPERTY, property, false);
+		CCD_STREAMING_PREVIEW_PROPERTY->state = INDIGO_OK_STATE;
+		if (IS_CONNECTED) {
+			indigo_update_property(device, CCD_STREAMING_PREVIEW_PROPERTY, NULL);
+		}
+		return INDIGO_OK;
 		// -------------------------------------------------------------------------------- FLI_RBI_FLUSH
 	} else if (indigo_property_match(CCD_RBI_FLUSH_PROPERTY, property)) {
 		if (CCD_EXPOSURE_PROPERTY->state == INDIGO_BUSY_STATE) {
@@ -718,14 +986,25 @@ indigo_result indigo_ccd_change_property(indigo_device *device, indigo_client *c
 
 indigo_result indigo_ccd_detach(indigo_device *device) {
 	assert(device != NULL);
+	if (CCD_CONTEXT->streaming)
+		indigo_ccd_streaming_stop(device);
+	if (CCD_CONTEXT->local_writer)
+		local_writer_close(device);
 	indigo_release_property(CCD_INFO_PROPERTY);
 	indigo_release_property(CCD_UPLOAD_MODE_PROPERTY);
 	indigo_release_property(CCD_PREVIEW_PROPERTY);
 	indigo_release_property(CCD_LOCAL_MODE_PROPERTY);
+	indigo_release_property(CCD_LOCAL_MODE_WRITER_PROPERTY);
+	indigo_release_property(CCD_LOCAL_MODE_SYNC_PROPERTY);
+	indigo_release_property(CCD_LOCAL_MODE_STATS_PROPERTY);
 	indigo_release_property(CCD_MODE_PROPERTY);
 	indigo_release_property(CCD_READ_MODE_PROPERTY);
 	indigo_release_property(CCD_EXPOSURE_PROPERTY);
 	indigo_release_property(CCD_STREAMING_PROPERTY);
+	indigo_release_property(CCD_STREAMING_STATS_PROPERTY);
+	indigo_release_property(CCD_STREAMING_POLICY_PROPERTY);
+	indigo_release_property(CCD_STREAMING_MODE_PROPERTY);
+	indigo_release_property(CCD_STREAMING_PREVIEW_PROPERTY);
 	indigo_release_property(CCD_ABORT_EXPOSURE_PROPERTY);
 	indigo_release_property(CCD_FRAME_PROPERTY);
 	indigo_release_property(CCD_BIN_PROPERTY);
@@ -737,6 +1016,11 @@ indigo_result indigo_ccd_detach(indigo_device *device) {
 	indigo_release_property(CCD_IMAGE_FILE_PROPERTY);
 	indigo_release_property(CCD_IMAGE_PROPERTY);
 	indigo_release_property(CCD_PREVIEW_IMAGE_PROPERTY);
+	indigo_release_property(CCD_PREVIEW_SETTINGS_PROPERTY);
+	indigo_release_property(CCD_ANALYSIS_PROPERTY);
+	indigo_release_property(CCD_ANALYSIS_SETTINGS_PROPERTY);
+	indigo_release_property(CCD_ANALYSIS_STATS_PROPERTY);
+	indigo_release_property(CCD_ANALYSIS_STARS_PROPERTY);
 	indigo_release_property(CCD_TEMPERATURE_PROPERTY);
 	indigo_release_property(CCD_COOLER_PROPERTY);
 	indigo_release_property(CCD_COOLER_POWER_PROPERTY);
@@ -749,7 +1033,7 @@ indigo_result indigo_ccd_detach(indigo_device *device) {
 	return indigo_device_detach(device);
 }
 
-static void set_black_white(indigo_device *device, long *histo, long count) {
+static void set_black_white(indigo_device *device, const long *histo, long count) {
 	long black = CCD_JPEG_SETTINGS_BLACK_TRESHOLD_ITEM->number.value * count;
 	if (CCD_JPEG_SETTINGS_BLACK_ITEM->number.target == -1) {
 		long total = 0;
@@ -788,11 +1072,121 @@ static void set_black_white(indigo_device *device, long *histo, long count) {
 	}
 }
 
-static void raw_to_jpeg(indigo_device *device, void *data_in, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, void **data_out, unsigned long *size_out) {
-	INDIGO_DEBUG(clock_t start = clock());
+#define IMAGE_BAND_MAX_THREADS	8
+#define IMAGE_BAND_MIN_SIZE		(512 * 1024)
+
+typedef struct {
+	void *data;
+	unsigned char *out;
+	long start, count;
+	int bpp;
+	bool little_endian;
+	bool swap_rb;
+	const unsigned char *lut;
+	long histo[256];
+} preview_band;
+
+static void *preview_histogram_band(preview_band *band) {
+	// four interleaved histograms avoid stalls on repeated values
+	long histo[4][256] = { { 0 } };
+	long i = 0, count = band->count;
+	if (band->bpp == 8 || band->bpp == 24) {
+		unsigned char *b8 = (unsigned char *)band->data + band->start;
+		for (; i + 4 <= count; i += 4) {
+			histo[0][b8[i]]++;
+			histo[1][b8[i + 1]]++;
+			histo[2][b8[i + 2]]++;
+			histo[3][b8[i + 3]]++;
+		}
+		for (; i < count; i++)
+			histo[0][b8[i]]++;
+	} else {
+		unsigned short *b16 = (unsigned short *)band->data + band->start;
+		int shift = band->little_endian ? 8 : 0;
+		for (; i + 4 <= count; i += 4) {
+			histo[0][(b16[i] >> shift) & 0xFF]++;
+			histo[1][(b16[i + 1] >> shift) & 0xFF]++;
+			histo[2][(b16[i + 2] >> shift) & 0xFF]++;
+			histo[3][(b16[i + 3] >> shift) & 0xFF]++;
+		}
+		for (; i < count; i++)
+			histo[0][(b16[i] >> shift) & 0xFF]++;
+	}
+	for (int j = 0; j < 256; j++)
+		band->histo[j] = histo[0][j] + histo[1][j] + histo[2][j] + histo[3][j];
+	return NULL;
+}
+
+static void *preview_stretch_band(preview_band *band) {
+	const unsigned char *lut = band->lut;
+	unsigned char *out = band->out + band->start;
+	long count = band->count;
+	if (band->bpp == 8 || band->bpp == 24) {
+		unsigned char *b8 = (unsigned char *)band->data + band->start;
+		if (band->swap_rb) {
+			for (long i = 0; i < count; i += 3) {
+				out[i] = lut[b8[i + 2]];
+				out[i + 1] = lut[b8[i + 1]];
+				out[i + 2] = lut[b8[i]];
+			}
+		} else {
+			for (long i = 0; i < count; i++)
+				out[i] = lut[b8[i]];
+		}
+	} else {
+		unsigned short *b16 = (unsigned short *)band->data + band->start;
+		if (!band->little_endian) {
+			for (long i = 0; i < count; i++) {
+				unsigned short value = b16[i];
+				out[i] = lut[(unsigned short)(value << 8 | value >> 8)];
+			}
+		} else {
+			for (long i = 0; i < count; i++)
+				out[i] = lut[b16[i]];
+		}
+		if (band->swap_rb) {
+			for (long i = 0; i < count; i += 3) {
+				unsigned char b = out[i];
+				out[i] = out[i + 2];
+				out[i + 2] = b;
+			}
+		}
+	}
+	return NULL;
+}
+
+static int image_band_count(long bytes) {
+	int band_count = (int)(bytes / IMAGE_BAND_MIN_SIZE);
+	long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+	if (band_count > cpu_count)
+		band_count = (int)cpu_count;
+	if (band_count > IMAGE_BAND_MAX_THREADS)
+		band_count = IMAGE_BAND_MAX_THREADS;
+	if (band_count < 1)
+		band_count = 1;
+	return band_count;
+}
+
+static void run_image_bands(void *(*worker)(void *), void *bands, size_t band_size, int count) {
+	pthread_t threads[IMAGE_BAND_MAX_THREADS];
+	bool started[IMAGE_BAND_MAX_THREADS] = { false };
+	for (int i = 1; i < count; i++)
+		started[i] = pthread_create(&threads[i], NULL, worker, bands + i * band_size) == 0;
+	worker(bands);
+	for (int i = 1; i < count; i++) {
+		if (started[i])
+			pthread_join(threads[i], NULL);
+		else
+			worker(bands + i * band_size);
+	}
+}
+
+static void raw_to_jpeg(indigo_device *device, void *data_in, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, const long *frame_histogram, void **data_out, unsigned long *size_out) {
+	INDIGO_DEBUG(struct timespec start; clock_gettime(CLOCK_MONOTONIC, &start));
 	int size_in = frame_width * frame_height;
-	void *copy = malloc(size_in * bpp / 8);
-	memcpy(copy, data_in + FITS_HEADER_SIZE, size_in * bpp / 8);
+	int components = (bpp == 24 || bpp == 48) ? 3 : 1;
+	long count = (long)size_in * components;
+	unsigned char *preview = malloc(count);
 	unsigned char *mem = NULL;
 	unsigned long mem_size = 0;
 	struct jpeg_compress_struct cinfo;
@@ -802,70 +1196,54 @@ static void raw_to_jpeg(indigo_device *device, void *data_in, int frame_width, i
 	jpeg_mem_dest(&cinfo, &mem, &mem_size);
 	cinfo.image_width = frame_width;
 	cinfo.image_height = frame_height;
-	long histo[256] = { 0 };
-	if (bpp == 8 || bpp == 24) {
-		unsigned char *b8 = copy;
-		int count = size_in * (bpp == 8 ? 1 : 3);
-		for (int i = 0; i < count; i++) {
-			histo[*b8++]++;
-		}
-		set_black_white(device, histo, count);
-		double scale = (CCD_JPEG_SETTINGS_WHITE_ITEM->number.value - CCD_JPEG_SETTINGS_BLACK_ITEM->number.value) / 255;
-		int offset = CCD_JPEG_SETTINGS_BLACK_ITEM->number.value;
-		b8 = copy;
-		for (int i = 0; i < count; i++) {
-			int value = (*b8 - offset) / scale;
-			if (value < 0)
-				value = 0;
-			else if (value > 255)
-				value = 255;
-			*b8++ = value;
-		}
-	}
-	if (bpp == 16 || bpp == 48) {
-		unsigned short *b16 = copy;
-		int count = size_in * (bpp == 16 ? 1 : 3);
-		if (little_endian) {
-			for (int i = 0; i < count; i++) {
-				histo[*b16++ >> 8]++;
-			}
-		} else {
-			for (int i = 0; i < count; i++) {
-				int value = *b16;
-				value = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-				*b16++ = value;
-				histo[value >> 8]++;
-			}
-		}
+	// histogram and stretch run in horizontal bands, one per CPU core
+	int band_count = image_band_count(count);
+	preview_band bands[IMAGE_BAND_MAX_THREADS];
+	long band_pixels = size_in / band_count;
+	for (int i = 0; i < band_count; i++) {
+		preview_band *band = bands + i;
+		band->data = data_in + FITS_HEADER_SIZE;
+		band->out = preview;
+		band->start = i * band_pixels * components;
+		band->count = (i == band_count - 1 ? size_in - i * band_pixels : band_pixels) * components;
+		band->bpp = bpp;
+		band->little_endian = little_endian;
+		band->swap_rb = components == 3 && !byte_order_rgb;
+	}
+	if (frame_histogram) {
+		// histogram of the most significant byte is already known from image analysis
+		set_black_white(device, frame_histogram, count);
+	} else {
+		run_image_bands((void *(*)(void *))preview_histogram_band, bands, sizeof(preview_band), band_count);
+		long histo[256] = { 0 };
+		for (int i = 0; i < band_count; i++)
+			for (int j = 0; j < 256; j++)
+				histo[j] += bands[i].histo[j];
 		set_black_white(device, histo, count);
-		double scale = (CCD_JPEG_SETTINGS_WHITE_ITEM->number.value - CCD_JPEG_SETTINGS_BLACK_ITEM->number.value);
-		int offset = CCD_JPEG_SETTINGS_BLACK_ITEM->number.value;
-		unsigned char *b8 = copy;
-		b16 = copy;
-		for (int i = 0; i < count; i++) {
-			int value = (*b16++ - offset) / scale;
-			if (value < 0)
-				value = 0;
-			else if (value > 255)
-				value = 255;
-			*b8++ = value;
-		}
-	}
-	if (bpp == 8 || bpp == 16) {
+	}
+	// stretch is precomputed for every input value, so per pixel work is a table lookup
+	int offset = CCD_JPEG_SETTINGS_BLACK_ITEM->number.value;
+	int lut_size = (bpp == 8 || bpp == 24) ? 256 : 65536;
+	double scale = CCD_JPEG_SETTINGS_WHITE_ITEM->number.value - CCD_JPEG_SETTINGS_BLACK_ITEM->number.value;
+	if (lut_size == 256)
+		scale /= 255;
+	unsigned char *lut = malloc(lut_size);
+	for (int i = 0; i < lut_size; i++) {
+		int value = (i - offset) / scale;
+		if (value < 0)
+			value = 0;
+		else if (value > 255)
+			value = 255;
+		lut[i] = value;
+	}
+	for (int i = 0; i < band_count; i++)
+		bands[i].lut = lut;
+	run_image_bands((void *(*)(void *))preview_stretch_band, bands, sizeof(preview_band), band_count);
+	free(lut);
+	if (components == 1) {
 		cinfo.input_components = 1;
 		cinfo.in_color_space = JCS_GRAYSCALE;
-	}
-	if (bpp == 24 || bpp == 48) {
-		if (!byte_order_rgb) {
-			unsigned char *b8 = copy;
-			for (int i = 0; i < size_in; i++) {
-				unsigned char b = *b8;
-				unsigned char r = *(b8 + 2);
-				*b8 = r;
-				*(b8 + 2) = b;
-				b8 += 3;
-			}
-		}
+	} else {
 		cinfo.input_components = 3;
 		cinfo.in_color_space = JCS_RGB;
 	}
@@ -874,15 +1252,969 @@ static void raw_to_jpeg(indigo_device *device, void *data_in, int frame_width, i
 	JSAMPROW row_pointer[1];
 	jpeg_start_compress( &cinfo, TRUE);
 	while( cinfo.next_scanline < cinfo.image_height ) {
-		row_pointer[0] = &((JSAMPROW)copy)[cinfo.next_scanline * cinfo.image_width *  cinfo.input_components];
+		row_pointer[0] = &((JSAMPROW)preview)[cinfo.next_scanline * cinfo.image_width *  cinfo.input_components];
 		jpeg_write_scanlines(&cinfo, row_pointer, 1);
 	}
 	jpeg_finish_compress(&cinfo);
 	jpeg_destroy_compress(&cinfo);
 	*data_out = mem;
 	*size_out = mem_size;
-	free(copy);
-	INDIGO_DEBUG(indigo_debug("RAW to preview conversion in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+	free(preview);
+	INDIGO_DEBUG(struct timespec end; clock_gettime(CLOCK_MONOTONIC, &end));
+	INDIGO_DEBUG(double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+	INDIGO_DEBUG(indigo_debug("RAW to preview conversion in %gs (%g ms/MP, %d threads)", elapsed, size_in ? 1e9 * elapsed / size_in : 0, band_count));
+}
+
+void indigo_raw_to_jpeg(indigo_device *device, void *data, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, void **data_out, unsigned long *size_out) {
+	raw_to_jpeg(device, data, frame_width, frame_height, bpp, little_endian, byte_order_rgb, NULL, data_out, size_out);
+}
+
+typedef struct {
+	unsigned char *data;
+	int width;
+	long start, count;
+	int byte_per_sample;
+	int components;
+	bool swap16;
+	unsigned short xor16;
+	bool swap_rb;
+	bool planar;
+} encoder_band;
+
+static void *encoder_band_worker(encoder_band *band) {
+	// plain loops over whole rows, so the compiler can vectorize them
+	long samples = (long)band->width * band->components;
+	long row_size = samples * band->byte_per_sample;
+	unsigned char *scratch = band->planar ? malloc(row_size) : NULL;
+	for (long row = band->start; row < band->start + band->count; row++) {
+		unsigned char *b8 = band->data + row * row_size;
+		if (band->byte_per_sample == 2) {
+			unsigned short *b16 = (unsigned short *)b8;
+			unsigned short xor16 = band->xor16;
+			if (band->swap16) {
+				for (long i = 0; i < samples; i++) {
+					unsigned short value = b16[i];
+					b16[i] = (unsigned short)(value << 8 | value >> 8) ^ xor16;
+				}
+			} else if (xor16) {
+				for (long i = 0; i < samples; i++)
+					b16[i] ^= xor16;
+			}
+			if (band->planar) {
+				unsigned short *red = (unsigned short *)scratch, *green = red + band->width, *blue = green + band->width;
+				if (band->swap_rb) {
+					unsigned short *tmp = red;
+					red = blue;
+					blue = tmp;
+				}
+				for (int i = 0; i < band->width; i++) {
+					red[i] = b16[3 * i];
+					green[i] = b16[3 * i + 1];
+					blue[i] = b16[3 * i + 2];
+				}
+			} else if (band->swap_rb) {
+				for (int i = 0; i < band->width; i++) {
+					unsigned short value = b16[3 * i];
+					b16[3 * i] = b16[3 * i + 2];
+					b16[3 * i + 2] = value;
+				}
+			}
+		} else if (band->planar) {
+			unsigned char *red = scratch, *green = red + band->width, *blue = green + band->width;
+			if (band->swap_rb) {
+				unsigned char *tmp = red;
+				red = blue;
+				blue = tmp;
+			}
+			for (int i = 0; i < band->width; i++) {
+				red[i] = b8[3 * i];
+				green[i] = b8[3 * i + 1];
+				blue[i] = b8[3 * i + 2];
+			}
+		} else if (band->swap_rb) {
+			for (int i = 0; i < band->width; i++) {
+				unsigned char value = b8[3 * i];
+				b8[3 * i] = b8[3 * i + 2];
+				b8[3 * i + 2] = value;
+			}
+		}
+		if (scratch)
+			memcpy(b8, scratch, row_size);
+	}
+	if (scratch)
+		free(scratch);
+	return NULL;
+}
+
+static void encoder_planar_rows(unsigned char *data, int height, long plane_row_size) {
+	// after each row is split to R, G and B runs the frame is a height x 3 matrix of plane rows,
+	// transposing it in place by following permutation cycles moves every plane row exactly once
+	long count = 3L * height;
+	unsigned char *moved = calloc(count, 1);
+	unsigned char *tmp = malloc(plane_row_size);
+	for (long start = 1; start < count - 1; start++) {
+		if (moved[start])
+			continue;
+		memcpy(tmp, data + start * plane_row_size, plane_row_size);
+		long target = start;
+		while (true) {
+			long source = (target % height) * 3 + target / height;
+			moved[target] = 1;
+			if (source == start) {
+				memcpy(data + target * plane_row_size, tmp, plane_row_size);
+				break;
+			}
+			memcpy(data + target * plane_row_size, data + source * plane_row_size, plane_row_size);
+			target = source;
+		}
+	}
+	free(tmp);
+	free(moved);
+}
+
+static void encode_image(unsigned char *data, int width, int height, encoder_band *encoder) {
+	if (encoder->components == 1)
+		encoder->planar = encoder->swap_rb = false;
+	if (!encoder->swap16 && !encoder->xor16 && !encoder->swap_rb && !encoder->planar)
+		return;
+	long row_size = (long)width * encoder->components * encoder->byte_per_sample;
+	int band_count = image_band_count(row_size * height);
+	if (band_count > height)
+		band_count = height;
+	encoder_band bands[IMAGE_BAND_MAX_THREADS];
+	long band_rows = height / band_count;
+	for (int i = 0; i < band_count; i++) {
+		encoder_band *band = bands + i;
+		*band = *encoder;
+		band->data = data;
+		band->width = width;
+		band->start = i * band_rows;
+		band->count = i == band_count - 1 ? height - i * band_rows : band_rows;
+	}
+	run_image_bands((void *(*)(void *))encoder_band_worker, bands, sizeof(encoder_band), band_count);
+	if (encoder->planar && height > 1)
+		encoder_planar_rows(data, height, (long)width * encoder->byte_per_sample);
+}
+
+static void update_preview_image(indigo_device *device, void *jpeg_data, unsigned long jpeg_size) {
+	if (CCD_CONTEXT->preview_image) {
+		if (CCD_CONTEXT->preview_image_size < jpeg_size) {
+			CCD_CONTEXT->preview_image = realloc(CCD_CONTEXT->preview_image, CCD_CONTEXT->preview_image_size = jpeg_size);
+		}
+	} else {
+		CCD_CONTEXT->preview_image = malloc(CCD_CONTEXT->preview_image_size = jpeg_size);
+	}
+	memcpy(CCD_CONTEXT->preview_image, jpeg_data, jpeg_size);
+	CCD_PREVIEW_IMAGE_ITEM->blob.value = CCD_CONTEXT->preview_image;
+	CCD_PREVIEW_IMAGE_ITEM->blob.size = jpeg_size;
+	strcpy(CCD_PREVIEW_IMAGE_ITEM->blob.format, ".jpeg");
+	CCD_PREVIEW_IMAGE_PROPERTY->state = INDIGO_OK_STATE;
+	indigo_update_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
+}
+
+#define PREVIEW_MAX_FACTOR	256
+
+typedef struct {
+	void *data;
+	void *out;
+	int frame_width;
+	int left, top;
+	int out_width;
+	int start, count;
+	int factor;
+	int components;
+	bool wide;
+	bool swap;
+} decimate_band;
+
+static void *decimate_band_worker(decimate_band *band) {
+	int factor = band->factor, components = band->components;
+	long span = (long)band->out_width * factor * components;
+	uint32_t area = factor * factor;
+	uint32_t *restrict sum = malloc(span * sizeof(uint32_t));
+	assert(sum != NULL);
+	for (int y = band->start; y < band->start + band->count; y++) {
+		memset(sum, 0, span * sizeof(uint32_t));
+		// rows are summed as contiguous sample runs, simple enough for the compiler to vectorize
+		for (int k = 0; k < factor; k++) {
+			long offset = ((long)(band->top + y * factor + k) * band->frame_width + band->left) * components;
+			if (band->wide) {
+				const uint16_t *restrict in = (const uint16_t *)band->data + offset;
+				if (band->swap) {
+					for (long i = 0; i < span; i++)
+						sum[i] += __builtin_bswap16(in[i]);
+				} else {
+					for (long i = 0; i < span; i++)
+						sum[i] += in[i];
+				}
+			} else {
+				const uint8_t *restrict in = (const uint8_t *)band->data + offset;
+				for (long i = 0; i < span; i++)
+					sum[i] += in[i];
+			}
+		}
+		long out_offset = (long)y * band->out_width * components;
+		for (int x = 0; x < band->out_width; x++) {
+			const uint32_t *column = sum + (long)x * factor * components;
+			for (int c = 0; c < components; c++) {
+				uint32_t value = 0;
+				for (int j = 0; j < factor; j++)
+					value += column[j * components + c];
+				value = (value + area / 2) / area;
+				if (band->wide)
+					((uint16_t *)band->out)[out_offset + c] = band->swap ? __builtin_bswap16((uint16_t)value) : (uint16_t)value;
+				else
+					((uint8_t *)band->out)[out_offset + c] = (uint8_t)value;
+			}
+			out_offset += components;
+		}
+	}
+	free(sum);
+	return NULL;
+}
+
+static void send_preview_image(indigo_device *device, void *data, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, const long *frame_histogram, void *frame_jpeg_data, unsigned long frame_jpeg_size) {
+	if (CCD_STREAMING_PROPERTY->state == INDIGO_BUSY_STATE && CCD_PREVIEW_SETTINGS_INTERVAL_ITEM->number.value > 0) {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		double now = ts.tv_sec + ts.tv_nsec / 1e9;
+		if (now - CCD_CONTEXT->preview_time < CCD_PREVIEW_SETTINGS_INTERVAL_ITEM->number.value)
+			return;
+		CCD_CONTEXT->preview_time = now;
+	}
+	int left = (int)CCD_PREVIEW_SETTINGS_LEFT_ITEM->number.value;
+	int top = (int)CCD_PREVIEW_SETTINGS_TOP_ITEM->number.value;
+	if (left >= frame_width)
+		left = 0;
+	if (top >= frame_height)
+		top = 0;
+	int width = (int)CCD_PREVIEW_SETTINGS_WIDTH_ITEM->number.value;
+	int height = (int)CCD_PREVIEW_SETTINGS_HEIGHT_ITEM->number.value;
+	if (width <= 0 || left + width > frame_width)
+		width = frame_width - left;
+	if (height <= 0 || top + height > frame_height)
+		height = frame_height - top;
+	int max_size = (int)CCD_PREVIEW_SETTINGS_MAX_SIZE_ITEM->number.value;
+	int factor = 1;
+	if (max_size > 0) {
+		int size = width > height ? width : height;
+		factor = (size + max_size - 1) / max_size;
+		if (factor > width)
+			factor = width;
+		if (factor > height)
+			factor = height;
+		if (factor > PREVIEW_MAX_FACTOR)
+			factor = PREVIEW_MAX_FACTOR;
+		if (factor < 1)
+			factor = 1;
+	}
+	void *jpeg_data = NULL;
+	unsigned long jpeg_size = 0;
+	if (factor == 1 && width == frame_width && height == frame_height) {
+		if (frame_jpeg_data) {
+			update_preview_image(device, frame_jpeg_data, frame_jpeg_size);
+			return;
+		}
+		raw_to_jpeg(device, data, frame_width, frame_height, bpp, little_endian, byte_order_rgb, frame_histogram, &jpeg_data, &jpeg_size);
+	} else {
+		INDIGO_DEBUG(clock_t start = clock());
+		int components = (bpp == 24 || bpp == 48) ? 3 : 1;
+		int sample_size = (bpp == 16 || bpp == 48) ? 2 : 1;
+		int out_width = width / factor, out_height = height / factor;
+		void *out = malloc(FITS_HEADER_SIZE + (long)out_width * out_height * components * sample_size);
+		assert(out != NULL);
+		// region is binned in horizontal bands of output rows, one per CPU core
+		int band_count = image_band_count((long)width * height * components * sample_size);
+		if (band_count > out_height)
+			band_count = out_height;
+		decimate_band bands[IMAGE_BAND_MAX_THREADS];
+		int band_rows = out_height / band_count;
+		for (int i = 0; i < band_count; i++) {
+			decimate_band *band = bands + i;
+			band->data = (char *)data + FITS_HEADER_SIZE;
+			band->out = (char *)out + FITS_HEADER_SIZE;
+			band->frame_width = frame_width;
+			band->left = left;
+			band->top = top;
+			band->out_width = out_width;
+			band->start = i * band_rows;
+			band->count = i == band_count - 1 ? out_height - i * band_rows : band_rows;
+			band->factor = factor;
+			band->components = components;
+			band->wide = sample_size == 2;
+			band->swap = sample_size == 2 && !little_endian;
+		}
+		run_image_bands((void *(*)(void *))decimate_band_worker, bands, sizeof(decimate_band), band_count);
+		INDIGO_DEBUG(indigo_debug("Preview %dx%d region binned %dx to %dx%d in %gs", width, height, factor, out_width, out_height, (clock() - start) / (double)CLOCKS_PER_SEC));
+		raw_to_jpeg(device, out, out_width, out_height, bpp, little_endian, byte_order_rgb, NULL, &jpeg_data, &jpeg_size);
+		free(out);
+	}
+	if (jpeg_data) {
+		update_preview_image(device, jpeg_data, jpeg_size);
+		free(jpeg_data);
+	}
+}
+
+#define ANALYSIS_MAX_CANDIDATES	1024
+#define ANALYSIS_MAX_DETECTED		1000
+
+typedef struct {
+	int x, y;
+	int value;
+} analysis_candidate;
+
+typedef struct {
+	double x, y;
+	double hfd, fwhm, flux;
+} analysis_star;
+
+typedef struct {
+	void *data;
+	int frame_width, frame_height;
+	int start, count;
+	int components;
+	bool wide;
+	bool swap;
+	uint32_t *histogram;
+	int threshold;
+	int support;
+	int border;
+	analysis_candidate *candidates;
+	int candidate_count;
+} analysis_band;
+
+static inline int analysis_pixel(const analysis_band *band, long index) {
+	int value = 0;
+	if (band->wide) {
+		uint16_t *sample = (uint16_t *)band->data + index * band->components;
+		for (int c = 0; c < band->components; c++)
+			value += band->swap ? (uint16_t)(sample[c] << 8 | sample[c] >> 8) : sample[c];
+	} else {
+		uint8_t *sample = (uint8_t *)band->data + index * band->components;
+		for (int c = 0; c < band->components; c++)
+			value += sample[c];
+	}
+	return value;
+}
+
+static void *analysis_histogram_band(analysis_band *band) {
+	long start = (long)band->start * band->frame_width * band->components;
+	long count = (long)band->count * band->frame_width * band->components;
+	uint32_t *histogram = band->histogram;
+	if (band->wide) {
+		uint16_t *b16 = (uint16_t *)band->data + start;
+		if (band->swap) {
+			for (long i = 0; i < count; i++)
+				histogram[(uint16_t)(b16[i] << 8 | b16[i] >> 8)]++;
+		} else {
+			for (long i = 0; i < count; i++)
+				histogram[b16[i]]++;
+		}
+	} else {
+		uint8_t *b8 = (uint8_t *)band->data + start;
+		for (long i = 0; i < count; i++)
+			histogram[b8[i]]++;
+	}
+	return NULL;
+}
+
+static void analysis_row(const analysis_band *band, int y, int *row) {
+	int width = band->frame_width;
+	long start = (long)y * width * band->components;
+	if (band->wide) {
+		uint16_t *b16 = (uint16_t *)band->data + start;
+		if (band->components == 1) {
+			if (band->swap) {
+				for (int x = 0; x < width; x++)
+					row[x] = (uint16_t)(b16[x] << 8 | b16[x] >> 8);
+			} else {
+				for (int x = 0; x < width; x++)
+					row[x] = b16[x];
+			}
+		} else if (band->swap) {
+			for (int x = 0; x < width; x++) {
+				uint16_t *sample = b16 + 3 * x;
+				row[x] = (uint16_t)(sample[0] << 8 | sample[0] >> 8) + (uint16_t)(sample[1] << 8 | sample[1] >> 8) + (uint16_t)(sample[2] << 8 | sample[2] >> 8);
+			}
+		} else {
+			for (int x = 0; x < width; x++)
+				row[x] = b16[3 * x] + b16[3 * x + 1] + b16[3 * x + 2];
+		}
+	} else {
+		uint8_t *b8 = (uint8_t *)band->data + start;
+		if (band->components == 1) {
+			for (int x = 0; x < width; x++)
+				row[x] = b8[x];
+		} else {
+			for (int x = 0; x < width; x++)
+				row[x] = b8[3 * x] + b8[3 * x + 1] + b8[3 * x + 2];
+		}
+	}
+}
+
+static void *analysis_detection_band(analysis_band *band) {
+	int width = band->frame_width;
+	int border = band->border;
+	int first = band->start > border ? band->start : border;
+	int last = band->start + band->count < band->frame_height - border ? band->start + band->count : band->frame_height - border;
+	if (first >= last)
+		return NULL;
+	// luminance of previous, current and next row, each row is converted just once
+	int *buffer = malloc(3 * width * sizeof(int));
+	assert(buffer != NULL);
+	int *above = buffer, *row = buffer + width, *below = buffer + 2 * width;
+	analysis_row(band, first - 1, above);
+	analysis_row(band, first, row);
+	for (int y = first; y < last; y++) {
+		analysis_row(band, y + 1, below);
+		for (int x = border; x < width - border; x++) {
+			int value = row[x];
+			if (value <= band->threshold)
+				continue;
+			// strict comparison with already visited neighbours keeps one maximum on flat tops
+			if (value <= above[x - 1] || value <= above[x] || value <= above[x + 1] || value <= row[x - 1])
+				continue;
+			if (value < row[x + 1] || value < below[x - 1] || value < below[x] || value < below[x + 1])
+				continue;
+			// hot pixels and noise peaks have no support from their neighbours
+			int support = 0;
+			for (int i = -1; i <= 1; i++)
+				support += (above[x + i] > band->support) + (row[x + i] > band->support) + (below[x + i] > band->support);
+			if (support < 3)
+				continue;
+			if (band->candidate_count < ANALYSIS_MAX_CANDIDATES) {
+				band->candidates[band->candidate_count++] = (analysis_candidate){ x, y, value };
+			} else {
+				// crowded band, replace the faintest candidate
+				int faintest = 0;
+				for (int i = 1; i < ANALYSIS_MAX_CANDIDATES; i++)
+					if (band->candidates[i].value < band->candidates[faintest].value)
+						faintest = i;
+				if (band->candidates[faintest].value < value)
+					band->candidates[faintest] = (analysis_candidate){ x, y, value };
+			}
+		}
+		int *free_row = above;
+		above = row;
+		row = below;
+		below = free_row;
+	}
+	free(buffer);
+	return NULL;
+}
+
+static int analysis_candidate_compare(const void *a, const void *b) {
+	return ((analysis_candidate *)b)->value - ((analysis_candidate *)a)->value;
+}
+
+static int analysis_double_compare(const void *a, const void *b) {
+	double d = *(double *)a - *(double *)b;
+	return d < 0 ? -1 : d > 0 ? 1 : 0;
+}
+
+static bool measure_star(const analysis_band *band, const analysis_candidate *candidate, int radius, analysis_star *star) {
+	int width = band->frame_width;
+	// local background is the mean of the measurement box border
+	double background = 0;
+	int border_count = 0;
+	for (int i = -radius; i <= radius; i++) {
+		background += analysis_pixel(band, (long)(candidate->y - radius) * width + candidate->x + i);
+		background += analysis_pixel(band, (long)(candidate->y + radius) * width + candidate->x + i);
+		background += analysis_pixel(band, (long)(candidate->y + i) * width + candidate->x - radius);
+		background += analysis_pixel(band, (long)(candidate->y + i) * width + candidate->x + radius);
+		border_count += 4;
+	}
+	background /= border_count;
+	// background noise is zero mean, so it is not clipped to keep the moments unbiased
+	double flux = 0, sum_x = 0, sum_y = 0;
+	for (int j = -radius + 1; j < radius; j++) {
+		long row = (long)(candidate->y + j) * width + candidate->x;
+		for (int i = -radius + 1; i < radius; i++) {
+			double value = analysis_pixel(band, row + i) - background;
+			flux += value;
+			sum_x += value * i;
+			sum_y += value * j;
+		}
+	}
+	if (flux <= 0)
+		return false;
+	double cx = sum_x / flux, cy = sum_y / flux;
+	double total = 0, sum_r = 0, sum_r2 = 0;
+	for (int j = -radius + 1; j < radius; j++) {
+		long row = (long)(candidate->y + j) * width + candidate->x;
+		for (int i = -radius + 1; i < radius; i++) {
+			double dx = i - cx, dy = j - cy;
+			double r2 = dx * dx + dy * dy;
+			if (r2 > radius * radius)
+				continue;
+			double value = analysis_pixel(band, row + i) - background;
+			total += value;
+			sum_r += value * sqrt(r2);
+			sum_r2 += value * r2;
+		}
+	}
+	if (total <= 0)
+		return false;
+	star->x = candidate->x + cx;
+	star->y = candidate->y + cy;
+	star->flux = total;
+	star->hfd = 2 * sum_r / total;
+	// FWHM of gaussian with the same second moment
+	star->fwhm = 2.3548 * sqrt(sum_r2 / total / 2);
+	// anything sharper than a pixel is not an optical star image
+	return star->hfd >= 1;
+}
+
+static bool analyze_image(indigo_device *device, void *data, int frame_width, int frame_height, int bpp, bool little_endian, long *preview_histogram) {
+	INDIGO_DEBUG(struct timespec start; clock_gettime(CLOCK_MONOTONIC, &start));
+	int components = (bpp == 24 || bpp == 48) ? 3 : 1;
+	bool wide = bpp == 16 || bpp == 48;
+	int bins = wide ? 65536 : 256;
+	long count = (long)frame_width * frame_height * components;
+	if (count == 0)
+		return false;
+	// histogram and detection run in horizontal bands, one per CPU core
+	int band_count = image_band_count(count * (wide ? 2 : 1));
+	if (band_count > frame_height)
+		band_count = frame_height;
+	analysis_band bands[IMAGE_BAND_MAX_THREADS];
+	int band_rows = frame_height / band_count;
+	for (int i = 0; i < band_count; i++) {
+		analysis_band *band = bands + i;
+		band->data = (char *)data + FITS_HEADER_SIZE;
+		band->frame_width = frame_width;
+		band->frame_height = frame_height;
+		band->start = i * band_rows;
+		band->count = i == band_count - 1 ? frame_height - i * band_rows : band_rows;
+		band->components = components;
+		band->wide = wide;
+		band->swap = wide && !little_endian;
+		band->histogram = calloc(bins, sizeof(uint32_t));
+		assert(band->histogram != NULL);
+		band->candidates = NULL;
+		band->candidate_count = 0;
+	}
+	run_image_bands((void *(*)(void *))analysis_histogram_band, bands, sizeof(analysis_band), band_count);
+	long *histogram = calloc(bins, sizeof(long));
+	assert(histogram != NULL);
+	for (int i = 0; i < band_count; i++) {
+		for (int j = 0; j < bins; j++)
+			histogram[j] += bands[i].histogram[j];
+		free(bands[i].histogram);
+	}
+	// everything but star detection follows from the histogram
+	int saturation = CCD_ANALYSIS_SETTINGS_SATURATION_ITEM->number.value > 0 && CCD_ANALYSIS_SETTINGS_SATURATION_ITEM->number.value < bins ? (int)CCD_ANALYSIS_SETTINGS_SATURATION_ITEM->number.value : bins - 1;
+	int min = -1, max = 0, median = -1;
+	long total = 0, saturated = 0;
+	double sum = 0, sum2 = 0;
+	for (int i = 0; i < bins; i++) {
+		long n = histogram[i];
+		if (n == 0)
+			continue;
+		if (min < 0)
+			min = i;
+		max = i;
+		total += n;
+		if (median < 0 && 2 * total >= count)
+			median = i;
+		sum += (double)n * i;
+		sum2 += (double)n * i * i;
+		if (i >= saturation)
+			saturated += n;
+	}
+	double mean = sum / count;
+	double variance = sum2 / count - mean * mean;
+	// background noise estimated from median absolute deviation is not inflated by stars
+	long within = histogram[median];
+	int deviation = 0;
+	while (2 * within < count && deviation < bins) {
+		deviation++;
+		if (median - deviation >= 0)
+			within += histogram[median - deviation];
+		if (median + deviation < bins)
+			within += histogram[median + deviation];
+	}
+	double sigma = 1.4826 * deviation;
+	if (sigma < 1)
+		sigma = 1;
+	if (preview_histogram) {
+		memset(preview_histogram, 0, 256 * sizeof(long));
+		for (int i = 0; i < bins; i++)
+			preview_histogram[wide ? i >> 8 : i] += histogram[i];
+	}
+	free(histogram);
+	// stars are detected on luminance, i.e. sum of components
+	int radius = (int)CCD_ANALYSIS_SETTINGS_RADIUS_ITEM->number.value;
+	double noise = sigma * sqrt(components);
+	int threshold = (int)(median * components + CCD_ANALYSIS_SETTINGS_THRESHOLD_ITEM->number.value * noise);
+	int star_count = 0;
+	analysis_star *stars = NULL;
+	if (frame_width > 2 * radius + 2 && frame_height > 2 * radius + 2) {
+		for (int i = 0; i < band_count; i++) {
+			bands[i].threshold = threshold;
+			bands[i].support = (int)(median * components + 2 * noise);
+			bands[i].border = radius;
+			bands[i].candidates = malloc(ANALYSIS_MAX_CANDIDATES * sizeof(analysis_candidate));
+			assert(bands[i].candidates != NULL);
+		}
+		run_image_bands((void *(*)(void *))analysis_detection_band, bands, sizeof(analysis_band), band_count);
+		int candidate_count = 0;
+		for (int i = 0; i < band_count; i++)
+			candidate_count += bands[i].candidate_count;
+		analysis_candidate *candidates = malloc((candidate_count + 1) * sizeof(analysis_candidate));
+		assert(candidates != NULL);
+		candidate_count = 0;
+		for (int i = 0; i < band_count; i++) {
+			memcpy(candidates + candidate_count, bands[i].candidates, bands[i].candidate_count * sizeof(analysis_candidate));
+			candidate_count += bands[i].candidate_count;
+			free(bands[i].candidates);
+		}
+		qsort(candidates, candidate_count, sizeof(analysis_candidate), analysis_candidate_compare);
+		stars = malloc(ANALYSIS_MAX_DETECTED * sizeof(analysis_star));
+		assert(stars != NULL);
+		int min_distance2 = radius * radius;
+		for (int i = 0; i < candidate_count && star_count < ANALYSIS_MAX_DETECTED; i++) {
+			analysis_candidate *candidate = candidates + i;
+			bool isolated = true;
+			for (int j = 0; j < star_count && isolated; j++) {
+				double dx = stars[j].x - candidate->x, dy = stars[j].y - candidate->y;
+				isolated = dx * dx + dy * dy > min_distance2;
+			}
+			if (isolated && measure_star(bands, candidate, radius, stars + star_count))
+				star_count++;
+		}
+		free(candidates);
+	}
+	double hfd = 0, fwhm = 0;
+	if (star_count > 0) {
+		double *values = malloc(star_count * sizeof(double));
+		assert(values != NULL);
+		for (int i = 0; i < star_count; i++)
+			values[i] = stars[i].hfd;
+		qsort(values, star_count, sizeof(double), analysis_double_compare);
+		hfd = values[star_count / 2];
+		for (int i = 0; i < star_count; i++)
+			values[i] = stars[i].fwhm;
+		qsort(values, star_count, sizeof(double), analysis_double_compare);
+		fwhm = values[star_count / 2];
+		free(values);
+	}
+	CCD_ANALYSIS_STATS_MIN_ITEM->number.value = min;
+	CCD_ANALYSIS_STATS_MAX_ITEM->number.value = max;
+	CCD_ANALYSIS_STATS_MEAN_ITEM->number.value = mean;
+	CCD_ANALYSIS_STATS_MEDIAN_ITEM->number.value = median;
+	CCD_ANALYSIS_STATS_STDDEV_ITEM->number.value = variance > 0 ? sqrt(variance) : 0;
+	CCD_ANALYSIS_STATS_SATURATED_ITEM->number.value = saturated;
+	CCD_ANALYSIS_STATS_STARS_ITEM->number.value = star_count;
+	CCD_ANALYSIS_STATS_HFD_ITEM->number.value = hfd;
+	CCD_ANALYSIS_STATS_FWHM_ITEM->number.value = fwhm;
+	CCD_ANALYSIS_STATS_PROPERTY->state = INDIGO_OK_STATE;
+	indigo_update_property(device, CCD_ANALYSIS_STATS_PROPERTY, NULL);
+	for (int i = 0; i < CCD_ANALYSIS_MAX_STARS; i++) {
+		indigo_item *item = CCD_ANALYSIS_STARS_PROPERTY->items + i * CCD_ANALYSIS_STAR_ITEMS;
+		analysis_star *star = i < star_count ? stars + i : &(analysis_star){ 0 };
+		item[0].number.value = star->x;
+		item[1].number.value = star->y;
+		item[2].number.value = star->hfd;
+		item[3].number.value = star->fwhm;
+		item[4].number.value = star->flux;
+	}
+	CCD_ANALYSIS_STARS_PROPERTY->state = INDIGO_OK_STATE;
+	indigo_update_property(device, CCD_ANALYSIS_STARS_PROPERTY, NULL);
+	if (stars)
+		free(stars);
+	INDIGO_DEBUG(struct timespec end; clock_gettime(CLOCK_MONOTONIC, &end));
+	INDIGO_DEBUG(indigo_debug("Image analysis in %gs (%d stars, %d threads)", (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9, star_count, band_count));
+	return true;
+}
+
+#define LOCAL_WRITER_MB		(1024.0 * 1024.0)
+
+typedef struct local_write {
+	struct local_write *next;
+	char file_name[INDIGO_VALUE_SIZE];
+	void *data;
+	long size;
+	bool retained;
+	void *copy;
+	long capacity;
+	double queued;
+} local_write;
+
+typedef struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t changed;
+	pthread_mutex_t publish_mutex;
+	pthread_t thread;
+	bool running;
+	local_write *queue, *spare;
+	int pending;
+	char format[INDIGO_VALUE_SIZE];
+	int sequence;
+} local_writer;
+
+static double local_writer_time() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static local_writer *get_local_writer(indigo_device *device) {
+	local_writer *writer = CCD_CONTEXT->local_writer;
+	if (writer == NULL) {
+		writer = calloc(1, sizeof(local_writer));
+		assert(writer != NULL);
+		pthread_mutex_init(&writer->mutex, NULL);
+		pthread_cond_init(&writer->changed, NULL);
+		pthread_mutex_init(&writer->publish_mutex, NULL);
+		CCD_CONTEXT->local_writer = writer;
+	}
+	return writer;
+}
+
+static bool local_file_name(indigo_device *device, const char *suffix, char *file_name) {
+	char *dir = CCD_LOCAL_MODE_DIR_ITEM->text.value;
+	char *prefix = CCD_LOCAL_MODE_PREFIX_ITEM->text.value;
+	if (strlen(dir) + strlen(prefix) + strlen(suffix) >= INDIGO_VALUE_SIZE)
+		return false;
+	char *placeholder = strstr(prefix, "XXX");
+	if (placeholder == NULL) {
+		strncpy(file_name, dir, INDIGO_VALUE_SIZE);
+		strcat(file_name, prefix);
+		strcat(file_name, suffix);
+	} else {
+		char format[INDIGO_VALUE_SIZE];
+		strcpy(format, dir);
+		strncat(format, prefix, placeholder - prefix);
+		if (!strncmp(placeholder, "XXXX", 4)) {
+			strcat(format, "%04d");
+			strcat(format, placeholder + 4);
+		} else {
+			strcat(format, "%03d");
+			strcat(format, placeholder + 3);
+		}
+		strcat(format, suffix);
+		// directory is probed just once per name pattern, then the sequence continues from the last used number,
+		// that also reserves names of images still waiting in the writer queue
+		local_writer *writer = get_local_writer(device);
+		pthread_mutex_lock(&writer->mutex);
+		int i = 1;
+		if (!strcmp(format, writer->format))
+			i = writer->sequence + 1;
+		else
+			strcpy(writer->format, format);
+		struct stat sb;
+		while (i < 10000) {
+			snprintf(file_name, INDIGO_VALUE_SIZE, format, i);
+			if (stat(file_name, &sb) == 0 && S_ISREG(sb.st_mode))
+				i++;
+			else
+				break;
+		}
+		writer->sequence = i;
+		pthread_mutex_unlock(&writer->mutex);
+	}
+	return true;
+}
+
+static bool local_write_file(indigo_device *device, const char *file_name, void *data, long size, char **message) {
+	int handle = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (handle < 0) {
+		*message = strerror(errno);
+		return false;
+	}
+#if defined(INDIGO_LINUX)
+	// allocate the whole file at once to avoid fragmentation, not all file systems support it
+	fallocate(handle, 0, 0, size);
+#endif
+	bool result = indigo_write(handle, data, size);
+	if (result) {
+		if (CCD_LOCAL_MODE_SYNC_FULL_ITEM->sw.value)
+			result = fsync(handle) == 0;
+		else if (CCD_LOCAL_MODE_SYNC_DATA_ITEM->sw.value)
+#if defined(INDIGO_LINUX)
+			result = fdatasync(handle) == 0;
+#else
+			result = fsync(handle) == 0;
+#endif
+	}
+	if (!result)
+		*message = strerror(errno);
+	close(handle);
+	return result;
+}
+
+static void local_write_done(indigo_device *device, const char *file_name, long size, double queued, double start, bool result, char *message) {
+	double end = local_writer_time();
+	local_writer *writer = CCD_CONTEXT->local_writer;
+	// properties are updated without writer->mutex, so the caller is never blocked by slow clients,
+	// pending count is read under publish_mutex, so a newer image published by local_save() is never overwritten
+	pthread_mutex_lock(&writer->publish_mutex);
+	pthread_mutex_lock(&writer->mutex);
+	int pending = writer->pending;
+	pthread_mutex_unlock(&writer->mutex);
+	CCD_LOCAL_MODE_STATS_PENDING_ITEM->number.value = pending;
+	if (result) {
+		CCD_LOCAL_MODE_STATS_WRITTEN_ITEM->number.value++;
+		CCD_LOCAL_MODE_STATS_THROUGHPUT_ITEM->number.value = end > start ? size / LOCAL_WRITER_MB / (end - start) : 0;
+	}
+	CCD_LOCAL_MODE_STATS_LATENCY_ITEM->number.value = end - queued;
+	CCD_LOCAL_MODE_STATS_PROPERTY->state = pending ? INDIGO_BUSY_STATE : INDIGO_OK_STATE;
+	indigo_update_property(device, CCD_LOCAL_MODE_STATS_PROPERTY, NULL);
+	// file name is published when the image is queued, images are written in order, so the last one is done if nothing is pending
+	if (pending == 0) {
+		strncpy(CCD_IMAGE_FILE_ITEM->text.value, file_name, INDIGO_VALUE_SIZE);
+		CCD_IMAGE_FILE_PROPERTY->state = result ? INDIGO_OK_STATE : INDIGO_ALERT_STATE;
+		indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, message);
+	} else if (!result) {
+		CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
+		indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, "%s: %s", file_name, message);
+	}
+	pthread_mutex_unlock(&writer->publish_mutex);
+	INDIGO_DEBUG(indigo_debug("Local save of %s in %gs (%gs after processing)", file_name, end - start, end - queued));
+}
+
+static void *local_writer_thread(indigo_device *device) {
+	local_writer *writer = CCD_CONTEXT->local_writer;
+	pthread_mutex_lock(&writer->mutex);
+	while (true) {
+		while (writer->queue == NULL && writer->running)
+			pthread_cond_wait(&writer->changed, &writer->mutex);
+		local_write *entry = writer->queue;
+		if (entry == NULL)
+			break;
+		writer->queue = entry->next;
+		pthread_mutex_unlock(&writer->mutex);
+		char *message = NULL;
+		double start = local_writer_time();
+		bool result = local_write_file(device, entry->file_name, entry->data, entry->size, &message);
+		if (entry->retained)
+			indigo_release_blob_buffer(entry->data);
+		entry->data = NULL;
+		pthread_mutex_lock(&writer->mutex);
+		writer->pending--;
+		pthread_mutex_unlock(&writer->mutex);
+		local_write_done(device, entry->file_name, entry->size, entry->queued, start, result, message);
+		pthread_mutex_lock(&writer->mutex);
+		entry->next = writer->spare;
+		writer->spare = entry;
+		pthread_cond_broadcast(&writer->changed);
+	}
+	pthread_mutex_unlock(&writer->mutex);
+	return NULL;
+}
+
+static void local_save(indigo_device *device, const char *file_name, void *data, long size) {
+	local_writer *writer = get_local_writer(device);
+	int queue_size = (int)CCD_LOCAL_MODE_WRITER_QUEUE_ITEM->number.value;
+	double queued = local_writer_time();
+	pthread_mutex_lock(&writer->mutex);
+	// images are written in order, so the queue is drained before a synchronous write or if it is full
+	while (writer->pending > 0 && writer->pending >= queue_size)
+		pthread_cond_wait(&writer->changed, &writer->mutex);
+	if (queue_size == 0) {
+		pthread_mutex_unlock(&writer->mutex);
+		char *message = NULL;
+		bool result = local_write_file(device, file_name, data, size, &message);
+		local_write_done(device, file_name, size, queued, queued, result, message);
+		return;
+	}
+	local_write *entry = writer->spare;
+	if (entry)
+		writer->spare = entry->next;
+	else
+		entry = calloc(1, sizeof(local_write));
+	assert(entry != NULL);
+	pthread_mutex_unlock(&writer->mutex);
+	// shared blob buffer is kept by reference (driver gets a new one from indigo_writable_blob_buffer()),
+	// any other image buffer belongs to the driver, so it is copied to a recycled queue entry
+	entry->retained = indigo_retain_blob_buffer(data);
+	if (entry->retained) {
+		entry->data = data;
+	} else {
+		if (entry->capacity < size) {
+			free(entry->copy);
+			entry->copy = malloc(entry->capacity = size);
+			assert(entry->copy != NULL);
+		}
+		memcpy(entry->copy, data, size);
+		entry->data = entry->copy;
+	}
+	strncpy(entry->file_name, file_name, INDIGO_VALUE_SIZE);
+	entry->size = size;
+	entry->queued = queued;
+	entry->next = NULL;
+	// publish_mutex is held until the image is published, so the writer thread can't report it done before
+	pthread_mutex_lock(&writer->publish_mutex);
+	pthread_mutex_lock(&writer->mutex);
+	local_write **tail = &writer->queue;
+	while (*tail)
+		tail = &(*tail)->next;
+	*tail = entry;
+	writer->pending++;
+	if (!writer->running)
+		writer->running = pthread_create(&writer->thread, NULL, (void *(*)(void *))local_writer_thread, device) == 0;
+	if (!writer->running) {
+		// no writer thread, fall back to synchronous write
+		writer->queue = NULL;
+		writer->pending--;
+		if (entry->retained)
+			indigo_release_blob_buffer(entry->data);
+		entry->data = NULL;
+		entry->next = writer->spare;
+		writer->spare = entry;
+		pthread_mutex_unlock(&writer->mutex);
+		pthread_mutex_unlock(&writer->publish_mutex);
+		char *message = NULL;
+		bool result = local_write_file(device, file_name, data, size, &message);
+		local_write_done(device, file_name, size, queued, queued, result, message);
+		return;
+	}
+	// drop spare buffers above queue size, queue size may have been decreased
+	int spare_count = writer->pending;
+	for (local_write **spare = &writer->spare; *spare;) {
+		if (++spare_count > queue_size) {
+			local_write *extra = *spare;
+			*spare = extra->next;
+			free(extra->copy);
+			free(extra);
+		} else {
+			spare = &(*spare)->next;
+		}
+	}
+	int pending = writer->pending;
+	pthread_cond_broadcast(&writer->changed);
+	pthread_mutex_unlock(&writer->mutex);
+	CCD_LOCAL_MODE_STATS_PENDING_ITEM->number.value = pending;
+	CCD_LOCAL_MODE_STATS_PROPERTY->state = INDIGO_BUSY_STATE;
+	indigo_update_property(device, CCD_LOCAL_MODE_STATS_PROPERTY, NULL);
+	strncpy(CCD_IMAGE_FILE_ITEM->text.value, file_name, INDIGO_VALUE_SIZE);
+	CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
+	indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+	pthread_mutex_unlock(&writer->publish_mutex);
+}
+
+static void local_writer_close(indigo_device *device) {
+	local_writer *writer = CCD_CONTEXT->local_writer;
+	pthread_mutex_lock(&writer->mutex);
+	bool running = writer->running;
+	writer->running = false;
+	pthread_cond_broadcast(&writer->changed);
+	pthread_mutex_unlock(&writer->mutex);
+	// queued images are still written before the thread exits
+	if (running)
+		pthread_join(writer->thread, NULL);
+	while (writer->spare) {
+		local_write *entry = writer->spare;
+		writer->spare = entry->next;
+		free(entry->copy);
+		free(entry);
+	}
+	pthread_mutex_destroy(&writer->mutex);
+	pthread_cond_destroy(&writer->changed);
+	pthread_mutex_destroy(&writer->publish_mutex);
+	free(writer);
+	CCD_CONTEXT->local_writer = NULL;
 }
 
 void indigo_process_image(indigo_device *device, void *data, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, indigo_fits_keyword *keywords) {
@@ -904,28 +2236,14 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		naxis = 3;
 	}
 
+	long histogram[256];
+	bool analyzed = CCD_ANALYSIS_ENABLED_ITEM->sw.value && analyze_image(device, data, frame_width, frame_height, bpp, little_endian, histogram);
 	void *jpeg_data = NULL;
 	unsigned long jpeg_size = 0;
-	if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value || CCD_PREVIEW_ENABLED_ITEM->sw.value) {
-		raw_to_jpeg(device, data, frame_width, frame_height, bpp, little_endian, byte_order_rgb, &jpeg_data, &jpeg_size);
-		if (CCD_PREVIEW_ENABLED_ITEM->sw.value) {
-			if (jpeg_data) {
-				if (CCD_CONTEXT->preview_image) {
-					if (CCD_CONTEXT->preview_image_size < jpeg_size) {
-						CCD_CONTEXT->preview_image = realloc(CCD_CONTEXT->preview_image, CCD_CONTEXT->preview_image_size = jpeg_size);
-					}
-				} else {
-					CCD_CONTEXT->preview_image = malloc(CCD_CONTEXT->preview_image_size = jpeg_size);
-				}
-				memcpy(CCD_CONTEXT->preview_image, jpeg_data, jpeg_size);
-				CCD_PREVIEW_IMAGE_ITEM->blob.value = CCD_CONTEXT->preview_image;
-				CCD_PREVIEW_IMAGE_ITEM->blob.size = jpeg_size;
-				strcpy(CCD_PREVIEW_IMAGE_ITEM->blob.format, ".jpeg");
-				CCD_PREVIEW_IMAGE_PROPERTY->state = INDIGO_OK_STATE;
-				indigo_update_property(device, CCD_PREVIEW_IMAGE_PROPERTY, NULL);
-			}
-		}
-	}
+	if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value)
+		raw_to_jpeg(device, data, frame_width, frame_height, bpp, little_endian, byte_order_rgb, analyzed ? histogram : NULL, &jpeg_data, &jpeg_size);
+	if (CCD_PREVIEW_ENABLED_ITEM->sw.value)
+		send_preview_image(device, data, frame_width, frame_height, bpp, little_endian, byte_order_rgb, analyzed ? histogram : NULL, jpeg_data, jpeg_size);
 
 	if (CCD_IMAGE_FORMAT_FITS_ITEM->sw.value) {
 		INDIGO_DEBUG(clock_t start = clock());
@@ -1043,87 +2361,34 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 				header[t] = ' ';
 			}
 		}
+		if (analyzed) {
+			indigo_fits_keyword statistics[] = {
+				{ INDIGO_FITS_NUMBER, "DATAMIN", .number = CCD_ANALYSIS_STATS_MIN_ITEM->number.value, "minimum data value" },
+				{ INDIGO_FITS_NUMBER, "DATAMAX", .number = CCD_ANALYSIS_STATS_MAX_ITEM->number.value, "maximum data value" },
+				{ INDIGO_FITS_NUMBER, "MEDIAN", .number = CCD_ANALYSIS_STATS_MEDIAN_ITEM->number.value, "median data value" },
+				{ INDIGO_FITS_NUMBER, "STDDEV", .number = CCD_ANALYSIS_STATS_STDDEV_ITEM->number.value, "standard deviation of data values" },
+				{ INDIGO_FITS_NUMBER, "STARS", .number = CCD_ANALYSIS_STATS_STARS_ITEM->number.value, "number of detected stars" },
+				{ INDIGO_FITS_NUMBER, "HFD", .number = CCD_ANALYSIS_STATS_HFD_ITEM->number.value, "median half flux diameter [pixels]" },
+				{ INDIGO_FITS_NUMBER, "FWHM", .number = CCD_ANALYSIS_STATS_FWHM_ITEM->number.value, "median full width at half maximum [pixels]" },
+				{ 0 }
+			};
+			// the last card is left for END
+			for (indigo_fits_keyword *keyword = statistics; keyword->type && (header - (char *)data) < (FITS_HEADER_SIZE - 160); keyword++) {
+				t = sprintf(header += 80, "%-8s= %20.2f / %s", keyword->name, keyword->number, keyword->comment);
+				indigo_fix_locale(header - 80);
+				header[t] = ' ';
+			}
+		}
 		t = sprintf(header += 80, "END");
 		header[t] = ' ';
-		if (byte_per_pixel == 2 && naxis == 2) {
-			short *raw = (short *)(data + FITS_HEADER_SIZE);
-			if (little_endian) {
-				for (int i = 0; i < size; i++) {
-					int value = *raw - 32768;
-					*raw++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-				}
-			} else {
-				for (int i = 0; i < size; i++) {
-					int value = *raw;
-					value = ((value & 0xff) << 8 | (value & 0xff00) >> 8 ) - 32768;
-					*raw++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-				}
-			}
-		} else if (byte_per_pixel == 1 && naxis == 3) {
-			unsigned char *raw = malloc(3 * size);
-			unsigned char *red = raw;
-			unsigned char *green = raw + size;
-			unsigned char *blue = raw + 2 * size;
-			unsigned char *tmp = data + FITS_HEADER_SIZE;
-			if (byte_order_rgb) {
-				for (int i = 0; i < size; i++) {
-					*red++ = *tmp++;
-					*green++ = *tmp++;
-					*blue++ = *tmp++;
-				}
-			} else {
-				for (int i = 0; i < size; i++) {
-					*blue++ = *tmp++;
-					*green++ = *tmp++;
-					*red++ = *tmp++;
-				}
-			}
-			memcpy(data + FITS_HEADER_SIZE, raw, 3 * size);
-			free(raw);
-		} else if (byte_per_pixel == 2 && naxis == 3) {
-			unsigned short *raw = malloc(6 * size);
-			unsigned short *red = raw;
-			unsigned short *green = raw + size;
-			unsigned short *blue = raw + 2 * size;
-			unsigned short *tmp = (unsigned short *)(data + FITS_HEADER_SIZE);
-			if (little_endian) {
-				if (byte_order_rgb) {
-					for (int i = 0; i < size; i++) {
-						int value = *tmp++ - 32768;
-						*red++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						value = *tmp++ - 32768;
-						*green++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						value = *tmp++ - 32768;
-						*blue++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-					}
-				} else {
-					for (int i = 0; i < size; i++) {
-						int value = *tmp++ - 32768;
-						*blue++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						value = *tmp++ - 32768;
-						*green++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						value = *tmp++ - 32768;
-						*red++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-					}
-				}
-			} else {
-				if (byte_order_rgb) {
-					for (int i = 0; i < size; i++) {
-						*red++ = *tmp++;
-						*green++ = *tmp++;
-						*blue++ = *tmp++;
-					}
-				} else {
-					for (int i = 0; i < size; i++) {
-						*blue++ = *tmp++;
-						*green++ = *tmp++;
-						*red++ = *tmp++;
-					}
-				}
-			}
-			memcpy(data + FITS_HEADER_SIZE, raw, 6 * size);
-			free(raw);
+		// FITS wants planar, big endian, signed 16-bit data with BZERO offset
+		encoder_band encoder = { .byte_per_sample = byte_per_pixel, .components = naxis == 3 ? 3 : 1, .planar = true, .swap_rb = !byte_order_rgb };
+		if (byte_per_pixel == 2) {
+			// subtracting 32768 flips the most significant bit, that is 0x0080 once stored big endian
+			encoder.swap16 = little_endian;
+			encoder.xor16 = 0x0080;
 		}
+		encode_image(data + FITS_HEADER_SIZE, frame_width, frame_height, &encoder);
 		int mod2880 = blobsize % 2880;
 		if (mod2880) {
 			int padding = 2880 - mod2880;
@@ -1147,7 +2412,7 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		char *header = data;
 		strcpy(header, "XISF0100");
 		header += 16;
-		memset(header, 0, FITS_HEADER_SIZE);
+		memset(header, 0, FITS_HEADER_SIZE - 16);
 		sprintf(header, "<?xml version='1.0' encoding='UTF-8'?><xisf xmlns='http://www.pixinsight.com/xisf' xmlns:xsi='http://www.w3.org/2001/XMLSchema-instance' version='1.0' xsi:schemaLocation='http://www.pixinsight.com/xisf http://pixinsight.com/xisf/xisf-1.0.xsd'>");
 		header += strlen(header);
 		char *frame_type = "Light";
@@ -1220,120 +2485,22 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		sprintf(header, "<Property id='XISF:BlockAlignmentSize' type='UInt16' value='2880'/></Metadata></xisf>");
 		header += strlen(header);
 		*(uint32_t *)(data + 8) = (uint32_t)(header - (char *)data) - 16;
-		if (naxis == 2 && byte_per_pixel == 2) {
-			if (!little_endian) {
-				short *b16 = (short *)(data + FITS_HEADER_SIZE);
-				for (int i = 0; i < size; i++) {
-					int value = *b16;
-					*b16++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-				}
-			}
-		} else if (naxis == 3 && byte_per_pixel == 1) {
-			if (!byte_order_rgb) {
-				unsigned char *b8 = data + FITS_HEADER_SIZE;
-				for (int i = 0; i < size; i++) {
-					unsigned char b = *b8;
-					unsigned char r = *(b8 + 2);
-					*b8 = r;
-					*(b8 + 2) = b;
-					b8 += 3;
-				}
-			}
-		} else if (naxis == 3 && byte_per_pixel == 2) {
-			unsigned char *b16 = data + FITS_HEADER_SIZE;
-			if (little_endian) {
-				if (!byte_order_rgb) {
-					for (int i = 0; i < size; i++) {
-						unsigned char b = *b16;
-						unsigned char r = *(b16 + 2);
-						*b16 = r;
-						*(b16 + 2) = b;
-						b16 += 3;
-					}
-				}
-			} else {
-				if (byte_order_rgb) {
-					for (int i = 0; i < size; i++) {
-						int value = *b16;
-						*b16++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-					}
-				} else {
-					for (int i = 0; i < size; i++) {
-						int value = *b16;
-						unsigned b = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						value = *(b16 + 1);
-						unsigned g = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						value = *(b16 + 2);
-						unsigned r = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						*b16 = r;
-						*(b16 + 1) = g;
-						*(b16 + 2) = b;
-						b16 += 3;
-					}
-				}
-			}
-		}
+		// XISF wants interleaved, little endian, RGB ordered data
+		encoder_band encoder = { .byte_per_sample = byte_per_pixel, .components = naxis == 3 ? 3 : 1, .swap16 = byte_per_pixel == 2 && !little_endian, .swap_rb = !byte_order_rgb };
+		encode_image(data + FITS_HEADER_SIZE, frame_width, frame_height, &encoder);
 		INDIGO_DEBUG(indigo_debug("RAW to XISF conversion in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
 	} else if (CCD_IMAGE_FORMAT_RAW_ITEM->sw.value) {
 		indigo_raw_header *header = (indigo_raw_header *)(data + FITS_HEADER_SIZE - sizeof(indigo_raw_header));
 		if (naxis == 2 && byte_per_pixel == 1)
 			header->signature = INDIGO_RAW_MONO8;
-		else if (naxis == 2 && byte_per_pixel == 2) {
+		else if (naxis == 2 && byte_per_pixel == 2)
 			header->signature = INDIGO_RAW_MONO16;
-			if (!little_endian) {
-				short *b16 = (short *)(data + FITS_HEADER_SIZE);
-				for (int i = 0; i < size; i++) {
-					int value = *b16;
-					*b16++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-				}
-			}
-		} else if (naxis == 3 && byte_per_pixel == 1) {
+		else if (naxis == 3 && byte_per_pixel == 1)
 			header->signature = INDIGO_RAW_RGB24;
-			if (!byte_order_rgb) {
-				unsigned char *b8 = data + FITS_HEADER_SIZE;
-				for (int i = 0; i < size; i++) {
-					unsigned char b = *b8;
-					unsigned char r = *(b8 + 2);
-					*b8 = r;
-					*(b8 + 2) = b;
-					b8 += 3;
-				}
-			}
-		} else if (naxis == 3 && byte_per_pixel == 2) {
+		else if (naxis == 3 && byte_per_pixel == 2)
 			header->signature = INDIGO_RAW_RGB48;
-			unsigned char *b16 = data + FITS_HEADER_SIZE;
-			if (little_endian) {
-				if (!byte_order_rgb) {
-					for (int i = 0; i < size; i++) {
-						unsigned char b = *b16;
-						unsigned char r = *(b16 + 2);
-						*b16 = r;
-						*(b16 + 2) = b;
-						b16 += 3;
-					}
-				}
-			} else {
-				if (byte_order_rgb) {
-					for (int i = 0; i < size; i++) {
-						int value = *b16;
-						*b16++ = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-					}
-				} else {
-					for (int i = 0; i < size; i++) {
-						int value = *b16;
-						unsigned b = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						value = *(b16 + 1);
-						unsigned g = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						value = *(b16 + 2);
-						unsigned r = (value & 0xff) << 8 | (value & 0xff00) >> 8;
-						*b16 = r;
-						*(b16 + 1) = g;
-						*(b16 + 2) = b;
-						b16 += 3;
-					}
-				}
-			}
-		}
+		encoder_band encoder = { .byte_per_sample = byte_per_pixel, .components = naxis == 3 ? 3 : 1, .swap16 = byte_per_pixel == 2 && !little_endian, .swap_rb = !byte_order_rgb };
+		encode_image(data + FITS_HEADER_SIZE, frame_width, frame_height, &encoder);
 		header->width = frame_width;
 		header->height = frame_height;
 	} else if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value) {
@@ -1343,8 +2510,6 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		}
 	}
 	if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-		char *dir = CCD_LOCAL_MODE_DIR_ITEM->text.value;
-		char *prefix = CCD_LOCAL_MODE_PREFIX_ITEM->text.value;
 		char *suffix = "";
 		if (CCD_IMAGE_FORMAT_FITS_ITEM->sw.value) {
 			suffix = ".fits";
@@ -1355,73 +2520,19 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		} else if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value) {
 			suffix = ".jpeg";
 		}
-		int handle = 0;
-		char *message = NULL;
-		if (strlen(dir) + strlen(prefix) + strlen(suffix) < INDIGO_VALUE_SIZE) {
-			char file_name[INDIGO_VALUE_SIZE];
-			char *placeholder = strstr(prefix, "XXX");
-			if (placeholder == NULL) {
-				strncpy(file_name, dir, INDIGO_VALUE_SIZE);
-				strcat(file_name, prefix);
-				strcat(file_name, suffix);
-			} else {
-				char format[INDIGO_VALUE_SIZE];
-				strcpy(format, dir);
-				strncat(format, prefix, placeholder - prefix);
-				if (!strncmp(placeholder, "XXXX", 4)) {
-					strcat(format, "%04d");
-					strcat(format, placeholder + 4);
-				} else {
-					strcat(format, "%03d");
-					strcat(format, placeholder + 3);
-				}
-				strcat(format, suffix);
-				struct stat sb;
-				int i = 1;
-				while (i < 10000) {
-					snprintf(file_name, sizeof(file_name), format, i);
-					if (stat(file_name, &sb) == 0 && S_ISREG(sb.st_mode))
-						i++;
-					else
-						break;
-				}
-			}
-			strncpy(CCD_IMAGE_FILE_ITEM->text.value, file_name, INDIGO_VALUE_SIZE);
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
-			handle = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-			if (handle) {
-				if (CCD_IMAGE_FORMAT_FITS_ITEM->sw.value) {
-					if (!indigo_write(handle, data, FITS_HEADER_SIZE + blobsize)) {
-						CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-						message = strerror(errno);
-					}
-				} else if (CCD_IMAGE_FORMAT_XISF_ITEM->sw.value) {
-					if (!indigo_write(handle, data, FITS_HEADER_SIZE + blobsize)) {
-						CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-						message = strerror(errno);
-					}
-				} else if (CCD_IMAGE_FORMAT_RAW_ITEM->sw.value) {
-					if (!indigo_write(handle, data + FITS_HEADER_SIZE - sizeof(indigo_raw_header), blobsize + sizeof(indigo_raw_header))) {
-						CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-						message = strerror(errno);
-					}
-				} else if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value) {
-					if (!indigo_write(handle, data, blobsize)) {
-						CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-						message = strerror(errno);
-					}
-				}
-				close(handle);
-			} else {
-				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-				message = strerror(errno);
-			}
+		char file_name[INDIGO_VALUE_SIZE];
+		if (local_file_name(device, suffix, file_name)) {
+			if (CCD_IMAGE_FORMAT_RAW_ITEM->sw.value)
+				local_save(device, file_name, data + FITS_HEADER_SIZE - sizeof(indigo_raw_header), blobsize + sizeof(indigo_raw_header));
+			else if (CCD_IMAGE_FORMAT_JPEG_ITEM->sw.value)
+				local_save(device, file_name, data, blobsize);
+			else
+				local_save(device, file_name, data, FITS_HEADER_SIZE + blobsize);
 		} else {
 			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-			message = "dir + prefix + suffix is too long";
+			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, "dir + prefix + suffix is too long");
 		}
-		indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, message);
-		INDIGO_DEBUG(indigo_debug("Local save in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+		INDIGO_DEBUG(indigo_debug("Local save queued in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
 	}
 	if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 		*CCD_IMAGE_ITEM->blob.url = 0;
@@ -1450,6 +2561,514 @@ void indigo_process_image(indigo_device *device, void *data, int frame_width, in
 		free(jpeg_data);
 }
 
+#define SER_HEADER_SIZE				178
+#define SER_BLOCK_SIZE				(4L * 1024 * 1024)
+#define SER_BLOCK_ALIGNMENT		4096
+#define SER_PREALLOCATE_SIZE	(256L * 1024 * 1024)
+#define SER_CHUNK_SIZE				(32L * 1024 * 1024)
+#define SER_TICKS_AT_EPOCH		621355968000000000ULL
+
+#define SER_MONO							0
+#define SER_BAYER_RGGB				8
+#define SER_BAYER_GRBG				9
+#define SER_BAYER_GBRG				10
+#define SER_BAYER_BGGR				11
+#define SER_RGB								100
+#define SER_BGR								101
+
+typedef struct {
+	int frame_width, frame_height, bpp;
+	int depth, color_id;
+	long frame_size;
+	uint64_t start_time;
+	int64_t utc_offset;
+	char file_name[INDIGO_VALUE_SIZE];
+	int handle;
+	bool direct;
+	unsigned char *block;
+	long block_used;
+	off_t offset, allocated;
+	uint64_t *timestamps;
+	int frame_count, timestamp_capacity;
+	bool upload;
+	unsigned char *chunk;
+	long chunk_size, chunk_used;
+	uint64_t *chunk_timestamps;
+	int chunk_frame_count, chunk_frame_capacity;
+	char *message;
+} ser_writer;
+
+static uint64_t ser_timestamp() {
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	// SER timestamps are in 100ns ticks since 0001-01-01
+	return SER_TICKS_AT_EPOCH + (uint64_t)ts.tv_sec * 10000000 + ts.tv_nsec / 100;
+}
+
+static void ser_put(unsigned char *data, uint64_t value, int size) {
+	for (int i = 0; i < size; i++, value >>= 8)
+		data[i] = value & 0xFF;
+}
+
+static void ser_header(indigo_device *device, ser_writer *ser, unsigned char *header, int frame_count) {
+	memset(header, 0, SER_HEADER_SIZE);
+	memcpy(header, "LUCAM-RECORDER", 14);
+	ser_put(header + 18, ser->color_id, 4);
+	// LittleEndian = 0 is what the capture and stacking software in use treats as little endian data
+	ser_put(header + 22, 0, 4);
+	ser_put(header + 26, ser->frame_width, 4);
+	ser_put(header + 30, ser->frame_height, 4);
+	ser_put(header + 34, ser->depth, 4);
+	ser_put(header + 38, frame_count, 4);
+	strncpy((char *)header + 82, device->name, 40);
+	ser_put(header + 162, ser->start_time + ser->utc_offset, 8);
+	ser_put(header + 170, ser->start_time, 8);
+}
+
+static bool ser_write_block(ser_writer *ser, unsigned char *data, long size) {
+	while (size > 0) {
+		ssize_t written = pwrite(ser->handle, data, size, ser->offset);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+#if defined(INDIGO_LINUX)
+			if (errno == EINVAL && ser->direct) {
+				// file system doesn't support direct I/O
+				fcntl(ser->handle, F_SETFL, fcntl(ser->handle, F_GETFL) & ~O_DIRECT);
+				ser->direct = false;
+				continue;
+			}
+#endif
+			ser->message = strerror(errno);
+			return false;
+		}
+		data += written;
+		size -= written;
+		ser->offset += written;
+	}
+	return true;
+}
+
+static void ser_preallocate(ser_writer *ser, off_t size) {
+#if defined(INDIGO_LINUX)
+	if (size > ser->allocated && fallocate(ser->handle, FALLOC_FL_KEEP_SIZE, ser->allocated, size - ser->allocated) == 0)
+		ser->allocated = size;
+#endif
+}
+
+static bool ser_append(ser_writer *ser, unsigned char *data, long size) {
+	while (size > 0) {
+		long length = SER_BLOCK_SIZE - ser->block_used;
+		if (length > size)
+			length = size;
+		memcpy(ser->block + ser->block_used, data, length);
+		ser->block_used += length;
+		data += length;
+		size -= length;
+		if (ser->block_used == SER_BLOCK_SIZE) {
+			if (ser->offset + SER_BLOCK_SIZE > ser->allocated)
+				ser_preallocate(ser, ser->allocated + SER_PREALLOCATE_SIZE);
+			if (!ser_write_block(ser, ser->block, SER_BLOCK_SIZE))
+				return false;
+			ser->block_used = 0;
+		}
+	}
+	return true;
+}
+
+static void ser_add_timestamp(uint64_t **timestamps, int *capacity, int count, uint64_t timestamp) {
+	if (count == *capacity) {
+		*capacity = *capacity ? 2 * *capacity : 1024;
+		*timestamps = realloc(*timestamps, *capacity * sizeof(uint64_t));
+		assert(*timestamps != NULL);
+	}
+	(*timestamps)[count] = timestamp;
+}
+
+static void ser_send_chunk(indigo_device *device, ser_writer *ser) {
+	ser_header(device, ser, ser->chunk, ser->chunk_frame_count);
+	for (int i = 0; i < ser->chunk_frame_count; i++)
+		ser_put(ser->chunk + ser->chunk_used + 8 * i, ser->chunk_timestamps[i], 8);
+	*CCD_IMAGE_ITEM->blob.url = 0;
+	CCD_IMAGE_ITEM->blob.value = ser->chunk;
+	CCD_IMAGE_ITEM->blob.size = ser->chunk_used + 8 * ser->chunk_frame_count;
+	strcpy(CCD_IMAGE_ITEM->blob.format, ".ser");
+	CCD_IMAGE_PROPERTY->state = INDIGO_OK_STATE;
+	indigo_update_property(device, CCD_IMAGE_PROPERTY, NULL);
+	ser->chunk_used = SER_HEADER_SIZE;
+	ser->chunk_frame_count = 0;
+}
+
+static ser_writer *ser_open(indigo_device *device) {
+	ser_writer *ser = calloc(1, sizeof(ser_writer));
+	assert(ser != NULL);
+	ser->handle = -1;
+	ser->start_time = ser_timestamp();
+	time_t now = time(NULL);
+	struct tm tm_info;
+	localtime_r(&now, &tm_info);
+	ser->utc_offset = (int64_t)tm_info.tm_gmtoff * 10000000;
+	ser->upload = CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value;
+	if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
+		char *message = NULL;
+		if (!local_file_name(device, ".ser", ser->file_name)) {
+			message = "dir + prefix + suffix is too long";
+		} else {
+#if defined(INDIGO_LINUX)
+			ser->handle = open(ser->file_name, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+			ser->direct = ser->handle >= 0;
+			if (ser->handle < 0 && errno == EINVAL)
+#endif
+				ser->handle = open(ser->file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#if defined(INDIGO_MACOS)
+			if (ser->handle >= 0)
+				fcntl(ser->handle, F_NOCACHE, 1);
+#endif
+			if (ser->handle < 0)
+				message = strerror(errno);
+		}
+		strncpy(CCD_IMAGE_FILE_ITEM->text.value, ser->file_name, INDIGO_VALUE_SIZE);
+		if (message) {
+			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
+			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, message);
+			free(ser);
+			return NULL;
+		}
+		CCD_IMAGE_FILE_PROPERTY->state = INDIGO_BUSY_STATE;
+		indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+		if (posix_memalign((void **)&ser->block, SER_BLOCK_ALIGNMENT, SER_BLOCK_SIZE))
+			ser->block = NULL;
+		assert(ser->block != NULL);
+		// header is rewritten with the final frame count on close
+		memset(ser->block, 0, SER_HEADER_SIZE);
+		ser->block_used = SER_HEADER_SIZE;
+	}
+	INDIGO_DEBUG(indigo_debug("%s(): '%s'%s%s", __FUNCTION__, ser->file_name, ser->direct ? " (direct I/O)" : "", ser->upload ? " + client upload" : ""));
+	return ser;
+}
+
+static void ser_write_frame(indigo_device *device, ser_writer *ser, void *data, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, indigo_fits_keyword *keywords, uint64_t timestamp) {
+	if (ser->frame_size == 0) {
+		ser->frame_width = frame_width;
+		ser->frame_height = frame_height;
+		ser->bpp = bpp;
+		ser->depth = bpp == 16 || bpp == 48 ? 16 : 8;
+		ser->frame_size = (long)frame_width * frame_height * (bpp / 8);
+		if (bpp == 24 || bpp == 48) {
+			ser->color_id = byte_order_rgb ? SER_RGB : SER_BGR;
+		} else {
+			ser->color_id = SER_MONO;
+			for (indigo_fits_keyword *keyword = keywords; keyword && keyword->type; keyword++) {
+				if (keyword->type == INDIGO_FITS_STRING && !strcmp(keyword->name, "BAYERPAT") && keyword->string) {
+					if (!strcmp(keyword->string, "RGGB"))
+						ser->color_id = SER_BAYER_RGGB;
+					else if (!strcmp(keyword->string, "GRBG"))
+						ser->color_id = SER_BAYER_GRBG;
+					else if (!strcmp(keyword->string, "GBRG"))
+						ser->color_id = SER_BAYER_GBRG;
+					else if (!strcmp(keyword->string, "BGGR"))
+						ser->color_id = SER_BAYER_BGGR;
+				}
+			}
+		}
+		if (ser->handle >= 0) {
+			long count = CCD_STREAMING_COUNT_ITEM->number.target;
+			ser_preallocate(ser, count > 0 ? SER_HEADER_SIZE + count * (ser->frame_size + 8) : SER_PREALLOCATE_SIZE);
+		}
+		if (ser->upload) {
+			ser->chunk_frame_capacity = SER_CHUNK_SIZE / ser->frame_size;
+			if (ser->chunk_frame_capacity < 1)
+				ser->chunk_frame_capacity = 1;
+			ser->chunk_size = SER_HEADER_SIZE + ser->chunk_frame_capacity * (ser->frame_size + 8);
+			ser->chunk = indigo_alloc_shared_blob_buffer(ser->chunk_size);
+			ser->chunk_timestamps = malloc(ser->chunk_frame_capacity * sizeof(uint64_t));
+			assert(ser->chunk_timestamps != NULL);
+			ser->chunk_used = SER_HEADER_SIZE;
+		}
+	} else if (frame_width != ser->frame_width || frame_height != ser->frame_height || bpp != ser->bpp) {
+		INDIGO_ERROR(indigo_error("%s(): %dx%dx%d frame doesn't match %dx%dx%d stream, ignored", __FUNCTION__, frame_width, frame_height, bpp, ser->frame_width, ser->frame_height, ser->bpp));
+		return;
+	}
+	unsigned char *pixels = (unsigned char *)data + FITS_HEADER_SIZE;
+	if (ser->depth == 16 && !little_endian) {
+		encoder_band encoder = { .byte_per_sample = 2, .components = bpp == 48 ? 3 : 1, .swap16 = true, .swap_rb = false };
+		encode_image(pixels, frame_width, frame_height, &encoder);
+	}
+	if (ser->handle >= 0 && ser->message == NULL) {
+		if (ser_append(ser, pixels, ser->frame_size)) {
+			ser_add_timestamp(&ser->timestamps, &ser->timestamp_capacity, ser->frame_count++, timestamp);
+		} else {
+			// reported once, following frames are not written (streaming and client upload go on)
+			INDIGO_ERROR(indigo_error("%s(): write to '%s' failed after %d frames (%s)", __FUNCTION__, ser->file_name, ser->frame_count, ser->message));
+			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
+			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, "SER file write failed after %d frames (%s), recording stopped", ser->frame_count, ser->message);
+		}
+	}
+	if (ser->upload) {
+		ser->chunk = indigo_writable_blob_buffer(ser->chunk, ser->chunk_size);
+		memcpy(ser->chunk + ser->chunk_used, pixels, ser->frame_size);
+		ser->chunk_used += ser->frame_size;
+		ser->chunk_timestamps[ser->chunk_frame_count++] = timestamp;
+		if (ser->chunk_frame_count == ser->chunk_frame_capacity)
+			ser_send_chunk(device, ser);
+	}
+}
+
+static void ser_close(indigo_device *device, ser_writer *ser) {
+	if (ser->upload) {
+		if (ser->chunk_frame_count > 0)
+			ser_send_chunk(device, ser);
+		indigo_release_blob_buffer(ser->chunk);
+		free(ser->chunk_timestamps);
+	}
+	if (ser->handle >= 0) {
+#if defined(INDIGO_LINUX)
+		// the tail is not block aligned
+		if (ser->direct)
+			fcntl(ser->handle, F_SETFL, fcntl(ser->handle, F_GETFL) & ~O_DIRECT);
+#endif
+		int frame_count = ser->frame_count;
+		if (ser->message != NULL || !ser_write_block(ser, ser->block, ser->block_used)) {
+			// keep whole frames which made it to the disk
+			frame_count = ser->frame_size > 0 && ser->offset > SER_HEADER_SIZE ? (int)((ser->offset - SER_HEADER_SIZE) / ser->frame_size) : 0;
+			if (frame_count > ser->frame_count)
+				frame_count = ser->frame_count;
+			ser->offset = SER_HEADER_SIZE + (off_t)frame_count * ser->frame_size;
+		}
+		char *message = ser->message;
+		off_t end = ser->offset;
+		unsigned char *trailer = malloc(8 * frame_count + 1);
+		assert(trailer != NULL);
+		for (int i = 0; i < frame_count; i++)
+			ser_put(trailer + 8 * i, ser->timestamps[i], 8);
+		if (!ser_write_block(ser, trailer, 8 * frame_count)) {
+			// trailer is optional, file ends with the last frame
+			ser->offset = end;
+			if (message == NULL)
+				message = ser->message;
+		}
+		free(trailer);
+		unsigned char header[SER_HEADER_SIZE];
+		ser_header(device, ser, header, frame_count);
+		if (pwrite(ser->handle, header, SER_HEADER_SIZE, 0) != SER_HEADER_SIZE && message == NULL)
+			message = strerror(errno);
+		// release space preallocated beyond the end of data
+		if (ftruncate(ser->handle, ser->offset) < 0 && message == NULL)
+			message = strerror(errno);
+		close(ser->handle);
+		if (message) {
+			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
+			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, "SER file write failed, %d of %d frames kept (%s)", frame_count, ser->frame_count, message);
+		} else {
+			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
+			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, NULL);
+		}
+		INDIGO_DEBUG(indigo_debug("%s(): %d frames, %lld bytes written to '%s'", __FUNCTION__, frame_count, (long long)ser->offset, ser->file_name));
+		free(ser->block);
+		free(ser->timestamps);
+	}
+	free(ser);
+}
+
+typedef struct {
+	void *data;
+	int frame_width, frame_height, bpp;
+	bool little_endian, byte_order_rgb;
+	indigo_fits_keyword *keywords;
+	uint64_t timestamp;
+} streaming_frame;
+
+typedef struct {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	pthread_t thread;
+	bool running;
+	long size;
+	int count;
+	streaming_frame *frames;
+	int *free_frames;
+	int free_count;
+	int *ready_frames;
+	int ready_head, ready_count;
+	int filling;
+	bool stopping;
+	unsigned long captured, processed, dropped;
+	double last_update;
+	ser_writer *ser;
+	int preview_interval;
+} streaming_pipeline;
+
+#define STREAMING_STATS_INTERVAL	0.5
+
+static double streaming_time() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void update_streaming_stats(indigo_device *device, bool force) {
+	streaming_pipeline *streaming = CCD_CONTEXT->streaming;
+	double now = streaming_time();
+	if (!force && now - streaming->last_update < STREAMING_STATS_INTERVAL)
+		return;
+	streaming->last_update = now;
+	pthread_mutex_lock(&streaming->mutex);
+	CCD_STREAMING_STATS_CAPTURED_ITEM->number.value = streaming->captured;
+	CCD_STREAMING_STATS_PROCESSED_ITEM->number.value = streaming->processed;
+	CCD_STREAMING_STATS_DROPPED_ITEM->number.value = streaming->dropped;
+	pthread_mutex_unlock(&streaming->mutex);
+	CCD_STREAMING_STATS_PROPERTY->state = force ? INDIGO_OK_STATE : INDIGO_BUSY_STATE;
+	indigo_update_property(device, CCD_STREAMING_STATS_PROPERTY, NULL);
+}
+
+static void *streaming_processing_thread(indigo_device *device) {
+	streaming_pipeline *streaming = CCD_CONTEXT->streaming;
+	unsigned long frame_index = 0;
+	pthread_mutex_lock(&streaming->mutex);
+	while (true) {
+		while (streaming->ready_count == 0 && !streaming->stopping)
+			pthread_cond_wait(&streaming->cond, &streaming->mutex);
+		if (streaming->ready_count == 0)
+			break;
+		int index = streaming->ready_frames[streaming->ready_head];
+		streaming->ready_head = (streaming->ready_head + 1) % streaming->count;
+		streaming->ready_count--;
+		pthread_mutex_unlock(&streaming->mutex);
+		streaming_frame *frame = streaming->frames + index;
+		if (streaming->ser) {
+			if (CCD_PREVIEW_ENABLED_ITEM->sw.value && streaming->preview_interval > 0 && frame_index % streaming->preview_interval == 0)
+				send_preview_image(device, frame->data, frame->frame_width, frame->frame_height, frame->bpp, frame->little_endian, frame->byte_order_rgb, NULL, NULL, 0);
+			ser_write_frame(device, streaming->ser, frame->data, frame->frame_width, frame->frame_height, frame->bpp, frame->little_endian, frame->byte_order_rgb, frame->keywords, frame->timestamp);
+		} else {
+			indigo_process_image(device, frame->data, frame->frame_width, frame->frame_height, frame->bpp, frame->little_endian, frame->byte_order_rgb, frame->keywords);
+		}
+		frame_index++;
+		pthread_mutex_lock(&streaming->mutex);
+		streaming->free_frames[streaming->free_count++] = index;
+		streaming->processed++;
+		pthread_mutex_unlock(&streaming->mutex);
+		update_streaming_stats(device, false);
+		pthread_mutex_lock(&streaming->mutex);
+	}
+	pthread_mutex_unlock(&streaming->mutex);
+	return NULL;
+}
+
+bool indigo_ccd_streaming_start(indigo_device *device, int count, long size) {
+	assert(device != NULL);
+	assert(CCD_CONTEXT->streaming == NULL);
+	ser_writer *ser = NULL;
+	if (CCD_STREAMING_MODE_SER_ITEM->sw.value && (ser = ser_open(device)) == NULL)
+		return false;
+	if (count < INDIGO_CCD_STREAMING_MIN_BUFFERS)
+		count = INDIGO_CCD_STREAMING_MIN_BUFFERS;
+	streaming_pipeline *streaming = calloc(1, sizeof(streaming_pipeline));
+	assert(streaming != NULL);
+	streaming->ser = ser;
+	streaming->preview_interval = (int)CCD_STREAMING_PREVIEW_INTERVAL_ITEM->number.value;
+	pthread_mutex_init(&streaming->mutex, NULL);
+	pthread_cond_init(&streaming->cond, NULL);
+	streaming->size = size;
+	streaming->count = count;
+	streaming->frames = calloc(count, sizeof(streaming_frame));
+	streaming->free_frames = malloc(count * sizeof(int));
+	streaming->ready_frames = malloc(count * sizeof(int));
+	assert(streaming->frames != NULL && streaming->free_frames != NULL && streaming->ready_frames != NULL);
+	for (int i = 0; i < count; i++) {
+		streaming->frames[i].data = indigo_alloc_shared_blob_buffer(size);
+		streaming->free_frames[i] = count - 1 - i;
+	}
+	streaming->free_count = count;
+	streaming->filling = -1;
+	CCD_CONTEXT->streaming = streaming;
+	update_streaming_stats(device, false);
+	streaming->running = pthread_create(&streaming->thread, NULL, (void *(*)(void *))streaming_processing_thread, device) == 0;
+	if (!streaming->running) {
+		INDIGO_ERROR(indigo_error("%s(): failed to start processing thread", __FUNCTION__));
+		indigo_ccd_streaming_stop(device);
+		return false;
+	}
+	INDIGO_DEBUG(indigo_debug("%s(): %d buffers of %ld bytes", __FUNCTION__, count, size));
+	return true;
+}
+
+void *indigo_ccd_streaming_buffer(indigo_device *device) {
+	streaming_pipeline *streaming = CCD_CONTEXT->streaming;
+	if (streaming == NULL)
+		return NULL;
+	pthread_mutex_lock(&streaming->mutex);
+	if (streaming->filling < 0) {
+		assert(streaming->free_count > 0);
+		streaming->filling = streaming->free_frames[--streaming->free_count];
+		streaming_frame *frame = streaming->frames + streaming->filling;
+		// previously processed frame may still be referenced by BLOB cache
+		frame->data = indigo_writable_blob_buffer(frame->data, streaming->size);
+	}
+	void *data = streaming->frames[streaming->filling].data;
+	pthread_mutex_unlock(&streaming->mutex);
+	return data;
+}
+
+void indigo_ccd_streaming_queue_frame(indigo_device *device, void *buffer, int frame_width, int frame_height, int bpp, bool little_endian, bool byte_order_rgb, indigo_fits_keyword *keywords) {
+	streaming_pipeline *streaming = CCD_CONTEXT->streaming;
+	assert(streaming != NULL);
+	pthread_mutex_lock(&streaming->mutex);
+	assert(streaming->filling >= 0 && streaming->frames[streaming->filling].data == buffer);
+	streaming->captured++;
+	if (streaming->free_count == 0 && CCD_STREAMING_POLICY_DROP_NEWEST_ITEM->sw.value) {
+		// keep the buffer to be refilled by the next frame
+		streaming->dropped++;
+		pthread_mutex_unlock(&streaming->mutex);
+		return;
+	}
+	streaming_frame *frame = streaming->frames + streaming->filling;
+	frame->frame_width = frame_width;
+	frame->frame_height = frame_height;
+	frame->bpp = bpp;
+	frame->little_endian = little_endian;
+	frame->byte_order_rgb = byte_order_rgb;
+	frame->keywords = keywords;
+	frame->timestamp = ser_timestamp();
+	if (streaming->free_count == 0) {
+		// next frame needs a buffer, recycle the oldest one not taken by processing thread yet
+		streaming->free_frames[streaming->free_count++] = streaming->ready_frames[streaming->ready_head];
+		streaming->ready_head = (streaming->ready_head + 1) % streaming->count;
+		streaming->ready_count--;
+		streaming->dropped++;
+	}
+	streaming->ready_frames[(streaming->ready_head + streaming->ready_count) % streaming->count] = streaming->filling;
+	streaming->ready_count++;
+	streaming->filling = -1;
+	pthread_cond_signal(&streaming->cond);
+	pthread_mutex_unlock(&streaming->mutex);
+}
+
+void indigo_ccd_streaming_stop(indigo_device *device) {
+	streaming_pipeline *streaming = CCD_CONTEXT->streaming;
+	if (streaming == NULL)
+		return;
+	if (streaming->running) {
+		pthread_mutex_lock(&streaming->mutex);
+		streaming->stopping = true;
+		pthread_cond_signal(&streaming->cond);
+		pthread_mutex_unlock(&streaming->mutex);
+		pthread_join(streaming->thread, NULL);
+	}
+	if (streaming->ser)
+		ser_close(device, streaming->ser);
+	update_streaming_stats(device, true);
+	INDIGO_DEBUG(indigo_debug("%s(): %lu captured, %lu processed, %lu dropped", __FUNCTION__, streaming->captured, streaming->processed, streaming->dropped));
+	CCD_CONTEXT->streaming = NULL;
+	for (int i = 0; i < streaming->count; i++)
+		indigo_release_blob_buffer(streaming->frames[i].data);
+	free(streaming->frames);
+	free(streaming->free_frames);
+	free(streaming->ready_frames);
+	pthread_cond_destroy(&streaming->cond);
+	pthread_mutex_destroy(&streaming->mutex);
+	free(streaming);
+}
+
 void indigo_process_dslr_image(indigo_device *device, void *data, int blobsize, const char *suffix) {
 	assert(device != NULL);
 	assert(data != NULL);
@@ -1461,53 +3080,14 @@ void indigo_process_dslr_image(indigo_device *device, void *data, int blobsize,
 	if (!strcmp(standard_suffix, ".jpg"))
 		strcpy(standard_suffix, ".jpeg");
 	if (CCD_UPLOAD_MODE_LOCAL_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
-		char *dir = CCD_LOCAL_MODE_DIR_ITEM->text.value;
-		char *prefix = CCD_LOCAL_MODE_PREFIX_ITEM->text.value;
-		int handle = 0;
-		char *message = NULL;
-		if (strlen(dir) + strlen(prefix) + strlen(standard_suffix) < INDIGO_VALUE_SIZE) {
-			char file_name[INDIGO_VALUE_SIZE];
-			char *xxx = strstr(prefix, "XXX");
-			if (xxx == NULL) {
-				strncpy(file_name, dir, INDIGO_VALUE_SIZE - strlen(prefix) - strlen(standard_suffix));
-				strcat(file_name, prefix);
-				strcat(file_name, standard_suffix);
-			} else {
-				char format[INDIGO_VALUE_SIZE];
-				strncpy(format, dir, INDIGO_VALUE_SIZE);
-				strncat(format, prefix, xxx - prefix);
-				strcat(format, "%03d");
-				strcat(format, xxx+3);
-				strcat(format, standard_suffix);
-				struct stat sb;
-				int i = 1;
-				while (true) {
-					snprintf(file_name, sizeof(file_name), format, i);
-					if (stat(file_name, &sb) == 0 && S_ISREG(sb.st_mode))
-						i++;
-					else
-						break;
-				}
-			}
-			strncpy(CCD_IMAGE_FILE_ITEM->text.value, file_name, INDIGO_VALUE_SIZE);
-			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_OK_STATE;
-			handle = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-			if (handle) {
-				if (!indigo_write(handle, data, blobsize)) {
-					CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-					message = strerror(errno);
-				}
-				close(handle);
-			} else {
-				CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-				message = strerror(errno);
-			}
+		char file_name[INDIGO_VALUE_SIZE];
+		if (local_file_name(device, standard_suffix, file_name)) {
+			local_save(device, file_name, data, blobsize);
 		} else {
 			CCD_IMAGE_FILE_PROPERTY->state = INDIGO_ALERT_STATE;
-			message = "dir + prefix + suffix is too long";
+			indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, "dir + prefix + suffix is too long");
 		}
-		indigo_update_property(device, CCD_IMAGE_FILE_PROPERTY, message);
-		INDIGO_DEBUG(indigo_debug("Local save in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
+		INDIGO_DEBUG(indigo_debug("Local save queued in %gs", (clock() - start) / (double)CLOCKS_PER_SEC));
 	}
 	if (CCD_UPLOAD_MODE_CLIENT_ITEM->sw.value || CCD_UPLOAD_MODE_BOTH_ITEM->sw.value) {
 		*CCD_IMAGE_ITEM->blob.url = 0;
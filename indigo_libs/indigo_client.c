@@ -38,6 +38,9 @@
 #include <libgen.h>
 #include <dlfcn.h>
 #include <netdb.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -52,7 +55,12 @@
 #include <indigo/indigo_client_xml.h>
 #include <indigo/indigo_client.h>
 
+#define SERVER_RECONNECT_MIN_DELAY	1
+#define SERVER_RECONNECT_MAX_DELAY	60
+#define SERVER_CONNECT_TIMEOUT			5
+
 static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reconnect_cond = PTHREAD_COND_INITIALIZER;
 
 #if defined(INDIGO_WINDOWS)
 static bool is_pre_vista() {
@@ -223,8 +231,7 @@ static void *subprocess_thread(indigo_subprocess_entry *subprocess) {
 			indigo_attach_device(subprocess->protocol_adapter);
 			indigo_xml_parse(subprocess->protocol_adapter, NULL);
 			indigo_detach_device(subprocess->protocol_adapter);
-			free(subprocess->protocol_adapter->device_context);
-			free(subprocess->protocol_adapter);
+			indigo_release_xml_client_adapter(subprocess->protocol_adapter);
 		}
 		if (subprocess->pid >= 0) {
 			 indigo_usleep(sleep_interval * 1000000);
@@ -321,10 +328,55 @@ static void reset_socket(indigo_server_entry *server, int new_socket) {
 		server->socket = new_socket;
 }
 
+static int connect_with_timeout(int socket, struct sockaddr *address, socklen_t length) {
+#if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
+	int flags = fcntl(socket, F_GETFL, 0);
+	if (flags < 0 || fcntl(socket, F_SETFL, flags | O_NONBLOCK) < 0)
+		return connect(socket, address, length);
+	int result = connect(socket, address, length);
+	if (result < 0 && errno == EINPROGRESS) {
+		struct pollfd pfd = { .fd = socket, .events = POLLOUT };
+		result = poll(&pfd, 1, SERVER_CONNECT_TIMEOUT * 1000);
+		if (result == 0) {
+			errno = ETIMEDOUT;
+			result = -1;
+		} else if (result > 0) {
+			int error = 0;
+			socklen_t error_length = sizeof(error);
+			if (getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &error_length) < 0) {
+				result = -1;
+			} else if (error) {
+				errno = error;
+				result = -1;
+			} else {
+				result = 0;
+			}
+		}
+	}
+	if (result == 0)
+		fcntl(socket, F_SETFL, flags);
+	return result;
+#else
+	return connect(socket, address, length);
+#endif
+}
+
+static bool wait_for_reconnect(indigo_server_entry *server, int delay) {
+	struct timespec end;
+	clock_gettime(CLOCK_REALTIME, &end);
+	end.tv_sec += delay;
+	bool woken = false;
+	pthread_mutex_lock(&mutex);
+	if (server->socket == 0)
+		woken = pthread_cond_timedwait(&reconnect_cond, &mutex, &end) == 0;
+	pthread_mutex_unlock(&mutex);
+	return woken;
+}
 
 static void *server_thread(indigo_server_entry *server) {
 	INDIGO_LOG(indigo_log("Server %s:%d thread started", server->host, server->port));
 	pthread_detach(pthread_self());
+	int reconnect_delay = SERVER_RECONNECT_MIN_DELAY;
 	while (server->socket >= 0) {
 		pthread_mutex_lock(&mutex);
 		reset_socket(server, 0);
@@ -340,7 +392,7 @@ static void *server_thread(indigo_server_entry *server) {
 			strncpy(server->last_error, strerror(errno), sizeof(server->last_error));
 		} else {
 			((struct sockaddr_in *)address->ai_addr)->sin_port = htons(server->port);
-			if (connect(server->socket, address->ai_addr, address->ai_addrlen) < 0) {
+			if (connect_with_timeout(server->socket, address->ai_addr, address->ai_addrlen) < 0) {
 				char text[INET_ADDRSTRLEN];
 #if defined(INDIGO_WINDOWS)
 				if (is_pre_vista()) {
@@ -383,9 +435,9 @@ static void *server_thread(indigo_server_entry *server) {
 			indigo_attach_device(server->protocol_adapter);
 			indigo_xml_parse(server->protocol_adapter, NULL);
 			indigo_detach_device(server->protocol_adapter);
-			free(server->protocol_adapter->device_context);
-			free(server->protocol_adapter);
+			indigo_release_xml_client_adapter(server->protocol_adapter);
 			server->protocol_adapter = NULL;
+			reconnect_delay = SERVER_RECONNECT_MIN_DELAY;
 			pthread_mutex_lock(&mutex);
 			reset_socket(server, 0);
 			pthread_mutex_unlock(&mutex);
@@ -394,7 +446,11 @@ static void *server_thread(indigo_server_entry *server) {
 			indigo_send_message(server->protocol_adapter, "disconnected");
 #endif
 		} else if (server->socket == 0) {
-			indigo_usleep(5 * ONE_SECOND_DELAY);
+			INDIGO_DEBUG(indigo_debug("Server %s:%d reconnect in %ds", server->host, server->port, reconnect_delay));
+			if (wait_for_reconnect(server, reconnect_delay))
+				reconnect_delay = SERVER_RECONNECT_MIN_DELAY;
+			else if (reconnect_delay < SERVER_RECONNECT_MAX_DELAY)
+				reconnect_delay = reconnect_delay * 2 < SERVER_RECONNECT_MAX_DELAY ? reconnect_delay * 2 : SERVER_RECONNECT_MAX_DELAY;
 		}
 	}
 	server->thread_started = false;
@@ -458,6 +514,7 @@ indigo_result indigo_disconnect_server(indigo_server_entry *server) {
 #endif
 	}
 	reset_socket(server, -1);
+	pthread_cond_broadcast(&reconnect_cond);
 	pthread_mutex_unlock(&mutex);
 	return INDIGO_OK;
 }
@@ -49,42 +49,86 @@
 #include <indigo/indigo_version.h>
 #include <indigo/indigo_client_xml.h>
 
-static pthread_mutex_t xml_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define ESCAPE_BUFFER_COUNT 5
+#define OUTPUT_BUFFER_SIZE 4096
+
+// each remote server has its own lock and output buffer, so a slow link to one server never blocks requests to the others
+
+typedef struct {
+	indigo_adapter_context context;
+	pthread_mutex_t mutex;
+	char *buffer;
+	long buffer_size, buffer_length;
+	char escape_buffers[ESCAPE_BUFFER_COUNT][INDIGO_VALUE_SIZE];
+	int escape_index;
+} xml_client_context;
+
+static char *escape(xml_client_context *context, char *string) {
+	return indigo_xml_escape_r(string, context->escape_buffers[context->escape_index = (context->escape_index + 1) % ESCAPE_BUFFER_COUNT]);
+}
+
+static void xml_printf(xml_client_context *context, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	long length = vsnprintf(context->buffer + context->buffer_length, context->buffer_size - context->buffer_length, format, args);
+	va_end(args);
+	if (context->buffer_length + length >= context->buffer_size) {
+		while (context->buffer_length + length >= context->buffer_size)
+			context->buffer_size *= 2;
+		context->buffer = realloc(context->buffer, context->buffer_size);
+		assert(context->buffer != NULL);
+		va_start(args, format);
+		vsnprintf(context->buffer + context->buffer_length, context->buffer_size - context->buffer_length, format, args);
+		va_end(args);
+	}
+	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s", context->context.output, context->buffer + context->buffer_length));
+	context->buffer_length += length;
+}
+
+static bool xml_flush(xml_client_context *context) {
+	bool result = indigo_write(context->context.output, context->buffer, context->buffer_length);
+	context->buffer_length = 0;
+	return result;
+}
+
+static void strip_host_suffix(char *device_name, const char *name) {
+	strncpy(device_name, name, INDIGO_NAME_SIZE);
+	if (indigo_use_host_suffix) {
+		char *at = strrchr(device_name, '@');
+		if (at != NULL) {
+			while (at > device_name && at[-1] == ' ')
+				at--;
+			*at = 0;
+		}
+	}
+}
+
 
 static indigo_result xml_client_parser_enumerate_properties(indigo_device *device, indigo_client *client, indigo_property *property) {
 	assert(device != NULL);
 	if (!indigo_reshare_remote_devices && client && client->is_remote)
 		return INDIGO_OK;
-	pthread_mutex_lock(&xml_mutex);
-	indigo_adapter_context *device_context = (indigo_adapter_context *)device->device_context;
+	xml_client_context *device_context = (xml_client_context *)device->device_context;
 	assert(device_context != NULL);
-	int handle = device_context->output;
+	pthread_mutex_lock(&device_context->mutex);
 	char device_name[INDIGO_NAME_SIZE];
-	if (property != NULL && *property->device) {
-		strncpy(device_name, property->device, INDIGO_NAME_SIZE);
-		if (indigo_use_host_suffix) {
-			char *at = strrchr(device_name, '@');
-			if (at != NULL) {
-				while (at > device_name && at[-1] == ' ')
-					at--;
-				*at = 0;
-			}
-		}
-	}
+	if (property != NULL && *property->device)
+		strip_host_suffix(device_name, property->device);
 	if (property != NULL) {
 		if (*property->device && *indigo_property_name(device->version, property)) {
-			indigo_printf(handle, "<getProperties version='1.7' switch='%d.%d' device='%s' name='%s'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, indigo_xml_escape(device_name), indigo_property_name(device->version, property));
+			xml_printf(device_context, "<getProperties version='1.7' switch='%d.%d' device='%s' name='%s'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, escape(device_context, device_name), indigo_property_name(device->version, property));
 		} else if (*property->device) {
-			indigo_printf(handle, "<getProperties version='1.7' switch='%d.%d' device='%s'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, indigo_xml_escape(device_name));
+			xml_printf(device_context, "<getProperties version='1.7' switch='%d.%d' device='%s'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, escape(device_context, device_name));
 		} else if (*indigo_property_name(device->version, property)) {
-			indigo_printf(handle, "<getProperties version='1.7' switch='%d.%d' name='%s'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, indigo_property_name(device->version, property));
+			xml_printf(device_context, "<getProperties version='1.7' switch='%d.%d' name='%s'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, indigo_property_name(device->version, property));
 		} else {
-			indigo_printf(handle, "<getProperties version='1.7' switch='%d.%d'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF);
+			xml_printf(device_context, "<getProperties version='1.7' switch='%d.%d'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF);
 		}
 	} else {
-		indigo_printf(handle, "<getProperties version='1.7' switch='%d.%d'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF);
+		xml_printf(device_context, "<getProperties version='1.7' switch='%d.%d'/>\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF);
 	}
-	pthread_mutex_unlock(&xml_mutex);
+	xml_flush(device_context);
+	pthread_mutex_unlock(&device_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -93,50 +137,42 @@ static indigo_result xml_client_parser_change_property(indigo_device *device, in
 	assert(property != NULL);
 	if (!indigo_reshare_remote_devices && client && client->is_remote)
 		return INDIGO_OK;
-	pthread_mutex_lock(&xml_mutex);
-	indigo_adapter_context *device_context = (indigo_adapter_context *)device->device_context;
+	xml_client_context *device_context = (xml_client_context *)device->device_context;
 	assert(device_context != NULL);
-	int handle = device_context->output;
+	pthread_mutex_lock(&device_context->mutex);
 	char device_name[INDIGO_NAME_SIZE];
 	char b1[32];
-	strncpy(device_name, property->device, INDIGO_NAME_SIZE);
-	if (indigo_use_host_suffix) {
-		char *at = strrchr(device_name, '@');
-		if (at != NULL) {
-			while (at > device_name && at[-1] == ' ')
-				at--;
-			*at = 0;
-		}
-	}
+	strip_host_suffix(device_name, property->device);
 	switch (property->type) {
 	case INDIGO_TEXT_VECTOR:
-		indigo_printf(handle, "<newTextVector device='%s' name='%s'>\n", indigo_xml_escape(device_name), indigo_property_name(device->version, property), indigo_property_state_text[property->state]);
+		xml_printf(device_context, "<newTextVector device='%s' name='%s'>\n", escape(device_context, device_name), indigo_property_name(device->version, property));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
-			indigo_printf(handle, "<oneText name='%s'>%s</oneText>\n", indigo_item_name(device->version, property, item), indigo_xml_escape(item->text.value));
+			xml_printf(device_context, "<oneText name='%s'>%s</oneText>\n", indigo_item_name(device->version, property, item), escape(device_context, item->text.value));
 		}
-		indigo_printf(handle, "</newTextVector>\n");
+		xml_printf(device_context, "</newTextVector>\n");
 		break;
 	case INDIGO_NUMBER_VECTOR:
-		indigo_printf(handle, "<newNumberVector device='%s' name='%s'>\n", indigo_xml_escape(device_name), indigo_property_name(device->version, property), indigo_property_state_text[property->state]);
+		xml_printf(device_context, "<newNumberVector device='%s' name='%s'>\n", escape(device_context, device_name), indigo_property_name(device->version, property));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
-			indigo_printf(handle, "<oneNumber name='%s'>%s</oneNumber>\n", indigo_item_name(device->version, property, item), indigo_dtoa(item->number.value, b1));
+			xml_printf(device_context, "<oneNumber name='%s'>%s</oneNumber>\n", indigo_item_name(device->version, property, item), indigo_dtoa(item->number.value, b1));
 		}
-		indigo_printf(handle, "</newNumberVector>\n");
+		xml_printf(device_context, "</newNumberVector>\n");
 		break;
 	case INDIGO_SWITCH_VECTOR:
-		indigo_printf(handle, "<newSwitchVector device='%s' name='%s'>\n", indigo_xml_escape(device_name), indigo_property_name(device->version, property), indigo_property_state_text[property->state]);
+		xml_printf(device_context, "<newSwitchVector device='%s' name='%s'>\n", escape(device_context, device_name), indigo_property_name(device->version, property));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
-			indigo_printf(handle, "<oneSwitch name='%s'>%s</oneSwitch>\n", indigo_item_name(device->version, property, item), item->sw.value ? "On" : "Off");
+			xml_printf(device_context, "<oneSwitch name='%s'>%s</oneSwitch>\n", indigo_item_name(device->version, property, item), item->sw.value ? "On" : "Off");
 		}
-		indigo_printf(handle, "</newSwitchVector>\n");
+		xml_printf(device_context, "</newSwitchVector>\n");
 		break;
 	default:
 		break;
 	}
-	pthread_mutex_unlock(&xml_mutex);
+	xml_flush(device_context);
+	pthread_mutex_unlock(&device_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -145,30 +181,22 @@ static indigo_result xml_client_parser_enable_blob(indigo_device *device, indigo
 	assert(property != NULL);
 	if (!indigo_reshare_remote_devices && client && client->is_remote)
 		return INDIGO_OK;
-	pthread_mutex_lock(&xml_mutex);
-	indigo_adapter_context *device_context = (indigo_adapter_context *)device->device_context;
+	xml_client_context *device_context = (xml_client_context *)device->device_context;
 	assert(device_context != NULL);
-	int handle = device_context->output;
+	pthread_mutex_lock(&device_context->mutex);
 	char device_name[INDIGO_NAME_SIZE];
-	strncpy(device_name, property->device, INDIGO_NAME_SIZE);
-	if (indigo_use_host_suffix) {
-		char *at = strrchr(device_name, '@');
-		if (at != NULL) {
-			while (at > device_name && at[-1] == ' ')
-				at--;
-			*at = 0;
-		}
-	}
+	strip_host_suffix(device_name, property->device);
 	char *mode_text = "Also";
 	if (mode == INDIGO_ENABLE_BLOB_NEVER)
 		mode_text = "Never";
 	else if (mode == INDIGO_ENABLE_BLOB_URL && device->version >= INDIGO_VERSION_2_0)
 		mode_text = "URL";
 	if (*property->name)
-		indigo_printf(handle, "<enableBLOB device='%s' name='%s'>%s</enableBLOB>\n", indigo_xml_escape(device_name), indigo_property_name(device->version, property), mode_text);
+		xml_printf(device_context, "<enableBLOB device='%s' name='%s'>%s</enableBLOB>\n", escape(device_context, device_name), indigo_property_name(device->version, property), mode_text);
 	else
-		indigo_printf(handle, "<enableBLOB device='%s'>%s</enableBLOB>\n", indigo_xml_escape(device_name), mode_text);
-	pthread_mutex_unlock(&xml_mutex);
+		xml_printf(device_context, "<enableBLOB device='%s'>%s</enableBLOB>\n", escape(device_context, device_name), mode_text);
+	xml_flush(device_context);
+	pthread_mutex_unlock(&device_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -193,11 +221,25 @@ indigo_device *indigo_xml_client_adapter(char *name, char *url_prefix, int input
 	memcpy(device, &device_template, sizeof(indigo_device));
 	sprintf(device->name, "@ %s", name);
 	device->is_remote = input == output; // is socket, otherwise is pipe
-	indigo_adapter_context *device_context = malloc(sizeof(indigo_adapter_context));
+	xml_client_context *device_context = malloc(sizeof(xml_client_context));
 	assert(device_context != NULL);
-	device_context->input = input;
-	device_context->output = output;
-	strncpy(device_context->url_prefix, url_prefix, INDIGO_NAME_SIZE);
+	memset(device_context, 0, sizeof(xml_client_context));
+	device_context->context.input = input;
+	device_context->context.output = output;
+	strncpy(device_context->context.url_prefix, url_prefix, INDIGO_NAME_SIZE);
+	pthread_mutex_init(&device_context->mutex, NULL);
+	device_context->buffer = malloc(device_context->buffer_size = OUTPUT_BUFFER_SIZE);
+	assert(device_context->buffer != NULL);
 	device->device_context = device_context;
 	return device;
 }
+
+void indigo_release_xml_client_adapter(indigo_device *device) {
+	assert(device != NULL);
+	xml_client_context *device_context = (xml_client_context *)device->device_context;
+	assert(device_context != NULL);
+	pthread_mutex_destroy(&device_context->mutex);
+	free(device_context->buffer);
+	free(device_context);
+	free(device);
+}
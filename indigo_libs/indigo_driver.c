@@ -25,6 +25,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <unistd.h>
 #include <string.h>
 #include <pthread.h>
@@ -365,8 +366,7 @@ indigo_result indigo_device_change_property(indigo_device *device, indigo_client
 			indigo_save_property(device, NULL, DEVICE_PORT_PROPERTY);
 			indigo_save_property(device, NULL, DEVICE_BAUDRATE_PROPERTY);
 			if (DEVICE_CONTEXT->property_save_file_handle) {
-				CONFIG_PROPERTY->state = INDIGO_OK_STATE;
-				close(DEVICE_CONTEXT->property_save_file_handle);
+				CONFIG_PROPERTY->state = indigo_close_config_file(DEVICE_CONTEXT->property_save_file_handle) == INDIGO_OK ? INDIGO_OK_STATE : INDIGO_ALERT_STATE;
 				DEVICE_CONTEXT->property_save_file_handle = 0;
 			} else {
 				CONFIG_PROPERTY->state = INDIGO_ALERT_STATE;
@@ -487,9 +487,85 @@ static bool make_config_file_name(char *device_name, int profile, const char *su
 	return false;
 }
 
+// files opened for rewrite are written to a temporary file and renamed over the original by indigo_close_config_file(),
+// so a crash or a full disk never leaves a truncated config behind; text written by indigo_save_property() is collected
+// in memory and written with a single write() on close
+
+typedef struct config_file {
+	int handle;
+	char path[512];
+	char *buffer;
+	long length;
+	long size;
+	struct config_file *next;
+} config_file;
+
+static config_file *config_files = NULL;
+static pthread_mutex_t config_files_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static config_file *find_config_file(int handle) {
+	pthread_mutex_lock(&config_files_mutex);
+	config_file *file = config_files;
+	while (file && file->handle != handle)
+		file = file->next;
+	pthread_mutex_unlock(&config_files_mutex);
+	return file;
+}
+
+static bool config_printf(config_file *file, int handle, const char *format, ...) {
+	va_list args;
+	if (file == NULL) {
+		char buffer[1024];
+		va_start(args, format);
+		int length = vsnprintf(buffer, sizeof(buffer), format, args);
+		va_end(args);
+		return indigo_write(handle, buffer, length < sizeof(buffer) ? length : sizeof(buffer) - 1);
+	}
+	va_start(args, format);
+	int length = vsnprintf(file->buffer + file->length, file->size - file->length, format, args);
+	va_end(args);
+	if (length < 0)
+		return false;
+	if (file->length + length >= file->size) {
+		long size = 2 * file->size + length + 1;
+		char *buffer = realloc(file->buffer, size);
+		if (buffer == NULL)
+			return false;
+		file->buffer = buffer;
+		file->size = size;
+		va_start(args, format);
+		vsnprintf(file->buffer + file->length, file->size - file->length, format, args);
+		va_end(args);
+	}
+	file->length += length;
+	return true;
+}
+
 int indigo_open_config_file(char *device_name, int profile, int mode, const char *suffix) {
 	static char path[512];
 	if (make_config_file_name(device_name, profile, suffix, path, sizeof(path))) {
+		if ((mode & O_TRUNC) && (mode & (O_WRONLY | O_RDWR))) {
+			config_file *file = malloc(sizeof(config_file));
+			if (file == NULL)
+				return -1;
+			char tmp[sizeof(file->path) + 4];
+			strcpy(file->path, path);
+			snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+			int handle = open(tmp, mode, 0644);
+			if (handle < 0) {
+				INDIGO_DEBUG(indigo_debug("Can't create %s (%s)", tmp, strerror(errno)));
+				free(file);
+				return handle;
+			}
+			file->handle = handle;
+			file->buffer = NULL;
+			file->length = file->size = 0;
+			pthread_mutex_lock(&config_files_mutex);
+			file->next = config_files;
+			config_files = file;
+			pthread_mutex_unlock(&config_files_mutex);
+			return handle;
+		}
 		int handle = open(path, mode, 0644);
 		if (handle < 0)
 			INDIGO_DEBUG(indigo_debug("Can't %s %s (%s)", mode == O_RDONLY ? "open" : "create", path, strerror(errno)));
@@ -500,6 +576,36 @@ int indigo_open_config_file(char *device_name, int profile, int mode, const char
 	return -1;
 }
 
+indigo_result indigo_close_config_file(int handle) {
+	if (handle <= 0)
+		return INDIGO_FAILED;
+	pthread_mutex_lock(&config_files_mutex);
+	config_file **link = &config_files;
+	while (*link && (*link)->handle != handle)
+		link = &(*link)->next;
+	config_file *file = *link;
+	if (file)
+		*link = file->next;
+	pthread_mutex_unlock(&config_files_mutex);
+	if (file == NULL)
+		return close(handle) == 0 ? INDIGO_OK : INDIGO_FAILED;
+	char path[sizeof(file->path) + 4];
+	snprintf(path, sizeof(path), "%s.tmp", file->path);
+	bool result = file->length == 0 || indigo_write(handle, file->buffer, file->length);
+	result = fsync(handle) == 0 && result;
+	result = close(handle) == 0 && result;
+	if (result && rename(path, file->path) == 0) {
+		INDIGO_TRACE(indigo_trace("%s saved (%ld bytes)", file->path, file->length));
+	} else {
+		INDIGO_ERROR(indigo_error("Can't save %s (%s)", file->path, strerror(errno)));
+		unlink(path);
+		result = false;
+	}
+	free(file->buffer);
+	free(file);
+	return result ? INDIGO_OK : INDIGO_FAILED;
+}
+
 indigo_result indigo_load_properties(indigo_device *device, bool default_properties) {
 	assert(device != NULL);
 	int profile = 0;
@@ -545,33 +651,36 @@ indigo_result indigo_save_property(indigo_device*device, int *file_handle, indig
 					}
 			}
 			*file_handle = handle = indigo_open_config_file(property->device, profile, O_WRONLY | O_CREAT | O_TRUNC, ".config");
-			if (handle == 0)
+			if (handle < 0) {
+				*file_handle = 0;
 				return INDIGO_FAILED;
+			}
 		}
+		config_file *file = find_config_file(handle);
 		switch (property->type) {
 		case INDIGO_TEXT_VECTOR:
-			indigo_printf(handle, "<newTextVector device='%s' name='%s'>\n", indigo_xml_escape(property->device), property->name, indigo_property_state_text[property->state]);
+			config_printf(file, handle, "<newTextVector device='%s' name='%s'>\n", indigo_xml_escape(property->device), property->name);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				indigo_printf(handle, "<oneText name='%s'>%s</oneText>\n", item->name, indigo_xml_escape(item->text.value));
+				config_printf(file, handle, "<oneText name='%s'>%s</oneText>\n", item->name, indigo_xml_escape(item->text.value));
 			}
-			indigo_printf(handle, "</newTextVector>\n");
+			config_printf(file, handle, "</newTextVector>\n");
 			break;
 		case INDIGO_NUMBER_VECTOR:
-			indigo_printf(handle, "<newNumberVector device='%s' name='%s'>\n", indigo_xml_escape(property->device), property->name, indigo_property_state_text[property->state]);
+			config_printf(file, handle, "<newNumberVector device='%s' name='%s'>\n", indigo_xml_escape(property->device), property->name);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				indigo_printf(handle, "<oneNumber name='%s'>%s</oneNumber>\n", item->name, indigo_dtoa(item->number.value, b1));
+				config_printf(file, handle, "<oneNumber name='%s'>%s</oneNumber>\n", item->name, indigo_dtoa(item->number.value, b1));
 			}
-			indigo_printf(handle, "</newNumberVector>\n");
+			config_printf(file, handle, "</newNumberVector>\n");
 			break;
 		case INDIGO_SWITCH_VECTOR:
-			indigo_printf(handle, "<newSwitchVector device='%s' name='%s'>\n", indigo_xml_escape(property->device), property->name, indigo_property_state_text[property->state]);
+			config_printf(file, handle, "<newSwitchVector device='%s' name='%s'>\n", indigo_xml_escape(property->device), property->name);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				indigo_printf(handle, "<oneSwitch name='%s'>%s</oneSwitch>\n", item->name, item->sw.value ? "On" : "Off");
+				config_printf(file, handle, "<oneSwitch name='%s'>%s</oneSwitch>\n", item->name, item->sw.value ? "On" : "Off");
 			}
-			indigo_printf(handle, "</newSwitchVector>\n");
+			config_printf(file, handle, "</newSwitchVector>\n");
 			break;
 		default:
 			break;
@@ -33,7 +33,10 @@
 #include <assert.h>
 #include <stdint.h>
 #include <arpa/inet.h>
-
+#include <errno.h>
+#include <math.h>
+#include <sys/uio.h>
+#include <zlib.h>
 
 #include <indigo/indigo_json.h>
 #include <indigo/indigo_io.h>
@@ -41,44 +44,255 @@
 //#undef INDIGO_TRACE_PROTOCOL
 //#define INDIGO_TRACE_PROTOCOL(c) c
 
-static pthread_mutex_t json_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define OUTPUT_BUFFER_SIZE 4096
+#define DEFLATE_THRESHOLD 128
+
+typedef struct {
+	indigo_adapter_context context;
+	pthread_mutex_t mutex;
+	char *buffer;
+	long buffer_size, buffer_length;
+	bool deflate_ready;
+	z_stream deflate_stream;
+	unsigned char *deflate_buffer;
+	long deflate_buffer_size;
+} json_adapter_context;
+
+static void reserve(json_adapter_context *context, long length) {
+	if (context->buffer_length + length > context->buffer_size) {
+		while (context->buffer_length + length > context->buffer_size)
+			context->buffer_size *= 2;
+		context->buffer = realloc(context->buffer, context->buffer_size);
+		assert(context->buffer != NULL);
+	}
+}
+
+static void json_append(json_adapter_context *context, const char *string, long length) {
+	reserve(context, length);
+	memcpy(context->buffer + context->buffer_length, string, length);
+	context->buffer_length += length;
+}
+
+#define json_literal(context, string) json_append(context, string, sizeof(string) - 1)
+
+static void json_text(json_adapter_context *context, const char *string) {
+	json_append(context, string, strlen(string));
+}
+
+static void json_string(json_adapter_context *context, const char *string) {
+	static const char hex[] = "0123456789abcdef";
+	reserve(context, 6 * strlen(string) + 2);
+	char *out = context->buffer + context->buffer_length;
+	*out++ = '"';
+	for (const unsigned char *in = (const unsigned char *)string; *in; in++) {
+		unsigned char c = *in;
+		if (c >= 0x20 && c != '"' && c != '\\') {
+			*out++ = c;
+			continue;
+		}
+		*out++ = '\\';
+		switch (c) {
+			case '"':
+			case '\\':
+				*out++ = c;
+				break;
+			case '\n':
+				*out++ = 'n';
+				break;
+			case '\r':
+				*out++ = 'r';
+				break;
+			case '\t':
+				*out++ = 't';
+				break;
+			default:
+				*out++ = 'u';
+				*out++ = '0';
+				*out++ = '0';
+				*out++ = hex[c >> 4];
+				*out++ = hex[c & 0xF];
+				break;
+		}
+	}
+	*out++ = '"';
+	context->buffer_length = out - context->buffer;
+}
+
+static void json_number(json_adapter_context *context, double value) {
+	reserve(context, 32);
+	char *out = context->buffer + context->buffer_length;
+	if (!isfinite(value)) {
+		// NaN and infinity have no JSON representation
+		memcpy(out, "null", 4);
+		context->buffer_length += 4;
+		return;
+	}
+	// integral values (counts, coordinates in pixels, enumerated settings) are the common case and don't need printf
+	// range is checked first, casting out of range value to long long is undefined
+	if (fabs(value) < 1e15 && value == (long long)value) {
+		char digits[24], *pnt = digits + sizeof(digits);
+		long long number = (long long)value;
+		bool negative = number < 0;
+		if (negative)
+			number = -number;
+		do {
+			*--pnt = '0' + number % 10;
+			number /= 10;
+		} while (number);
+		if (negative)
+			*--pnt = '-';
+		long length = digits + sizeof(digits) - pnt;
+		memcpy(out, pnt, length);
+		context->buffer_length += length;
+	} else {
+		context->buffer_length += strlen(indigo_dtoa(value, out));
+	}
+}
 
-static void ws_write(int handle, const char *buffer, long length) {
-	uint8_t header[10] = { 0x81 };
+static bool ws_write(int handle, const unsigned char *buffer, long length, bool compressed) {
+	// frame header and payload go out in a single writev()
+	uint8_t header[10] = { compressed ? 0xC1 : 0x81 };
+	long header_length;
 	if (length <= 0x7D) {
 		header[1] = length;
-		indigo_write(handle, (char *)header, 2);
+		header_length = 2;
 	} else if (length <= 0xFFFF) {
 		header[1] = 0x7E;
 		uint16_t payloadLength = htons(length);
 		memcpy(header+2, &payloadLength, 2);
-		indigo_write(handle, (char *)header, 4);
+		header_length = 4;
 	} else {
 		header[1] = 0x7F;
 		uint64_t payloadLength = htonll(length);
 		memcpy(header+2, &payloadLength, 8);
-		indigo_write(handle, (char *)header, 10);
+		header_length = 10;
+	}
+	struct iovec chunks[2] = { { header, header_length }, { (void *)buffer, length } };
+	struct iovec *chunk = chunks;
+	int count = 2;
+	while (count > 0) {
+		if (chunk->iov_len == 0) {
+			chunk++;
+			count--;
+			continue;
+		}
+		long bytes_written = writev(handle, chunk, count);
+		if (bytes_written < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		while (count > 0 && bytes_written >= (long)chunk->iov_len) {
+			bytes_written -= chunk->iov_len;
+			chunk++;
+			count--;
+		}
+		if (count > 0) {
+			chunk->iov_base = (char *)chunk->iov_base + bytes_written;
+			chunk->iov_len -= bytes_written;
+		}
 	}
-	indigo_write(handle, buffer, length);
+	return true;
 }
 
-static const char *escape(const char *s) {
-	char *q = strchr(s, '"');
-	if (q == NULL)
-		return s;
-	static char tmp[INDIGO_VALUE_SIZE * 2];
-	char *t = tmp;
-	while (q) {
-		long l = q - s;
-		memcpy(t, s, l);
-		t += l;
-		*t++ = '\\';
-		*t++ = '"';
-		s = q + 1;
-		q = strchr(s, '"');
+static bool ws_write_deflated(json_adapter_context *context) {
+	// permessage-deflate (RFC7692) with server context takeover, each message ends with a sync flush marker which is not sent
+	z_stream *stream = &context->deflate_stream;
+	if (!context->deflate_ready) {
+		memset(stream, 0, sizeof(z_stream));
+		if (deflateInit2(stream, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+			INDIGO_ERROR(indigo_error("Can't initialise WebSocket compression"));
+			context->context.web_socket_deflate = false;
+			return ws_write(context->context.output, (unsigned char *)context->buffer, context->buffer_length, false);
+		}
+		context->deflate_ready = true;
+	}
+	long size = deflateBound(stream, context->buffer_length) + 16;
+	if (context->deflate_buffer_size < size) {
+		context->deflate_buffer = realloc(context->deflate_buffer, context->deflate_buffer_size = size);
+		assert(context->deflate_buffer != NULL);
 	}
-	strncpy(t, s, INDIGO_VALUE_SIZE);
-	return tmp;
+	stream->next_in = (unsigned char *)context->buffer;
+	stream->avail_in = (unsigned)context->buffer_length;
+	long length = 0;
+	do {
+		if (length == context->deflate_buffer_size) {
+			context->deflate_buffer = realloc(context->deflate_buffer, context->deflate_buffer_size *= 2);
+			assert(context->deflate_buffer != NULL);
+		}
+		stream->next_out = context->deflate_buffer + length;
+		stream->avail_out = (unsigned)(context->deflate_buffer_size - length);
+		if (deflate(stream, Z_SYNC_FLUSH) == Z_STREAM_ERROR)
+			return false;
+		length = context->deflate_buffer_size - stream->avail_out;
+	} while (stream->avail_out == 0);
+	if (length >= 4 && !memcmp(context->deflate_buffer + length - 4, "\x00\x00\xff\xff", 4))
+		length -= 4;
+	return ws_write(context->context.output, context->deflate_buffer, length, true);
+}
+
+static bool json_flush(json_adapter_context *context) {
+	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %.*s\n", context->context.output, (int)context->buffer_length, context->buffer));
+	bool result;
+	if (!context->context.web_socket)
+		result = indigo_write(context->context.output, context->buffer, context->buffer_length);
+	else if (context->context.web_socket_deflate && context->buffer_length >= DEFLATE_THRESHOLD)
+		result = ws_write_deflated(context);
+	else
+		result = ws_write(context->context.output, (unsigned char *)context->buffer, context->buffer_length, false);
+	context->buffer_length = 0;
+	return result;
+}
+
+static void json_property_header(json_adapter_context *context, const char *tag, indigo_property *property, bool definition, const char *message) {
+	json_literal(context, "{ \"");
+	json_text(context, tag);
+	json_literal(context, "\": { ");
+	if (definition) {
+		json_literal(context, "\"version\": ");
+		json_number(context, property->version);
+		json_literal(context, ", ");
+	}
+	json_literal(context, "\"device\": ");
+	json_string(context, property->device);
+	json_literal(context, ", \"name\": ");
+	json_string(context, property->name);
+	if (definition) {
+		json_literal(context, ", \"group\": ");
+		json_string(context, property->group);
+		json_literal(context, ", \"label\": ");
+		json_string(context, property->label);
+		if (property->type != INDIGO_LIGHT_VECTOR && property->type != INDIGO_BLOB_VECTOR) {
+			json_literal(context, ", \"perm\": \"");
+			json_text(context, indigo_property_perm_text[property->perm]);
+			json_literal(context, "\"");
+		}
+	}
+	json_literal(context, ", \"state\": \"");
+	json_text(context, indigo_property_state_text[property->state]);
+	json_literal(context, "\"");
+	if (definition) {
+		if (property->type == INDIGO_SWITCH_VECTOR) {
+			json_literal(context, ", \"rule\": \"");
+			json_text(context, indigo_switch_rule_text[property->rule]);
+			json_literal(context, "\"");
+		}
+		if (*property->hints) {
+			json_literal(context, ", \"hints\": ");
+			json_string(context, property->hints);
+		}
+	}
+	if (message) {
+		json_literal(context, ", \"message\": ");
+		json_string(context, message);
+	}
+	json_literal(context, ", \"items\": [ ");
+}
+
+static void json_blob_url(json_adapter_context *context, indigo_property *property, indigo_item *item) {
+	char url[INDIGO_NAME_SIZE + 32];
+	snprintf(url, sizeof(url), "/blob/%p%s", indigo_registered_blob_item(property, item), item->blob.format);
+	json_string(context, url);
 }
 
 static indigo_result json_define_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
@@ -89,139 +303,104 @@ static indigo_result json_define_property(indigo_client *client, indigo_device *
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&json_mutex);
-	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+	json_adapter_context *client_context = (json_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
-	char output_buffer[JSON_BUFFER_SIZE];
-	char *pnt = output_buffer;
-	int size;
-	char b1[32], b2[32], b3[32], b4[32], b5[32];
+	pthread_mutex_lock(&client_context->mutex);
 	switch (property->type) {
 		case INDIGO_TEXT_VECTOR:
-			size = sprintf(pnt, "{ \"defTextVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"perm\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state]);
-			pnt += size;
-			if (*property->hints) {
-				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints));
-				pnt += size;
-			}
-			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message));
-				pnt += size;
-			} else {
-				size = sprintf(pnt, ", \"items\": [ ");
-				pnt += size;
-			}
+			json_property_header(client_context, "defTextVector", property, true, message);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"value\": \"%s\" }",  i > 0 ? "," : "", item->name, escape(item->label), item->text.value);
-				pnt += size;
+				if (i > 0)
+					json_literal(client_context, ",");
+				json_literal(client_context, " { \"name\": ");
+				json_string(client_context, item->name);
+				json_literal(client_context, ", \"label\": ");
+				json_string(client_context, item->label);
+				json_literal(client_context, ", \"value\": ");
+				json_string(client_context, item->text.value);
+				json_literal(client_context, " }");
 			}
-			size = sprintf(pnt, " ] } }");
-			size += pnt - output_buffer;
 			break;
 		case INDIGO_NUMBER_VECTOR:
-			size = sprintf(pnt, "{ \"defNumberVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"perm\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state]);
-			pnt += size;
-			if (*property->hints) {
-				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints));
-				pnt += size;
-			}
-			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message));
-				pnt += size;
-			} else {
-				size = sprintf(pnt, ", \"items\": [ ");
-				pnt += size;
-			}
+			json_property_header(client_context, "defNumberVector", property, true, message);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				if (property->perm != INDIGO_RO_PERM)
-					size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"min\": %s, \"max\": %s, \"step\": %s, \"format\": \"%s\", \"target\": %s, \"value\": %s }",  i > 0 ? "," : "", item->name, escape(item->label), indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), item->number.format, indigo_dtoa(item->number.target, b4), indigo_dtoa(item->number.value, b5));
-				else
-					size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"min\": %s, \"max\": %s, \"step\": %s, \"format\": \"%s\", \"value\": %s }",  i > 0 ? "," : "", item->name, escape(item->label), indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), item->number.format, indigo_dtoa(item->number.value, b4));
-				pnt += size;
+				if (i > 0)
+					json_literal(client_context, ",");
+				json_literal(client_context, " { \"name\": ");
+				json_string(client_context, item->name);
+				json_literal(client_context, ", \"label\": ");
+				json_string(client_context, item->label);
+				json_literal(client_context, ", \"min\": ");
+				json_number(client_context, item->number.min);
+				json_literal(client_context, ", \"max\": ");
+				json_number(client_context, item->number.max);
+				json_literal(client_context, ", \"step\": ");
+				json_number(client_context, item->number.step);
+				json_literal(client_context, ", \"format\": ");
+				json_string(client_context, item->number.format);
+				if (property->perm != INDIGO_RO_PERM) {
+					json_literal(client_context, ", \"target\": ");
+					json_number(client_context, item->number.target);
+				}
+				json_literal(client_context, ", \"value\": ");
+				json_number(client_context, item->number.value);
+				json_literal(client_context, " }");
 			}
-			size = sprintf(pnt, " ] } }");
-			size += pnt - output_buffer;
 			break;
 		case INDIGO_SWITCH_VECTOR:
-			size = sprintf(pnt, "{ \"defSwitchVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"perm\": \"%s\", \"state\": \"%s\", \"rule\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], indigo_switch_rule_text[property->rule]);
-			pnt += size;
-			if (*property->hints) {
-				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints));
-				pnt += size;
-			}
-			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message));
-				pnt += size;
-			} else {
-				size = sprintf(pnt, ", \"items\": [ ");
-				pnt += size;
-			}
+			json_property_header(client_context, "defSwitchVector", property, true, message);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"value\": %s }",  i > 0 ? "," : "", item->name, escape(item->label), item->sw.value ? "true" : "false");
-				pnt += size;
+				if (i > 0)
+					json_literal(client_context, ",");
+				json_literal(client_context, " { \"name\": ");
+				json_string(client_context, item->name);
+				json_literal(client_context, ", \"label\": ");
+				json_string(client_context, item->label);
+				if (item->sw.value)
+					json_literal(client_context, ", \"value\": true }");
+				else
+					json_literal(client_context, ", \"value\": false }");
 			}
-			size = sprintf(pnt, " ] } }");
-			size += pnt - output_buffer;
 			break;
 		case INDIGO_LIGHT_VECTOR:
-			size = sprintf(pnt, "{ \"defLightVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label), indigo_property_state_text[property->state]);
-			pnt += size;
-			if (*property->hints) {
-				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints));
-				pnt += size;
-			}
-			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message));
-				pnt += size;
-			} else {
-				size = sprintf(pnt, ", \"items\": [ ");
-				pnt += size;
-			}
+			json_property_header(client_context, "defLightVector", property, true, message);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\", \"value\": \"%s\" }",  i > 0 ? "," : "", item->name, escape(item->label), indigo_property_state_text[item->light.value]);
-				pnt += size;
+				if (i > 0)
+					json_literal(client_context, ",");
+				json_literal(client_context, " { \"name\": ");
+				json_string(client_context, item->name);
+				json_literal(client_context, ", \"label\": ");
+				json_string(client_context, item->label);
+				json_literal(client_context, ", \"value\": \"");
+				json_text(client_context, indigo_property_state_text[item->light.value]);
+				json_literal(client_context, "\" }");
 			}
-			size = sprintf(pnt, " ] } }");
-			size += pnt - output_buffer;
 			break;
 		case INDIGO_BLOB_VECTOR:
-			size = sprintf(pnt, "{ \"defBLOBVector\": { \"version\": %d, \"device\": \"%s\", \"name\": \"%s\", \"group\": \"%s\", \"label\": \"%s\", \"state\": \"%s\"", property->version, property->device, property->name, property->group, escape(property->label), indigo_property_state_text[property->state]);
-			pnt += size;
-			if (*property->hints) {
-				size = sprintf(pnt, ", \"hints\": \"%s\"", escape(property->hints));
-				pnt += size;
-			}
-			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", escape(message));
-				pnt += size;
-			} else {
-				size = sprintf(pnt, ", \"items\": [ ");
-				pnt += size;
-			}
+			json_property_header(client_context, "defBLOBVector", property, true, message);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-
-				if (property->state == INDIGO_OK_STATE && item->blob.value)
-					size = sprintf(pnt, "%s { \"name\": \"%s\",  \"label\": \"%s\", \"value\": \"/blob/%p%s\" }", i > 0 ? "," : "", item->name, escape(item->label), item, item->blob.format);
-				else
-					size = sprintf(pnt, "%s { \"name\": \"%s\", \"label\": \"%s\" }", i > 0 ? "," : "", item->name, escape(item->label));
-				pnt += size;
+				if (i > 0)
+					json_literal(client_context, ",");
+				json_literal(client_context, " { \"name\": ");
+				json_string(client_context, item->name);
+				json_literal(client_context, ", \"label\": ");
+				json_string(client_context, item->label);
+				if (property->state == INDIGO_OK_STATE && item->blob.value) {
+					json_literal(client_context, ", \"value\": ");
+					json_blob_url(client_context, property, item);
+				}
+				json_literal(client_context, " }");
 			}
-			size = sprintf(pnt, " ] } }");
-			size += pnt - output_buffer;
 			break;
 	}
-	if (client_context->web_socket)
-		ws_write(handle, output_buffer, size);
-	else
-		indigo_write(handle, output_buffer, size);
-	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", handle, output_buffer));
-	pthread_mutex_unlock(&json_mutex);
+	json_literal(client_context, " ] } }");
+	json_flush(client_context);
+	pthread_mutex_unlock(&client_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -233,118 +412,86 @@ static indigo_result json_update_property(indigo_client *client, indigo_device *
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&json_mutex);
-	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+	json_adapter_context *client_context = (json_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
-	char output_buffer[JSON_BUFFER_SIZE];
-	char *pnt = output_buffer;
-	int size;
-	char b1[32], b2[32];
+	pthread_mutex_lock(&client_context->mutex);
 	switch (property->type) {
 		case INDIGO_TEXT_VECTOR:
-			size = sprintf(pnt, "{ \"setTextVector\": { \"device\": \"%s\", \"name\": \"%s\", \"state\": \"%s\"", property->device, property->name, indigo_property_state_text[property->state]);
-			pnt += size;
-			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", message);
-				pnt += size;
-			} else {
-				size = sprintf(pnt, ", \"items\": [ ");
-				pnt += size;
-			}
+			json_property_header(client_context, "setTextVector", property, false, message);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": \"%s\" }",  i > 0 ? "," : "", item->name, item->text.value);
-				pnt += size;
+				if (i > 0)
+					json_literal(client_context, ",");
+				json_literal(client_context, " { \"name\": ");
+				json_string(client_context, item->name);
+				json_literal(client_context, ", \"value\": ");
+				json_string(client_context, item->text.value);
+				json_literal(client_context, " }");
 			}
-			size = sprintf(pnt, " ] } }");
-			size += pnt - output_buffer;
 			break;
 		case INDIGO_NUMBER_VECTOR:
-			size = sprintf(pnt, "{ \"setNumberVector\": { \"device\": \"%s\", \"name\": \"%s\", \"state\": \"%s\"", property->device, property->name, indigo_property_state_text[property->state]);
-			pnt += size;
-			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", message);
-				pnt += size;
-			} else {
-				size = sprintf(pnt, ", \"items\": [ ");
-				pnt += size;
-			}
+			json_property_header(client_context, "setNumberVector", property, false, message);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				if (property->perm != INDIGO_RO_PERM)
-					size = sprintf(pnt, "%s { \"name\": \"%s\", \"target\": %s, \"value\": %s }",  i > 0 ? "," : "", item->name, indigo_dtoa(item->number.target, b1), indigo_dtoa(item->number.value, b2));
-				else
-					size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": %s }",  i > 0 ? "," : "", item->name, indigo_dtoa(item->number.value, b1));
-				pnt += size;
+				if (i > 0)
+					json_literal(client_context, ",");
+				json_literal(client_context, " { \"name\": ");
+				json_string(client_context, item->name);
+				if (property->perm != INDIGO_RO_PERM) {
+					json_literal(client_context, ", \"target\": ");
+					json_number(client_context, item->number.target);
+				}
+				json_literal(client_context, ", \"value\": ");
+				json_number(client_context, item->number.value);
+				json_literal(client_context, " }");
 			}
-			size = sprintf(pnt, " ] } }");
-			size += pnt - output_buffer;
 			break;
 		case INDIGO_SWITCH_VECTOR:
-			size = sprintf(pnt, "{ \"setSwitchVector\": { \"device\": \"%s\", \"name\": \"%s\", \"state\": \"%s\"", property->device, property->name, indigo_property_state_text[property->state]);
-			pnt += size;
-			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", message);
-				pnt += size;
-			} else {
-				size = sprintf(pnt, ", \"items\": [ ");
-				pnt += size;
-			}
+			json_property_header(client_context, "setSwitchVector", property, false, message);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": %s }",  i > 0 ? "," : "", item->name, item->sw.value ? "true" : "false");
-				pnt += size;
+				if (i > 0)
+					json_literal(client_context, ",");
+				json_literal(client_context, " { \"name\": ");
+				json_string(client_context, item->name);
+				if (item->sw.value)
+					json_literal(client_context, ", \"value\": true }");
+				else
+					json_literal(client_context, ", \"value\": false }");
 			}
-			size = sprintf(pnt, " ] } }");
-			size += pnt - output_buffer;
 			break;
 		case INDIGO_LIGHT_VECTOR:
-			size = sprintf(pnt, "{ \"setLightVector\": { \"device\": \"%s\", \"name\": \"%s\", \"state\": \"%s\"", property->device, property->name, indigo_property_state_text[property->state]);
-			pnt += size;
-			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", message);
-				pnt += size;
-			} else {
-				size = sprintf(pnt, ", \"items\": [ ");
-				pnt += size;
-			}
+			json_property_header(client_context, "setLightVector", property, false, message);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": \"%s\" }",  i > 0 ? "," : "", item->name, indigo_property_state_text[item->light.value]);
-				pnt += size;
+				if (i > 0)
+					json_literal(client_context, ",");
+				json_literal(client_context, " { \"name\": ");
+				json_string(client_context, item->name);
+				json_literal(client_context, ", \"value\": \"");
+				json_text(client_context, indigo_property_state_text[item->light.value]);
+				json_literal(client_context, "\" }");
 			}
-			size = sprintf(pnt, " ] } }");
-			size += pnt - output_buffer;
 			break;
 		case INDIGO_BLOB_VECTOR:
-			size = sprintf(pnt, "{ \"setBLOBVector\": { \"device\": \"%s\", \"name\": \"%s\", \"state\": \"%s\"", property->device, property->name, indigo_property_state_text[property->state]);
-			pnt += size;
-			if (message) {
-				size = sprintf(pnt, ", \"message\": \"%s\", \"items\": [ ", message);
-				pnt += size;
-			} else {
-				size = sprintf(pnt, ", \"items\": [ ");
-				pnt += size;
-			}
+			json_property_header(client_context, "setBLOBVector", property, false, message);
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				if (property->state == INDIGO_OK_STATE && item->blob.value)
-					size = sprintf(pnt, "%s { \"name\": \"%s\", \"value\": \"/blob/%p%s\" }", i > 0 ? "," : "", item->name, item, item->blob.format);
-				else
-					size = sprintf(pnt, "%s { \"name\": \"%s\" }", i > 0 ? "," : "", item->name);
-				pnt += size;
+				if (i > 0)
+					json_literal(client_context, ",");
+				json_literal(client_context, " { \"name\": ");
+				json_string(client_context, item->name);
+				if (property->state == INDIGO_OK_STATE && item->blob.value) {
+					json_literal(client_context, ", \"value\": ");
+					json_blob_url(client_context, property, item);
+				}
+				json_literal(client_context, " }");
 			}
-			size = sprintf(pnt, " ] } }");
-			size += pnt - output_buffer;
 			break;
 	}
-	if (client_context->web_socket)
-		ws_write(handle, output_buffer, size);
-	else
-		indigo_write(handle, output_buffer, size);
-	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", handle, output_buffer));
-	pthread_mutex_unlock(&json_mutex);
+	json_literal(client_context, " ] } }");
+	json_flush(client_context);
+	pthread_mutex_unlock(&client_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -356,30 +503,24 @@ static indigo_result json_delete_property(indigo_client *client, indigo_device *
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&json_mutex);
-	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+	json_adapter_context *client_context = (json_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
-	char output_buffer[JSON_BUFFER_SIZE];
-	char *pnt = output_buffer;
-	int size;
-	if (*property->name == 0)
-		size = sprintf(pnt, "{ \"deleteProperty\": { \"device\": \"%s\"", device->name);
-	else
-		size = sprintf(pnt, "{ \"deleteProperty\": { \"device\": \"%s\", \"name\": \"%s\"", property->device, property->name);
-	pnt += size;
-	if (message) {
-		size = sprintf(pnt, ", \"message\": \"%s\" } }", message);
+	pthread_mutex_lock(&client_context->mutex);
+	json_literal(client_context, "{ \"deleteProperty\": { \"device\": ");
+	if (*property->name == 0) {
+		json_string(client_context, device->name);
 	} else {
-		size = sprintf(pnt, " } }");
+		json_string(client_context, property->device);
+		json_literal(client_context, ", \"name\": ");
+		json_string(client_context, property->name);
 	}
-	size += pnt - output_buffer;
-	if (client_context->web_socket)
-		ws_write(handle, output_buffer, size);
-	else
-		indigo_write(handle, output_buffer, size);
-	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", handle, output_buffer));
-	pthread_mutex_unlock(&json_mutex);
+	if (message) {
+		json_literal(client_context, ", \"message\": ");
+		json_string(client_context, message);
+	}
+	json_literal(client_context, " } }");
+	json_flush(client_context);
+	pthread_mutex_unlock(&client_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -388,19 +529,14 @@ static indigo_result json_message_property(indigo_client *client, indigo_device
 	assert(client != NULL);
 	if (!indigo_reshare_remote_devices && device->is_remote)
 		return INDIGO_OK;
-	pthread_mutex_lock(&json_mutex);
-	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+	json_adapter_context *client_context = (json_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
-	char output_buffer[JSON_BUFFER_SIZE];
-	char *pnt = output_buffer;
-	int size = sprintf(pnt, "{ \"message\": \"%s\" }", message);
-	if (client_context->web_socket)
-		ws_write(handle, output_buffer, size);
-	else
-		indigo_write(handle, output_buffer, size);
-	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s\n", handle, output_buffer));
-	pthread_mutex_unlock(&json_mutex);
+	pthread_mutex_lock(&client_context->mutex);
+	json_literal(client_context, "{ \"message\": ");
+	json_string(client_context, message);
+	json_literal(client_context, " }");
+	json_flush(client_context);
+	pthread_mutex_unlock(&client_context->mutex);
 	return INDIGO_OK;
 }
 
@@ -426,11 +562,15 @@ indigo_client *indigo_json_device_adapter(int input, int ouput, bool web_socket)
 	indigo_client *client = malloc(sizeof(indigo_client));
 	assert(client != NULL);
 	memcpy(client, &client_template, sizeof(indigo_client));
-	indigo_adapter_context *client_context = malloc(sizeof(indigo_adapter_context));
+	json_adapter_context *client_context = malloc(sizeof(json_adapter_context));
 	assert(client_context != NULL);
-	client_context->input = input;
-	client_context->output = ouput;
-	client_context->web_socket = web_socket;
+	memset(client_context, 0, sizeof(json_adapter_context));
+	client_context->context.input = input;
+	client_context->context.output = ouput;
+	client_context->context.web_socket = web_socket;
+	pthread_mutex_init(&client_context->mutex, NULL);
+	client_context->buffer = malloc(client_context->buffer_size = OUTPUT_BUFFER_SIZE);
+	assert(client_context->buffer != NULL);
 	client->client_context = client_context;
 	client->is_remote = input == ouput;
 	indigo_enable_blob_mode_record *record = (indigo_enable_blob_mode_record *)malloc(sizeof(indigo_enable_blob_mode_record));
@@ -442,13 +582,19 @@ indigo_client *indigo_json_device_adapter(int input, int ouput, bool web_socket)
 
 void indigo_release_json_device_adapter(indigo_client *client) {
 	assert(client != NULL);
-	assert(client->client_context != NULL);
+	json_adapter_context *client_context = (json_adapter_context *)client->client_context;
+	assert(client_context != NULL);
 	indigo_enable_blob_mode_record *record = client->enable_blob_mode_records;
 	while (record) {
 		indigo_enable_blob_mode_record *tmp = record;
 		record = record->next;
 		free(tmp);
 	}
-	free(client->client_context);
+	if (client_context->deflate_ready)
+		deflateEnd(&client_context->deflate_stream);
+	pthread_mutex_destroy(&client_context->mutex);
+	free(client_context->deflate_buffer);
+	free(client_context->buffer);
+	free(client_context);
 	free(client);
 }
@@ -54,26 +54,79 @@
 #define RAW_BUF_SIZE 98304
 #define BASE64_BUF_SIZE 131072  /* BASE64_BUF_SIZE >= (RAW_BUF_SIZE + 2) / 3 * 4 */
 
-static pthread_mutex_t write_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define ESCAPE_BUFFER_COUNT 5
+#define OUTPUT_BUFFER_SIZE 4096
 
-static const char *message_attribute(const char *message) {
+typedef struct {
+	indigo_adapter_context context;
+	pthread_mutex_t mutex;
+	char *buffer;
+	long buffer_size, buffer_length;
+	bool failed;
+	char escape_buffers[ESCAPE_BUFFER_COUNT][INDIGO_VALUE_SIZE];
+	int escape_index;
+	char message_buffer[INDIGO_VALUE_SIZE];
+	char hints_buffer[INDIGO_VALUE_SIZE];
+} xml_adapter_context;
+
+static char *escape(xml_adapter_context *context, char *string) {
+	return indigo_xml_escape_r(string, context->escape_buffers[context->escape_index = (context->escape_index + 1) % ESCAPE_BUFFER_COUNT]);
+}
+
+static const char *message_attribute(xml_adapter_context *context, const char *message) {
 	if (message) {
-		static char buffer[INDIGO_VALUE_SIZE];
-		snprintf(buffer, INDIGO_VALUE_SIZE, " message='%s'", indigo_xml_escape((char *)message));
-		return buffer;
+		snprintf(context->message_buffer, INDIGO_VALUE_SIZE, " message='%s'", escape(context, (char *)message));
+		return context->message_buffer;
 	}
 	return "";
 }
 
-static const char *hints_attribute(const char *hints) {
+static const char *hints_attribute(xml_adapter_context *context, const char *hints) {
 	if (*hints) {
-		static char buffer[INDIGO_VALUE_SIZE];
-		snprintf(buffer, INDIGO_VALUE_SIZE, " hints='%s'", indigo_xml_escape((char *)hints));
-		return buffer;
+		snprintf(context->hints_buffer, INDIGO_VALUE_SIZE, " hints='%s'", escape(context, (char *)hints));
+		return context->hints_buffer;
 	}
 	return "";
 }
 
+static void reserve(xml_adapter_context *context, long length) {
+	if (context->buffer_length + length > context->buffer_size) {
+		while (context->buffer_length + length > context->buffer_size)
+			context->buffer_size *= 2;
+		context->buffer = realloc(context->buffer, context->buffer_size);
+		assert(context->buffer != NULL);
+	}
+}
+
+static void xml_printf(xml_adapter_context *context, const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	long length = vsnprintf(context->buffer + context->buffer_length, context->buffer_size - context->buffer_length, format, args);
+	va_end(args);
+	if (context->buffer_length + length >= context->buffer_size) {
+		reserve(context, length + 1);
+		va_start(args, format);
+		vsnprintf(context->buffer + context->buffer_length, context->buffer_size - context->buffer_length, format, args);
+		va_end(args);
+	}
+	INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s", context->context.output, context->buffer + context->buffer_length));
+	context->buffer_length += length;
+}
+
+static bool xml_flush(xml_adapter_context *context) {
+	long length = context->buffer_length;
+	context->buffer_length = 0;
+	if (context->failed)
+		return false;
+	if (length > 0 && !indigo_write(context->context.output, context->buffer, length)) {
+		// connection is broken, nothing else will be sent to it
+		INDIGO_ERROR(indigo_error("XML adapter: write to %d failed", context->context.output));
+		context->failed = true;
+		return false;
+	}
+	return true;
+}
+
 static indigo_result xml_device_adapter_define_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
 	assert(device != NULL);
 	assert(client != NULL);
@@ -82,63 +135,61 @@ static indigo_result xml_device_adapter_define_property(indigo_client *client, i
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&write_mutex);
-	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+	xml_adapter_context *client_context = (xml_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
+	pthread_mutex_lock(&client_context->mutex);
 	char b1[32], b2[32], b3[32], b4[32], b5[32];
 	switch (property->type) {
 	case INDIGO_TEXT_VECTOR:
-		indigo_printf(handle, "<defTextVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints), message_attribute(message));
+		xml_printf(client_context, "<defTextVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", escape(client_context, property->device), indigo_property_name(client->version, property), escape(client_context, property->group), escape(client_context, property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(client_context, property->hints), message_attribute(client_context, message));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
-			indigo_printf(handle, "<defText name='%s' label='%s'%s>%s</defText>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints), item->text.value);
+			xml_printf(client_context, "<defText name='%s' label='%s'%s>%s</defText>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(client_context, item->hints), item->text.value);
 		}
-		indigo_printf(handle, "</defTextVector>\n");
+		xml_printf(client_context, "</defTextVector>\n");
 		break;
 	case INDIGO_NUMBER_VECTOR:
-		indigo_printf(handle, "<defNumberVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints), message_attribute(message));
+		xml_printf(client_context, "<defNumberVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", escape(client_context, property->device), indigo_property_name(client->version, property), escape(client_context, property->group), escape(client_context, property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(client_context, property->hints), message_attribute(client_context, message));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
 			if (client->version >= INDIGO_VERSION_2_0 && property->perm != INDIGO_RO_PERM)
-				indigo_printf(handle, "<defNumber name='%s' label='%s' format='%s' min='%s' max='%s' step='%s' target='%s'>%s</defNumber>\n", indigo_item_name(client->version, property, item), item->label, item->number.format, indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), indigo_dtoa(item->number.target, b4), indigo_dtoa(item->number.value, b5));
+				xml_printf(client_context, "<defNumber name='%s' label='%s' format='%s' min='%s' max='%s' step='%s' target='%s'>%s</defNumber>\n", indigo_item_name(client->version, property, item), item->label, item->number.format, indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), indigo_dtoa(item->number.target, b4), indigo_dtoa(item->number.value, b5));
 			else
-				indigo_printf(handle, "<defNumber name='%s' label='%s'%s format='%s' min='%s' max='%s' step='%s'>%s</defNumber>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints), item->number.format, indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), indigo_dtoa(item->number.value, b4));
+				xml_printf(client_context, "<defNumber name='%s' label='%s'%s format='%s' min='%s' max='%s' step='%s'>%s</defNumber>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(client_context, item->hints), item->number.format, indigo_dtoa(item->number.min, b1), indigo_dtoa(item->number.max, b2), indigo_dtoa(item->number.step, b3), indigo_dtoa(item->number.value, b4));
 		}
-		indigo_printf(handle, "</defNumberVector>\n");
+		xml_printf(client_context, "</defNumberVector>\n");
 		break;
 	case INDIGO_SWITCH_VECTOR:
-		indigo_printf(handle, "<defSwitchVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s' rule='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], indigo_switch_rule_text[property->rule], hints_attribute(property->hints), message_attribute(message));
+		xml_printf(client_context, "<defSwitchVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s' rule='%s'%s%s>\n", escape(client_context, property->device), indigo_property_name(client->version, property), escape(client_context, property->group), escape(client_context, property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], indigo_switch_rule_text[property->rule], hints_attribute(client_context, property->hints), message_attribute(client_context, message));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
-			indigo_printf(handle, "<defSwitch name='%s' label='%s'%s>%s</defSwitch>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints), item->sw.value ? "On" : "Off");
+			xml_printf(client_context, "<defSwitch name='%s' label='%s'%s>%s</defSwitch>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(client_context, item->hints), item->sw.value ? "On" : "Off");
 		}
-		indigo_printf(handle, "</defSwitchVector>\n");
+		xml_printf(client_context, "</defSwitchVector>\n");
 		break;
 	case INDIGO_LIGHT_VECTOR:
-		indigo_printf(handle, "<defLightVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints), message_attribute(message));
+		xml_printf(client_context, "<defLightVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", escape(client_context, property->device), indigo_property_name(client->version, property), escape(client_context, property->group), escape(client_context, property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(client_context, property->hints), message_attribute(client_context, message));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
-			indigo_printf(handle, " <defLight name='%s' label='%s'%s>%s</defLight>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints), indigo_property_state_text[item->light.value]);
+			xml_printf(client_context, " <defLight name='%s' label='%s'%s>%s</defLight>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(client_context, item->hints), indigo_property_state_text[item->light.value]);
 		}
-		indigo_printf(handle, "</defLightVector>\n");
+		xml_printf(client_context, "</defLightVector>\n");
 		break;
 	case INDIGO_BLOB_VECTOR:
-		indigo_printf(handle, "<defBLOBVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_xml_escape(property->group), indigo_xml_escape(property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(property->hints), message_attribute(message));
+		xml_printf(client_context, "<defBLOBVector device='%s' name='%s' group='%s' label='%s' perm='%s' state='%s'%s%s>\n", escape(client_context, property->device), indigo_property_name(client->version, property), escape(client_context, property->group), escape(client_context, property->label), indigo_property_perm_text[property->perm], indigo_property_state_text[property->state], hints_attribute(client_context, property->hints), message_attribute(client_context, message));
 		for (int i = 0; i < property->count; i++) {
 			indigo_item *item = &property->items[i];
-			indigo_printf(handle, "<defBLOB name='%s' label='%s'%s/>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(item->hints));
+			xml_printf(client_context, "<defBLOB name='%s' label='%s'%s/>\n", indigo_item_name(client->version, property, item), item->label, hints_attribute(client_context, item->hints));
 		}
-		indigo_printf(handle, "</defBLOBVector>\n");
+		xml_printf(client_context, "</defBLOBVector>\n");
 		break;
 	}
-	pthread_mutex_unlock(&write_mutex);
-	return INDIGO_OK;
+	indigo_result result = xml_flush(client_context) ? INDIGO_OK : INDIGO_FAILED;
+	pthread_mutex_unlock(&client_context->mutex);
+	return result;
 }
 
 static indigo_result xml_device_adapter_update_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
-	FILE* fh;
-	int handle2;
 	assert(device != NULL);
 	assert(client != NULL);
 	assert(property != NULL);
@@ -146,46 +197,45 @@ static indigo_result xml_device_adapter_update_property(indigo_client *client, i
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&write_mutex);
-	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+	xml_adapter_context *client_context = (xml_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
+	pthread_mutex_lock(&client_context->mutex);
 	char b1[32], b2[32];
 	switch (property->type) {
 		case INDIGO_TEXT_VECTOR:
-			indigo_printf(handle, "<setTextVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
+			xml_printf(client_context, "<setTextVector device='%s' name='%s' state='%s'%s>\n", escape(client_context, property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(client_context, message));
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				indigo_printf(handle, "<oneText name='%s'>%s</oneText>\n", indigo_item_name(client->version, property, item), indigo_xml_escape(item->text.value));
+				xml_printf(client_context, "<oneText name='%s'>%s</oneText>\n", indigo_item_name(client->version, property, item), escape(client_context, item->text.value));
 			}
-			indigo_printf(handle, "</setTextVector>\n");
+			xml_printf(client_context, "</setTextVector>\n");
 			break;
 		case INDIGO_NUMBER_VECTOR:
-			indigo_printf(handle, "<setNumberVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
+			xml_printf(client_context, "<setNumberVector device='%s' name='%s' state='%s'%s>\n", escape(client_context, property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(client_context, message));
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
 				if (client->version >= INDIGO_VERSION_2_0 && property->perm != INDIGO_RO_PERM)
-					indigo_printf(handle, "<oneNumber name='%s' target='%s'>%s</oneNumber>\n", indigo_item_name(client->version, property, item), indigo_dtoa(item->number.target, b1), indigo_dtoa(item->number.value, b2));
+					xml_printf(client_context, "<oneNumber name='%s' target='%s'>%s</oneNumber>\n", indigo_item_name(client->version, property, item), indigo_dtoa(item->number.target, b1), indigo_dtoa(item->number.value, b2));
 				else
-					indigo_printf(handle, "<oneNumber name='%s'>%s</oneNumber>\n", indigo_item_name(client->version, property, item), indigo_dtoa(item->number.value, b1));
+					xml_printf(client_context, "<oneNumber name='%s'>%s</oneNumber>\n", indigo_item_name(client->version, property, item), indigo_dtoa(item->number.value, b1));
 			}
-			indigo_printf(handle, "</setNumberVector>\n");
+			xml_printf(client_context, "</setNumberVector>\n");
 			break;
 		case INDIGO_SWITCH_VECTOR:
-			indigo_printf(handle, "<setSwitchVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
+			xml_printf(client_context, "<setSwitchVector device='%s' name='%s' state='%s'%s>\n", escape(client_context, property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(client_context, message));
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				indigo_printf(handle, "<oneSwitch name='%s'>%s</oneSwitch>\n", indigo_item_name(client->version, property, item), item->sw.value ? "On" : "Off");
+				xml_printf(client_context, "<oneSwitch name='%s'>%s</oneSwitch>\n", indigo_item_name(client->version, property, item), item->sw.value ? "On" : "Off");
 			}
-			indigo_printf(handle, "</setSwitchVector>\n");
+			xml_printf(client_context, "</setSwitchVector>\n");
 			break;
 		case INDIGO_LIGHT_VECTOR:
-			indigo_printf(handle, "<setLightVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
+			xml_printf(client_context, "<setLightVector device='%s' name='%s' state='%s'%s>\n", escape(client_context, property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(client_context, message));
 			for (int i = 0; i < property->count; i++) {
 				indigo_item *item = &property->items[i];
-				indigo_printf(handle, "<oneLight name='%s'>%s</oneLight>\n", indigo_item_name(client->version, property, item), indigo_property_state_text[item->light.value]);
+				xml_printf(client_context, "<oneLight name='%s'>%s</oneLight>\n", indigo_item_name(client->version, property, item), indigo_property_state_text[item->light.value]);
 			}
-			indigo_printf(handle, "</setLightVector>\n");
+			xml_printf(client_context, "</setLightVector>\n");
 			break;
 		case INDIGO_BLOB_VECTOR: {
 			indigo_enable_blob_mode mode = INDIGO_ENABLE_BLOB_NEVER;
@@ -198,55 +248,55 @@ static indigo_result xml_device_adapter_update_property(indigo_client *client, i
 				record = record->next;
 			}
 			if (mode != INDIGO_ENABLE_BLOB_NEVER) {
-				indigo_printf(handle, "<setBLOBVector device='%s' name='%s' state='%s'%s>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(message));
+				xml_printf(client_context, "<setBLOBVector device='%s' name='%s' state='%s'%s>\n", escape(client_context, property->device), indigo_property_name(client->version, property), indigo_property_state_text[property->state], message_attribute(client_context, message));
 				if (property->state == INDIGO_OK_STATE) {
-					for (int i = 0; i < property->count; i++) {
+					for (int i = 0; i < property->count && !client_context->failed; i++) {
 						indigo_item *item = &property->items[i];
 						long input_length = item->blob.size;
 						unsigned char *data = item->blob.value;
 						if (mode == INDIGO_ENABLE_BLOB_URL && client->version >= INDIGO_VERSION_2_0) {
 							if (*item->blob.url == 0)
-								indigo_printf(handle, "<oneBLOB name='%s' path='/blob/%p%s'/>\n", indigo_item_name(client->version, property, item), item, item->blob.format);
+								xml_printf(client_context, "<oneBLOB name='%s' path='/blob/%p%s'/>\n", indigo_item_name(client->version, property, item), indigo_registered_blob_item(property, item), item->blob.format);
 							else
-								indigo_printf(handle, "<oneBLOB name='%s' url='%s'/>\n", indigo_item_name(client->version, property, item), item->blob.url);
+								xml_printf(client_context, "<oneBLOB name='%s' url='%s'/>\n", indigo_item_name(client->version, property, item), item->blob.url);
 						} else {
-							indigo_printf(handle, "<oneBLOB name='%s' format='%s' size='%ld'>\n", indigo_item_name(client->version, property, item), item->blob.format, item->blob.size);
-							handle2 = dup(handle);
-							fh = fdopen(handle2, "w");
+							xml_printf(client_context, "<oneBLOB name='%s' format='%s' size='%ld'>\n", indigo_item_name(client->version, property, item), item->blob.format, item->blob.size);
+							// data are encoded directly into the output buffer and sent in BASE64_BUF_SIZE chunks
 							if (client->version >= INDIGO_VERSION_2_0) {
 								while (input_length) {
-									char encoded_data[BASE64_BUF_SIZE + 1];
 									long len = (RAW_BUF_SIZE < input_length) ?  RAW_BUF_SIZE : input_length;
-									long enclen = base64_encode((unsigned char*)encoded_data, (unsigned char*)data, len);
-									fwrite(encoded_data, 1, enclen, fh);
+									reserve(client_context, BASE64_BUF_SIZE + 1);
+									client_context->buffer_length += base64_encode((unsigned char *)client_context->buffer + client_context->buffer_length, data, len);
+									if (!xml_flush(client_context))
+										break;
 									input_length -= len;
 									data += len;
 								}
 							} else {
-								static char encoded_data[74];
 								while (input_length) {
-									/* 54 raw = 72 encoded */
+									/* 54 raw = 72 encoded + new line */
 									long len = (54 < input_length) ?  54 : input_length;
-									long enclen = base64_encode((unsigned char*)encoded_data, (unsigned char*)data, len);
-									encoded_data[enclen] = '\n';
-									fwrite(encoded_data, 1, enclen, fh);
+									reserve(client_context, 74);
+									client_context->buffer_length += base64_encode((unsigned char *)client_context->buffer + client_context->buffer_length, data, len);
+									client_context->buffer[client_context->buffer_length++] = '\n';
+									if (client_context->buffer_length >= BASE64_BUF_SIZE && !xml_flush(client_context))
+										break;
 									input_length -= len;
 									data += len;
 								}
 							}
-							fflush(fh);
-							fclose(fh);
-							indigo_printf(handle, "</oneBLOB>\n");
+							xml_printf(client_context, "</oneBLOB>\n");
 						}
 					}
 				}
-				indigo_printf(handle, "</setBLOBVector>\n");
+				xml_printf(client_context, "</setBLOBVector>\n");
 			}
 			break;
 		}
 	}
-	pthread_mutex_unlock(&write_mutex);
-	return INDIGO_OK;
+	indigo_result result = xml_flush(client_context) ? INDIGO_OK : INDIGO_FAILED;
+	pthread_mutex_unlock(&client_context->mutex);
+	return result;
 }
 
 static indigo_result xml_device_adapter_delete_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
@@ -257,16 +307,16 @@ static indigo_result xml_device_adapter_delete_property(indigo_client *client, i
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&write_mutex);
-	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+	xml_adapter_context *client_context = (xml_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
+	pthread_mutex_lock(&client_context->mutex);
 	if (*property->name)
-		indigo_printf(handle, "<delProperty device='%s' name='%s'%s/>\n", indigo_xml_escape(property->device), indigo_property_name(client->version, property), message_attribute(message));
+		xml_printf(client_context, "<delProperty device='%s' name='%s'%s/>\n", escape(client_context, property->device), indigo_property_name(client->version, property), message_attribute(client_context, message));
 	else
-		indigo_printf(handle, "<delProperty device='%s'%s/>\n", device->name, message_attribute(message));
-	pthread_mutex_unlock(&write_mutex);
-	return INDIGO_OK;
+		xml_printf(client_context, "<delProperty device='%s'%s/>\n", device->name, message_attribute(client_context, message));
+	indigo_result result = xml_flush(client_context) ? INDIGO_OK : INDIGO_FAILED;
+	pthread_mutex_unlock(&client_context->mutex);
+	return result;
 }
 
 static indigo_result xml_device_adapter_send_message(indigo_client *client, indigo_device *device, const char *message) {
@@ -276,14 +326,14 @@ static indigo_result xml_device_adapter_send_message(indigo_client *client, indi
 		return INDIGO_OK;
 	if (client->version == INDIGO_VERSION_NONE)
 		return INDIGO_OK;
-	pthread_mutex_lock(&write_mutex);
-	indigo_adapter_context *client_context = (indigo_adapter_context *)client->client_context;
+	xml_adapter_context *client_context = (xml_adapter_context *)client->client_context;
 	assert(client_context != NULL);
-	int handle = client_context->output;
+	pthread_mutex_lock(&client_context->mutex);
 	if (message)
-		indigo_printf(handle, "<message%s/>\n", message_attribute(message));
-	pthread_mutex_unlock(&write_mutex);
-	return INDIGO_OK;
+		xml_printf(client_context, "<message%s/>\n", message_attribute(client_context, message));
+	indigo_result result = xml_flush(client_context) ? INDIGO_OK : INDIGO_FAILED;
+	pthread_mutex_unlock(&client_context->mutex);
+	return result;
 }
 
 indigo_client *indigo_xml_device_adapter(int input, int ouput) {
@@ -299,10 +349,14 @@ indigo_client *indigo_xml_device_adapter(int input, int ouput) {
 	indigo_client *client = malloc(sizeof(indigo_client));
 	assert(client != NULL);
 	memcpy(client, &client_template, sizeof(indigo_client));
-	indigo_adapter_context *client_context = malloc(sizeof(indigo_adapter_context));
+	xml_adapter_context *client_context = malloc(sizeof(xml_adapter_context));
 	assert(client_context != NULL);
-	client_context->input = input;
-	client_context->output = ouput;
+	memset(client_context, 0, sizeof(xml_adapter_context));
+	client_context->context.input = input;
+	client_context->context.output = ouput;
+	pthread_mutex_init(&client_context->mutex, NULL);
+	client_context->buffer = malloc(client_context->buffer_size = OUTPUT_BUFFER_SIZE);
+	assert(client_context->buffer != NULL);
 	client->client_context = client_context;
 	client->is_remote = input == ouput;
 	return client;
@@ -310,8 +364,11 @@ indigo_client *indigo_xml_device_adapter(int input, int ouput) {
 
 void indigo_release_xml_device_adapter(indigo_client *client) {
 	assert(client != NULL);
-	assert(client->client_context != NULL);
-	free(client->client_context);
+	xml_adapter_context *client_context = (xml_adapter_context *)client->client_context;
+	assert(client_context != NULL);
+	pthread_mutex_destroy(&client_context->mutex);
+	free(client_context->buffer);
+	free(client_context);
 	free(client);
 }
 
@@ -41,12 +41,108 @@ static char *property_name_prefix[INDIGO_FILTER_LIST_COUNT] = { "CCD_", "WHEEL_"
 static int property_name_prefix_len[INDIGO_FILTER_LIST_COUNT] = { 4, 6, 8, 6, 7, 5, 4, 9, 6, 6, 6, 6 };
 static char *property_name_label[INDIGO_FILTER_LIST_COUNT] = { "CCD ", "Wheel ", "Focuser ", "Mount ", "Guider ", "Dome ", "GPS ", "Joystick", "AUX #1 ", "AUX #2 ", "AUX #3 ", "AUX #4 " };
 
+static unsigned cache_hash(const char *device, const char *name) {
+	unsigned hash = 2166136261U;
+	while (*device)
+		hash = (hash ^ (unsigned char)*device++) * 16777619U;
+	hash *= 16777619U;
+	while (*name)
+		hash = (hash ^ (unsigned char)*name++) * 16777619U;
+	return hash;
+}
+
+static indigo_filter_cache_entry *cache_find(indigo_filter_context *context, const char *device, const char *name, unsigned hash) {
+	if (context->cache_index_size == 0)
+		return NULL;
+	for (indigo_filter_cache_entry *entry = context->cache_index[hash & (context->cache_index_size - 1)]; entry; entry = entry->next) {
+		if (entry->hash == hash && !strcmp(entry->name, name) && !strcmp(entry->device, device))
+			return entry;
+	}
+	return NULL;
+}
+
+static indigo_filter_cache_entry *cache_add(indigo_filter_context *context, const char *device, const char *name, unsigned hash) {
+	if (context->cache_count == context->cache_size) {
+		int size = context->cache_size ? 2 * context->cache_size : INDIGO_FILTER_CACHE_INITIAL_SIZE;
+		indigo_filter_cache_entry **cache = realloc(context->cache, size * sizeof(indigo_filter_cache_entry *));
+		indigo_filter_cache_entry **cache_index = calloc(2 * size, sizeof(indigo_filter_cache_entry *));
+		if (cache == NULL || cache_index == NULL) {
+			if (cache)
+				context->cache = cache;
+			free(cache_index);
+			return NULL;
+		}
+		for (int i = 0; i < context->cache_count; i++) {
+			indigo_filter_cache_entry *entry = cache[i];
+			int bucket = entry->hash & (2 * size - 1);
+			entry->next = cache_index[bucket];
+			cache_index[bucket] = entry;
+		}
+		free(context->cache_index);
+		context->cache = cache;
+		context->cache_size = size;
+		context->cache_index = cache_index;
+		context->cache_index_size = 2 * size;
+	}
+	indigo_filter_cache_entry *entry = malloc(sizeof(indigo_filter_cache_entry));
+	if (entry == NULL)
+		return NULL;
+	memset(entry, 0, sizeof(indigo_filter_cache_entry));
+	strncpy(entry->device, device, INDIGO_NAME_SIZE - 1);
+	strncpy(entry->name, name, INDIGO_NAME_SIZE - 1);
+	entry->hash = hash;
+	int bucket = hash & (context->cache_index_size - 1);
+	entry->next = context->cache_index[bucket];
+	context->cache_index[bucket] = entry;
+	context->cache[context->cache_count++] = entry;
+	return entry;
+}
+
+static void mirror_property(indigo_property *copy, indigo_property *property) {
+	// only values can change on update, so names, labels and formats already in the copy are left untouched
+	int count = copy->count < property->count ? copy->count : property->count;
+	for (int i = 0; i < count; i++) {
+		indigo_item *target = copy->items + i;
+		indigo_item *source = property->items + i;
+		switch (property->type) {
+			case INDIGO_TEXT_VECTOR:
+				if (strcmp(target->text.value, source->text.value))
+					strcpy(target->text.value, source->text.value);
+				break;
+			case INDIGO_NUMBER_VECTOR:
+				target->number.min = source->number.min;
+				target->number.max = source->number.max;
+				target->number.step = source->number.step;
+				target->number.value = source->number.value;
+				target->number.target = source->number.target;
+				break;
+			case INDIGO_SWITCH_VECTOR:
+				target->sw.value = source->sw.value;
+				break;
+			case INDIGO_LIGHT_VECTOR:
+				target->light.value = source->light.value;
+				break;
+			case INDIGO_BLOB_VECTOR:
+				if (strcmp(target->blob.format, source->blob.format))
+					strcpy(target->blob.format, source->blob.format);
+				if (strcmp(target->blob.url, source->blob.url))
+					strcpy(target->blob.url, source->blob.url);
+				target->blob.size = source->blob.size;
+				target->blob.value = source->blob.value;
+				break;
+		}
+	}
+	copy->state = property->state;
+}
+
 indigo_result indigo_filter_device_attach(indigo_device *device, unsigned version, indigo_device_interface device_interface) {
 	assert(device != NULL);
 	if (FILTER_DEVICE_CONTEXT == NULL) {
 		device->device_context = malloc(sizeof(indigo_filter_context));
 		assert(device->device_context);
 		memset(device->device_context, 0, sizeof(indigo_filter_context));
+		pthread_mutex_init(&FILTER_DEVICE_CONTEXT->cache_mutex, NULL);
+		pthread_cond_init(&FILTER_DEVICE_CONTEXT->cache_cond, NULL);
 	}
 	FILTER_DEVICE_CONTEXT->device = device;
 	if (FILTER_DEVICE_CONTEXT != NULL) {
@@ -248,10 +344,10 @@ indigo_result indigo_filter_enumerate_properties(indigo_device *device, indigo_c
 	}
 	if (indigo_property_match(FILTER_DEVICE_CONTEXT->filter_related_agent_list_property, property))
 		indigo_define_property(device, FILTER_DEVICE_CONTEXT->filter_related_agent_list_property, NULL);
-	for (int i = 0; i < INDIGO_FILTER_MAX_CACHED_PROPERTIES; i++) {
-		indigo_property *cached_property = FILTER_DEVICE_CONTEXT->agent_property_cache[i];
-		if (cached_property && indigo_property_match(cached_property, property))
-			indigo_define_property(device, cached_property, NULL);
+	for (int i = 0; i < FILTER_DEVICE_CONTEXT->cache_count; i++) {
+		indigo_filter_cache_entry *entry = FILTER_DEVICE_CONTEXT->cache[i];
+		if (entry->device_property && entry->agent_property && indigo_property_match(entry->agent_property, property))
+			indigo_define_property(device, entry->agent_property, NULL);
 	}
 	return indigo_device_enumerate_properties(device, client, property);
 }
@@ -331,14 +427,14 @@ indigo_result indigo_filter_change_property(indigo_device *device, indigo_client
 	}
 	if (indigo_property_match(FILTER_DEVICE_CONTEXT->filter_related_agent_list_property, property))
 		return update_related_agent_list(device, property);
-	indigo_property **agent_cache = FILTER_DEVICE_CONTEXT->agent_property_cache;
-	for (int i = 0; i < INDIGO_FILTER_MAX_CACHED_PROPERTIES; i++) {
-		if (agent_cache[i] && indigo_property_match(agent_cache[i], property)) {
+	for (int i = 0; i < FILTER_DEVICE_CONTEXT->cache_count; i++) {
+		indigo_filter_cache_entry *entry = FILTER_DEVICE_CONTEXT->cache[i];
+		if (entry->device_property && entry->agent_property && indigo_property_match(entry->agent_property, property)) {
 			int size = sizeof(indigo_property) + property->count * sizeof(indigo_item);
 			indigo_property *copy = (indigo_property *)malloc(size);
 			memcpy(copy, property, size);
-			strcpy(copy->device, FILTER_DEVICE_CONTEXT->device_property_cache[i]->device);
-			strcpy(copy->name, FILTER_DEVICE_CONTEXT->device_property_cache[i]->name);
+			strcpy(copy->device, entry->device);
+			strcpy(copy->name, entry->name);
 			indigo_change_property(client, copy);
 			indigo_release_property(copy);
 			return INDIGO_OK;
@@ -361,12 +457,6 @@ indigo_result indigo_filter_client_attach(indigo_client *client) {
 	assert(client != NULL);
 	assert (FILTER_CLIENT_CONTEXT != NULL);
 	FILTER_CLIENT_CONTEXT->client = client;
-	indigo_property **device_cache = FILTER_CLIENT_CONTEXT->device_property_cache;
-	indigo_property **agent_cache = FILTER_CLIENT_CONTEXT->device_property_cache;
-	for (int i = 0; i < INDIGO_FILTER_MAX_CACHED_PROPERTIES; i++) {
-		device_cache[i] = NULL;
-		agent_cache[i] = NULL;
-	}
 	indigo_property all_properties;
 	memset(&all_properties, 0, sizeof(all_properties));
 	indigo_enumerate_properties(client, &all_properties);
@@ -397,8 +487,6 @@ indigo_result indigo_filter_define_property(indigo_client *client, indigo_device
 	if (device == FILTER_CLIENT_CONTEXT->device)
 		return INDIGO_OK;
 	device = FILTER_CLIENT_CONTEXT->device;
-	indigo_property **device_cache = FILTER_CLIENT_CONTEXT->device_property_cache;
-	indigo_property **agent_cache = FILTER_CLIENT_CONTEXT->agent_property_cache;
 	if (!strcmp(property->name, INFO_PROPERTY_NAME)) {
 		indigo_item *interface = indigo_get_item(property, INFO_DEVICE_INTERFACE_ITEM_NAME);
 		if (interface) {
@@ -429,33 +517,38 @@ indigo_result indigo_filter_define_property(indigo_client *client, indigo_device
 			int name_prefix_length = property_name_prefix_len[i];
 			if (strcmp(property->device, FILTER_CLIENT_CONTEXT->device_name[i]))
 				continue;
-			bool found = false;
-			for (int j = 0; j < INDIGO_FILTER_MAX_CACHED_PROPERTIES; j++) {
-				if (device_cache[j] == property) {
-					found = true;
-					break;
-				}
+			indigo_filter_context *context = FILTER_CLIENT_CONTEXT;
+			unsigned hash = cache_hash(property->device, property->name);
+			pthread_mutex_lock(&context->cache_mutex);
+			indigo_filter_cache_entry *entry = cache_find(context, property->device, property->name, hash);
+			if (entry == NULL)
+				entry = cache_add(context, property->device, property->name, hash);
+			if (entry == NULL || entry->device_property == property) {
+				pthread_mutex_unlock(&context->cache_mutex);
+				return INDIGO_OK;
 			}
-			if (!found) {
-				for (int j = 0; j < INDIGO_FILTER_MAX_CACHED_PROPERTIES; j++) {
-					if (device_cache[j] == NULL) {
-						device_cache[j] = property;
-						int size = sizeof(indigo_property) + property->count * sizeof(indigo_item);
-						indigo_property *copy = (indigo_property *)malloc(size);
-						memcpy(copy, property, size);
-						strcpy(copy->device, device->name);
-						if (strncmp(name_prefix, copy->name, name_prefix_length)) {
-							strcpy(copy->name, name_prefix);
-							strcat(copy->name, property->name);
-							strcpy(copy->label, property_name_label[i]);
-							strcat(copy->label, property->label);
-						}
-						agent_cache[j] = copy;
-						indigo_define_property(device, copy, NULL);
-						break;
-					}
-				}
+			bool redefined = entry->device_property != NULL;
+			entry->device_property = NULL;
+			pthread_mutex_unlock(&context->cache_mutex);
+			if (redefined && entry->agent_property)
+				indigo_delete_property(device, entry->agent_property, NULL);
+			int size = sizeof(indigo_property) + property->count * sizeof(indigo_item);
+			indigo_property *copy = (indigo_property *)realloc(entry->agent_property, size);
+			if (copy == NULL)
+				return INDIGO_OK;
+			memcpy(copy, property, size);
+			strcpy(copy->device, device->name);
+			if (strncmp(name_prefix, copy->name, name_prefix_length)) {
+				strcpy(copy->name, name_prefix);
+				strcat(copy->name, property->name);
+				strcpy(copy->label, property_name_label[i]);
+				strcat(copy->label, property->label);
 			}
+			pthread_mutex_lock(&context->cache_mutex);
+			entry->agent_property = copy;
+			entry->device_property = property;
+			pthread_mutex_unlock(&context->cache_mutex);
+			indigo_define_property(device, copy, NULL);
 			return INDIGO_OK;
 		}
 	}
@@ -466,8 +559,6 @@ indigo_result indigo_filter_update_property(indigo_client *client, indigo_device
 	if (device == FILTER_CLIENT_CONTEXT->device)
 		return INDIGO_OK;
 	device = FILTER_CLIENT_CONTEXT->device;
-	indigo_property **device_cache = FILTER_CLIENT_CONTEXT->device_property_cache;
-	indigo_property **agent_cache = FILTER_CLIENT_CONTEXT->agent_property_cache;
 	for (int i = 0; i < INDIGO_FILTER_LIST_COUNT; i++) {
 		if (!strcmp(property->name, CONNECTION_PROPERTY_NAME) && property->state != INDIGO_BUSY_STATE) {
 			indigo_item *connected_device = indigo_get_item(property, CONNECTION_CONNECTED_ITEM_NAME);
@@ -502,16 +593,17 @@ indigo_result indigo_filter_update_property(indigo_client *client, indigo_device
 		} else {
 			if (strcmp(property->device, FILTER_CLIENT_CONTEXT->device_name[i]))
 				continue;
-			for (int i = 0; i < INDIGO_FILTER_MAX_CACHED_PROPERTIES; i++) {
-				if (device_cache[i] == property) {
-					if (agent_cache[i]) {
-						memcpy(agent_cache[i]->items, device_cache[i]->items, device_cache[i]->count * sizeof(indigo_item));
-						agent_cache[i]->state = device_cache[i]->state;
-						indigo_update_property(device, agent_cache[i], NULL);
-					}
-					return INDIGO_OK;
-				}
+			indigo_filter_context *context = FILTER_CLIENT_CONTEXT;
+			pthread_mutex_lock(&context->cache_mutex);
+			indigo_filter_cache_entry *entry = cache_find(context, property->device, property->name, cache_hash(property->device, property->name));
+			if (entry)
+				pthread_cond_broadcast(&context->cache_cond);
+			pthread_mutex_unlock(&context->cache_mutex);
+			if (entry && entry->device_property == property && entry->agent_property) {
+				mirror_property(entry->agent_property, property);
+				indigo_update_property(device, entry->agent_property, NULL);
 			}
+			return INDIGO_OK;
 		}
 	}
 	return INDIGO_OK;
@@ -542,30 +634,30 @@ indigo_result indigo_filter_delete_property(indigo_client *client, indigo_device
 	if (device == FILTER_CLIENT_CONTEXT->device)
 		return INDIGO_OK;
 	device = FILTER_CLIENT_CONTEXT->device;
-	indigo_property **device_cache = FILTER_CLIENT_CONTEXT->device_property_cache;
-	indigo_property **agent_cache = FILTER_CLIENT_CONTEXT->agent_property_cache;
+	indigo_filter_context *context = FILTER_CLIENT_CONTEXT;
 	if (*property->name) {
-		for (int i = 0; i < INDIGO_FILTER_MAX_CACHED_PROPERTIES; i++) {
-			if (device_cache[i] == property) {
-				device_cache[i] = NULL;
-				if (agent_cache[i]) {
-					indigo_delete_property(device, agent_cache[i], NULL);
-					indigo_release_property(agent_cache[i]);
-					agent_cache[i] = NULL;
-				}
-				break;
-			}
+		pthread_mutex_lock(&context->cache_mutex);
+		indigo_filter_cache_entry *entry = cache_find(context, property->device, property->name, cache_hash(property->device, property->name));
+		bool deleted = entry && entry->device_property;
+		if (deleted) {
+			entry->device_property = NULL;
+			pthread_cond_broadcast(&context->cache_cond);
 		}
+		pthread_mutex_unlock(&context->cache_mutex);
+		if (deleted && entry->agent_property)
+			indigo_delete_property(device, entry->agent_property, NULL);
 	} else {
-		for (int i = 0; i < INDIGO_FILTER_MAX_CACHED_PROPERTIES; i++) {
-			if (device_cache[i] && !strcmp(device_cache[i]->device, property->device)) {
-				device_cache[i] = NULL;
-				if (agent_cache[i]) {
-					indigo_delete_property(device, agent_cache[i], NULL);
-					indigo_release_property(agent_cache[i]);
-					agent_cache[i] = NULL;
-				}
+		for (int i = 0; i < context->cache_count; i++) {
+			pthread_mutex_lock(&context->cache_mutex);
+			indigo_filter_cache_entry *entry = context->cache[i];
+			bool deleted = entry->device_property && !strcmp(entry->device, property->device);
+			if (deleted) {
+				entry->device_property = NULL;
+				pthread_cond_broadcast(&context->cache_cond);
 			}
+			pthread_mutex_unlock(&context->cache_mutex);
+			if (deleted && entry->agent_property)
+				indigo_delete_property(device, entry->agent_property, NULL);
 		}
 	}
 	if (*property->name == 0 || !strcmp(property->name, INFO_PROPERTY_NAME)) {
@@ -579,26 +671,79 @@ indigo_result indigo_filter_delete_property(indigo_client *client, indigo_device
 }
 
 indigo_result indigo_filter_client_detach(indigo_client *client) {
-	indigo_property **agent_cache = FILTER_CLIENT_CONTEXT->agent_property_cache;
-	for (int i = 0; i < INDIGO_FILTER_MAX_CACHED_PROPERTIES; i++) {
-		if (agent_cache[i])
-			indigo_release_property(agent_cache[i]);
+	indigo_filter_context *context = FILTER_CLIENT_CONTEXT;
+	pthread_mutex_lock(&context->cache_mutex);
+	for (int i = 0; i < context->cache_count; i++) {
+		indigo_release_property(context->cache[i]->agent_property);
+		free(context->cache[i]);
 	}
+	free(context->cache);
+	free(context->cache_index);
+	context->cache = context->cache_index = NULL;
+	context->cache_count = context->cache_size = context->cache_index_size = 0;
+	pthread_mutex_unlock(&context->cache_mutex);
 	return INDIGO_OK;
 }
 
+indigo_filter_cache_entry *indigo_filter_cached_property_entry(indigo_device *device, int index, char *name) {
+	indigo_filter_context *context = FILTER_DEVICE_CONTEXT;
+	char *device_name = context->device_name[index];
+	pthread_mutex_lock(&context->cache_mutex);
+	indigo_filter_cache_entry *entry = cache_find(context, device_name, name, cache_hash(device_name, name));
+	pthread_mutex_unlock(&context->cache_mutex);
+	return entry;
+}
+
 indigo_property *indigo_filter_cached_property(indigo_device *device, int index, char *name) {
-	indigo_property **cache = FILTER_DEVICE_CONTEXT->device_property_cache;
-	char *device_name = FILTER_DEVICE_CONTEXT->device_name[index];
-	indigo_property *property;
-	for (int j = 0; j < INDIGO_FILTER_MAX_CACHED_PROPERTIES; j++) {
-		if ((property = cache[j])) {
-			if (!strcmp(property->device, device_name) && !strcmp(property->name, name)) {
-				return cache[j];
+	indigo_filter_cache_entry *entry = indigo_filter_cached_property_entry(device, index, name);
+	return entry ? entry->device_property : NULL;
+}
+
+indigo_filter_wait_result indigo_filter_wait_for_busy_state(indigo_device *device, indigo_property *property, bool busy, double timeout, indigo_property *process_property) {
+	indigo_filter_context *context = FILTER_DEVICE_CONTEXT;
+	struct timespec end;
+	if (timeout > 0) {
+		clock_gettime(CLOCK_REALTIME, &end);
+		long long nsec = end.tv_nsec + (long long)(timeout * 1e9);
+		end.tv_sec += nsec / 1000000000LL;
+		end.tv_nsec = nsec % 1000000000LL;
+	}
+	indigo_filter_wait_result result = INDIGO_FILTER_WAIT_OK;
+	indigo_filter_cache_entry *entry = NULL;
+	pthread_mutex_lock(&context->cache_mutex);
+	if (property)
+		entry = cache_find(context, property->device, property->name, cache_hash(property->device, property->name));
+	while (true) {
+		if (entry == NULL || entry->device_property != property) {
+			result = INDIGO_FILTER_WAIT_DELETED;
+			break;
+		}
+		if ((property->state == INDIGO_BUSY_STATE) == busy)
+			break;
+		if (process_property && process_property->state != INDIGO_BUSY_STATE) {
+			result = INDIGO_FILTER_WAIT_TIMEOUT;
+			break;
+		}
+		if (timeout > 0) {
+			if (pthread_cond_timedwait(&context->cache_cond, &context->cache_mutex, &end) == ETIMEDOUT) {
+				if (entry->device_property != property)
+					result = INDIGO_FILTER_WAIT_DELETED;
+				else if ((property->state == INDIGO_BUSY_STATE) != busy)
+					result = INDIGO_FILTER_WAIT_TIMEOUT;
+				break;
 			}
+		} else {
+			pthread_cond_wait(&context->cache_cond, &context->cache_mutex);
 		}
 	}
-	return NULL;
+	pthread_mutex_unlock(&context->cache_mutex);
+	return result;
+}
+
+void indigo_filter_wake_waiting(indigo_device *device) {
+	pthread_mutex_lock(&FILTER_DEVICE_CONTEXT->cache_mutex);
+	pthread_cond_broadcast(&FILTER_DEVICE_CONTEXT->cache_cond);
+	pthread_mutex_unlock(&FILTER_DEVICE_CONTEXT->cache_mutex);
 }
 
 indigo_result indigo_filter_forward_change_property(indigo_client *client, indigo_property *property, char *device_name) {
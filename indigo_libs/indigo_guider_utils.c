@@ -12,6 +12,7 @@
 #include <stdlib.h>
 #include <math.h>
 #include <stdio.h>
+#include <pthread.h>
 
 #include <indigo/indigo_bus.h>
 #include <indigo/indigo_ccd_driver.h>
@@ -21,85 +22,125 @@
 #define IM (1)
 #define PI_2 (6.2831853071795864769252867665590057683943L)
 
-static void _fft(const int n, const int offset, const int delta, const double (*x)[2], double (*X)[2], double (*_X)[2]);
+#define MAX_FFT_LOG2	31
 
-static void fft(const int n, const double (*x)[2], double (*X)[2]) {
-	double (*_X)[2] = malloc(2 * n * sizeof(double));
-	_fft(n, 0, 1, x, X, _X);
-	free(_X);
+static pthread_mutex_t twiddle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static double (*twiddle_cache[MAX_FFT_LOG2])[2];
+
+/* e^(-2 pi i k / n) for k < n / 2, computed once per size and never released */
+static const double (*twiddles(const int n))[2] {
+	int bits = 0;
+	while ((1 << bits) < n)
+		bits++;
+	pthread_mutex_lock(&twiddle_mutex);
+	double (*w)[2] = twiddle_cache[bits];
+	if (w == NULL) {
+		w = malloc((n / 2 + 1) * 2 * sizeof(double));
+		for (int k = 0; k < n / 2; k++) {
+			w[k][RE] = cos(PI_2 * k / (double)n);
+			w[k][IM] = -sin(PI_2 * k / (double)n);
+		}
+		twiddle_cache[bits] = w;
+	}
+	pthread_mutex_unlock(&twiddle_mutex);
+	return (const double (*)[2])w;
 }
 
-static void _fft(const int n, const int offset, const int delta, const double (*x)[2], double (*X)[2], double (*_X)[2]) {
-	int n2 = n / 2;
-	int k;
-	double ccos, csin;
-	int k00, k01, k10, k11;
-	double tmp0, tmp1;
-	if (n != 2) {
-		_fft(n2, offset, 2 * delta, x, _X, X);
-		_fft(n2, offset + delta, 2 * delta, x, _X, X);
-		for (k = 0; k < n2; k++) {
-			k00 = offset + k * delta;
-			k01 = k00 + n2 * delta;
-			k10 = offset + 2 * k * delta;
-			k11 = k10 + delta;
-			ccos = cos(PI_2 * k / (double)n);
-			csin = sin(PI_2 * k / (double)n);
-			tmp0 = ccos * _X[k11][RE] + csin * _X[k11][IM];
-			tmp1 = ccos * _X[k11][IM] - csin * _X[k11][RE];
-			X[k01][RE] = _X[k10][RE] - tmp0;
-			X[k01][IM] = _X[k10][IM] - tmp1;
-			X[k00][RE] = _X[k10][RE] + tmp0;
-			X[k00][IM] = _X[k10][IM] + tmp1;
+/* in-place iterative radix-2 FFT of size n, w is twiddle table for size n * stride */
+static void fft(const int n, double (*x)[2], const double (*w)[2], const int stride) {
+	for (int i = 1, j = 0; i < n; i++) {
+		int bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j) {
+			double tmp0 = x[i][RE], tmp1 = x[i][IM];
+			x[i][RE] = x[j][RE];
+			x[i][IM] = x[j][IM];
+			x[j][RE] = tmp0;
+			x[j][IM] = tmp1;
+		}
+	}
+	for (int len = 2, step = n / 2 * stride; len <= n; len <<= 1, step >>= 1) {
+		int half = len / 2;
+		for (int i = 0; i < n; i += len) {
+			double (*a)[2] = x + i, (*b)[2] = x + i + half;
+			for (int k = 0; k < half; k++) {
+				double wr = w[k * step][RE], wi = w[k * step][IM];
+				double tmp0 = wr * b[k][RE] - wi * b[k][IM];
+				double tmp1 = wr * b[k][IM] + wi * b[k][RE];
+				b[k][RE] = a[k][RE] - tmp0;
+				b[k][IM] = a[k][IM] - tmp1;
+				a[k][RE] += tmp0;
+				a[k][IM] += tmp1;
+			}
 		}
-	} else {
-		k00 = offset;
-		k01 = k00 + delta;
-		X[k01][RE] = x[k00][RE] - x[k01][RE];
-		X[k01][IM] = x[k00][IM] - x[k01][IM];
-		X[k00][RE] = x[k00][RE] + x[k01][RE];
-		X[k00][IM] = x[k00][IM] + x[k01][IM];
 	}
 }
 
-static void ifft(const int n, const double (*X)[2], double (*x)[2]) {
-	int n2 = n / 2;
-	int i;
-	double tmp0, tmp1;
-	fft(n, X, x);
-	x[0][RE] = x[0][RE] / n;
-	x[0][IM] = x[0][IM] / n;
-	x[n2][RE] = x[n2][RE] / n;
-	x[n2][IM] = x[n2][IM] / n;
-	for (i = 1; i < n2; i++) {
-		tmp0 = x[i][RE] / n;
-		tmp1 = x[i][IM] / n;
-		x[i][RE] = x[n-i][RE] / n;
-		x[i][IM] = x[n-i][IM] / n;
-		x[n-i][RE] = tmp0;
-		x[n-i][IM] = tmp1;
+/* spectrum of n real values stored in the first n doubles of X, computed in place with n / 2 point FFT */
+static void real_fft(const int n, double (*X)[2]) {
+	const int n2 = n / 2;
+	const double (*w)[2] = twiddles(n);
+	fft(n2, X, w, 2);
+	double z0 = X[0][RE], z1 = X[0][IM];
+	X[0][RE] = z0 + z1;
+	X[0][IM] = 0;
+	X[n2][RE] = z0 - z1;
+	X[n2][IM] = 0;
+	for (int k = 1; k <= n2 / 2; k++) {
+		int l = n2 - k;
+		double zkr = X[k][RE], zki = X[k][IM], zlr = X[l][RE], zli = X[l][IM];
+		/* E = (Z[k] + conj(Z[l])) / 2, O = (Z[k] - conj(Z[l])) / 2i, X[k] = E + w^k O, X[l] = conj(E) - w^l conj(O) */
+		double er = (zkr + zlr) / 2, ei = (zki - zli) / 2;
+		double or = (zki + zli) / 2, oi = (zlr - zkr) / 2;
+		double wor = w[k][RE] * or - w[k][IM] * oi;
+		double woi = w[k][RE] * oi + w[k][IM] * or;
+		X[k][RE] = er + wor;
+		X[k][IM] = ei + woi;
+		X[l][RE] = er - wor;
+		X[l][IM] = woi - ei;
+	}
+	for (int k = 1; k < n2; k++) {
+		X[n - k][RE] = X[k][RE];
+		X[n - k][IM] = -X[k][IM];
 	}
 }
 
-static void corellate_fft(const int n, const double (*X1)[2], const double (*X2)[2], double (*c)[2]) {
-	int i;
-	double (*C)[2] = malloc(2 * n * sizeof(double));
-	/* pointwise multiply X1 conjugate with X2 here, store in X1 */
-	for (i = 0; i < n; i++) {
-		C[i][RE] = X1[i][RE] * X2[i][RE] + X1[i][IM] * X2[i][IM];
-		C[i][IM] = X1[i][IM] * X2[i][RE] - X1[i][RE] * X2[i][IM];
+/* real cross-correlation of two real signals given by spectra, computed with n / 2 point inverse FFT */
+static void corellate_fft(const int n, const double (*X1)[2], const double (*X2)[2], double *c) {
+	const int n2 = n / 2;
+	const double (*w)[2] = twiddles(n);
+	double (*z)[2] = (double (*)[2])c;
+	for (int k = 0; k < n2; k++) {
+		int l = k + n2;
+		/* pointwise multiply X1 conjugate with X2 */
+		double ckr = X1[k][RE] * X2[k][RE] + X1[k][IM] * X2[k][IM];
+		double cki = X1[k][IM] * X2[k][RE] - X1[k][RE] * X2[k][IM];
+		double clr = X1[l][RE] * X2[l][RE] + X1[l][IM] * X2[l][IM];
+		double cli = X1[l][IM] * X2[l][RE] - X1[l][RE] * X2[l][IM];
+		/* E = (C[k] + C[l]) / 2, O = (C[k] - C[l]) / (2 w^k), Z = E + i O, conjugated for inverse transform */
+		double er = (ckr + clr) / 2, ei = (cki + cli) / 2;
+		double dr = (ckr - clr) / 2, di = (cki - cli) / 2;
+		double or = dr * w[k][RE] + di * w[k][IM];
+		double oi = di * w[k][RE] - dr * w[k][IM];
+		z[k][RE] = er - oi;
+		z[k][IM] = -(ei + or);
+	}
+	fft(n2, z, w, 2);
+	for (int k = 0; k < n2; k++) {
+		z[k][RE] /= n2;
+		z[k][IM] /= -n2;
 	}
-	ifft(n, C, c);
-	free(C);
 }
 
-static double find_distance(const int n, const double (*c)[2]) {
+static double find_distance(const int n, const double *c) {
 	int i;
 	const int n2 = n / 2;
 	int max=0;
 	int prev, next;
 	for (i = 0; i < n; i++) {
-		max = (c[i][0] > c[max][0]) ? i : max;
+		max = (c[i] > c[max]) ? i : max;
 	}
 	/* find previous and next positions to calculate quadratic interpolation */
 	if ((max == 0) || (max == n2)) {
@@ -113,8 +154,8 @@ static double find_distance(const int n, const double (*c)[2]) {
 		next = max + 1;
 	}
 	/* find subpixel offset of the maximum position using quadratic interpolation */
-	double max_subp = (c[next][RE] - c[prev][RE]) / (2 * (2 * c[max][RE] - c[next][RE] - c[prev][RE]));
-//	INDIGO_DEBUG(indigo_debug("max_subp = %5.2f max: %d -> %5.2f %5.2f %5.2f\n", max_subp, max, c[prev][0], c[max][0], c[next][0]));
+	double max_subp = (c[next] - c[prev]) / (2 * (2 * c[max] - c[next] - c[prev]));
+//	INDIGO_DEBUG(indigo_debug("max_subp = %5.2f max: %d -> %5.2f %5.2f %5.2f\n", max_subp, max, c[prev], c[max], c[next]));
 	if (max == n2) {
 		return max_subp;
 	} else if (max > n2) {
@@ -393,34 +434,34 @@ indigo_result indigo_centroid_frame_digest(indigo_raw_type raw_type, const void
 
 #define BG_RADIUS	5
 
-static double calibrate_re(double (*vector)[2], int size) {
+static double calibrate_re(double *vector, int size) {
 	int first = BG_RADIUS + 1, last = size - BG_RADIUS - 1;
 	double avg = 0;
 	double mins[size];
 	for (int i = first; i <= last; i++) {
-		double min = vector[i - BG_RADIUS][RE];
+		double min = vector[i - BG_RADIUS];
 		for (int j = -BG_RADIUS + 1; j <= BG_RADIUS; j++) {
-			double value = vector[i + j][RE];
+			double value = vector[i + j];
 			if (value < min)
 				min = value;
 		}
 		mins[i] = min;
 	}
 	for (int i = 0; i < first; i++)
-		vector[i][RE] = 0;
+		vector[i] = 0;
 	for (int i = last + 1; i < size; i++)
-		vector[i][RE] = 0;
+		vector[i] = 0;
 	avg = 0;
 	int count = last - first + 1;
 	for (int i = first; i <= last; i++) {
-		double value = vector[i][RE] - mins[i];
-		vector[i][RE] = value;
+		double value = vector[i] - mins[i];
+		vector[i] = value;
 		avg += value;
 	}
 	avg /= count;
 	double stddev = 0;
 	for (int i = first; i <= last; i++) {
-		double value = vector[i][RE] - avg;
+		double value = vector[i] - avg;
 		stddev += value * value;
 	}
 	stddev /= count;
@@ -428,7 +469,7 @@ static double calibrate_re(double (*vector)[2], int size) {
 	double signal_ms = 0, noise_ms = 0;
 	int signal_count = 0, noise_count = 0;
 	for (int i = first; i <= last; i++) {
-		double value = vector[i][RE];
+		double value = vector[i];
 		if (value > threshold) {
 			signal_ms += value * value;
 			signal_count++;
@@ -450,10 +491,11 @@ indigo_result indigo_donuts_frame_digest(indigo_raw_type raw_type, const void *d
 		return INDIGO_FAILED;
 	c->width = next_power_2(width);
 	c->height = next_power_2(height);
-	double (*col_x)[2] = calloc(2 * c->width * sizeof(double), 1);
-	double (*col_y)[2] = calloc(2 * c->height * sizeof(double), 1);
-	c->fft_x = malloc(2 * c->width * sizeof(double));
-	c->fft_y = malloc(2 * c->height * sizeof(double));
+	/* projections are accumulated directly in the digest buffers and transformed in place */
+	c->fft_x = calloc(2 * c->width * sizeof(double), 1);
+	c->fft_y = calloc(2 * c->height * sizeof(double), 1);
+	double *col_x = (double *)c->fft_x;
+	double *col_y = (double *)c->fft_y;
 	int ci = 0, li = 0, max = width * height;
 	for (int i = 0; i < max; i++) {
 		double value;
@@ -475,8 +517,8 @@ indigo_result indigo_donuts_frame_digest(indigo_raw_type raw_type, const void *d
 				break;
 			}
 		}
-		col_x[ci][RE] += value;
-		col_y[li][RE] += value;
+		col_x[ci] += value;
+		col_y[li] += value;
 		ci++;
 		if (ci == width) {
 			ci = 0;
@@ -494,11 +536,9 @@ indigo_result indigo_donuts_frame_digest(indigo_raw_type raw_type, const void *d
 //		printf(" %5.2f",col_y[i][RE]);
 //	}
 //	printf("\n");
-	fft(c->width, col_x, c->fft_x);
-	fft(c->height, col_y, c->fft_y);
+	real_fft(c->width, c->fft_x);
+	real_fft(c->height, c->fft_y);
 	c->algorithm = donuts;
-	free(col_x);
-	free(col_y);
 	return INDIGO_OK;
 }
 
@@ -513,16 +553,14 @@ indigo_result indigo_calculate_drift(const indigo_frame_digest *ref, const indig
 		return INDIGO_OK;
 	}
 	if (ref->algorithm == donuts) {
-		double (*c_buf)[2];
 		int max_dim = (ref->width > ref->height) ? ref->width : ref->height;
-		c_buf = malloc(2 * max_dim * sizeof(double));
+		double c_buf[max_dim];
 		/* find X correction */
 		corellate_fft(ref->width, ref->fft_x, new->fft_x, c_buf);
 		*drift_x = -find_distance(ref->width, c_buf);
 		/* find Y correction */
 		corellate_fft(ref->height, ref->fft_y, new->fft_y, c_buf);
 		*drift_y = find_distance(ref->height, c_buf);
-		free(c_buf);
 		return INDIGO_OK;
 	}
 	return INDIGO_FAILED;
@@ -33,6 +33,7 @@
 #include <assert.h>
 #include <stdint.h>
 #include <arpa/inet.h>
+#include <zlib.h>
 
 #include <indigo/indigo_json.h>
 #include <indigo/indigo_io.h>
@@ -45,7 +46,7 @@
 
 #define PROPERTY_SIZE sizeof(indigo_property)+INDIGO_MAX_ITEMS*(sizeof(indigo_item))
 
-static long ws_read(int handle, char *buffer, long length) {
+static long ws_read(int handle, char *buffer, long length, z_stream *inflate_stream) {
 	uint8_t header[14];
 	if (indigo_read(handle, (char *)header, 6) <= 0)
 		return -1;
@@ -65,10 +66,31 @@ static long ws_read(int handle, char *buffer, long length) {
 	}
 	if (length < payload_length)
 		return -1;
-	if (indigo_read(handle, buffer, payload_length) <= 0)
+	// compressed frames (RSV1) are sent only if permessage-deflate was negotiated, client_no_context_takeover makes each one self-contained
+	bool compressed = (header[0] & 0x40) && inflate_stream != NULL;
+	char *payload = compressed ? malloc(payload_length + 4) : buffer;
+	if (payload == NULL)
 		return -1;
+	if (indigo_read(handle, payload, payload_length) <= 0) {
+		if (compressed)
+			free(payload);
+		return -1;
+	}
 	for (uint64_t i = 0; i < payload_length; i++) {
-		buffer[i] ^= masking_key[i%4];
+		payload[i] ^= masking_key[i%4];
+	}
+	if (compressed) {
+		memcpy(payload + payload_length, "\x00\x00\xff\xff", 4);
+		inflateReset(inflate_stream);
+		inflate_stream->next_in = (unsigned char *)payload;
+		inflate_stream->avail_in = (unsigned)payload_length + 4;
+		inflate_stream->next_out = (unsigned char *)buffer;
+		inflate_stream->avail_out = (unsigned)length - 1;
+		int result = inflate(inflate_stream, Z_SYNC_FLUSH);
+		free(payload);
+		if ((result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) || inflate_stream->avail_in > 0)
+			return -1;
+		payload_length = length - 1 - inflate_stream->avail_out;
 	}
 	return payload_length;
 }
@@ -275,6 +297,8 @@ void indigo_json_parse(indigo_device *device, indigo_client *client) {
 	parser_state state = IDLE;
 	indigo_property *property = (indigo_property *)property_buffer;
 	memset(property_buffer, 0, PROPERTY_SIZE);
+	z_stream inflate_stream = { 0 };
+	bool inflating = context->web_socket && context->web_socket_deflate && inflateInit2(&inflate_stream, -MAX_WBITS) == Z_OK;
 
 	while (true) {
 		assert(pointer - buffer <= JSON_BUFFER_SIZE);
@@ -284,7 +308,7 @@ void indigo_json_parse(indigo_device *device, indigo_client *client) {
 			goto exit_loop;
 		}
 		while ((c = *pointer++) == 0) {
-			ssize_t count = (int)context->web_socket ? ws_read(handle, buffer, JSON_BUFFER_SIZE) : indigo_read_line(handle, buffer, JSON_BUFFER_SIZE);
+			ssize_t count = (int)context->web_socket ? ws_read(handle, buffer, JSON_BUFFER_SIZE, inflating ? &inflate_stream : NULL) : indigo_read_line(handle, buffer, JSON_BUFFER_SIZE);
 			if (count <= 0) {
 				goto exit_loop;
 			}
@@ -461,6 +485,8 @@ void indigo_json_parse(indigo_device *device, indigo_client *client) {
 		}
 	}
 exit_loop:
+	if (inflating)
+		inflateEnd(&inflate_stream);
 	close(handle);
 	indigo_log("JSON Parser: parser finished");
 }
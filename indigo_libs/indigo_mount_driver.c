@@ -40,10 +40,15 @@
 #include <indigo/indigo_agent.h>
 
 
+#define DEG2RAD	(M_PI / 180.0)
+
 static double indigo_range24(double ha) {
 	return fmod(ha + (24000), 24);
 }
 
+static void indigo_update_pointing_model(indigo_device *device);
+static void indigo_add_pointing_model_point(indigo_device *device, indigo_alignment_point *point);
+
 indigo_result indigo_mount_attach(indigo_device *device, unsigned version) {
 	assert(device != NULL);
 	assert(device != NULL);
@@ -281,6 +286,7 @@ void indigo_mount_load_alignment_points(indigo_device *device) {
 			indigo_init_switch_item(MOUNT_ALIGNMENT_DELETE_POINTS_PROPERTY->items + i, name, label, false);
 		}
 		close(handle);
+		indigo_update_pointing_model(device);
 		if (IS_CONNECTED) {
 			MOUNT_ALIGNMENT_SELECT_POINTS_PROPERTY->state = INDIGO_OK_STATE;
 			indigo_update_property(device, MOUNT_ALIGNMENT_SELECT_POINTS_PROPERTY, NULL);
@@ -300,12 +306,13 @@ void indigo_mount_save_alignment_points(indigo_device *device) {
 			indigo_alignment_point *point =  MOUNT_CONTEXT->alignment_points + i;
 			indigo_printf(handle, "%d %s %s %s %s %s %d\n", point->used, indigo_dtoa(point->ra, b1), indigo_dtoa(point->dec, b2), indigo_dtoa(point->raw_ra, b3), indigo_dtoa(point->raw_dec, b4), indigo_dtoa(point->lst, b5), point->side_of_pier);
 		}
-		close(handle);
+		indigo_close_config_file(handle);
 	}
 }
 
 void indigo_mount_update_alignment_points(indigo_device *device) {
 	indigo_mount_save_alignment_points(device);
+	indigo_update_pointing_model(device);
 	char label[INDIGO_VALUE_SIZE];
 	for (int i = 0; i < MOUNT_CONTEXT->alignment_point_count; i++) {
 		indigo_alignment_point *point =  MOUNT_CONTEXT->alignment_points + i;
@@ -661,6 +668,9 @@ indigo_result indigo_mount_change_property(indigo_device *device, indigo_client
 						MOUNT_ALIGNMENT_SELECT_POINTS_PROPERTY->items[i].sw.value = false;
 						MOUNT_CONTEXT->alignment_points[i].used = false;
 					}
+					indigo_update_pointing_model(device);
+				} else {
+					indigo_add_pointing_model_point(device, point);
 				}
 
 				indigo_mount_save_alignment_points(device);
@@ -742,6 +752,7 @@ indigo_result indigo_mount_change_property(indigo_device *device, indigo_client
 			}
 		}
 		indigo_mount_save_alignment_points(device);
+		indigo_update_pointing_model(device);
 		indigo_raw_to_translated(device, MOUNT_RAW_COORDINATES_RA_ITEM->number.value, MOUNT_RAW_COORDINATES_DEC_ITEM->number.value, &MOUNT_EQUATORIAL_COORDINATES_RA_ITEM->number.value, &MOUNT_EQUATORIAL_COORDINATES_DEC_ITEM->number.value);
 		indigo_raw_to_translated(device, MOUNT_RAW_COORDINATES_RA_ITEM->number.target, MOUNT_RAW_COORDINATES_DEC_ITEM->number.target, &MOUNT_EQUATORIAL_COORDINATES_RA_ITEM->number.target, &MOUNT_EQUATORIAL_COORDINATES_DEC_ITEM->number.target);
 		MOUNT_EQUATORIAL_COORDINATES_PROPERTY->state = INDIGO_OK_STATE;
@@ -932,6 +943,183 @@ static void indigo_eq_to_encoder(indigo_device* device, double ha, double dec, i
 	*enc_dec /= 360.0;
 }
 
+static void indigo_cache_encoder_position(indigo_device *device, indigo_alignment_point *point) {
+	indigo_eq_to_encoder(device, indigo_range24(point->lst - point->ra), point->dec, point->side_of_pier, &point->enc_ra, &point->enc_dec);
+	indigo_eq_to_encoder(device, indigo_range24(point->lst - point->raw_ra), point->raw_dec, point->side_of_pier, &point->raw_enc_ra, &point->raw_enc_dec);
+}
+
+//  Pointing model terms are IH (HA index), ID (DEC index), CH (collimation), NP (HA/DEC non-perpendicularity),
+//  MA/ME (polar axis azimuth/elevation misalignment) and TF (tube flexure). Rows give HA correction multiplied
+//  by cos(DEC) and DEC correction, so the model is linear in the terms and fitted by least squares.
+static void indigo_pointing_model_rows(indigo_pointing_model *model, double ha, double dec, int side_of_pier, double *ha_row, double *dec_row) {
+	double sin_ha = sin(ha * 15 * DEG2RAD), cos_ha = cos(ha * 15 * DEG2RAD);
+	double sin_dec = sin(dec * DEG2RAD), cos_dec = cos(dec * DEG2RAD);
+	double pier = side_of_pier == MOUNT_SIDE_WEST ? 1 : -1;
+	ha_row[0] = cos_dec;
+	ha_row[1] = 0;
+	ha_row[2] = pier;
+	ha_row[3] = pier * sin_dec;
+	ha_row[4] = -cos_ha * sin_dec;
+	ha_row[5] = sin_ha * sin_dec;
+	ha_row[6] = model->cos_latitude * sin_ha;
+	dec_row[0] = 0;
+	dec_row[1] = pier;
+	dec_row[2] = 0;
+	dec_row[3] = 0;
+	dec_row[4] = sin_ha;
+	dec_row[5] = cos_ha;
+	dec_row[6] = model->cos_latitude * cos_ha * sin_dec - model->sin_latitude * cos_dec;
+}
+
+static void indigo_accumulate_pointing_model_point(indigo_pointing_model *model, indigo_alignment_point *point) {
+	double rows[2][MOUNT_MODEL_TERM_COUNT], values[2];
+	double delta_ha = (point->ra - point->raw_ra) * 15;
+	if (delta_ha > 180)
+		delta_ha -= 360;
+	if (delta_ha < -180)
+		delta_ha += 360;
+	values[0] = delta_ha * cos(point->dec * DEG2RAD);
+	values[1] = point->raw_dec - point->dec;
+	indigo_pointing_model_rows(model, indigo_range24(point->lst - point->ra), point->dec, point->side_of_pier, rows[0], rows[1]);
+	for (int r = 0; r < 2; r++) {
+		for (int i = 0; i < MOUNT_MODEL_TERM_COUNT; i++) {
+			model->rhs[i] += rows[r][i] * values[r];
+			for (int j = 0; j < MOUNT_MODEL_TERM_COUNT; j++)
+				model->normal[i][j] += rows[r][i] * rows[r][j];
+		}
+		model->sum_squares += values[r] * values[r];
+	}
+	model->point_count++;
+}
+
+static void indigo_solve_pointing_model(indigo_pointing_model *model) {
+	//  Terms in order of significance, the number of fitted terms grows with the number of points
+	static const int priority[MOUNT_MODEL_TERM_COUNT] = { 0, 1, 4, 5, 2, 3, 6 };
+	static const int term_limit[] = { 0, 2, 4, 5, 6 };
+	bool active[MOUNT_MODEL_TERM_COUNT] = { false };
+	int limit = model->point_count < 5 ? term_limit[model->point_count] : MOUNT_MODEL_TERM_COUNT;
+	for (int i = 0; i < limit; i++)
+		active[priority[i]] = true;
+	int index[MOUNT_MODEL_TERM_COUNT], count;
+	double l[MOUNT_MODEL_TERM_COUNT][MOUNT_MODEL_TERM_COUNT];
+	bool singular = true;
+	while (singular) {
+		//  Cholesky decomposition of normal equations, terms not determined by the points are dropped
+		singular = false;
+		count = 0;
+		for (int i = 0; i < MOUNT_MODEL_TERM_COUNT; i++)
+			if (active[i])
+				index[count++] = i;
+		for (int i = 0; i < count && !singular; i++) {
+			for (int j = 0; j <= i; j++) {
+				double sum = model->normal[index[i]][index[j]];
+				for (int k = 0; k < j; k++)
+					sum -= l[i][k] * l[j][k];
+				if (i == j) {
+					if (sum <= 1e-9 * model->normal[index[i]][index[i]] || sum <= 0) {
+						active[index[i]] = false;
+						singular = true;
+						break;
+					}
+					l[i][i] = sqrt(sum);
+				} else {
+					l[i][j] = sum / l[j][j];
+				}
+			}
+		}
+	}
+	double y[MOUNT_MODEL_TERM_COUNT], x[MOUNT_MODEL_TERM_COUNT];
+	for (int i = 0; i < count; i++) {
+		double sum = model->rhs[index[i]];
+		for (int k = 0; k < i; k++)
+			sum -= l[i][k] * y[k];
+		y[i] = sum / l[i][i];
+	}
+	memset(model->terms, 0, sizeof(model->terms));
+	double explained = 0;
+	for (int i = count - 1; i >= 0; i--) {
+		double sum = y[i];
+		for (int k = i + 1; k < count; k++)
+			sum -= l[k][i] * x[k];
+		x[i] = sum / l[i][i];
+		model->terms[index[i]] = x[i];
+		explained += x[i] * model->rhs[index[i]];
+	}
+	model->term_count = count;
+	model->rms = model->point_count ? sqrt(fmax(0, model->sum_squares - explained) / (2 * model->point_count)) : 0;
+	INDIGO_DEBUG(indigo_debug("Pointing model from %d points: IH=%g ID=%g CH=%g NP=%g MA=%g ME=%g TF=%g, RMS=%g", model->point_count, model->terms[0], model->terms[1], model->terms[2], model->terms[3], model->terms[4], model->terms[5], model->terms[6], model->rms));
+}
+
+static void indigo_update_pointing_model(indigo_device *device) {
+	indigo_pointing_model *model = &MOUNT_CONTEXT->pointing_model;
+	memset(model, 0, sizeof(indigo_pointing_model));
+	model->latitude = MOUNT_GEOGRAPHIC_COORDINATES_LATITUDE_ITEM->number.value;
+	model->cos_latitude = cos(model->latitude * DEG2RAD);
+	model->sin_latitude = sin(model->latitude * DEG2RAD);
+	for (int i = 0; i < MOUNT_CONTEXT->alignment_point_count; i++) {
+		indigo_alignment_point *point = MOUNT_CONTEXT->alignment_points + i;
+		indigo_cache_encoder_position(device, point);
+		if (point->used)
+			indigo_accumulate_pointing_model_point(model, point);
+	}
+	indigo_solve_pointing_model(model);
+}
+
+static void indigo_add_pointing_model_point(indigo_device *device, indigo_alignment_point *point) {
+	indigo_pointing_model *model = &MOUNT_CONTEXT->pointing_model;
+	if (model->latitude != MOUNT_GEOGRAPHIC_COORDINATES_LATITUDE_ITEM->number.value) {
+		indigo_update_pointing_model(device);
+		return;
+	}
+	indigo_cache_encoder_position(device, point);
+	if (point->used) {
+		indigo_accumulate_pointing_model_point(model, point);
+		indigo_solve_pointing_model(model);
+	}
+}
+
+static indigo_pointing_model *indigo_get_pointing_model(indigo_device *device) {
+	//  Model and cached encoder positions depend on latitude
+	if (MOUNT_CONTEXT->pointing_model.latitude != MOUNT_GEOGRAPHIC_COORDINATES_LATITUDE_ITEM->number.value)
+		indigo_update_pointing_model(device);
+	return &MOUNT_CONTEXT->pointing_model;
+}
+
+static void indigo_pointing_model_correction(indigo_pointing_model *model, double ha, double dec, int side_of_pier, double *delta_ha, double *delta_dec) {
+	double ha_row[MOUNT_MODEL_TERM_COUNT], dec_row[MOUNT_MODEL_TERM_COUNT];
+	indigo_pointing_model_rows(model, ha, dec, side_of_pier, ha_row, dec_row);
+	double ha_correction = 0, dec_correction = 0;
+	for (int i = 0; i < MOUNT_MODEL_TERM_COUNT; i++) {
+		ha_correction += ha_row[i] * model->terms[i];
+		dec_correction += dec_row[i] * model->terms[i];
+	}
+	double cos_dec = fmax(cos(dec * DEG2RAD), 0.01);
+	*delta_ha = ha_correction / cos_dec / 15;
+	*delta_dec = dec_correction;
+}
+
+static void indigo_normalize_coordinates(double *ra, double *dec) {
+	//  RA
+	if (*ra < 0.0)
+		*ra += 24.0;
+	if (*ra >= 24.0)
+		*ra -= 24.0;
+
+	//  DEC
+	if (*dec > 90.0) {
+		*dec = 180.0 - *dec;
+		*ra += 12.0;
+		if (*ra >= 24.0)
+			*ra -= 24.0;
+	}
+	if (*dec < -90.0) {
+		*dec = -180.0 - *dec;
+		*ra += 12.0;
+		if (*ra >= 24.0)
+			*ra -= 24.0;
+	}
+}
+
 static indigo_alignment_point* indigo_find_single_alignment_point(indigo_device* device) {
 	for (int i = 0; i < MOUNT_CONTEXT->alignment_point_count; i++) {
 		//  Return first used point
@@ -948,6 +1136,7 @@ static indigo_alignment_point* indigo_nearest_alignment_point(indigo_device* dev
 	//  Compute virtual encoder angles for RA/DEC
 	double enc_ra, enc_dec;
 	indigo_eq_to_encoder(device, indigo_range24(lst - ra), dec, side_of_pier, &enc_ra, &enc_dec);
+	indigo_get_pointing_model(device);
 
 	//  Find nearest alignment point
 	double min_d = 10.0;   //  Larger than 2.0
@@ -958,12 +1147,9 @@ static indigo_alignment_point* indigo_nearest_alignment_point(indigo_device* dev
 		if (!point->used)
 			continue;
 
-		//  Compute virtual encoder angles for alignment point
-		double enc_p_ra, enc_p_dec;
-		if (raw)
-			indigo_eq_to_encoder(device, indigo_range24(point->lst - point->raw_ra), point->raw_dec, point->side_of_pier, &enc_p_ra, &enc_p_dec);
-		else
-			indigo_eq_to_encoder(device, indigo_range24(point->lst - point->ra), point->dec, point->side_of_pier, &enc_p_ra, &enc_p_dec);
+		//  Use cached virtual encoder angles for alignment point
+		double enc_p_ra = raw ? point->raw_enc_ra : point->enc_ra;
+		double enc_p_dec = raw ? point->raw_enc_dec : point->enc_dec;
 
 		//  Compute separation of encoder angles of RA/DEC and alignment point
 		//  Determine nearest point
@@ -986,7 +1172,7 @@ indigo_result indigo_translated_to_raw(indigo_device *device, double ra, double
 		*raw_ra = ra;
 		*raw_dec = dec;
 		return INDIGO_OK;
-	} else if (MOUNT_ALIGNMENT_MODE_NEAREST_POINT_ITEM->sw.value || MOUNT_ALIGNMENT_MODE_SINGLE_POINT_ITEM->sw.value) {
+	} else if (MOUNT_ALIGNMENT_MODE_NEAREST_POINT_ITEM->sw.value || MOUNT_ALIGNMENT_MODE_SINGLE_POINT_ITEM->sw.value || MOUNT_ALIGNMENT_MODE_MULTI_POINT_ITEM->sw.value) {
 		time_t utc = indigo_get_mount_utc(device);
 		double lst = indigo_lst(&utc, MOUNT_GEOGRAPHIC_COORDINATES_LONGITUDE_ITEM->number.value);
 		double ha = indigo_range24(lst - ra);
@@ -994,11 +1180,6 @@ indigo_result indigo_translated_to_raw(indigo_device *device, double ra, double
 			ha -= 24.0;
 		int side_of_pier = (ha >= 0.0) ? MOUNT_SIDE_WEST : MOUNT_SIDE_EAST;
 		return indigo_translated_to_raw_with_lst(device, lst, ra, dec, side_of_pier, raw_ra, raw_dec);
-	} else if (MOUNT_ALIGNMENT_MODE_MULTI_POINT_ITEM->sw.value) {
-
-		// TBD Rumen
-
-		return INDIGO_OK;
 	}
 	return INDIGO_FAILED;
 }
@@ -1020,25 +1201,7 @@ indigo_result indigo_translated_to_raw_with_lst(indigo_device *device, double ls
 			*raw_dec = dec + (point->raw_dec - point->dec);
 
 			//**  Re-normalize coordinates to ensure they are in range
-			//  RA
-			if (*raw_ra < 0.0)
-				*raw_ra += 24.0;
-			if (*raw_ra >= 24.0)
-				*raw_ra -= 24.0;
-
-			//  DEC
-			if (*raw_dec > 90.0) {
-				*raw_dec = 180.0 - *raw_dec;
-				*raw_ra += 12.0;
-				if (*raw_ra >= 24.0)
-					*raw_ra -= 24.0;
-			}
-			if (*raw_dec < -90.0) {
-				*raw_dec = -180.0 - *raw_dec;
-				*raw_ra += 12.0;
-				if (*raw_ra >= 24.0)
-					*raw_ra -= 24.0;
-			}
+			indigo_normalize_coordinates(raw_ra, raw_dec);
 		}
 		else {
 			*raw_ra = ra;
@@ -1046,9 +1209,12 @@ indigo_result indigo_translated_to_raw_with_lst(indigo_device *device, double ls
 		}
 		return INDIGO_OK;
 	} else if (MOUNT_ALIGNMENT_MODE_MULTI_POINT_ITEM->sw.value) {
-
-		// TBD Rumen
-
+		indigo_pointing_model *model = indigo_get_pointing_model(device);
+		double delta_ha, delta_dec;
+		indigo_pointing_model_correction(model, indigo_range24(lst - ra), dec, side_of_pier, &delta_ha, &delta_dec);
+		*raw_ra = ra - delta_ha;
+		*raw_dec = dec + delta_dec;
+		indigo_normalize_coordinates(raw_ra, raw_dec);
 		return INDIGO_OK;
 	}
 	return INDIGO_FAILED;
@@ -1060,7 +1226,7 @@ indigo_result indigo_raw_to_translated(indigo_device *device, double raw_ra, dou
 		*ra = raw_ra;
 		*dec = raw_dec;
 		return INDIGO_OK;
-	} else if (MOUNT_ALIGNMENT_MODE_NEAREST_POINT_ITEM->sw.value || MOUNT_ALIGNMENT_MODE_SINGLE_POINT_ITEM->sw.value) {
+	} else if (MOUNT_ALIGNMENT_MODE_NEAREST_POINT_ITEM->sw.value || MOUNT_ALIGNMENT_MODE_SINGLE_POINT_ITEM->sw.value || MOUNT_ALIGNMENT_MODE_MULTI_POINT_ITEM->sw.value) {
 		time_t utc = indigo_get_mount_utc(device);
 		double lst = indigo_lst(&utc, MOUNT_GEOGRAPHIC_COORDINATES_LONGITUDE_ITEM->number.value);
 		double ha = indigo_range24(lst - raw_ra);
@@ -1068,11 +1234,6 @@ indigo_result indigo_raw_to_translated(indigo_device *device, double raw_ra, dou
 			ha -= 24.0;
 		int side_of_pier = (ha >= 0.0) ? MOUNT_SIDE_WEST : MOUNT_SIDE_EAST;
 		return indigo_raw_to_translated_with_lst(device, lst, raw_ra, raw_dec, side_of_pier, ra, dec);
-	} else if (MOUNT_ALIGNMENT_MODE_MULTI_POINT_ITEM->sw.value) {
-
-		// TBD Rumen
-
-		return INDIGO_OK;
 	}
 	return INDIGO_FAILED;
 }
@@ -1095,25 +1256,7 @@ indigo_result indigo_raw_to_translated_with_lst(indigo_device *device, double ls
 			*dec = raw_dec + (point->dec - point->raw_dec);
 
 			//**  Re-normalize coordinates to ensure they are in range
-			//  RA
-			if (*ra < 0.0)
-				*ra += 24.0;
-			if (*ra >= 24.0)
-				*ra -= 24.0;
-
-			//  DEC
-			if (*dec > 90.0) {
-				*dec = 180.0 - *dec;
-				*ra += 12.0;
-				if (*ra >= 24.0)
-					*ra -= 24.0;
-			}
-			if (*dec < -90.0) {
-				*dec = -180.0 - *dec;
-				*ra += 12.0;
-				if (*ra >= 24.0)
-					*ra -= 24.0;
-			}
+			indigo_normalize_coordinates(ra, dec);
 		}
 		else {
 			*ra = raw_ra;
@@ -1121,9 +1264,17 @@ indigo_result indigo_raw_to_translated_with_lst(indigo_device *device, double ls
 		}
 		return INDIGO_OK;
 	} else if (MOUNT_ALIGNMENT_MODE_MULTI_POINT_ITEM->sw.value) {
-
-		// TBD Rumen
-
+		//  Invert model by fixed point iteration, corrections are small and smooth
+		indigo_pointing_model *model = indigo_get_pointing_model(device);
+		double delta_ha = 0, delta_dec = 0;
+		*ra = raw_ra;
+		*dec = raw_dec;
+		for (int i = 0; i < 4; i++) {
+			indigo_pointing_model_correction(model, indigo_range24(lst - *ra), *dec, side_of_pier, &delta_ha, &delta_dec);
+			*ra = raw_ra + delta_ha;
+			*dec = raw_dec - delta_dec;
+		}
+		indigo_normalize_coordinates(ra, dec);
 		return INDIGO_OK;
 	}
 	return INDIGO_FAILED;
@@ -24,6 +24,10 @@
  */
 
 //#include <time.h>
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
 #include <novas.h>
 #include <eph_manager.h>
 
@@ -60,43 +64,157 @@ double indigo_lst(time_t *utc, double longitude) {
 	return fmod(gst + longitude/15.0 + 24.0, 24.0);
 }
 
-void indigo_eq2hor(time_t *utc, double latitude, double longitude, double elevation, double ra, double dec, double *alt, double *az) {
-	double ut1;
-	if (utc)
-		ut1 = UT2JD(*utc);
-	else
-		ut1 = UT2JD(time(NULL));
+static object earth, sun;
+static pthread_once_t objects_once = PTHREAD_ONCE_INIT;
 
-	on_surface position = { latitude, longitude, elevation, 0.0, 0.0 };
-	equ2hor(ut1, DELTA_T, 1, 0.0, 0.0, &position, ra, dec, 0, alt, az, &ra, &dec);
-	*alt = 90 - *alt;
+static void make_objects(void) {
+	cat_entry dummy;
+	make_cat_entry("DUMMY", "", 0, 0, 0, 0, 0, 0, 0, &dummy);
+	make_object(0, 3, "Earth", &dummy, &earth);
+	make_object(0, 10, "Sun", &dummy, &sun);
 }
 
-void indigo_app_star(double promora, double promodec, double parallax, double rv, double *ra, double *dec) {
-	double ut1_now = time(NULL) / 86400.0 + 2440587.5 + DELTA_UTC_UT1;
-	double tt_now = ut1_now + DELTA_T / 86400.0;
-	cat_entry star;
+void indigo_init_epoch(indigo_epoch *epoch, double utc, double latitude, double longitude, double elevation) {
 	init();
-	make_cat_entry("HIP 1", "HP2", 1, *ra, *dec, promora, promodec, parallax, rv, &star);
-	int error = app_star(tt_now, &star, 1, ra, dec);
-	if (error != 0) {
-		indigo_error("app_star() -> %d", error);
+	pthread_once(&objects_once, make_objects);
+	if (utc == 0) {
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		utc = now.tv_sec + now.tv_usec / 1e6;
 	}
+	memset(epoch, 0, sizeof(indigo_epoch));
+	epoch->utc = utc;
+	epoch->latitude = latitude;
+	epoch->longitude = longitude;
+	epoch->elevation = elevation;
+	epoch->jd_ut1 = UT2JD(utc);
+	epoch->jd_tt = epoch->jd_ut1 + DELTA_T / 86400.0;
+	double x, secdif;
+	tdb2tt(epoch->jd_tt, &x, &secdif);
+	epoch->jd_tdb = epoch->jd_tt + secdif / 86400.0;
+	// Earth and Sun
+	double jd[2] = { epoch->jd_tdb, 0 }, sun_velocity[3];
+	int error = ephemeris(jd, &earth, 0, 1, epoch->earth_position, epoch->earth_velocity);
+	if (error == 0)
+		error = ephemeris(jd, &sun, 0, 1, epoch->sun_position, sun_velocity);
+	if (error != 0)
+		indigo_error("ephemeris() -> %d", error);
+	// observer
+	on_surface position = { latitude, longitude, elevation, 0.0, 0.0 };
+	observer location;
+	double observer_position[3], observer_velocity[3];
+	make_observer(1, &position, NULL, &location);
+	error = geo_posvel(epoch->jd_tt, DELTA_T, 1, &location, observer_position, observer_velocity);
+	if (error != 0)
+		indigo_error("geo_posvel() -> %d", error);
+	for (int i = 0; i < 3; i++) {
+		epoch->observer_position[i] = epoch->earth_position[i] + observer_position[i];
+		epoch->observer_velocity[i] = epoch->earth_velocity[i] + observer_velocity[i];
+	}
+	// frame tie, precession and nutation
+	for (int i = 0; i < 3; i++) {
+		double axis[3] = { i == 0, i == 1, i == 2 }, tied[3], precessed[3], nutated[3];
+		frame_tie(axis, 1, tied);
+		precession(T0, tied, epoch->jd_tdb, precessed);
+		nutation(epoch->jd_tdb, 0, 1, precessed, nutated);
+		for (int j = 0; j < 3; j++)
+			epoch->matrix[j][i] = nutated[j];
+	}
+	// sidereal time and local horizon basis
+	double gst;
+	error = sidereal_time(epoch->jd_ut1, 0.0, DELTA_T, 0, 0, 0, &gst);
+	if (error != 0)
+		indigo_error("sidereal_time() -> %d", error);
+	epoch->lst = fmod(gst + longitude / 15.0 + 24.0, 24.0);
+	double sin_lat = sin(latitude * DEG2RAD), cos_lat = cos(latitude * DEG2RAD);
+	double sin_lon = sin(longitude * DEG2RAD), cos_lon = cos(longitude * DEG2RAD);
+	double zenith[3] = { cos_lat * cos_lon, cos_lat * sin_lon, sin_lat };
+	double north[3] = { -sin_lat * cos_lon, -sin_lat * sin_lon, cos_lat };
+	double west[3] = { sin_lon, -cos_lon, 0.0 };
+	ter2cel(epoch->jd_ut1, 0.0, DELTA_T, 1, 1, 1, 0.0, 0.0, zenith, epoch->zenith);
+	ter2cel(epoch->jd_ut1, 0.0, DELTA_T, 1, 1, 1, 0.0, 0.0, north, epoch->north);
+	ter2cel(epoch->jd_ut1, 0.0, DELTA_T, 1, 1, 1, 0.0, 0.0, west, epoch->west);
 }
 
-void indigo_topo_star(double latitude, double longitude, double elevation, double promora, double promodec, double parallax, double rv, double *ra, double *dec) {
-	double ut1_now = time(NULL) / 86400.0 + 2440587.5 + DELTA_UTC_UT1;
-	double tt_now = ut1_now + DELTA_T / 86400.0;
-	cat_entry star;
-	init();
-	make_cat_entry("HIP1", "HP2", 1, *ra, *dec, promora, promodec, parallax, rv, &star);
-	on_surface position = { latitude, longitude, elevation, 0.0, 0.0 };
-	int error = topo_star(tt_now, DELTA_T, &star, &position, 1, ra, dec);
-	if (error != 0) {
-		indigo_error("topo_star() -> %d", error);
+static void epoch_star(const indigo_epoch *epoch, const double *observer_position, const double *observer_velocity, double promora, double promodec, double parallax, double rv, double *ra, double *dec) {
+	// same reduction as place() with reduced accuracy, Sun deflection uses its position at epoch and Earth deflection is omitted
+	cat_entry star = { .ra = *ra, .dec = *dec, .promora = promora, .promodec = promodec, .parallax = parallax, .radialvelocity = rv };
+	double pos1[3], vel1[3], pos2[3], pos3[3], pos4[3], pos5[3], pos6[3], t_light;
+	starvectors(&star, pos1, vel1);
+	double dt = d_light(pos1, (double *)observer_position);
+	proper_motion(T0, pos1, vel1, epoch->jd_tdb + dt, pos2);
+	bary2obs(pos2, (double *)observer_position, pos3, &t_light);
+	grav_vec(pos3, (double *)observer_position, (double *)epoch->sun_position, RMASS[10], pos4);
+	aberration(pos4, (double *)observer_velocity, t_light, pos5);
+	for (int i = 0; i < 3; i++)
+		pos6[i] = epoch->matrix[i][0] * pos5[0] + epoch->matrix[i][1] * pos5[1] + epoch->matrix[i][2] * pos5[2];
+	vector2radec(pos6, ra, dec);
+}
+
+void indigo_epoch_app_star(const indigo_epoch *epoch, double promora, double promodec, double parallax, double rv, double *ra, double *dec) {
+	epoch_star(epoch, epoch->earth_position, epoch->earth_velocity, promora, promodec, parallax, rv, ra, dec);
+}
+
+void indigo_epoch_app_stars(const indigo_epoch *epoch, int count, const double *promora, const double *promodec, const double *parallax, const double *rv, double *ra, double *dec) {
+	for (int i = 0; i < count; i++)
+		epoch_star(epoch, epoch->earth_position, epoch->earth_velocity, promora ? promora[i] : 0, promodec ? promodec[i] : 0, parallax ? parallax[i] : 0, rv ? rv[i] : 0, ra + i, dec + i);
+}
+
+void indigo_epoch_topo_stars(const indigo_epoch *epoch, int count, const double *promora, const double *promodec, const double *parallax, const double *rv, double *ra, double *dec) {
+	for (int i = 0; i < count; i++)
+		epoch_star(epoch, epoch->observer_position, epoch->observer_velocity, promora ? promora[i] : 0, promodec ? promodec[i] : 0, parallax ? parallax[i] : 0, rv ? rv[i] : 0, ra + i, dec + i);
+}
+
+void indigo_epoch_eq2hor(const indigo_epoch *epoch, int count, const double *ra, const double *dec, double *alt, double *az) {
+	// same as equ2hor() without refraction, local horizon basis is part of epoch
+	for (int i = 0; i < count; i++) {
+		double sin_dec = sin(dec[i] * DEG2RAD), cos_dec = cos(dec[i] * DEG2RAD);
+		double sin_ra = sin(ra[i] * 15.0 * DEG2RAD), cos_ra = cos(ra[i] * 15.0 * DEG2RAD);
+		double p[3] = { cos_dec * cos_ra, cos_dec * sin_ra, sin_dec };
+		double pz = p[0] * epoch->zenith[0] + p[1] * epoch->zenith[1] + p[2] * epoch->zenith[2];
+		double pn = p[0] * epoch->north[0] + p[1] * epoch->north[1] + p[2] * epoch->north[2];
+		double pw = p[0] * epoch->west[0] + p[1] * epoch->west[1] + p[2] * epoch->west[2];
+		double proj = sqrt(pn * pn + pw * pw);
+		double azimuth = proj > 0.0 ? -atan2(pw, pn) * RAD2DEG : 0.0;
+		if (azimuth < 0.0)
+			azimuth += 360.0;
+		if (azimuth >= 360.0)
+			azimuth -= 360.0;
+		az[i] = azimuth;
+		alt[i] = 90 - atan2(proj, pz) * RAD2DEG;
 	}
 }
 
+static pthread_mutex_t epoch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static indigo_epoch cached_epoch;
+
+static void get_epoch(time_t utc, bool site, double latitude, double longitude, double elevation, indigo_epoch *epoch) {
+	// single object calls made within the same second share one epoch
+	pthread_mutex_lock(&epoch_mutex);
+	if (cached_epoch.utc != utc || (site && (cached_epoch.latitude != latitude || cached_epoch.longitude != longitude || cached_epoch.elevation != elevation)))
+		indigo_init_epoch(&cached_epoch, utc, latitude, longitude, elevation);
+	*epoch = cached_epoch;
+	pthread_mutex_unlock(&epoch_mutex);
+}
+
+void indigo_eq2hor(time_t *utc, double latitude, double longitude, double elevation, double ra, double dec, double *alt, double *az) {
+	indigo_epoch epoch;
+	get_epoch(utc ? *utc : time(NULL), true, latitude, longitude, elevation, &epoch);
+	indigo_epoch_eq2hor(&epoch, 1, &ra, &dec, alt, az);
+}
+
+void indigo_app_star(double promora, double promodec, double parallax, double rv, double *ra, double *dec) {
+	indigo_epoch epoch;
+	get_epoch(time(NULL), false, 0, 0, 0, &epoch);
+	indigo_epoch_app_star(&epoch, promora, promodec, parallax, rv, ra, dec);
+}
+
+void indigo_topo_star(double latitude, double longitude, double elevation, double promora, double promodec, double parallax, double rv, double *ra, double *dec) {
+	indigo_epoch epoch;
+	get_epoch(time(NULL), true, latitude, longitude, elevation, &epoch);
+	indigo_epoch_topo_stars(&epoch, 1, &promora, &promodec, &parallax, &rv, ra, dec);
+}
+
 void indigo_topo_planet(double latitude, double longitude, double elevation, int id, double *ra, double *dec) {
 	cat_entry DUMMY_STAR;
 	object solarSystem;
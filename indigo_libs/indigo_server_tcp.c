@@ -43,6 +43,13 @@
 
 #ifdef INDIGO_LINUX
 #include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
 #endif
 
 #include <indigo/indigo_bus.h>
@@ -76,200 +83,722 @@ static struct resource {
 	unsigned length;
 	const char *file_name;
 	char *content_type;
+	indigo_server_resource_generator generator;
+	indigo_server_query_handler query_handler;
 	struct resource *next;
 } *resources = NULL;
 
+static pthread_mutex_t resource_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 #define BUFFER_SIZE	1024
+#define INPUT_BUFFER_SIZE	(16 * 1024)
+#define OUTPUT_BUFFER_SIZE	(4 * 1024)
+#define FILE_BUFFER_SIZE	(128 * 1024)
+#define WORKER_COUNT	4
+
+typedef enum {
+	CONNECTION_READ,
+	CONNECTION_WRITE,
+	CONNECTION_UPGRADE,
+	CONNECTION_CLOSE
+} connection_state;
+
+typedef struct http_connection {
+	int socket;
+	char protocol;
+	bool keep_alive;
+	bool upgrade;
+	bool deflate;
+	char request[BUFFER_SIZE];
+	char input[INPUT_BUFFER_SIZE];
+	int input_length;
+	char output[OUTPUT_BUFFER_SIZE];
+	int output_length, output_offset;
+	long content_length;
+	const char *body;
+	long body_length, body_offset;
+	void *body_buffer;
+	void *blob;
+	int file;
+	bool file_owned;
+	off_t file_offset;
+	long file_remaining;
+	double start_time;
+	char *file_buffer;
+	long file_buffer_length, file_buffer_offset;
+	struct http_connection *next;
+} http_connection;
+
+static pthread_mutex_t client_count_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void update_client_count(int delta) {
+	pthread_mutex_lock(&client_count_mutex);
+	client_count += delta;
+	server_callback(client_count);
+	pthread_mutex_unlock(&client_count_mutex);
+}
+
+static void run_protocol_adapter(int socket, char protocol, bool deflate) {
+	if (protocol == '<') {
+		INDIGO_LOG(indigo_log("Protocol switched to XML"));
+		indigo_client *protocol_adapter = indigo_xml_device_adapter(socket, socket);
+		assert(protocol_adapter != NULL);
+		indigo_attach_client(protocol_adapter);
+		indigo_xml_parse(NULL, protocol_adapter);
+		indigo_detach_client(protocol_adapter);
+		indigo_release_xml_device_adapter(protocol_adapter);
+	} else if (protocol == '{') {
+		INDIGO_LOG(indigo_log("Protocol switched to JSON"));
+		indigo_client *protocol_adapter = indigo_json_device_adapter(socket, socket, false);
+		assert(protocol_adapter != NULL);
+		indigo_attach_client(protocol_adapter);
+		indigo_json_parse(NULL, protocol_adapter);
+		indigo_detach_client(protocol_adapter);
+		indigo_release_json_device_adapter(protocol_adapter);
+	} else {
+		INDIGO_LOG(indigo_log("Protocol switched to JSON-over-WebSockets%s", deflate ? " (compressed)" : ""));
+		indigo_client *protocol_adapter = indigo_json_device_adapter(socket, socket, true);
+		assert(protocol_adapter != NULL);
+		((indigo_adapter_context *)protocol_adapter->client_context)->web_socket_deflate = deflate;
+		indigo_attach_client(protocol_adapter);
+		indigo_json_parse(NULL, protocol_adapter);
+		indigo_detach_client(protocol_adapter);
+		indigo_release_json_device_adapter(protocol_adapter);
+	}
+}
+
+static http_connection *create_connection(int socket) {
+	http_connection *connection = malloc(sizeof(http_connection));
+	assert(connection != NULL);
+	memset(connection, 0, sizeof(http_connection));
+	connection->socket = socket;
+	connection->file = -1;
+	return connection;
+}
+
+static double current_time() {
+	struct timeval time;
+	gettimeofday(&time, NULL);
+	return time.tv_sec + time.tv_usec / 1e6;
+}
+
+static void finish_response(http_connection *connection) {
+	if (connection->blob) {
+		indigo_release_blob_buffer(connection->blob);
+		connection->blob = NULL;
+	}
+	if (connection->file >= 0) {
+		if (connection->file_owned)
+			close(connection->file);
+		connection->file = -1;
+	}
+	if (connection->body_buffer) {
+		free(connection->body_buffer);
+		connection->body_buffer = NULL;
+	}
+	connection->body = NULL;
+	connection->output_length = connection->output_offset = 0;
+	connection->content_length = connection->body_length = connection->body_offset = 0;
+	connection->file_offset = connection->file_remaining = connection->file_buffer_length = connection->file_buffer_offset = 0;
+}
+
+static void release_connection(http_connection *connection) {
+	finish_response(connection);
+	if (connection->file_buffer)
+		free(connection->file_buffer);
+	free(connection);
+}
+
+static void response_printf(http_connection *connection, const char *format, ...) {
+	char *line = connection->output + connection->output_length;
+	int available = OUTPUT_BUFFER_SIZE - connection->output_length;
+	va_list args;
+	va_start(args, format);
+	int length = vsnprintf(line, available, format, args);
+	va_end(args);
+	if (length >= available)
+		length = available - 1;
+	if (length > 0) {
+		connection->output_length += length;
+		INDIGO_TRACE_PROTOCOL(indigo_trace("%d ← %s", connection->socket, line));
+	}
+}
+
+static long send_buffer(http_connection *connection, const char *buffer, long length) {
+	while (true) {
+		long bytes_written = send(connection->socket, buffer, length, MSG_NOSIGNAL);
+		if (bytes_written >= 0)
+			return bytes_written;
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return 0;
+		INDIGO_LOG(indigo_log("%s -> Failed (%s)", connection->request, strerror(errno)));
+		return -1;
+	}
+}
+
+static bool is_response_pending(http_connection *connection) {
+	return connection->output_length > 0 || connection->body != NULL || connection->file >= 0;
+}
+
+static connection_state flush_response(http_connection *connection) {
+	while (connection->output_offset < connection->output_length) {
+		long bytes_written = send_buffer(connection, connection->output + connection->output_offset, connection->output_length - connection->output_offset);
+		if (bytes_written <= 0)
+			return bytes_written < 0 ? CONNECTION_CLOSE : CONNECTION_WRITE;
+		connection->output_offset += bytes_written;
+	}
+	while (connection->body_offset < connection->body_length) {
+		long bytes_written = send_buffer(connection, connection->body + connection->body_offset, connection->body_length - connection->body_offset);
+		if (bytes_written <= 0)
+			return bytes_written < 0 ? CONNECTION_CLOSE : CONNECTION_WRITE;
+		connection->body_offset += bytes_written;
+	}
+#ifdef INDIGO_LINUX
+	while (connection->file >= 0 && connection->file_remaining > 0) {
+		// file content goes from page cache to socket without copying to user space
+		long bytes_written = sendfile(connection->socket, connection->file, &connection->file_offset, connection->file_remaining);
+		if (bytes_written < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return CONNECTION_WRITE;
+			INDIGO_LOG(indigo_log("%s -> Failed (%s)", connection->request, strerror(errno)));
+			return CONNECTION_CLOSE;
+		}
+		if (bytes_written == 0) {
+			INDIGO_LOG(indigo_log("%s -> Failed to read file (unexpected end of file)", connection->request));
+			return CONNECTION_CLOSE;
+		}
+		connection->file_remaining -= bytes_written;
+	}
+#else
+	while (connection->file >= 0) {
+		if (connection->file_buffer_offset == connection->file_buffer_length) {
+			if (connection->file_remaining == 0)
+				break;
+			if (connection->file_buffer == NULL)
+				connection->file_buffer = malloc(FILE_BUFFER_SIZE);
+			long count = pread(connection->file, connection->file_buffer, connection->file_remaining < FILE_BUFFER_SIZE ? connection->file_remaining : FILE_BUFFER_SIZE, connection->file_offset);
+			if (count <= 0) {
+				INDIGO_LOG(indigo_log("%s -> Failed to read file (%s)", connection->request, strerror(errno)));
+				return CONNECTION_CLOSE;
+			}
+			connection->file_buffer_offset = 0;
+			connection->file_buffer_length = count;
+			connection->file_offset += count;
+			connection->file_remaining -= count;
+		}
+		long bytes_written = send_buffer(connection, connection->file_buffer + connection->file_buffer_offset, connection->file_buffer_length - connection->file_buffer_offset);
+		if (bytes_written <= 0)
+			return bytes_written < 0 ? CONNECTION_CLOSE : CONNECTION_WRITE;
+		connection->file_buffer_offset += bytes_written;
+	}
+#endif
+	if (connection->body != NULL || connection->file >= 0) {
+		double elapsed = current_time() - connection->start_time;
+		if (elapsed > 0)
+			INDIGO_LOG(indigo_log("%s -> OK (%ld bytes, %.1f MB/s)", connection->request, connection->content_length, connection->content_length / elapsed / 1e6));
+		else
+			INDIGO_LOG(indigo_log("%s -> OK (%ld bytes)", connection->request, connection->content_length));
+	}
+	finish_response(connection);
+	if (connection->upgrade)
+		return CONNECTION_UPGRADE;
+	return connection->keep_alive ? CONNECTION_READ : CONNECTION_CLOSE;
+}
+
+static int request_length(const char *buffer, int length) {
+	int line_length = 0;
+	for (int i = 0; i < length; i++) {
+		if (buffer[i] == '\n') {
+			if (line_length == 0)
+				return i + 1;
+			line_length = 0;
+		} else if (buffer[i] != '\r') {
+			line_length++;
+		}
+	}
+	return -1;
+}
+
+static char *next_line(char **cursor) {
+	char *line = *cursor;
+	char *end = strchr(line, '\n');
+	*end = 0;
+	*cursor = end + 1;
+	if (end > line && end[-1] == '\r')
+		end[-1] = 0;
+	return line;
+}
+
+static int parse_range(const char *range, long length, long *start, long *end) {
+	// only single "first-last", "first-" or "-suffix" range is supported, others are ignored
+	char *tail;
+	if (*range == 0 || strchr(range, ','))
+		return 0;
+	if (*range == '-') {
+		long suffix = strtol(range + 1, &tail, 10);
+		if (tail == range + 1 || *tail)
+			return 0;
+		if (suffix <= 0 || length == 0)
+			return -1;
+		*start = suffix > length ? 0 : length - suffix;
+		*end = length - 1;
+		return 1;
+	}
+	long first = strtol(range, &tail, 10);
+	if (tail == range || *tail != '-' || first < 0)
+		return 0;
+	long last = length - 1;
+	if (tail[1]) {
+		char *last_tail;
+		last = strtol(tail + 1, &last_tail, 10);
+		if (*last_tail || last < first)
+			return 0;
+		if (last >= length)
+			last = length - 1;
+	}
+	if (first >= length)
+		return -1;
+	*start = first;
+	*end = last;
+	return 1;
+}
+
+static bool generate_resource(struct resource *resource) {
+	pthread_mutex_lock(&resource_mutex);
+	if (resource->data == NULL) {
+		unsigned length = 0;
+		unsigned char *data = resource->generator(&length);
+		if (data) {
+			resource->length = length;
+			resource->data = data;
+			INDIGO_LOG(indigo_log("Resource %s (%d, %s) generated", resource->path, length, resource->content_type));
+		}
+	}
+	bool result = resource->data != NULL;
+	pthread_mutex_unlock(&resource_mutex);
+	return result;
+}
+
+static bool content_header(http_connection *connection, const char *range, long length, long *offset) {
+	long start = 0, end = length - 1;
+	int result = parse_range(range, length, &start, &end);
+	if (result < 0) {
+		response_printf(connection, "HTTP/1.1 416 Range Not Satisfiable\r\n");
+		response_printf(connection, "Server: INDIGO/%d.%d-%d\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
+		response_printf(connection, "Content-Range: bytes */%ld\r\n", length);
+		response_printf(connection, "Content-Length: 0\r\n");
+		response_printf(connection, "\r\n");
+		INDIGO_LOG(indigo_log("%s -> Failed (invalid range %s)", connection->request, range));
+		connection->keep_alive = false;
+		return false;
+	}
+	response_printf(connection, result ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n");
+	response_printf(connection, "Server: INDIGO/%d.%d-%d\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
+	response_printf(connection, "Accept-Ranges: bytes\r\n");
+	if (result)
+		response_printf(connection, "Content-Range: bytes %ld-%ld/%ld\r\n", start, end, length);
+	connection->content_length = end - start + 1;
+	connection->start_time = current_time();
+	*offset = start;
+	return true;
+}
+
+static bool prepare_response(http_connection *connection, char *buffer, int length) {
+	char *cursor = buffer;
+	char *request = next_line(&cursor);
+	INDIGO_TRACE_PROTOCOL(indigo_trace("%d → %s", connection->socket, request));
+	if (strncmp(request, "GET /", 5))
+		return false;
+	strncpy(connection->request, request, BUFFER_SIZE - 1);
+	char *path = request + 4;
+	char *space = strchr(path, ' ');
+	if (space)
+		*space = 0;
+	char *param = strchr(path, '?');
+	if (param)
+		*param++ = 0;
+	char websocket_key[256] = "";
+	char websocket_extensions[256] = "";
+	char range[64] = "";
+	bool keep_alive = false;
+	long offset = 0;
+	while (cursor < buffer + length) {
+		char *header = next_line(&cursor);
+		INDIGO_TRACE_PROTOCOL(indigo_trace("%d → %s", connection->socket, header));
+		if (!strncasecmp(header, "Sec-WebSocket-Key: ", 19))
+			strncpy(websocket_key, header + 19, sizeof(websocket_key) - 64);
+		if (!strncasecmp(header, "Sec-WebSocket-Extensions: ", 26))
+			strncpy(websocket_extensions, header + 26, sizeof(websocket_extensions) - 1);
+		if (!strcasecmp(header, "Connection: keep-alive"))
+			keep_alive = true;
+		if (!strncasecmp(header, "Range: bytes=", 13))
+			strncpy(range, header + 13, sizeof(range) - 1);
+	}
+	connection->keep_alive = keep_alive;
+	if (!strcmp(path, "/")) {
+		if (*websocket_key) {
+			unsigned char shaHash[SHA1_SIZE];
+			memset(shaHash, 0, sizeof(shaHash));
+			strcat(websocket_key, "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
+			sha1(shaHash, websocket_key, strlen(websocket_key));
+			response_printf(connection, "HTTP/1.1 101 Switching Protocols\r\n");
+			response_printf(connection, "Server: INDIGO/%d.%d-%d\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
+			response_printf(connection, "Upgrade: websocket\r\n");
+			response_printf(connection, "Connection: upgrade\r\n");
+			base64_encode((unsigned char *)websocket_key, shaHash, 20);
+			response_printf(connection, "Sec-WebSocket-Accept: %s\r\n", websocket_key);
+			// offers restricting server side compression context are declined, uncompressed connection is always valid
+			if (strstr(websocket_extensions, "permessage-deflate") && !strstr(websocket_extensions, "server_no_context_takeover") && !strstr(websocket_extensions, "server_max_window_bits")) {
+				response_printf(connection, "Sec-WebSocket-Extensions: permessage-deflate; client_no_context_takeover\r\n");
+				connection->deflate = true;
+			}
+			response_printf(connection, "\r\n");
+			connection->upgrade = true;
+		} else {
+			response_printf(connection, "HTTP/1.1 301 OK\r\n");
+			response_printf(connection, "Server: INDIGO/%d.%d-%d\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
+			response_printf(connection, "Location: /mng.html\r\n");
+			response_printf(connection, "Content-type: text/html\r\n");
+			response_printf(connection, "\r\n");
+			response_printf(connection, "<a href='/mng.html'>INDIGO Server Manager</a>");
+		}
+		connection->keep_alive = false;
+	} else if (!strncmp(path, "/blob/", 6)) {
+		indigo_item *item;
+		indigo_blob_entry entry;
+		if (sscanf(path, "/blob/%p.", &item) && indigo_retain_blob(item, &entry)) {
+			connection->blob = entry.content;
+			if (content_header(connection, range, entry.size, &offset)) {
+				if (!strcmp(entry.format, ".jpeg")) {
+					response_printf(connection, "Content-Type: image/jpeg\r\n");
+				} else {
+					response_printf(connection, "Content-Type: application/octet-stream\r\n");
+					response_printf(connection, "Content-Disposition: attachment; filename=\"%p%s\"\r\n", item, entry.format);
+				}
+				if (keep_alive)
+					response_printf(connection, "Connection: keep-alive\r\n");
+				response_printf(connection, "Content-Length: %ld\r\n", connection->content_length);
+				response_printf(connection, "\r\n");
+				long buffer_offset;
+				int handle = indigo_blob_buffer_handle(entry.content, &buffer_offset);
+				if (handle >= 0) {
+					// retained buffer keeps handle open
+					connection->file = handle;
+					connection->file_owned = false;
+					connection->file_offset = buffer_offset + offset;
+					connection->file_remaining = connection->content_length;
+				} else {
+					connection->body = (const char *)entry.content + offset;
+					connection->body_length = connection->content_length;
+				}
+			}
+		} else {
+			response_printf(connection, "HTTP/1.1 404 Not found\r\n");
+			response_printf(connection, "Content-Type: text/plain\r\n");
+			response_printf(connection, "\r\n");
+			response_printf(connection, "BLOB not found!\r\n");
+			INDIGO_LOG(indigo_log("%s -> Failed", connection->request));
+			connection->keep_alive = false;
+		}
+	} else {
+		struct resource *resource = resources;
+		while (resource != NULL && strcmp(resource->path, path))
+			resource = resource->next;
+		if (resource == NULL) {
+			response_printf(connection, "HTTP/1.1 404 Not found\r\n");
+			response_printf(connection, "Content-Type: text/plain\r\n");
+			response_printf(connection, "\r\n");
+			response_printf(connection, "%s not found!\r\n", path);
+			INDIGO_LOG(indigo_log("%s -> Failed", connection->request));
+			connection->keep_alive = false;
+		} else if (resource->query_handler) {
+			unsigned length = 0;
+			unsigned char *data = resource->query_handler(param ? param : "", &length);
+			if (data == NULL) {
+				response_printf(connection, "HTTP/1.1 400 Bad Request\r\n");
+				response_printf(connection, "Content-Type: text/plain\r\n");
+				response_printf(connection, "\r\n");
+				response_printf(connection, "Invalid query for %s!\r\n", path);
+				INDIGO_LOG(indigo_log("%s -> Failed", connection->request));
+				connection->keep_alive = false;
+			} else if (content_header(connection, range, length, &offset)) {
+				response_printf(connection, "Content-Type: %s\r\n", resource->content_type);
+				if (keep_alive)
+					response_printf(connection, "Connection: keep-alive\r\n");
+				response_printf(connection, "Content-Length: %ld\r\n", connection->content_length);
+				response_printf(connection, "\r\n");
+				connection->body_buffer = data;
+				connection->body = (const char *)data + offset;
+				connection->body_length = connection->content_length;
+			} else {
+				free(data);
+			}
+		} else if (resource->generator && !generate_resource(resource)) {
+			response_printf(connection, "HTTP/1.1 500 Internal Server Error\r\n");
+			response_printf(connection, "Content-Type: text/plain\r\n");
+			response_printf(connection, "\r\n");
+			response_printf(connection, "%s not available!\r\n", path);
+			INDIGO_LOG(indigo_log("%s -> Failed to generate", connection->request));
+			connection->keep_alive = false;
+		} else if (resource->data) {
+			if (content_header(connection, range, resource->length, &offset)) {
+				response_printf(connection, "Content-Type: %s\r\n", resource->content_type);
+				if (keep_alive)
+					response_printf(connection, "Connection: keep-alive\r\n");
+				response_printf(connection, "Content-Length: %ld\r\n", connection->content_length);
+				response_printf(connection, "Content-Encoding: gzip\r\n");
+				response_printf(connection, "\r\n");
+				connection->body = (const char *)resource->data + offset;
+				connection->body_length = connection->content_length;
+			}
+		} else if (resource->file_name) {
+			char file_name[256];
+			struct stat file_stat;
+			int handle;
+			snprintf(file_name, sizeof(file_name), "%s/%s", getenv("HOME"), resource->file_name);
+			if (stat(file_name, &file_stat) < 0 || (handle = open(file_name, O_RDONLY)) < 0) {
+				response_printf(connection, "HTTP/1.1 404 Not found\r\n");
+				response_printf(connection, "Content-Type: text/plain\r\n");
+				response_printf(connection, "\r\n");
+				response_printf(connection, "%s not found (%s)\r\n", file_name, strerror(errno));
+				INDIGO_LOG(indigo_log("%s -> Failed to stat/open file (%s, %s)", connection->request, file_name, strerror(errno)));
+				connection->keep_alive = false;
+			} else if (content_header(connection, range, file_stat.st_size, &offset)) {
+				response_printf(connection, "Content-Type: %s\r\n", resource->content_type);
+				if (keep_alive)
+					response_printf(connection, "Connection: keep-alive\r\n");
+				response_printf(connection, "Content-Length: %ld\r\n", connection->content_length);
+				response_printf(connection, "\r\n");
+				connection->file = handle;
+				connection->file_owned = true;
+				connection->file_offset = offset;
+				connection->file_remaining = connection->content_length;
+			} else {
+				close(handle);
+			}
+		} else {
+			connection->keep_alive = false;
+		}
+	}
+	return true;
+}
+
+static connection_state process_input(http_connection *connection) {
+	while (true) {
+		if (is_response_pending(connection)) {
+			connection_state state = flush_response(connection);
+			if (state != CONNECTION_READ)
+				return state;
+		}
+		int length = request_length(connection->input, connection->input_length);
+		if (length < 0) {
+			if (connection->input_length == INPUT_BUFFER_SIZE) {
+				INDIGO_LOG(indigo_log("Request too long"));
+				return CONNECTION_CLOSE;
+			}
+			return CONNECTION_READ;
+		}
+		char request[length + 1];
+		memcpy(request, connection->input, length);
+		request[length] = 0;
+		connection->input_length -= length;
+		memmove(connection->input, connection->input + length, connection->input_length);
+		if (!prepare_response(connection, request, length))
+			return CONNECTION_CLOSE;
+	}
+}
+
+#ifdef INDIGO_LINUX
+
+static int epoll_handle = -1;
+static int wakeup_handle = -1;
+static http_connection *connections = NULL;
+static pthread_mutex_t connections_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void close_connection(http_connection *connection) {
+	epoll_ctl(epoll_handle, EPOLL_CTL_DEL, connection->socket, NULL);
+	pthread_mutex_lock(&connections_mutex);
+	for (http_connection **link = &connections; *link; link = &(*link)->next) {
+		if (*link == connection) {
+			*link = connection->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&connections_mutex);
+	shutdown(connection->socket, SHUT_RDWR);
+	close(connection->socket);
+	release_connection(connection);
+	update_client_count(-1);
+	INDIGO_LOG(indigo_log("Connection closed"));
+}
+
+static void *protocol_worker(http_connection *connection) {
+	int socket = connection->socket;
+	char protocol = connection->protocol;
+	bool deflate = connection->deflate;
+	release_connection(connection);
+	INDIGO_LOG(indigo_log("Worker thread started socket = %d", socket));
+	run_protocol_adapter(socket, protocol, deflate);
+	shutdown(socket, SHUT_RDWR);
+	close(socket);
+	update_client_count(-1);
+	INDIGO_LOG(indigo_log("Worker thread finished"));
+	return NULL;
+}
+
+static void detach_connection(http_connection *connection) {
+	// protocol adapters use blocking I/O, so they get their own thread
+	epoll_ctl(epoll_handle, EPOLL_CTL_DEL, connection->socket, NULL);
+	pthread_mutex_lock(&connections_mutex);
+	for (http_connection **link = &connections; *link; link = &(*link)->next) {
+		if (*link == connection) {
+			*link = connection->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&connections_mutex);
+	fcntl(connection->socket, F_SETFL, fcntl(connection->socket, F_GETFL) & ~O_NONBLOCK);
+	if (!indigo_async((void *(*)(void *))&protocol_worker, connection)) {
+		indigo_error("Can't create worker thread for connection (%s)", strerror(errno));
+		shutdown(connection->socket, SHUT_RDWR);
+		close(connection->socket);
+		release_connection(connection);
+		update_client_count(-1);
+	}
+}
+
+static void handle_event(http_connection *connection, uint32_t events) {
+	connection_state state = CONNECTION_READ;
+	if (events & EPOLLERR) {
+		close_connection(connection);
+		return;
+	}
+	if (connection->protocol == 0) {
+		char c;
+		long bytes_read = recv(connection->socket, &c, 1, MSG_PEEK);
+		if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			struct epoll_event event = { EPOLLIN | EPOLLONESHOT, { .ptr = connection } };
+			epoll_ctl(epoll_handle, EPOLL_CTL_MOD, connection->socket, &event);
+			return;
+		}
+		if (bytes_read != 1) {
+			close_connection(connection);
+			return;
+		}
+		connection->protocol = c;
+		if (c == '<' || c == '{') {
+			detach_connection(connection);
+			return;
+		} else if (c != 'G') {
+			INDIGO_LOG(indigo_log("Unrecognised protocol"));
+			close_connection(connection);
+			return;
+		}
+	}
+	if (is_response_pending(connection)) {
+		state = process_input(connection);
+	} else {
+		while (connection->input_length < INPUT_BUFFER_SIZE) {
+			long bytes_read = recv(connection->socket, connection->input + connection->input_length, INPUT_BUFFER_SIZE - connection->input_length, 0);
+			if (bytes_read > 0) {
+				connection->input_length += bytes_read;
+			} else if (bytes_read < 0 && errno == EINTR) {
+				continue;
+			} else if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+				break;
+			} else {
+				state = CONNECTION_CLOSE;
+				break;
+			}
+		}
+		if (state != CONNECTION_CLOSE)
+			state = process_input(connection);
+	}
+	switch (state) {
+		case CONNECTION_READ:
+		case CONNECTION_WRITE: {
+			struct epoll_event event = { (state == CONNECTION_READ ? EPOLLIN : EPOLLOUT) | EPOLLONESHOT, { .ptr = connection } };
+			if (epoll_ctl(epoll_handle, EPOLL_CTL_MOD, connection->socket, &event) < 0)
+				close_connection(connection);
+			break;
+		}
+		case CONNECTION_UPGRADE:
+			connection->protocol = 'W';
+			detach_connection(connection);
+			break;
+		case CONNECTION_CLOSE:
+			close_connection(connection);
+			break;
+	}
+}
+
+static void *event_worker(void *data) {
+	struct epoll_event event;
+	while (true) {
+		int count = epoll_wait(epoll_handle, &event, 1, -1);
+		if (count < 0 && errno != EINTR)
+			break;
+		if (count <= 0)
+			continue;
+		if (event.data.ptr == NULL)
+			break;
+		handle_event(event.data.ptr, event.events);
+	}
+	return NULL;
+}
+
+#else
 
 static void start_worker_thread(int *client_socket) {
 	int socket = *client_socket;
 	INDIGO_LOG(indigo_log("Worker thread started socket = %d", socket));
-	server_callback(++client_count);
-	int res = 0;
 	char c;
 	if (recv(socket, &c, 1, MSG_PEEK) == 1) {
-		if (c == '<') {
-			INDIGO_LOG(indigo_log("Protocol switched to XML"));
-			indigo_client *protocol_adapter = indigo_xml_device_adapter(socket, socket);
-			assert(protocol_adapter != NULL);
-			indigo_attach_client(protocol_adapter);
-			indigo_xml_parse(NULL, protocol_adapter);
-			indigo_detach_client(protocol_adapter);
-			indigo_release_xml_device_adapter(protocol_adapter);
-		} else if (c == '{') {
-			INDIGO_LOG(indigo_log("Protocol switched to JSON"));
-			indigo_client *protocol_adapter = indigo_json_device_adapter(socket, socket, false);
-			assert(protocol_adapter != NULL);
-			indigo_attach_client(protocol_adapter);
-			indigo_json_parse(NULL, protocol_adapter);
-			indigo_detach_client(protocol_adapter);
-			indigo_release_json_device_adapter(protocol_adapter);
+		if (c == '<' || c == '{') {
+			run_protocol_adapter(socket, c, false);
 		} else if (c == 'G') {
-			char request[BUFFER_SIZE];
-			char header[BUFFER_SIZE];
-			while ((res = indigo_read_line(socket, request, BUFFER_SIZE)) >= 0) {
-				bool keep_alive = false;
-				if (!strncmp(request, "GET /", 5)) {
-					char *path = request + 4;
-					char *space = strchr(path, ' ');
-					if (space)
-						*space = 0;
-					char *param = strchr(path, '?');
-					if (param)
-						*param = 0;
-					char websocket_key[256] = "";
-					while (indigo_read_line(socket, header, BUFFER_SIZE) > 0) {
-						if (!strncasecmp(header, "Sec-WebSocket-Key: ", 19))
-							strncpy(websocket_key, header + 19, sizeof(websocket_key));
-						if (!strcasecmp(header, "Connection: keep-alive"))
-							keep_alive = true;
-					}
-					if (!strcmp(path, "/")) {
-						if (*websocket_key) {
-							unsigned char shaHash[SHA1_SIZE];
-							memset(shaHash, 0, sizeof(shaHash));
-							strcat(websocket_key, "258EAFA5-E914-47DA-95CA-C5AB0DC85B11");
-							sha1(shaHash, websocket_key, strlen(websocket_key));
-							indigo_printf(socket, "HTTP/1.1 101 Switching Protocols\r\n");
-							indigo_printf(socket, "Server: INDIGO/%d.%d-%d\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
-							indigo_printf(socket, "Upgrade: websocket\r\n");
-							indigo_printf(socket, "Connection: upgrade\r\n");
-							base64_encode((unsigned char *)websocket_key, shaHash, 20);
-							indigo_printf(socket, "Sec-WebSocket-Accept: %s\r\n", websocket_key);
-							indigo_printf(socket, "\r\n");
-							INDIGO_LOG(indigo_log("Protocol switched to JSON-over-WebSockets"));
-							indigo_client *protocol_adapter = indigo_json_device_adapter(socket, socket, true);
-							assert(protocol_adapter != NULL);
-							indigo_attach_client(protocol_adapter);
-							indigo_json_parse(NULL, protocol_adapter);
-							indigo_detach_client(protocol_adapter);
-						} else {
-							indigo_printf(socket, "HTTP/1.1 301 OK\r\n");
-							indigo_printf(socket, "Server: INDIGO/%d.%d-%d\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
-							indigo_printf(socket, "Location: /mng.html\r\n");
-							indigo_printf(socket, "Content-type: text/html\r\n");
-							indigo_printf(socket, "\r\n");
-							indigo_printf(socket, "<a href='/mng.html'>INDIGO Server Manager</a>");
-						}
-						keep_alive = false;
-					} else if (!strncmp(path, "/blob/", 6)) {
-						indigo_item *item;
-						indigo_blob_entry *entry;
-						if (sscanf(path, "/blob/%p.", &item) && (entry = indigo_validate_blob(item))) {
-							indigo_printf(socket, "HTTP/1.1 200 OK\r\n");
-							indigo_printf(socket, "Server: INDIGO/%d.%d-%d\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
-							if (!strcmp(entry->format, ".jpeg")) {
-								indigo_printf(socket, "Content-Type: image/jpeg\r\n");
-							} else {
-								indigo_printf(socket, "Content-Type: application/octet-stream\r\n");
-								indigo_printf(socket, "Content-Disposition: attachment; filename=\"%p%s\"\r\n", item, entry->format);
-							}
-							if (keep_alive)
-								indigo_printf(socket, "Connection: keep-alive\r\n");
-							indigo_printf(socket, "Content-Length: %ld\r\n", entry->size);
-							indigo_printf(socket, "\r\n");
-							pthread_mutex_lock(&entry->mutext);
-							if (indigo_write(socket, entry->content, entry->size)) {
-								INDIGO_LOG(indigo_log("%s -> OK (%ld bytes)", request, entry->size));
-							} else {
-								INDIGO_LOG(indigo_log("%s -> Failed (%s)", request, strerror(errno)));
-								keep_alive = false;
-							}
-							pthread_mutex_unlock(&entry->mutext);
-						} else {
-							indigo_printf(socket, "HTTP/1.1 404 Not found\r\n");
-							indigo_printf(socket, "Content-Type: text/plain\r\n");
-							indigo_printf(socket, "\r\n");
-							indigo_printf(socket, "BLOB not found!\r\n");
-							shutdown(socket,SHUT_RDWR);
-							indigo_usleep(ONE_SECOND_DELAY);
-							close(socket);
-							INDIGO_LOG(indigo_log("%s -> Failed", request));
-							keep_alive = false;
-						}
-					} else {
-						struct resource *resource = resources;
-						do {
-							if (!strcmp(resource->path, path))
-								break;
-						} while ((resource = resource->next) != NULL);
-						if (resource == NULL) {
-							indigo_printf(socket, "HTTP/1.1 404 Not found\r\n");
-							indigo_printf(socket, "Content-Type: text/plain\r\n");
-							indigo_printf(socket, "\r\n");
-							indigo_printf(socket, "%s not found!\r\n", path);
-							INDIGO_LOG(indigo_log("%s -> Failed", request));
-							keep_alive = false;
-						} else if (resource->data) {
-							indigo_printf(socket, "HTTP/1.1 200 OK\r\n");
-							indigo_printf(socket, "Server: INDIGO/%d.%d-%d\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
-							indigo_printf(socket, "Content-Type: %s\r\n", resource->content_type);
-							indigo_printf(socket, "Content-Length: %d\r\n", resource->length);
-							indigo_printf(socket, "Content-Encoding: gzip\r\n");
-							indigo_printf(socket, "\r\n");
-							indigo_write(socket, (const char *)resource->data, resource->length);
-							INDIGO_LOG(indigo_log("%s -> OK (%d bytes)", request, resource->length));
-						} else if (resource->file_name) {
-							char file_name[256];
-							struct stat file_stat;
-							int handle;
-							sprintf(file_name, "%s/%s", getenv("HOME"), resource->file_name);
-							if (stat(file_name, &file_stat) < 0 || (handle = open(file_name, O_RDONLY)) < 0) {
-								indigo_printf(socket, "HTTP/1.1 404 Not found\r\n");
-								indigo_printf(socket, "Content-Type: text/plain\r\n");
-								indigo_printf(socket, "\r\n");
-								indigo_printf(socket, "%s not found (%s)\r\n", file_name, strerror(errno));
-								INDIGO_LOG(indigo_log("%s -> Failed to stat/open file (%s, %s)", request, file_name, strerror(errno)));
-								keep_alive = false;
-							} else {
-								indigo_printf(socket, "HTTP/1.1 200 OK\r\n");
-								indigo_printf(socket, "Server: INDIGO/%d.%d-%d\r\n", (INDIGO_VERSION_CURRENT >> 8) & 0xFF, INDIGO_VERSION_CURRENT & 0xFF, INDIGO_BUILD);
-								indigo_printf(socket, "Content-Type: %s\r\n", resource->content_type);
-								indigo_printf(socket, "Content-Length: %d\r\n", file_stat.st_size);
-								indigo_printf(socket, "\r\n");
-								long remaining = file_stat.st_size;
-								char buffer[128 * 1024];
-								while (remaining > 0) {
-									long count = read(handle, buffer, remaining < sizeof(buffer) ? remaining : sizeof(buffer));
-									if (count < 0) {
-										INDIGO_LOG(indigo_log("%s -> Failed to read file (%s)", request, strerror(errno)));
-										break;
-									}
-									if (indigo_write(socket, buffer, count)) {
-										INDIGO_LOG(indigo_log("%s -> OK (%ld bytes)", request, count));
-									} else {
-										INDIGO_LOG(indigo_log("%s -> Failed (%s)", request, strerror(errno)));
-										keep_alive = false;
-										break;
-									}
-									remaining -= count;
-								}
-								close(handle);
-							}
-						}
-					}
-				}
-				if (!keep_alive) {
+			http_connection *connection = create_connection(socket);
+			while (true) {
+				long bytes_read = recv(socket, connection->input + connection->input_length, INPUT_BUFFER_SIZE - connection->input_length, 0);
+				if (bytes_read <= 0)
+					break;
+				connection->input_length += bytes_read;
+				connection_state state = process_input(connection);
+				if (state == CONNECTION_UPGRADE)
+					run_protocol_adapter(socket, 'W', connection->deflate);
+				if (state != CONNECTION_READ)
 					break;
-				}
 			}
+			release_connection(connection);
 		} else {
 			INDIGO_LOG(indigo_log("Unrecognised protocol"));
 		}
 	}
 	shutdown(socket, SHUT_RDWR);
-	//indigo_usleep(ONE_SECOND_DELAY); // ???
 	close(socket);
-	server_callback(--client_count);
+	update_client_count(-1);
 	free(client_socket);
 	INDIGO_LOG(indigo_log("Worker thread finished"));
 }
 
+#endif
+
 void indigo_server_shutdown() {
 	if (!shutdown_initiated) {
 		shutdown_initiated = true;
 		shutdown(server_socket, SHUT_RDWR);
 		close(server_socket);
+#ifdef INDIGO_LINUX
+		if (wakeup_handle >= 0) {
+			uint64_t value = 1;
+			if (write(wakeup_handle, &value, sizeof(value)) < 0)
+				indigo_error("Can't wake up server workers (%s)", strerror(errno));
+		}
+#endif
 	}
 }
 
@@ -285,6 +814,28 @@ void indigo_server_add_resource(const char *path, unsigned char *data, unsigned
 	INDIGO_LOG(indigo_log("Resource %s (%d, %s) added", path, length, content_type));
 }
 
+void indigo_server_add_generated_resource(const char *path, indigo_server_resource_generator generator, const char *content_type) {
+	struct resource *resource = malloc(sizeof(struct resource));
+	memset(resource, 0, sizeof(struct resource));
+	resource->path = path;
+	resource->generator = generator;
+	resource->content_type = (char *)content_type;
+	resource->next = resources;
+	resources = resource;
+	INDIGO_LOG(indigo_log("Resource %s (generated, %s) added", path, content_type));
+}
+
+void indigo_server_add_query_resource(const char *path, indigo_server_query_handler handler, const char *content_type) {
+	struct resource *resource = malloc(sizeof(struct resource));
+	memset(resource, 0, sizeof(struct resource));
+	resource->path = path;
+	resource->query_handler = handler;
+	resource->content_type = (char *)content_type;
+	resource->next = resources;
+	resources = resource;
+	INDIGO_LOG(indigo_log("Resource %s (query, %s) added", path, content_type));
+}
+
 void indigo_server_add_file_resource(const char *path, const char *file_name, const char *content_type) {
 	struct resource *resource = malloc(sizeof(struct resource));
 	memset(resource, 0, sizeof(struct resource));
@@ -305,6 +856,8 @@ void indigo_server_remove_resource(const char *path) {
 					resources = resource->next;
 				else
 					prev->next = resource->next;
+			if (resource->generator && resource->data)
+				free(resource->data);
 			free(resource);
 			INDIGO_LOG(indigo_log("Resource %s removed", path));
 			return;
@@ -320,6 +873,8 @@ void indigo_server_remove_resources() {
 		struct resource *tmp = resource;
 		resource = resource->next;
 		INDIGO_LOG(indigo_log("Resource %s removed", tmp->path));
+		if (tmp->generator && tmp->data)
+			free(tmp->data);
 		free(tmp);
 	}
 	resources = NULL;
@@ -373,19 +928,67 @@ indigo_result indigo_server_start(indigo_server_tcp_callback callback) {
 	INDIGO_LOG(indigo_log("Server started on %d", indigo_server_tcp_port));
 	server_callback(client_count);
 	signal(SIGPIPE, SIG_IGN);
+#ifdef INDIGO_LINUX
+	pthread_t workers[WORKER_COUNT];
+	epoll_handle = epoll_create1(EPOLL_CLOEXEC);
+	wakeup_handle = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (epoll_handle < 0 || wakeup_handle < 0) {
+		indigo_error("Can't create epoll (%s)", strerror(errno));
+		close(server_socket);
+		return INDIGO_CANT_START_SERVER;
+	}
+	// wakeup event is never consumed, so it releases all workers on shutdown
+	struct epoll_event wakeup_event = { EPOLLIN, { .ptr = NULL } };
+	epoll_ctl(epoll_handle, EPOLL_CTL_ADD, wakeup_handle, &wakeup_event);
+	for (int i = 0; i < WORKER_COUNT; i++) {
+		if (pthread_create(&workers[i], NULL, event_worker, NULL) != 0) {
+			indigo_error("Can't create worker thread (%s)", strerror(errno));
+			return INDIGO_CANT_START_SERVER;
+		}
+	}
+#endif
 	while (1) {
 		client_socket = accept(server_socket, (struct sockaddr *)&client_name, &name_len);
 		if (client_socket == -1) {
 			if (shutdown_initiated)
 				break;
 			indigo_error("Can't accept connection (%s)", strerror(errno));
-		} else {
-			int *pointer = malloc(sizeof(int));
-			*pointer = client_socket;
-			if (!indigo_async((void *(*)(void *))&start_worker_thread, pointer))
-				indigo_error("Can't create worker thread for connection (%s)", strerror(errno));
+			continue;
+		}
+		update_client_count(1);
+#ifdef INDIGO_LINUX
+		INDIGO_LOG(indigo_log("Connection accepted socket = %d", client_socket));
+		fcntl(client_socket, F_SETFL, fcntl(client_socket, F_GETFL) | O_NONBLOCK);
+		http_connection *connection = create_connection(client_socket);
+		pthread_mutex_lock(&connections_mutex);
+		connection->next = connections;
+		connections = connection;
+		pthread_mutex_unlock(&connections_mutex);
+		struct epoll_event event = { EPOLLIN | EPOLLONESHOT, { .ptr = connection } };
+		if (epoll_ctl(epoll_handle, EPOLL_CTL_ADD, client_socket, &event) < 0) {
+			indigo_error("Can't register connection (%s)", strerror(errno));
+			close_connection(connection);
 		}
+#else
+		int *pointer = malloc(sizeof(int));
+		*pointer = client_socket;
+		if (!indigo_async((void *(*)(void *))&start_worker_thread, pointer)) {
+			indigo_error("Can't create worker thread for connection (%s)", strerror(errno));
+			close(client_socket);
+			free(pointer);
+			update_client_count(-1);
+		}
+#endif
 	}
+#ifdef INDIGO_LINUX
+	for (int i = 0; i < WORKER_COUNT; i++)
+		pthread_join(workers[i], NULL);
+	while (connections)
+		close_connection(connections);
+	close(epoll_handle);
+	close(wakeup_handle);
+	epoll_handle = wakeup_handle = -1;
+#endif
 	shutdown_initiated = false;
 	return INDIGO_OK;
 }
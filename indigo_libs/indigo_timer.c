@@ -28,6 +28,7 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <assert.h>
 
 #include <indigo/indigo_timer.h>
 
@@ -53,110 +54,332 @@ void utc_time(struct timespec *ts) {
 
 #define NANO	1000000000L
 
+#define MAX_TIMER_THREADS		128
+#define MIN_TIMER_THREADS		2
+#define TIMER_THREAD_IDLE		30
+#define TIMER_SPAWN_DELAY		(2 * NANO / 1000)
+
+#define TIMER_FREE					0
+#define TIMER_PENDING				1
+#define TIMER_READY					2
+#define TIMER_RUNNING				3
+
 int timer_count = 0;
 indigo_timer *free_timer;
 
-pthread_mutex_t free_timer_mutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t cancel_timer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t timer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t scheduler_cond;
+static pthread_cond_t worker_cond;
+static pthread_once_t timer_once = PTHREAD_ONCE_INIT;
+
+static indigo_timer **timer_heap = NULL;
+static int timer_heap_size = 0;
+static int timer_heap_capacity = 0;
+static indigo_timer *ready_head = NULL, *ready_tail = NULL;
+static indigo_timer *running_timers = NULL;
+static int ready_count = 0;
+static int running_count = 0;
+static int thread_count = 0;
+static int idle_count = 0;
+static long executed_count = 0;
+static long long total_lag = 0;
+static long long max_lag = 0;
+
+// scheduler runs on monotonic clock, so wall clock adjustments don't shift pending timers
+
+static long long timer_now() {
+	struct timespec ts;
+#ifdef __MACH__
+	utc_time(&ts);
+#else
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+	return ts.tv_sec * NANO + ts.tv_nsec;
+}
+
+static void timer_timedwait(pthread_cond_t *cond, long long time) {
+	struct timespec end;
+	end.tv_sec = time / NANO;
+	end.tv_nsec = time % NANO;
+	pthread_cond_timedwait(cond, &timer_mutex, &end);
+}
+
+static void *scheduler_func(void *arg);
+
+static void timer_init() {
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+#ifndef __MACH__
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+#endif
+	pthread_cond_init(&scheduler_cond, &attr);
+	pthread_cond_init(&worker_cond, &attr);
+	pthread_condattr_destroy(&attr);
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, scheduler_func, NULL) == 0)
+		pthread_detach(thread);
+	else
+		indigo_error("Failed to start timer scheduler");
+}
 
-static void *timer_func(indigo_timer *timer) {
-	pthread_detach(pthread_self());
+// min-heap of pending timers ordered by due time, called with timer_mutex held
+
+static void heap_swap(int i, int j) {
+	indigo_timer *timer = timer_heap[i];
+	timer_heap[i] = timer_heap[j];
+	timer_heap[j] = timer;
+	timer_heap[i]->heap_index = i;
+	timer_heap[j]->heap_index = j;
+}
+
+static void heap_up(int i) {
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+		if (timer_heap[parent]->due <= timer_heap[i]->due)
+			break;
+		heap_swap(i, parent);
+		i = parent;
+	}
+}
+
+static void heap_down(int i) {
 	while (true) {
-		while (timer->scheduled) {
-			INDIGO_TRACE(indigo_trace("timer #%d (of %d) used for %gs", timer->timer_id, timer_count, timer->delay));
-			if (timer->delay > 0) {
-				struct timespec end;
-				utc_time(&end);
-				end.tv_sec += (int)timer->delay;
-				end.tv_nsec += NANO * (timer->delay - (int)timer->delay);
-				normalize_timespec(&end);
-				while (!timer->canceled) {
-					pthread_mutex_lock(&timer->mutex);
-					int rc = pthread_cond_timedwait(&timer->cond, &timer->mutex, &end);
-					pthread_mutex_unlock(&timer->mutex);
-					if (rc == ETIMEDOUT)
-						break;
+		int child = 2 * i + 1;
+		if (child >= timer_heap_size)
+			break;
+		if (child + 1 < timer_heap_size && timer_heap[child + 1]->due < timer_heap[child]->due)
+			child++;
+		if (timer_heap[i]->due <= timer_heap[child]->due)
+			break;
+		heap_swap(i, child);
+		i = child;
+	}
+}
+
+static void heap_push(indigo_timer *timer) {
+	if (timer_heap_size == timer_heap_capacity) {
+		timer_heap_capacity = timer_heap_capacity ? 2 * timer_heap_capacity : 64;
+		timer_heap = realloc(timer_heap, timer_heap_capacity * sizeof(indigo_timer *));
+		assert(timer_heap != NULL);
+	}
+	timer->heap_index = timer_heap_size;
+	timer_heap[timer_heap_size++] = timer;
+	heap_up(timer->heap_index);
+}
+
+static void heap_remove(indigo_timer *timer) {
+	int i = timer->heap_index;
+	timer->heap_index = -1;
+	if (--timer_heap_size > i) {
+		timer_heap[i] = timer_heap[timer_heap_size];
+		timer_heap[i]->heap_index = i;
+		heap_down(i);
+		heap_up(i);
+	}
+}
+
+static void schedule_timer(indigo_timer *timer, double delay) {
+	timer->state = TIMER_PENDING;
+	timer->due = timer_now() + (long long)(delay * NANO);
+	heap_push(timer);
+	if (timer->heap_index == 0)
+		pthread_cond_signal(&scheduler_cond);
+}
+
+static void remove_from_list(indigo_timer **list, indigo_timer *timer, bool ready) {
+	indigo_timer *previous = NULL;
+	for (indigo_timer *current = *list; current; current = current->next_ready) {
+		if (current == timer) {
+			if (previous)
+				previous->next_ready = timer->next_ready;
+			else
+				*list = timer->next_ready;
+			if (ready && ready_tail == timer)
+				ready_tail = previous;
+			break;
+		}
+		previous = current;
+	}
+	timer->next_ready = NULL;
+}
+
+static void release_timer(indigo_timer *timer) {
+	indigo_device *device = timer->device;
+	if (device != NULL) {
+		if (DEVICE_CONTEXT->timers == timer) {
+			DEVICE_CONTEXT->timers = timer->next;
+		} else {
+			indigo_timer *previous = DEVICE_CONTEXT->timers;
+			while (previous != NULL && previous->next != NULL) {
+				if (previous->next == timer) {
+					previous->next = timer->next;
+					break;
 				}
+				previous = previous->next;
 			}
+		}
+	}
+	INDIGO_TRACE(indigo_trace("timer #%d done", timer->timer_id));
+	timer->state = TIMER_FREE;
+	timer->next = free_timer;
+	free_timer = timer;
+}
 
-			timer->scheduled = false;
-			if (!timer->canceled) {
-				timer->callback(timer->device);
-			}
+static bool is_device_busy(indigo_device *device) {
+	for (indigo_timer *timer = running_timers; timer; timer = timer->next_ready)
+		if (timer->device == device)
+			return true;
+	return false;
+}
+
+static bool is_timer_runnable(indigo_timer *timer) {
+	indigo_device *device = timer->device;
+	return device == NULL || !DEVICE_CONTEXT->serialize_timers || !is_device_busy(device);
+}
+
+static indigo_timer *take_ready_timer() {
+	for (indigo_timer *timer = ready_head; timer; timer = timer->next_ready) {
+		if (is_timer_runnable(timer)) {
+			remove_from_list(&ready_head, timer, true);
+			ready_count--;
+			return timer;
 		}
+	}
+	return NULL;
+}
 
-		INDIGO_TRACE(indigo_trace("timer #%d done", timer->timer_id));
-
-		pthread_mutex_lock(&cancel_timer_mutex);
-		indigo_device *device = timer->device;
-		if (device != NULL) {
-			if (DEVICE_CONTEXT->timers == timer) {
-				DEVICE_CONTEXT->timers = timer->next;
-			} else {
-				indigo_timer *previous = DEVICE_CONTEXT->timers;
-				while (previous->next != NULL) {
-					if (previous->next == timer) {
-						previous->next = timer->next;
-						break;
+static void *worker_func(void *arg) {
+	long long idle_end = 0;
+	pthread_mutex_lock(&timer_mutex);
+	while (true) {
+		indigo_timer *timer = take_ready_timer();
+		if (timer == NULL) {
+			if (idle_end == 0)
+				idle_end = timer_now() + TIMER_THREAD_IDLE * NANO;
+			else if (timer_now() >= idle_end && thread_count > MIN_TIMER_THREADS)
+				break;
+			idle_count++;
+			timer_timedwait(&worker_cond, idle_end);
+			idle_count--;
+			continue;
+		}
+		idle_end = 0;
+		long long lag = timer_now() - timer->due;
+		executed_count++;
+		total_lag += lag;
+		if (lag > max_lag)
+			max_lag = lag;
+		timer->state = TIMER_RUNNING;
+		timer->scheduled = false;
+		timer->next_ready = running_timers;
+		running_timers = timer;
+		running_count++;
+		INDIGO_TRACE(indigo_trace("timer #%d (of %d) fired after %gs, lag %gms", timer->timer_id, timer_count, timer->delay, lag / 1e6));
+		if (!timer->canceled) {
+			indigo_device *device = timer->device;
+			indigo_timer_callback callback = timer->callback;
+			pthread_mutex_unlock(&timer_mutex);
+			callback(device);
+			pthread_mutex_lock(&timer_mutex);
+		}
+		remove_from_list(&running_timers, timer, false);
+		running_count--;
+		if (timer->scheduled && !timer->canceled)
+			schedule_timer(timer, timer->delay);
+		else
+			release_timer(timer);
+	}
+	thread_count--;
+	pthread_mutex_unlock(&timer_mutex);
+	return NULL;
+}
+
+static void *scheduler_func(void *arg) {
+	bool exhausted = false;
+	pthread_mutex_lock(&timer_mutex);
+	while (true) {
+		long long now = timer_now();
+		int moved = 0;
+		while (timer_heap_size > 0 && timer_heap[0]->due <= now) {
+			indigo_timer *timer = timer_heap[0];
+			heap_remove(timer);
+			timer->state = TIMER_READY;
+			timer->next_ready = NULL;
+			if (ready_tail)
+				ready_tail->next_ready = timer;
+			else
+				ready_head = timer;
+			ready_tail = timer;
+			ready_count++;
+			moved++;
+		}
+		while (moved-- > 0)
+			pthread_cond_signal(&worker_cond);
+		long long wake = timer_heap_size > 0 ? timer_heap[0]->due : 0;
+		// most callbacks are short, so the pool grows only if a runnable timer keeps waiting for an idle thread
+		int missing = -idle_count;
+		long long oldest = 0;
+		for (indigo_timer *timer = ready_head; timer; timer = timer->next_ready) {
+			if (is_timer_runnable(timer)) {
+				if (missing++ == -idle_count)
+					oldest = timer->due;
+			}
+		}
+		if (missing > 0) {
+			if (thread_count < MAX_TIMER_THREADS) {
+				if (thread_count < MIN_TIMER_THREADS || now - oldest >= TIMER_SPAWN_DELAY) {
+					pthread_t thread;
+					if (pthread_create(&thread, NULL, worker_func, NULL) == 0) {
+						pthread_detach(thread);
+						thread_count++;
+					} else {
+						indigo_error("Failed to start timer thread");
 					}
-					previous = previous->next;
 				}
+				if (wake == 0 || now + TIMER_SPAWN_DELAY < wake)
+					wake = now + TIMER_SPAWN_DELAY;
+			} else if (!exhausted) {
+				INDIGO_DEBUG(indigo_debug("All %d timer threads are busy, %d timers delayed", MAX_TIMER_THREADS, ready_count));
+				exhausted = true;
 			}
+		} else {
+			exhausted = false;
 		}
-		pthread_mutex_unlock(&cancel_timer_mutex);
-
-		pthread_mutex_lock(&free_timer_mutex);
-		timer->next = free_timer;
-		free_timer = timer;
-		timer->wake = false;
-		pthread_mutex_unlock(&free_timer_mutex);
-
-		pthread_mutex_lock(&timer->mutex);
-		while (!timer->wake)
-			 pthread_cond_wait(&timer->cond, &timer->mutex);
-		pthread_mutex_unlock(&timer->mutex);
+		if (wake)
+			timer_timedwait(&scheduler_cond, wake);
+		else
+			pthread_cond_wait(&scheduler_cond, &timer_mutex);
 	}
+	pthread_mutex_unlock(&timer_mutex);
 	return NULL;
 }
 
 indigo_timer *indigo_set_timer(indigo_device *device, double delay, indigo_timer_callback callback) {
+	pthread_once(&timer_once, timer_init);
 	indigo_timer *timer = NULL;
-	pthread_mutex_lock(&free_timer_mutex);
+	pthread_mutex_lock(&timer_mutex);
 	if (free_timer != NULL) {
 		timer = free_timer;
 		free_timer = free_timer->next;
-		timer->wake = true;
-		timer->canceled = false;
-		timer->scheduled = true;
-		timer->delay = delay;
-		if ((timer->device = device) != NULL) {
-			timer->next = DEVICE_CONTEXT->timers;
-			DEVICE_CONTEXT->timers = timer;
-		} else {
-			timer->next = NULL;
-		}
-		timer->callback = callback;
-		pthread_mutex_lock(&timer->mutex);
-		pthread_cond_signal(&timer->cond);
-		pthread_mutex_unlock(&timer->mutex);
 	} else {
 		timer = malloc(sizeof(indigo_timer));
+		assert(timer != NULL);
 		timer->timer_id = timer_count++;
-		pthread_mutex_init(&timer->mutex, NULL);
-		pthread_cond_init(&timer->cond, NULL);
-		timer->canceled = false;
-		timer->scheduled = true;
-		if ((timer->device = device) != NULL) {
-			timer->next = DEVICE_CONTEXT->timers;
-			DEVICE_CONTEXT->timers = timer;
-		} else {
-			timer->next = NULL;
-		}
-		timer->delay = delay;
-		timer->callback = callback;
-		pthread_create(&timer->thread, NULL, (void * (*)(void*))timer_func, timer);
 	}
-	pthread_mutex_unlock(&free_timer_mutex);
+	timer->canceled = false;
+	timer->scheduled = true;
+	timer->delay = delay;
+	timer->callback = callback;
+	timer->heap_index = -1;
+	timer->next_ready = NULL;
+	if ((timer->device = device) != NULL) {
+		timer->next = DEVICE_CONTEXT->timers;
+		DEVICE_CONTEXT->timers = timer;
+	} else {
+		timer->next = NULL;
+	}
+	schedule_timer(timer, delay);
+	pthread_mutex_unlock(&timer_mutex);
 	return timer;
 }
 
@@ -164,13 +387,13 @@ indigo_timer *indigo_set_timer(indigo_device *device, double delay, indigo_timer
 
 bool indigo_reschedule_timer(indigo_device *device, double delay, indigo_timer **timer) {
 	bool result = false;
-	pthread_mutex_lock(&cancel_timer_mutex);
+	pthread_mutex_lock(&timer_mutex);
 	if (*timer != NULL) {
 		(*timer)->delay = delay;
 		(*timer)->scheduled = true;
 		result = true;
 	}
-	pthread_mutex_unlock(&cancel_timer_mutex);
+	pthread_mutex_unlock(&timer_mutex);
 	return result;
 }
 
@@ -178,32 +401,55 @@ bool indigo_reschedule_timer(indigo_device *device, double delay, indigo_timer *
 
 bool indigo_cancel_timer(indigo_device *device, indigo_timer **timer) {
 	bool result = false;
-	pthread_mutex_lock(&cancel_timer_mutex);
+	pthread_mutex_lock(&timer_mutex);
 	if (*timer != NULL) {
-		(*timer)->canceled = true;
-		(*timer)->scheduled = false;
-		pthread_mutex_lock(&(*timer)->mutex);
-		pthread_cond_signal(&(*timer)->cond);
-		pthread_mutex_unlock(&(*timer)->mutex);
+		indigo_timer *t = *timer;
+		t->canceled = true;
+		t->scheduled = false;
+		if (t->state == TIMER_PENDING) {
+			heap_remove(t);
+			release_timer(t);
+		} else if (t->state == TIMER_READY) {
+			remove_from_list(&ready_head, t, true);
+			ready_count--;
+			release_timer(t);
+		}
 		*timer = NULL;
 		result = true;
 	}
-	pthread_mutex_unlock(&cancel_timer_mutex);
+	pthread_mutex_unlock(&timer_mutex);
 	return result;
 }
 
 void indigo_cancel_all_timers(indigo_device *device) {
-	pthread_mutex_lock(&cancel_timer_mutex);
+	pthread_mutex_lock(&timer_mutex);
 	indigo_timer *timer;
 	while ((timer = DEVICE_CONTEXT->timers) != NULL) {
 		DEVICE_CONTEXT->timers = timer->next;
 		timer->device = NULL;
 		timer->next = NULL;
 		timer->canceled = true;
-		timer->scheduled = true;
-		pthread_mutex_lock(&timer->mutex);
-		pthread_cond_signal(&timer->cond);
-		pthread_mutex_unlock(&timer->mutex);
+		timer->scheduled = false;
+		if (timer->state == TIMER_PENDING) {
+			heap_remove(timer);
+			release_timer(timer);
+		} else if (timer->state == TIMER_READY) {
+			remove_from_list(&ready_head, timer, true);
+			ready_count--;
+			release_timer(timer);
+		}
 	}
-	pthread_mutex_unlock(&cancel_timer_mutex);
+	pthread_mutex_unlock(&timer_mutex);
+}
+
+void indigo_get_timer_stats(indigo_timer_stats *stats) {
+	pthread_mutex_lock(&timer_mutex);
+	stats->pending = timer_heap_size;
+	stats->ready = ready_count;
+	stats->running = running_count;
+	stats->threads = thread_count;
+	stats->executed = executed_count;
+	stats->average_lag = executed_count ? (double)total_lag / executed_count / NANO : 0;
+	stats->max_lag = (double)max_lag / NANO;
+	pthread_mutex_unlock(&timer_mutex);
 }
@@ -1207,7 +1207,7 @@ static void *top_level_handler(parser_state state, parser_context *context, char
 }
 
 void indigo_xml_parse(indigo_device *device, indigo_client *client) {
-	char *buffer = malloc(BUFFER_SIZE+3); /* BUFFER_SIZE % 4 == 0 and keep always +3 for base64 alignmet */
+	char *buffer = malloc(BUFFER_SIZE+4); /* BUFFER_SIZE % 4 == 0 and keep always +3 for base64 alignmet and +1 to accomodate \0 */
 	assert(buffer != NULL);
 	char *value_buffer = malloc(BUFFER_SIZE+1); /* +1 to accomodate \0" */
 	assert(value_buffer != NULL);
@@ -1440,7 +1440,8 @@ void indigo_xml_parse(indigo_device *device, indigo_client *client) {
 					state = TEXT1;
 					INDIGO_TRACE_PARSER(indigo_trace("XML Parser: '%c' BLOB_END -> TEXT1", c));
 				}
-				*name_pointer++ = c;
+				if (name_pointer - name_buffer < INDIGO_NAME_SIZE)
+					*name_pointer++ = c;
 				break;
 			case BLOB:
 				if (device->version >= INDIGO_VERSION_2_0) {
@@ -1464,9 +1465,12 @@ void indigo_xml_parse(indigo_device *device, indigo_client *client) {
 						bytes_needed -= count;
 						buffer_end += count;
 					}
+					*buffer_end = 0;
 					blob_pointer += base64_decode_fast((unsigned char*)blob_pointer, (unsigned char*)pointer, len);
 					pointer += len;
 					blob_len -= len;
+					// the rest of BLOB is read and decoded in BUFFER_SIZE chunks, the input buffer is consumed completely then
+					bool consumed = blob_len || pointer >= buffer_end;
 					while(blob_len) {
 						len = ((BUFFER_SIZE) < blob_len) ? (BUFFER_SIZE) : blob_len;
 						ssize_t to_read = len;
@@ -1485,10 +1489,13 @@ void indigo_xml_parse(indigo_device *device, indigo_client *client) {
 						blob_pointer += base64_decode_fast((unsigned char*)blob_pointer, (unsigned char*)buffer, len);
 						blob_len -= len;
 					}
+					// reset after the chunks, they overwrite the buffer
+					if (consumed) {
+						pointer = buffer;
+						*pointer = 0;
+					}
 
 					handler = handler(BLOB, context, NULL, (char *)blob_buffer, message);
-					pointer = buffer;
-					*pointer = 0;
 					state = BLOB_END;
 					INDIGO_TRACE_PARSER(indigo_trace("XML Parser: '%c' %d BLOB -> BLOB_END", c, depth));
 					break;
@@ -1502,17 +1509,35 @@ void indigo_xml_parse(indigo_device *device, indigo_client *client) {
 						state = TEXT1;
 						INDIGO_TRACE_PARSER(indigo_trace("XML Parser: '%c' %d BLOB -> TEXT1", c, depth));
 						break;
-					} else if (c != '\n') {
-						if (depth == 2) {
-							if (value_pointer - value_buffer < BUFFER_SIZE) {
-								*value_pointer++ = c;
-							} else {
-								*value_pointer = 0;
-								blob_pointer += base64_decode_fast((unsigned char*)blob_pointer, (unsigned char*)value_buffer, (int)(value_pointer-value_buffer));
-								value_pointer = value_buffer;
-								*value_pointer++ = c;
+					} else if (c != '\n' && depth == 2) {
+						// copy base64 lines in bulk up to the next tag, decoding whenever value buffer is full
+						char *value_end = value_buffer + BUFFER_SIZE;
+						pointer--;
+						while (pointer < buffer_end && *pointer != '<') {
+							char *line_end = memchr(pointer, '\n', buffer_end - pointer);
+							if (line_end == NULL)
+								line_end = buffer_end;
+							char *tag = memchr(pointer, '<', line_end - pointer);
+							if (tag != NULL)
+								line_end = tag;
+							while (pointer < line_end) {
+								if (value_pointer == value_end) {
+									*value_pointer = 0;
+									blob_pointer += base64_decode_fast((unsigned char*)blob_pointer, (unsigned char*)value_buffer, (int)(value_pointer-value_buffer));
+									value_pointer = value_buffer;
+								}
+								long length = line_end - pointer;
+								if (length > value_end - value_pointer)
+									length = value_end - value_pointer;
+								memcpy(value_pointer, pointer, length);
+								value_pointer += length;
+								pointer += length;
 							}
+							if (pointer < buffer_end && *pointer == '\n')
+								pointer++;
 						}
+						INDIGO_TRACE_PARSER(indigo_trace("XML Parser: %d BLOB bulk", depth));
+					} else if (c != '\n') {
 						INDIGO_TRACE_PARSER(indigo_trace("XML Parser: '%c' %d BLOB", c, depth));
 					}
 				}
@@ -1636,10 +1661,15 @@ exit_loop:
 }
 
 char *indigo_xml_escape(char *string) {
+	static char buffers[5][INDIGO_VALUE_SIZE];
+	static int	buffer_index = 0;
+	if (strpbrk(string, "%<>\"'"))
+		return indigo_xml_escape_r(string, buffers[buffer_index = (buffer_index + 1) % 5]);
+	return string;
+}
+
+char *indigo_xml_escape_r(char *string, char *buffer) {
 	if (strpbrk(string, "%<>\"'")) {
-		static char buffers[5][INDIGO_VALUE_SIZE];
-		static int	buffer_index = 0;
-		char *buffer = buffers[buffer_index = (buffer_index + 1) % 5];
 		char *in = string;
 		char *out = buffer;
 		char c;
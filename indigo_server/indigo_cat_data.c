@@ -28,6 +28,8 @@
 #include <string.h>
 #include <zlib.h>
 #include <stdarg.h>
+#include <math.h>
+#include <pthread.h>
 
 #include <indigo/indigo_server_tcp.h>
 #include <indigo/indigo_novas.h>
@@ -41288,10 +41290,293 @@ indigo_dso_entry indigo_dso_data[] = {
 	{ NULL }
 };
 
+static pthread_once_t star_index_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t apparent_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int star_count = 0;
+static int *star_hip_index = NULL;
+static double (*star_apparent)[2] = NULL;
+static double (*dso_apparent)[2] = NULL;
+static indigo_epoch apparent_epoch;
+static int star_max_mag = 6;
+static int dso_max_mag = 10;
+
+#define ZONE_COUNT	180
+#define DEG2RAD			(M_PI / 180.0)
+
+typedef struct {
+	int count;
+	int zone_start[ZONE_COUNT + 1];
+	int *entry;
+	double *ra, *dec;
+	float *mag;
+} zone_index;
+
+static pthread_once_t zone_index_once = PTHREAD_ONCE_INIT;
+static zone_index star_zones, dso_zones;
+
+typedef struct {
+	int entry;
+	int zone;
+	double ra, dec;
+	float mag;
+} zone_entry;
+
 static double h2deg(double ra) {
 	return ra > 12 ? (ra - 24) * 15 : ra * 15;
 }
 
+static int hip_compare(const void *a, const void *b) {
+	return indigo_star_data[*(const int *)a].hip - indigo_star_data[*(const int *)b].hip;
+}
+
+static void init_star_index(void) {
+	for (star_count = 0; indigo_star_data[star_count].hip; star_count++)
+		;
+	star_hip_index = malloc(star_count * sizeof(int));
+	for (int i = 0; i < star_count; i++)
+		star_hip_index[i] = i;
+	qsort(star_hip_index, star_count, sizeof(int), hip_compare);
+}
+
+indigo_star_entry *indigo_get_star_entry(int hip) {
+	pthread_once(&star_index_once, init_star_index);
+	int low = 0, high = star_count - 1;
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		int mid_hip = indigo_star_data[star_hip_index[mid]].hip;
+		if (mid_hip == hip)
+			return indigo_star_data + star_hip_index[mid];
+		if (mid_hip < hip)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+	return NULL;
+}
+
+static void star_apparent_place(indigo_star_entry *star, double *ra, double *dec) {
+	pthread_once(&star_index_once, init_star_index);
+	pthread_mutex_lock(&apparent_mutex);
+	if (star_apparent == NULL) {
+		if (dso_apparent == NULL)
+			indigo_init_epoch(&apparent_epoch, 0, 0, 0, 0);
+		star_apparent = malloc(star_count * sizeof(*star_apparent));
+		for (int i = 0; i < star_count; i++)
+			star_apparent[i][0] = NAN;
+	}
+	double *place = star_apparent[star - indigo_star_data];
+	if (isnan(place[0])) {
+		double app_ra = star->ra;
+		double app_dec = star->dec;
+		indigo_epoch_app_star(&apparent_epoch, star->promora, star->promodec, star->px, star->rv, &app_ra, &app_dec);
+		place[1] = app_dec;
+		place[0] = app_ra;
+	}
+	*ra = place[0];
+	*dec = place[1];
+	pthread_mutex_unlock(&apparent_mutex);
+}
+
+static void dso_apparent_place(indigo_dso_entry *dso, double *ra, double *dec) {
+	pthread_mutex_lock(&apparent_mutex);
+	if (dso_apparent == NULL) {
+		if (star_apparent == NULL)
+			indigo_init_epoch(&apparent_epoch, 0, 0, 0, 0);
+		int count = 0;
+		while (indigo_dso_data[count].id)
+			count++;
+		dso_apparent = malloc(count * sizeof(*dso_apparent));
+		for (int i = 0; i < count; i++)
+			dso_apparent[i][0] = NAN;
+	}
+	double *place = dso_apparent[dso - indigo_dso_data];
+	if (isnan(place[0])) {
+		double app_ra = dso->ra;
+		double app_dec = dso->dec;
+		indigo_epoch_app_star(&apparent_epoch, 0, 0, 0, 0, &app_ra, &app_dec);
+		place[1] = app_dec;
+		place[0] = app_ra;
+	}
+	*ra = place[0];
+	*dec = place[1];
+	pthread_mutex_unlock(&apparent_mutex);
+}
+
+static int zone_of(double dec) {
+	int zone = (int)floor(dec + 90);
+	return zone < 0 ? 0 : zone >= ZONE_COUNT ? ZONE_COUNT - 1 : zone;
+}
+
+static int zone_entry_compare(const void *a, const void *b) {
+	const zone_entry *entry_a = a, *entry_b = b;
+	if (entry_a->zone != entry_b->zone)
+		return entry_a->zone - entry_b->zone;
+	return entry_a->ra < entry_b->ra ? -1 : entry_a->ra > entry_b->ra ? 1 : 0;
+}
+
+static void build_zone_index(zone_index *index, zone_entry *entries, int count) {
+	qsort(entries, count, sizeof(zone_entry), zone_entry_compare);
+	index->count = count;
+	index->entry = malloc(count * sizeof(int));
+	index->ra = malloc(count * sizeof(double));
+	index->dec = malloc(count * sizeof(double));
+	index->mag = malloc(count * sizeof(float));
+	int zone = 0;
+	for (int i = 0; i < count; i++) {
+		while (zone <= entries[i].zone)
+			index->zone_start[zone++] = i;
+		index->entry[i] = entries[i].entry;
+		index->ra[i] = entries[i].ra;
+		index->dec[i] = entries[i].dec;
+		index->mag[i] = entries[i].mag;
+	}
+	while (zone <= ZONE_COUNT)
+		index->zone_start[zone++] = count;
+}
+
+static void init_zone_index(void) {
+	int count = 0;
+	while (indigo_star_data[count].hip)
+		count++;
+	zone_entry *entries = malloc(count * sizeof(zone_entry));
+	for (int i = 0; i < count; i++) {
+		indigo_star_entry *star = indigo_star_data + i;
+		entries[i] = (zone_entry){ i, zone_of(star->dec), star->ra, star->dec, star->mag };
+	}
+	build_zone_index(&star_zones, entries, count);
+	free(entries);
+	count = 0;
+	while (indigo_dso_data[count].id)
+		count++;
+	entries = malloc(count * sizeof(zone_entry));
+	for (int i = 0; i < count; i++) {
+		indigo_dso_entry *dso = indigo_dso_data + i;
+		entries[i] = (zone_entry){ i, zone_of(dso->dec), dso->ra, dso->dec, dso->mag };
+	}
+	build_zone_index(&dso_zones, entries, count);
+	free(entries);
+}
+
+typedef void (*zone_visitor)(zone_index *index, int i, double cos_distance, void *context);
+
+static void visit_ra_range(zone_index *index, int zone, double ra_min, double ra_max, double dec_min, double dec_max, zone_visitor visitor, void *context, double ra, double dec, double cos_radius) {
+	int low = index->zone_start[zone], high = index->zone_start[zone + 1];
+	while (low < high) {
+		int mid = (low + high) / 2;
+		if (index->ra[mid] < ra_min)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	double sin_dec = sin(dec * DEG2RAD), cos_dec = cos(dec * DEG2RAD);
+	for (int i = low; i < index->zone_start[zone + 1] && index->ra[i] <= ra_max; i++) {
+		if (index->dec[i] < dec_min || index->dec[i] > dec_max)
+			continue;
+		double cos_distance = 1;
+		if (cos_radius > -1) {
+			double entry_dec = index->dec[i] * DEG2RAD;
+			cos_distance = sin_dec * sin(entry_dec) + cos_dec * cos(entry_dec) * cos((index->ra[i] - ra) * 15 * DEG2RAD);
+			if (cos_distance < cos_radius)
+				continue;
+		}
+		visitor(index, i, cos_distance, context);
+	}
+}
+
+static void visit_zones(zone_index *index, double ra_min, double ra_max, double dec_min, double dec_max, zone_visitor visitor, void *context, double ra, double dec, double cos_radius) {
+	pthread_once(&zone_index_once, init_zone_index);
+	int first = zone_of(dec_min), last = zone_of(dec_max);
+	for (int zone = first; zone <= last; zone++) {
+		if (ra_min <= ra_max) {
+			visit_ra_range(index, zone, ra_min, ra_max, dec_min, dec_max, visitor, context, ra, dec, cos_radius);
+		} else {
+			visit_ra_range(index, zone, ra_min, 24, dec_min, dec_max, visitor, context, ra, dec, cos_radius);
+			visit_ra_range(index, zone, 0, ra_max, dec_min, dec_max, visitor, context, ra, dec, cos_radius);
+		}
+	}
+}
+
+static void visit_cone(zone_index *index, double ra, double dec, double radius, zone_visitor visitor, void *context) {
+	double dec_min = dec - radius, dec_max = dec + radius;
+	double ra_min = 0, ra_max = 24;
+	if (dec_min > -90 && dec_max < 90 && radius < 90) {
+		double delta = asin(fmin(1, sin(radius * DEG2RAD) / cos(dec * DEG2RAD))) / DEG2RAD / 15;
+		if (delta < 12) {
+			ra_min = fmod(ra - delta + 24, 24);
+			ra_max = fmod(ra + delta, 24);
+		}
+	}
+	visit_zones(index, ra_min, ra_max, dec_min, dec_max, visitor, context, ra, dec, cos(radius * DEG2RAD));
+}
+
+typedef struct {
+	double max_mag;
+	void **result;
+	char *base;
+	size_t size;
+	int max_count;
+	int count;
+} collect_context;
+
+static void collect_visitor(zone_index *index, int i, double cos_distance, void *context) {
+	collect_context *collect = context;
+	if (index->mag[i] > collect->max_mag)
+		return;
+	if (collect->count < collect->max_count)
+		collect->result[collect->count] = collect->base + index->entry[i] * collect->size;
+	collect->count++;
+}
+
+int indigo_find_stars_in_cone(double ra, double dec, double radius, double max_mag, indigo_star_entry **stars, int max_count) {
+	collect_context context = { max_mag, (void **)stars, (char *)indigo_star_data, sizeof(indigo_star_entry), max_count, 0 };
+	visit_cone(&star_zones, ra, dec, radius, collect_visitor, &context);
+	return context.count;
+}
+
+int indigo_find_stars_in_box(double ra_min, double ra_max, double dec_min, double dec_max, double max_mag, indigo_star_entry **stars, int max_count) {
+	collect_context context = { max_mag, (void **)stars, (char *)indigo_star_data, sizeof(indigo_star_entry), max_count, 0 };
+	visit_zones(&star_zones, ra_min, ra_max, dec_min, dec_max, collect_visitor, &context, 0, 0, -2);
+	return context.count;
+}
+
+int indigo_find_dsos_in_cone(double ra, double dec, double radius, double max_mag, indigo_dso_entry **dsos, int max_count) {
+	collect_context context = { max_mag, (void **)dsos, (char *)indigo_dso_data, sizeof(indigo_dso_entry), max_count, 0 };
+	visit_cone(&dso_zones, ra, dec, radius, collect_visitor, &context);
+	return context.count;
+}
+
+int indigo_find_dsos_in_box(double ra_min, double ra_max, double dec_min, double dec_max, double max_mag, indigo_dso_entry **dsos, int max_count) {
+	collect_context context = { max_mag, (void **)dsos, (char *)indigo_dso_data, sizeof(indigo_dso_entry), max_count, 0 };
+	visit_zones(&dso_zones, ra_min, ra_max, dec_min, dec_max, collect_visitor, &context, 0, 0, -2);
+	return context.count;
+}
+
+typedef struct {
+	double max_mag;
+	double cos_distance;
+	int entry;
+} nearest_context;
+
+static void nearest_visitor(zone_index *index, int i, double cos_distance, void *context) {
+	nearest_context *nearest = context;
+	if (index->mag[i] <= nearest->max_mag && cos_distance > nearest->cos_distance) {
+		nearest->cos_distance = cos_distance;
+		nearest->entry = index->entry[i];
+	}
+}
+
+indigo_star_entry *indigo_find_nearest_star(double ra, double dec, double max_mag, double max_radius) {
+	nearest_context context = { max_mag, -2, -1 };
+	for (double radius = 1; context.entry < 0; radius *= 2) {
+		if (radius > max_radius)
+			radius = max_radius;
+		visit_cone(&star_zones, ra, dec, radius, nearest_visitor, &context);
+		if (radius == max_radius)
+			break;
+	}
+	return context.entry < 0 ? NULL : indigo_star_data + context.entry;
+}
+
 static void indigo_compress(char *name, char *buffer, unsigned size, unsigned char **data, unsigned *data_size) {
 	z_stream defstream;
 	defstream.zalloc = Z_NULL;
@@ -41313,31 +41598,40 @@ static void indigo_compress(char *name, char *buffer, unsigned size, unsigned ch
 	*data = realloc(*data, *data_size);
 }
 
-void *indigo_add_star_json_resource(int max_mag) {
+static int append_star_feature(char *buffer, char *sep, indigo_star_entry *star) {
+	double ra, dec;
+	star_apparent_place(star, &ra, &dec);
+  char desig[256] = "";
+  char *name = "";
+  if (star->name) {
+		strcpy(desig, star->name);
+    name = strrchr(desig, ',');
+    if (name) {
+      *name = 0;
+      name += 2;
+		} else {
+			name = "";
+		}
+  }
+	return sprintf(buffer, "%s{\"type\":\"Feature\",\"id\":%d,\"properties\":{\"name\": \"%s\",\"desig\":\"%s\",\"mag\": %.2f,\"con\":\"\",\"bv\":0},\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.4f,%.4f]}}", sep, star->hip, name, desig, star->mag, h2deg(ra), dec);
+}
+
+static int append_dso_feature(char *buffer, char *sep, indigo_dso_entry *dso) {
+	double ra, dec;
+	dso_apparent_place(dso, &ra, &dec);
+	return sprintf(buffer, "%s{\"type\":\"Feature\",\"id\":\"%s\",\"properties\":{\"name\": \"%s\",\"desig\": \"%s\",\"type\":\"oc\",\"mag\": %.2f},\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.4f,%.4f]}}", sep, dso->id, dso->id, dso->name, dso->mag, h2deg(ra), dec);
+}
+
+static unsigned char *generate_star_json(unsigned *length) {
 	int buffer_size = 1024 * 1024;
 	char *buffer =  malloc(buffer_size);
 	strcpy(buffer, "{\"type\":\"FeatureCollection\",\"features\": [");
 	unsigned size = (unsigned)strlen(buffer);
 	char *sep = "";
 	for (int i = 0; indigo_star_data[i].hip; i++) {
-		if (indigo_star_data[i].mag > max_mag)
+		if (indigo_star_data[i].mag > star_max_mag)
 			continue;
-		double ra = indigo_star_data[i].ra;
-		double dec = indigo_star_data[i].dec;
-		indigo_app_star(indigo_star_data[i].promora, indigo_star_data[i].promodec, indigo_star_data[i].px, indigo_star_data[i].rv, &ra, &dec);
-    char desig[256] = "";
-    char *name = "";
-    if (indigo_star_data[i].name) {
-			strcpy(desig, indigo_star_data[i].name);
-      name = strrchr(desig, ',');
-      if (name) {
-        *name = 0;
-        name += 2;
-			} else {
-				name = "";
-			}
-    }
-		size += sprintf(buffer + size, "%s{\"type\":\"Feature\",\"id\":%d,\"properties\":{\"name\": \"%s\",\"desig\":\"%s\",\"mag\": %.2f,\"con\":\"\",\"bv\":0},\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.4f,%.4f]}}", sep, indigo_star_data[i].hip, name, desig, indigo_star_data[i].mag, h2deg(indigo_star_data[i].ra = ra), indigo_star_data[i].dec = dec);
+		size += append_star_feature(buffer + size, sep, indigo_star_data + i);
 		if (buffer_size - size < 1024) {
 			buffer = realloc(buffer, buffer_size *= 2);
 		}
@@ -41348,23 +41642,25 @@ void *indigo_add_star_json_resource(int max_mag) {
 	unsigned data_size = buffer_size;
 	indigo_compress("stars.json", buffer, size, &data, &data_size);
 	free(buffer);
-	indigo_server_add_resource("/data/stars.json", data, (int)data_size, "application/json; charset=utf-8");
+	*length = data_size;
 	return data;
 }
 
-void *indigo_add_dso_json_resource(int max_mag) {
+void indigo_add_star_json_resource(int max_mag) {
+	star_max_mag = max_mag;
+	indigo_server_add_generated_resource("/data/stars.json", generate_star_json, "application/json; charset=utf-8");
+}
+
+static unsigned char *generate_dso_json(unsigned *length) {
 	int buffer_size = 1024 * 1024;
 	char *buffer =  malloc(buffer_size);
 	strcpy(buffer, "{\"type\":\"FeatureCollection\",\"features\": [");
 	unsigned size = (unsigned)strlen(buffer);
 	char *sep = "";
 	for (int i = 0; indigo_dso_data[i].id; i++) {
-		if (indigo_dso_data[i].mag > max_mag)
+		if (indigo_dso_data[i].mag > dso_max_mag)
 			continue;
-		double ra = indigo_dso_data[i].ra;
-		double dec = indigo_dso_data[i].dec;
-		indigo_app_star(0, 0, 0, 0, &ra, &dec);
-		size += sprintf(buffer + size, "%s{\"type\":\"Feature\",\"id\":\"%s\",\"properties\":{\"name\": \"%s\",\"desig\": \"%s\",\"type\":\"oc\",\"mag\": %.2f},\"geometry\":{\"type\":\"Point\",\"coordinates\":[%.4f,%.4f]}}", sep, indigo_dso_data[i].id, indigo_dso_data[i].id, indigo_dso_data[i].name, indigo_dso_data[i].mag, h2deg(indigo_dso_data[i].ra = ra), indigo_dso_data[i].dec = dec);
+		size += append_dso_feature(buffer + size, sep, indigo_dso_data + i);
 		if (buffer_size - size < 1024) {
 			buffer = realloc(buffer, buffer_size *= 2);
 		}
@@ -41373,161 +41669,245 @@ void *indigo_add_dso_json_resource(int max_mag) {
 	size += sprintf(buffer + size, "]}");
 	unsigned char *data = malloc(buffer_size);
 	unsigned data_size = buffer_size;
-	indigo_compress("stars.json", buffer, size, &data, &data_size);
+	indigo_compress("dsos.json", buffer, size, &data, &data_size);
 	free(buffer);
-	indigo_server_add_resource("/data/dsos.json", data, (int)data_size, "application/json; charset=utf-8");
+	*length = data_size;
 	return data;
 }
 
-static int add_multiline(char *buffer, ...) {
+void indigo_add_dso_json_resource(int max_mag) {
+	dso_max_mag = max_mag;
+	indigo_server_add_generated_resource("/data/dsos.json", generate_dso_json, "application/json; charset=utf-8");
+}
+
+#define QUERY_DEFAULT_LIMIT	5000
+#define QUERY_MAX_LIMIT			50000
+
+static bool query_value(const char *query, const char *key, double *value) {
+	int length = (int)strlen(key);
+	for (const char *param = query; param && *param; param = strchr(param, '&') ? strchr(param, '&') + 1 : NULL) {
+		if (!strncmp(param, key, length) && param[length] == '=') {
+			char *end;
+			*value = strtod(param + length + 1, &end);
+			return end != param + length + 1;
+		}
+	}
+	return false;
+}
+
+static int query_catalog(const char *query, bool dso, void **result, int *limit) {
+	double ra, dec, radius, ra_min, ra_max, dec_min, dec_max, mag = dso ? dso_max_mag : star_max_mag, value;
+	query_value(query, "mag", &mag);
+	*limit = QUERY_DEFAULT_LIMIT;
+	if (query_value(query, "limit", &value) && value >= 0)
+		*limit = value > QUERY_MAX_LIMIT ? QUERY_MAX_LIMIT : (int)value;
+	if (query_value(query, "ra", &ra) && query_value(query, "dec", &dec) && query_value(query, "radius", &radius)) {
+		if (dso)
+			return indigo_find_dsos_in_cone(ra, dec, radius, mag, (indigo_dso_entry **)result, *limit);
+		return indigo_find_stars_in_cone(ra, dec, radius, mag, (indigo_star_entry **)result, *limit);
+	}
+	if (query_value(query, "ra_min", &ra_min) && query_value(query, "ra_max", &ra_max) && query_value(query, "dec_min", &dec_min) && query_value(query, "dec_max", &dec_max)) {
+		if (dso)
+			return indigo_find_dsos_in_box(ra_min, ra_max, dec_min, dec_max, mag, (indigo_dso_entry **)result, *limit);
+		return indigo_find_stars_in_box(ra_min, ra_max, dec_min, dec_max, mag, (indigo_star_entry **)result, *limit);
+	}
+	return -1;
+}
+
+static unsigned char *query_json(const char *query, bool dso, unsigned *length) {
+	void **result = malloc(QUERY_MAX_LIMIT * sizeof(void *));
+	int limit;
+	int count = query_catalog(query, dso, result, &limit);
+	if (count < 0) {
+		free(result);
+		return NULL;
+	}
+	if (count > limit)
+		count = limit;
+	int buffer_size = 1024 * (count + 1);
+	char *buffer = malloc(buffer_size);
+	unsigned size = sprintf(buffer, "{\"type\":\"FeatureCollection\",\"features\": [");
+	char *sep = "";
+	for (int i = 0; i < count; i++) {
+		if (dso)
+			size += append_dso_feature(buffer + size, sep, result[i]);
+		else
+			size += append_star_feature(buffer + size, sep, result[i]);
+		sep = ",";
+	}
+	size += sprintf(buffer + size, "]}");
+	free(result);
+	*length = size;
+	return (unsigned char *)buffer;
+}
+
+static unsigned char *query_star_json(const char *query, unsigned *length) {
+	return query_json(query, false, length);
+}
+
+static unsigned char *query_dso_json(const char *query, unsigned *length) {
+	return query_json(query, true, length);
+}
+
+void indigo_add_catalog_query_resources() {
+	indigo_server_add_query_resource("/data/stars", query_star_json, "application/json; charset=utf-8");
+	indigo_server_add_query_resource("/data/dsos", query_dso_json, "application/json; charset=utf-8");
+}
+
+static int add_multiline(char *buffer, char **sep2, ...) {
 	int size = 0;
 	va_list ap;
-	va_start(ap, buffer);
+	va_start(ap, sep2);
 	char *sep = "";
-	static char *sep2 = "";
-	size += sprintf(buffer, "%s[", sep2);
-	sep2 = ",";
+	size += sprintf(buffer, "%s[", *sep2);
+	*sep2 = ",";
 	for (int hip = va_arg(ap, int); hip; hip = va_arg(ap, int)) {
-		for (int i = 0; indigo_star_data[i].hip; i++) {
-			if (indigo_star_data[i].hip == hip) {
-				size += sprintf(buffer + size, "%s[%.4f,%.4f]", sep, h2deg(indigo_star_data[i].ra), indigo_star_data[i].dec);
-				sep = ",";
-				break;
-			}
+		indigo_star_entry *star = indigo_get_star_entry(hip);
+		if (star) {
+			double ra, dec;
+			star_apparent_place(star, &ra, &dec);
+			size += sprintf(buffer + size, "%s[%.4f,%.4f]", sep, h2deg(ra), dec);
+			sep = ",";
 		}
 	}
+	va_end(ap);
 	size += sprintf(buffer + size, "]");
 	return size;
 }
 
-void *indigo_add_constellations_lines_json_resource() {
+static unsigned char *generate_constellations_lines_json(unsigned *length) {
 	int buffer_size = 1024 * 1024;
 	char *buffer =  malloc(buffer_size);
 	strcpy(buffer, "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"id\":\"Const\",\"properties\":{},\"geometry\":{\"type\":\"MultiLineString\",\"coordinates\":[");
 	unsigned size = (unsigned)strlen(buffer);
-	size += add_multiline(buffer + size, 25428, 20889, 20455, 20205, 20894, 21421, 26451, 0);
-	size += add_multiline(buffer + size, 114341, 113136, 112716, 112961, 111497, 110960, 110395, 109074, 106278, 102618, 0);
-	size += add_multiline(buffer + size, 78384, 76297, 75264, 74376, 74395, 0);
-	size += add_multiline(buffer + size, 71860, 73273, 75141, 75177, 0);
-	size += add_multiline(buffer + size, 76297, 75141, 0);
-	size += add_multiline(buffer + size, 76127, 75695, 76267, 76952, 77512, 78159, 0);
-	size += add_multiline(buffer + size, 93747, 97649, 98036, 99473, 97804, 95501, 93747, 0);
-	size += add_multiline(buffer + size, 97278, 97649, 95501, 93805, 0);
-	size += add_multiline(buffer + size, 93174, 93825, 94114, 94160, 94005, 93542, 0);
-	size += add_multiline(buffer + size, 76333, 74785, 72622, 73714, 0);
-	size += add_multiline(buffer + size, 93506, 93864, 92855, 92041, 90496, 89931, 90185, 89642, 0);
-	size += add_multiline(buffer + size, 89931, 88635, 0);
-	size += add_multiline(buffer + size, 90496, 89341, 0);
-	size += add_multiline(buffer + size, 92855, 93683, 94141, 0);
-	size += add_multiline(buffer + size, 93683, 93085, 0);
-	size += add_multiline(buffer + size, 7083, 6867, 2081, 5165, 7083, 0);
-	size += add_multiline(buffer + size, 100751, 102395, 98495, 91792, 86929, 92609, 99240, 102395, 0);
-	size += add_multiline(buffer + size, 98337, 97365, 96837, 0);
-	size += add_multiline(buffer + size, 97365, 96757, 0);
-	size += add_multiline(buffer + size, 81852, 81065, 80047, 72370, 0);
-	size += add_multiline(buffer + size, 14879, 13147, 0);
-	size += add_multiline(buffer + size, 42515, 42828, 43409, 0);
-	size += add_multiline(buffer + size, 19893, 21281, 26069, 0);
-	size += add_multiline(buffer + size, 75323, 71908, 74824, 0);
-	size += add_multiline(buffer + size, 11767, 85822, 82080, 77055, 72607, 75097, 79822, 77055, 0);
-	size += add_multiline(buffer + size, 7097, 8198, 9487, 8833, 7884, 7007, 5737, 4906, 3786, 118268, 116771, 115830, 114971, 0);
-	size += add_multiline(buffer + size, 8796, 10064, 10670, 8796, 0);
-	size += add_multiline(buffer + size, 64241, 64394, 60742, 0);
-	size += add_multiline(buffer + size, 25859, 26634, 27628, 28199, 30277, 0);
-	size += add_multiline(buffer + size, 67301, 65378, 62956, 59774, 58001, 53910, 54061, 59774, 0);
-	size += add_multiline(buffer + size, 58001, 57399, 54539, 50801, 0);
-	size += add_multiline(buffer + size, 54061, 46733, 41704, 0);
-	size += add_multiline(buffer + size, 46733, 48319, 46853, 44127, 0);
-	size += add_multiline(buffer + size, 74666, 72105, 69673, 71053, 71075, 73555, 74666, 0);
-	size += add_multiline(buffer + size, 67927, 69673, 0);
-	size += add_multiline(buffer + size, 101772, 102333, 103227, 100751, 0);
-	size += add_multiline(buffer + size, 44816, 39953, 42913, 44816, 45941, 42913, 0);
-	size += add_multiline(buffer + size, 110538, 111169, 110609, 111022, 110351, 0);
-	size += add_multiline(buffer + size, 63121, 61317, 0);
-	size += add_multiline(buffer + size, 28360, 28380, 25428, 23015, 23179, 23416, 24608, 28360, 0);
-	size += add_multiline(buffer + size, 91262, 91971, 92420, 93194, 92791, 91971, 0);
-	size += add_multiline(buffer + size, 45860, 45688, 44248, 41075, 0);
-	size += add_multiline(buffer + size, 90422, 90568, 0);
-	size += add_multiline(buffer + size, 92946, 89962, 88404, 88048, 86263, 84012, 0);
-	size += add_multiline(buffer + size, 77450, 77233, 78072, 0);
-	size += add_multiline(buffer + size, 77233, 76276, 77070, 77622, 79593, 0);
-	size += add_multiline(buffer + size, 17440, 19780, 19921, 18772, 18597, 17440, 0);
-	size += add_multiline(buffer + size, 24436, 24674, 25930, 25336, 0);
-	size += add_multiline(buffer + size, 27366, 26727, 27989, 0);
-	size += add_multiline(buffer + size, 26727, 26311, 25930, 0);
-	size += add_multiline(buffer + size, 111954, 113368, 113246, 112948, 111188, 0);
-	size += add_multiline(buffer + size, 14328, 15863, 17358, 18532, 18246, 0);
-	size += add_multiline(buffer + size, 15863, 14576, 0);
-	size += add_multiline(buffer + size, 40702, 51839, 52633, 0);
-	size += add_multiline(buffer + size, 82273, 77952, 76440, 74946, 82273, 0);
-	size += add_multiline(buffer + size, 44066, 42911, 42806, 43100, 0);
-	size += add_multiline(buffer + size, 42911, 40526, 0);
-	size += add_multiline(buffer + size, 8886, 6686, 4427, 3179, 746, 0);
-	size += add_multiline(buffer + size, 9236, 17678, 2021, 0);
-	size += add_multiline(buffer + size, 113881, 677, 1067, 113963, 0);
-	size += add_multiline(buffer + size, 107315, 109427, 112029, 112447, 113963, 113881, 112158, 0);
-	size += add_multiline(buffer + size, 45556, 48002, 45238, 50099, 52419, 51576, 50371, 45556, 41037, 30438, 0);
-	size += add_multiline(buffer + size, 53229, 51233, 0);
-	size += add_multiline(buffer + size, 100027, 100345, 101027, 102485, 102978, 104234, 105881, 106723, 107556, 106985, 105515, 104139, 100345, 0);
-	size += add_multiline(buffer + size, 9640, 5447, 3092, 677, 0);
-	size += add_multiline(buffer + size, 23522, 22783, 0);
-	size += add_multiline(buffer + size, 68895, 64962, 57936, 56343, 54682, 53740, 52943, 51069, 49841, 48356, 46390, 47431, 45336, 43813, 43109, 42313, 42402, 42799, 43234, 43109, 0);
-	size += add_multiline(buffer + size, 24305, 25985, 27288, 28103, 0);
-	size += add_multiline(buffer + size, 25985, 25606, 0);
-	size += add_multiline(buffer + size, 27654, 27072, 25606, 23685, 0);
-	size += add_multiline(buffer + size, 47908, 48455, 50335, 50583, 49583, 49669, 54879, 57632, 54872, 50583, 0);
-	size += add_multiline(buffer + size, 108085, 109111, 109908, 110997, 111043, 112122, 112623, 0);
-	size += add_multiline(buffer + size, 109268, 111043, 0);
-	size += add_multiline(buffer + size, 57380, 57757, 60129, 61941, 63090, 63608, 0);
-	size += add_multiline(buffer + size, 61941, 64238, 66249, 0);
-	size += add_multiline(buffer + size, 65474, 64238, 0);
-	size += add_multiline(buffer + size, 44382, 41312, 35228, 34473, 37504, 0);
-	size += add_multiline(buffer + size, 92175, 91117, 0);
-	size += add_multiline(buffer + size, 94779, 95853, 97165, 100453, 102488, 104732, 0);
-	size += add_multiline(buffer + size, 102098, 100453, 98110, 95947, 0);
-	size += add_multiline(buffer + size, 78820, 80112, 78265, 0);
-	size += add_multiline(buffer + size, 78401, 80112, 80763, 81266, 82396, 82514, 82729, 84143, 86228, 87073, 86670, 85927, 0);
-	size += add_multiline(buffer + size, 87808, 85112, 84380, 81833, 81126, 79992, 0);
-	size += add_multiline(buffer + size, 81833, 81693, 0);
-	size += add_multiline(buffer + size, 84380, 83207, 0);
-	size += add_multiline(buffer + size, 80170, 80816, 81693, 83207, 84379, 85693, 86974, 87933, 88794, 0);
-	size += add_multiline(buffer + size, 59316, 59803, 60965, 61359, 59316, 0);
-	size += add_multiline(buffer + size, 60718, 61084, 0);
-	size += add_multiline(buffer + size, 62434, 59747, 0);
-	size += add_multiline(buffer + size, 23875, 22109, 21444, 19587, 18543, 17378, 16537, 13701, 12770, 12843, 14146, 15474, 16611, 17651, 21393, 20535, 20042, 17797, 13847, 12486, 11407, 10602, 9007, 7588, 0);
-	size += add_multiline(buffer + size, 55705, 54682, 53740, 55282, 55705, 0);
-	size += add_multiline(buffer + size, 88048, 87108, 86742, 86032, 84345, 83000, 80883, 79593, 79882, 81377, 84012, 84970, 0);
-	size += add_multiline(buffer + size, 31681, 34088, 35550, 37826, 36850, 32246, 30343, 29655, 0);
-	size += add_multiline(buffer + size, 107089, 112405, 70638, 0);
-	size += add_multiline(buffer + size, 37279, 36188, 0);
-	size += add_multiline(buffer + size, 110130, 114996, 2484, 0);
-	size += add_multiline(buffer + size, 87585, 85819, 85670, 87833, 87585, 94376, 97433, 89937, 83895, 80331, 78527, 75458, 68756, 61281, 56211, 0);
-	size += add_multiline(buffer + size, 104987, 104858, 104521, 0);
-	size += add_multiline(buffer + size, 30324, 32349, 33977, 34444, 33856, 33579, 30122, 0);
-	size += add_multiline(buffer + size, 34444, 35904, 0);
-	size += add_multiline(buffer + size, 12706, 14135, 0);
-	size += add_multiline(buffer + size, 12828, 11484, 12706, 12387, 10826, 8645, 6537, 5364, 1562, 3419, 5364, 0);
-	size += add_multiline(buffer + size, 8645, 8102, 0);
-	size += add_multiline(buffer + size, 9884, 8903, 8832, 0);
-	size += add_multiline(buffer + size, 101421, 101769, 102281, 102532, 101958, 101769, 0);
-	size += add_multiline(buffer + size, 32768, 31685, 35264, 39429, 36377, 32768, 0);
-	size += add_multiline(buffer + size, 39757, 38835, 38170, 37229, 36917, 35264, 0);
-	size += add_multiline(buffer + size, 102422, 105199, 106032, 116727, 112724, 110991, 109492, 105199, 0);
-	size += add_multiline(buffer + size, 32607, 27530, 27321, 0);
-	size += add_multiline(buffer + size, 71683, 68702, 66657, 68002, 67472, 67464, 68933, 71352, 73334, 0);
-	size += add_multiline(buffer + size, 66657, 61932, 59196, 0);
-	size += add_multiline(buffer + size, 67464, 65109, 0);
-	size += add_multiline(buffer + size, 80582, 80000, 0);
-	size += add_multiline(buffer + size, 85727, 85267, 85258, 85792, 0);
-	size += add_multiline(buffer + size, 83153, 83081, 82363, 0);
-	size += add_multiline(buffer + size, 83081, 85258, 0);
-	size += add_multiline(buffer + size, 37447, 34769, 30867, 29651, 0);
-	size += add_multiline(buffer + size, 61585, 61199, 63613, 62322, 61585, 59929, 57363, 0);
+	char *sep = "";
+	size += add_multiline(buffer + size, &sep, 25428, 20889, 20455, 20205, 20894, 21421, 26451, 0);
+	size += add_multiline(buffer + size, &sep, 114341, 113136, 112716, 112961, 111497, 110960, 110395, 109074, 106278, 102618, 0);
+	size += add_multiline(buffer + size, &sep, 78384, 76297, 75264, 74376, 74395, 0);
+	size += add_multiline(buffer + size, &sep, 71860, 73273, 75141, 75177, 0);
+	size += add_multiline(buffer + size, &sep, 76297, 75141, 0);
+	size += add_multiline(buffer + size, &sep, 76127, 75695, 76267, 76952, 77512, 78159, 0);
+	size += add_multiline(buffer + size, &sep, 93747, 97649, 98036, 99473, 97804, 95501, 93747, 0);
+	size += add_multiline(buffer + size, &sep, 97278, 97649, 95501, 93805, 0);
+	size += add_multiline(buffer + size, &sep, 93174, 93825, 94114, 94160, 94005, 93542, 0);
+	size += add_multiline(buffer + size, &sep, 76333, 74785, 72622, 73714, 0);
+	size += add_multiline(buffer + size, &sep, 93506, 93864, 92855, 92041, 90496, 89931, 90185, 89642, 0);
+	size += add_multiline(buffer + size, &sep, 89931, 88635, 0);
+	size += add_multiline(buffer + size, &sep, 90496, 89341, 0);
+	size += add_multiline(buffer + size, &sep, 92855, 93683, 94141, 0);
+	size += add_multiline(buffer + size, &sep, 93683, 93085, 0);
+	size += add_multiline(buffer + size, &sep, 7083, 6867, 2081, 5165, 7083, 0);
+	size += add_multiline(buffer + size, &sep, 100751, 102395, 98495, 91792, 86929, 92609, 99240, 102395, 0);
+	size += add_multiline(buffer + size, &sep, 98337, 97365, 96837, 0);
+	size += add_multiline(buffer + size, &sep, 97365, 96757, 0);
+	size += add_multiline(buffer + size, &sep, 81852, 81065, 80047, 72370, 0);
+	size += add_multiline(buffer + size, &sep, 14879, 13147, 0);
+	size += add_multiline(buffer + size, &sep, 42515, 42828, 43409, 0);
+	size += add_multiline(buffer + size, &sep, 19893, 21281, 26069, 0);
+	size += add_multiline(buffer + size, &sep, 75323, 71908, 74824, 0);
+	size += add_multiline(buffer + size, &sep, 11767, 85822, 82080, 77055, 72607, 75097, 79822, 77055, 0);
+	size += add_multiline(buffer + size, &sep, 7097, 8198, 9487, 8833, 7884, 7007, 5737, 4906, 3786, 118268, 116771, 115830, 114971, 0);
+	size += add_multiline(buffer + size, &sep, 8796, 10064, 10670, 8796, 0);
+	size += add_multiline(buffer + size, &sep, 64241, 64394, 60742, 0);
+	size += add_multiline(buffer + size, &sep, 25859, 26634, 27628, 28199, 30277, 0);
+	size += add_multiline(buffer + size, &sep, 67301, 65378, 62956, 59774, 58001, 53910, 54061, 59774, 0);
+	size += add_multiline(buffer + size, &sep, 58001, 57399, 54539, 50801, 0);
+	size += add_multiline(buffer + size, &sep, 54061, 46733, 41704, 0);
+	size += add_multiline(buffer + size, &sep, 46733, 48319, 46853, 44127, 0);
+	size += add_multiline(buffer + size, &sep, 74666, 72105, 69673, 71053, 71075, 73555, 74666, 0);
+	size += add_multiline(buffer + size, &sep, 67927, 69673, 0);
+	size += add_multiline(buffer + size, &sep, 101772, 102333, 103227, 100751, 0);
+	size += add_multiline(buffer + size, &sep, 44816, 39953, 42913, 44816, 45941, 42913, 0);
+	size += add_multiline(buffer + size, &sep, 110538, 111169, 110609, 111022, 110351, 0);
+	size += add_multiline(buffer + size, &sep, 63121, 61317, 0);
+	size += add_multiline(buffer + size, &sep, 28360, 28380, 25428, 23015, 23179, 23416, 24608, 28360, 0);
+	size += add_multiline(buffer + size, &sep, 91262, 91971, 92420, 93194, 92791, 91971, 0);
+	size += add_multiline(buffer + size, &sep, 45860, 45688, 44248, 41075, 0);
+	size += add_multiline(buffer + size, &sep, 90422, 90568, 0);
+	size += add_multiline(buffer + size, &sep, 92946, 89962, 88404, 88048, 86263, 84012, 0);
+	size += add_multiline(buffer + size, &sep, 77450, 77233, 78072, 0);
+	size += add_multiline(buffer + size, &sep, 77233, 76276, 77070, 77622, 79593, 0);
+	size += add_multiline(buffer + size, &sep, 17440, 19780, 19921, 18772, 18597, 17440, 0);
+	size += add_multiline(buffer + size, &sep, 24436, 24674, 25930, 25336, 0);
+	size += add_multiline(buffer + size, &sep, 27366, 26727, 27989, 0);
+	size += add_multiline(buffer + size, &sep, 26727, 26311, 25930, 0);
+	size += add_multiline(buffer + size, &sep, 111954, 113368, 113246, 112948, 111188, 0);
+	size += add_multiline(buffer + size, &sep, 14328, 15863, 17358, 18532, 18246, 0);
+	size += add_multiline(buffer + size, &sep, 15863, 14576, 0);
+	size += add_multiline(buffer + size, &sep, 40702, 51839, 52633, 0);
+	size += add_multiline(buffer + size, &sep, 82273, 77952, 76440, 74946, 82273, 0);
+	size += add_multiline(buffer + size, &sep, 44066, 42911, 42806, 43100, 0);
+	size += add_multiline(buffer + size, &sep, 42911, 40526, 0);
+	size += add_multiline(buffer + size, &sep, 8886, 6686, 4427, 3179, 746, 0);
+	size += add_multiline(buffer + size, &sep, 9236, 17678, 2021, 0);
+	size += add_multiline(buffer + size, &sep, 113881, 677, 1067, 113963, 0);
+	size += add_multiline(buffer + size, &sep, 107315, 109427, 112029, 112447, 113963, 113881, 112158, 0);
+	size += add_multiline(buffer + size, &sep, 45556, 48002, 45238, 50099, 52419, 51576, 50371, 45556, 41037, 30438, 0);
+	size += add_multiline(buffer + size, &sep, 53229, 51233, 0);
+	size += add_multiline(buffer + size, &sep, 100027, 100345, 101027, 102485, 102978, 104234, 105881, 106723, 107556, 106985, 105515, 104139, 100345, 0);
+	size += add_multiline(buffer + size, &sep, 9640, 5447, 3092, 677, 0);
+	size += add_multiline(buffer + size, &sep, 23522, 22783, 0);
+	size += add_multiline(buffer + size, &sep, 68895, 64962, 57936, 56343, 54682, 53740, 52943, 51069, 49841, 48356, 46390, 47431, 45336, 43813, 43109, 42313, 42402, 42799, 43234, 43109, 0);
+	size += add_multiline(buffer + size, &sep, 24305, 25985, 27288, 28103, 0);
+	size += add_multiline(buffer + size, &sep, 25985, 25606, 0);
+	size += add_multiline(buffer + size, &sep, 27654, 27072, 25606, 23685, 0);
+	size += add_multiline(buffer + size, &sep, 47908, 48455, 50335, 50583, 49583, 49669, 54879, 57632, 54872, 50583, 0);
+	size += add_multiline(buffer + size, &sep, 108085, 109111, 109908, 110997, 111043, 112122, 112623, 0);
+	size += add_multiline(buffer + size, &sep, 109268, 111043, 0);
+	size += add_multiline(buffer + size, &sep, 57380, 57757, 60129, 61941, 63090, 63608, 0);
+	size += add_multiline(buffer + size, &sep, 61941, 64238, 66249, 0);
+	size += add_multiline(buffer + size, &sep, 65474, 64238, 0);
+	size += add_multiline(buffer + size, &sep, 44382, 41312, 35228, 34473, 37504, 0);
+	size += add_multiline(buffer + size, &sep, 92175, 91117, 0);
+	size += add_multiline(buffer + size, &sep, 94779, 95853, 97165, 100453, 102488, 104732, 0);
+	size += add_multiline(buffer + size, &sep, 102098, 100453, 98110, 95947, 0);
+	size += add_multiline(buffer + size, &sep, 78820, 80112, 78265, 0);
+	size += add_multiline(buffer + size, &sep, 78401, 80112, 80763, 81266, 82396, 82514, 82729, 84143, 86228, 87073, 86670, 85927, 0);
+	size += add_multiline(buffer + size, &sep, 87808, 85112, 84380, 81833, 81126, 79992, 0);
+	size += add_multiline(buffer + size, &sep, 81833, 81693, 0);
+	size += add_multiline(buffer + size, &sep, 84380, 83207, 0);
+	size += add_multiline(buffer + size, &sep, 80170, 80816, 81693, 83207, 84379, 85693, 86974, 87933, 88794, 0);
+	size += add_multiline(buffer + size, &sep, 59316, 59803, 60965, 61359, 59316, 0);
+	size += add_multiline(buffer + size, &sep, 60718, 61084, 0);
+	size += add_multiline(buffer + size, &sep, 62434, 59747, 0);
+	size += add_multiline(buffer + size, &sep, 23875, 22109, 21444, 19587, 18543, 17378, 16537, 13701, 12770, 12843, 14146, 15474, 16611, 17651, 21393, 20535, 20042, 17797, 13847, 12486, 11407, 10602, 9007, 7588, 0);
+	size += add_multiline(buffer + size, &sep, 55705, 54682, 53740, 55282, 55705, 0);
+	size += add_multiline(buffer + size, &sep, 88048, 87108, 86742, 86032, 84345, 83000, 80883, 79593, 79882, 81377, 84012, 84970, 0);
+	size += add_multiline(buffer + size, &sep, 31681, 34088, 35550, 37826, 36850, 32246, 30343, 29655, 0);
+	size += add_multiline(buffer + size, &sep, 107089, 112405, 70638, 0);
+	size += add_multiline(buffer + size, &sep, 37279, 36188, 0);
+	size += add_multiline(buffer + size, &sep, 110130, 114996, 2484, 0);
+	size += add_multiline(buffer + size, &sep, 87585, 85819, 85670, 87833, 87585, 94376, 97433, 89937, 83895, 80331, 78527, 75458, 68756, 61281, 56211, 0);
+	size += add_multiline(buffer + size, &sep, 104987, 104858, 104521, 0);
+	size += add_multiline(buffer + size, &sep, 30324, 32349, 33977, 34444, 33856, 33579, 30122, 0);
+	size += add_multiline(buffer + size, &sep, 34444, 35904, 0);
+	size += add_multiline(buffer + size, &sep, 12706, 14135, 0);
+	size += add_multiline(buffer + size, &sep, 12828, 11484, 12706, 12387, 10826, 8645, 6537, 5364, 1562, 3419, 5364, 0);
+	size += add_multiline(buffer + size, &sep, 8645, 8102, 0);
+	size += add_multiline(buffer + size, &sep, 9884, 8903, 8832, 0);
+	size += add_multiline(buffer + size, &sep, 101421, 101769, 102281, 102532, 101958, 101769, 0);
+	size += add_multiline(buffer + size, &sep, 32768, 31685, 35264, 39429, 36377, 32768, 0);
+	size += add_multiline(buffer + size, &sep, 39757, 38835, 38170, 37229, 36917, 35264, 0);
+	size += add_multiline(buffer + size, &sep, 102422, 105199, 106032, 116727, 112724, 110991, 109492, 105199, 0);
+	size += add_multiline(buffer + size, &sep, 32607, 27530, 27321, 0);
+	size += add_multiline(buffer + size, &sep, 71683, 68702, 66657, 68002, 67472, 67464, 68933, 71352, 73334, 0);
+	size += add_multiline(buffer + size, &sep, 66657, 61932, 59196, 0);
+	size += add_multiline(buffer + size, &sep, 67464, 65109, 0);
+	size += add_multiline(buffer + size, &sep, 80582, 80000, 0);
+	size += add_multiline(buffer + size, &sep, 85727, 85267, 85258, 85792, 0);
+	size += add_multiline(buffer + size, &sep, 83153, 83081, 82363, 0);
+	size += add_multiline(buffer + size, &sep, 83081, 85258, 0);
+	size += add_multiline(buffer + size, &sep, 37447, 34769, 30867, 29651, 0);
+	size += add_multiline(buffer + size, &sep, 61585, 61199, 63613, 62322, 61585, 59929, 57363, 0);
 	size += sprintf(buffer + size, "]}}]}");
 	unsigned char *data = malloc(buffer_size);
 	unsigned data_size = buffer_size;
 	indigo_compress("constellations.lines.json", buffer, size, &data, &data_size);
 	free(buffer);
-	indigo_server_add_resource("/data/constellations.lines.json", data, (int)data_size, "application/json; charset=utf-8");
+	*length = data_size;
 	return data;
 }
+
+void indigo_add_constellations_lines_json_resource() {
+	indigo_server_add_generated_resource("/data/constellations.lines.json", generate_constellations_lines_json, "application/json; charset=utf-8");
+}
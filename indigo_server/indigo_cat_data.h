@@ -44,8 +44,33 @@ typedef struct {
 extern indigo_star_entry indigo_star_data[];
 extern indigo_dso_entry indigo_dso_data[];
 
-extern void *indigo_add_star_json_resource(int max_mag);
-extern void *indigo_add_dso_json_resource(int max_mag);
-extern void *indigo_add_constellations_lines_json_resource(void);
+extern indigo_star_entry *indigo_get_star_entry(int hip);
+
+/** Find stars brighter than max_mag within radius (deg) from J2000 ra (hours) and dec (deg).
+ Stores up to max_count entries and returns the number of all matching stars.
+ */
+extern int indigo_find_stars_in_cone(double ra, double dec, double radius, double max_mag, indigo_star_entry **stars, int max_count);
+
+/** Find stars brighter than max_mag in J2000 box (ra in hours, ra_min > ra_max wraps through 0h, dec in deg).
+ Stores up to max_count entries and returns the number of all matching stars.
+ */
+extern int indigo_find_stars_in_box(double ra_min, double ra_max, double dec_min, double dec_max, double max_mag, indigo_star_entry **stars, int max_count);
+
+/** Find nearest star brighter than max_mag within max_radius (deg) from J2000 ra (hours) and dec (deg).
+ */
+extern indigo_star_entry *indigo_find_nearest_star(double ra, double dec, double max_mag, double max_radius);
+
+/** Find DSOs brighter than max_mag within radius (deg) from J2000 ra (hours) and dec (deg).
+ */
+extern int indigo_find_dsos_in_cone(double ra, double dec, double radius, double max_mag, indigo_dso_entry **dsos, int max_count);
+
+/** Find DSOs brighter than max_mag in J2000 box.
+ */
+extern int indigo_find_dsos_in_box(double ra_min, double ra_max, double dec_min, double dec_max, double max_mag, indigo_dso_entry **dsos, int max_count);
+
+extern void indigo_add_star_json_resource(int max_mag);
+extern void indigo_add_dso_json_resource(int max_mag);
+extern void indigo_add_constellations_lines_json_resource(void);
+extern void indigo_add_catalog_query_resources(void);
 
 #endif /* star_data_h */
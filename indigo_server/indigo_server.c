@@ -136,6 +136,10 @@
 #define MDNS_HTTP_TYPE      "_http._tcp"
 #define SERVER_NAME         "INDIGO Server"
 
+#define MAX_CLIENT_QUEUE_COUNTER    1e12
+#define MAX_CLIENT_QUEUE_LEVELS     32
+#define MAX_TIMER_COUNTER           1e12
+
 driver_entry_point static_drivers[] = {
 #ifdef STATIC_DRIVERS
 	indigo_agent_alignment,
@@ -246,6 +250,11 @@ static indigo_property *unload_property;
 static indigo_property *restart_property;
 static indigo_property *log_level_property;
 static indigo_property *server_features_property;
+static indigo_property *client_queues_property;
+static indigo_timer *client_queues_timer;
+static indigo_property *client_queue_levels_property;
+static indigo_property *timers_property;
+static indigo_timer *timers_timer;
 
 #ifdef RPI_MANAGEMENT
 static indigo_property *wifi_ap_property;
@@ -260,10 +269,6 @@ static pthread_mutex_t install_property_mutex = PTHREAD_MUTEX_INITIALIZER;
 static DNSServiceRef sd_http;
 static DNSServiceRef sd_indigo;
 
-static void *star_data = NULL;
-static void *dso_data = NULL;
-static void *constellation_data = NULL;
-
 #ifdef INDIGO_MACOS
 static bool runLoop = true;
 #endif
@@ -282,6 +287,22 @@ static bool runLoop = true;
 #define CTRL_PANEL_ITEM             (server_features_property->items + 1)
 #define WEB_APPS_ITEM               (server_features_property->items + 2)
 
+#define CLIENT_QUEUES_CLIENTS_ITEM    (client_queues_property->items + 0)
+#define CLIENT_QUEUES_PENDING_ITEM    (client_queues_property->items + 1)
+#define CLIENT_QUEUES_HIGH_WATER_ITEM (client_queues_property->items + 2)
+#define CLIENT_QUEUES_QUEUED_ITEM     (client_queues_property->items + 3)
+#define CLIENT_QUEUES_DELIVERED_ITEM  (client_queues_property->items + 4)
+#define CLIENT_QUEUES_COALESCED_ITEM  (client_queues_property->items + 5)
+#define CLIENT_QUEUES_STALLED_ITEM    (client_queues_property->items + 6)
+
+#define TIMERS_PENDING_ITEM           (timers_property->items + 0)
+#define TIMERS_READY_ITEM             (timers_property->items + 1)
+#define TIMERS_RUNNING_ITEM           (timers_property->items + 2)
+#define TIMERS_THREADS_ITEM           (timers_property->items + 3)
+#define TIMERS_EXECUTED_ITEM          (timers_property->items + 4)
+#define TIMERS_AVERAGE_LAG_ITEM       (timers_property->items + 5)
+#define TIMERS_MAX_LAG_ITEM           (timers_property->items + 6)
+
 static pid_t server_pid = 0;
 static bool keep_server_running = true;
 static bool use_sigkill = false;
@@ -289,6 +310,7 @@ static bool server_startup = true;
 static bool use_bonjour = true;
 static bool use_ctrl_panel = true;
 static bool use_web_apps = true;
+static bool use_timer_stats = false;
 
 #ifdef RPI_MANAGEMENT
 static bool use_rpi_management = false;
@@ -442,6 +464,68 @@ static void check_versions(indigo_device *device) {
 
 #endif
 
+static void client_queues_handler(indigo_device *device) {
+	indigo_client_queue_stats stats;
+	indigo_get_client_queue_stats(&stats);
+	CLIENT_QUEUES_CLIENTS_ITEM->number.value = stats.clients;
+	CLIENT_QUEUES_PENDING_ITEM->number.value = stats.pending;
+	CLIENT_QUEUES_HIGH_WATER_ITEM->number.value = stats.high_water_mark;
+	CLIENT_QUEUES_QUEUED_ITEM->number.value = stats.queued;
+	CLIENT_QUEUES_DELIVERED_ITEM->number.value = stats.delivered;
+	CLIENT_QUEUES_COALESCED_ITEM->number.value = stats.coalesced;
+	CLIENT_QUEUES_STALLED_ITEM->number.value = stats.stalled;
+	indigo_update_property(device, client_queues_property, NULL);
+	indigo_client_queue_info info[MAX_CLIENT_QUEUE_LEVELS];
+	int count = indigo_get_client_queue_info(info, MAX_CLIENT_QUEUE_LEVELS);
+	bool redefine = client_queue_levels_property->count != 2 * count;
+	if (redefine)
+		indigo_delete_property(device, client_queue_levels_property, NULL);
+	client_queue_levels_property->count = 2 * count;
+	for (int i = 0; i < count; i++) {
+		char name[INDIGO_NAME_SIZE], label[INDIGO_VALUE_SIZE];
+		indigo_item *item = client_queue_levels_property->items + 2 * i;
+		snprintf(name, sizeof(name), "CLIENT_%d_PENDING", i + 1);
+		snprintf(label, sizeof(label), "%s pending", info[i].name);
+		indigo_init_number_item(item, name, label, 0, MAX_CLIENT_QUEUE_COUNTER, 0, info[i].pending);
+		snprintf(name, sizeof(name), "CLIENT_%d_HIGH_WATER_MARK", i + 1);
+		snprintf(label, sizeof(label), "%s max pending", info[i].name);
+		indigo_init_number_item(item + 1, name, label, 0, MAX_CLIENT_QUEUE_COUNTER, 0, info[i].high_water_mark);
+	}
+	if (redefine)
+		indigo_define_property(device, client_queue_levels_property, NULL);
+	else
+		indigo_update_property(device, client_queue_levels_property, NULL);
+	indigo_reschedule_timer(device, 5, &client_queues_timer);
+}
+
+static void timers_handler(indigo_device *device) {
+	indigo_timer_stats stats;
+	indigo_get_timer_stats(&stats);
+	TIMERS_PENDING_ITEM->number.value = stats.pending;
+	TIMERS_READY_ITEM->number.value = stats.ready;
+	TIMERS_RUNNING_ITEM->number.value = stats.running;
+	TIMERS_THREADS_ITEM->number.value = stats.threads;
+	TIMERS_EXECUTED_ITEM->number.value = stats.executed;
+	TIMERS_AVERAGE_LAG_ITEM->number.value = stats.average_lag * 1000;
+	TIMERS_MAX_LAG_ITEM->number.value = stats.max_lag * 1000;
+	indigo_update_property(device, timers_property, NULL);
+	indigo_reschedule_timer(device, 5, &timers_timer);
+}
+
+static void show_timers(indigo_device *device, bool show) {
+	if (show == !timers_property->hidden)
+		return;
+	if (show) {
+		timers_property->hidden = false;
+		indigo_define_property(device, timers_property, NULL);
+		timers_timer = indigo_set_timer(device, 5, timers_handler);
+	} else {
+		indigo_cancel_timer(device, &timers_timer);
+		indigo_delete_property(device, timers_property, NULL);
+		timers_property->hidden = true;
+	}
+}
+
 static indigo_result attach(indigo_device *device) {
 	assert(device != NULL);
 	info_property = indigo_init_text_property(NULL, server_device.name, "INFO", MAIN_GROUP, "Server info", INDIGO_OK_STATE, INDIGO_RO_PERM, 2);
@@ -488,6 +572,28 @@ static indigo_result attach(indigo_device *device) {
 	indigo_init_switch_item(BONJOUR_ITEM, "BONJOUR", "Bonjour", use_bonjour);
 	indigo_init_switch_item(CTRL_PANEL_ITEM, "CTRL_PANEL", "Control panel / Server manager", use_ctrl_panel);
 	indigo_init_switch_item(WEB_APPS_ITEM, "WEB_APPS", "Web applications", use_web_apps);
+	client_queues_property = indigo_init_number_property(NULL, device->name, "CLIENT_QUEUES", MAIN_GROUP, "Client queues", INDIGO_OK_STATE, INDIGO_RO_PERM, 7);
+	indigo_init_number_item(CLIENT_QUEUES_CLIENTS_ITEM, "CLIENTS", "Clients", 0, MAX_CLIENT_QUEUE_COUNTER, 0, 0);
+	indigo_init_number_item(CLIENT_QUEUES_PENDING_ITEM, "PENDING", "Pending messages", 0, MAX_CLIENT_QUEUE_COUNTER, 0, 0);
+	indigo_init_number_item(CLIENT_QUEUES_HIGH_WATER_ITEM, "HIGH_WATER_MARK", "Max pending messages per client", 0, MAX_CLIENT_QUEUE_COUNTER, 0, 0);
+	indigo_init_number_item(CLIENT_QUEUES_QUEUED_ITEM, "QUEUED", "Queued messages", 0, MAX_CLIENT_QUEUE_COUNTER, 0, 0);
+	indigo_init_number_item(CLIENT_QUEUES_DELIVERED_ITEM, "DELIVERED", "Delivered messages", 0, MAX_CLIENT_QUEUE_COUNTER, 0, 0);
+	indigo_init_number_item(CLIENT_QUEUES_COALESCED_ITEM, "COALESCED", "Coalesced updates", 0, MAX_CLIENT_QUEUE_COUNTER, 0, 0);
+	indigo_init_number_item(CLIENT_QUEUES_STALLED_ITEM, "STALLED", "Full queue overflows", 0, MAX_CLIENT_QUEUE_COUNTER, 0, 0);
+	client_queues_property->hidden = !indigo_use_client_queues;
+	client_queue_levels_property = indigo_init_number_property(NULL, device->name, "CLIENT_QUEUE_LEVELS", MAIN_GROUP, "Client queue levels", INDIGO_OK_STATE, INDIGO_RO_PERM, 2 * MAX_CLIENT_QUEUE_LEVELS);
+	client_queue_levels_property->count = 0;
+	client_queue_levels_property->hidden = !indigo_use_client_queues;
+	timers_property = indigo_init_number_property(NULL, device->name, "TIMERS", MAIN_GROUP, "Timers", INDIGO_OK_STATE, INDIGO_RO_PERM, 7);
+	indigo_init_number_item(TIMERS_PENDING_ITEM, "PENDING", "Pending timers", 0, MAX_TIMER_COUNTER, 0, 0);
+	indigo_init_number_item(TIMERS_READY_ITEM, "READY", "Timers waiting for thread", 0, MAX_TIMER_COUNTER, 0, 0);
+	indigo_init_number_item(TIMERS_RUNNING_ITEM, "RUNNING", "Running callbacks", 0, MAX_TIMER_COUNTER, 0, 0);
+	indigo_init_number_item(TIMERS_THREADS_ITEM, "THREADS", "Timer threads", 0, MAX_TIMER_COUNTER, 0, 0);
+	indigo_init_number_item(TIMERS_EXECUTED_ITEM, "EXECUTED", "Executed callbacks", 0, MAX_TIMER_COUNTER, 0, 0);
+	indigo_init_number_item(TIMERS_AVERAGE_LAG_ITEM, "AVERAGE_LAG", "Average lag [ms]", 0, MAX_TIMER_COUNTER, 0, 0);
+	indigo_init_number_item(TIMERS_MAX_LAG_ITEM, "MAX_LAG", "Max lag [ms]", 0, MAX_TIMER_COUNTER, 0, 0);
+	// diagnostic only, shown with debug log level or if enabled on command line
+	timers_property->hidden = true;
 #ifdef RPI_MANAGEMENT
 	if (use_rpi_management) {
 		char *line;
@@ -540,6 +646,9 @@ static indigo_result attach(indigo_device *device) {
 	}
 	if (!command_line_drivers)
 		indigo_load_properties(device, false);
+	if (indigo_use_client_queues)
+		client_queues_timer = indigo_set_timer(device, 5, client_queues_handler);
+	show_timers(device, use_timer_stats || indigo_get_log_level() >= INDIGO_LOG_DEBUG);
 	INDIGO_LOG(indigo_log("%s attached", device->name));
 	return INDIGO_OK;
 }
@@ -555,6 +664,9 @@ static indigo_result enumerate_properties(indigo_device *device, indigo_client *
 	indigo_define_property(device, restart_property, NULL);
 	indigo_define_property(device, log_level_property, NULL);
 	indigo_define_property(device, server_features_property, NULL);
+	indigo_define_property(device, client_queues_property, NULL);
+	indigo_define_property(device, client_queue_levels_property, NULL);
+	indigo_define_property(device, timers_property, NULL);
 #ifdef RPI_MANAGEMENT
 	if (use_rpi_management) {
 		indigo_define_property(device, wifi_ap_property, NULL);
@@ -621,7 +733,7 @@ static indigo_result change_property(indigo_device *device, indigo_client *clien
 		int handle = 0;
 		if (!command_line_drivers)
 			indigo_save_property(device, &handle, drivers_property);
-		close(handle);
+		indigo_close_config_file(handle);
 		return INDIGO_OK;
 	} else if (indigo_property_match(load_property, property)) {
 		// -------------------------------------------------------------------------------- LOAD
@@ -709,6 +821,7 @@ static indigo_result change_property(indigo_device *device, indigo_client *clien
 		} else if (log_level_property->items[3].sw.value) {
 			indigo_set_log_level(INDIGO_LOG_TRACE);
 		}
+		show_timers(device, use_timer_stats || indigo_get_log_level() >= INDIGO_LOG_DEBUG);
 		log_level_property->state = INDIGO_OK_STATE;
 		indigo_update_property(device, log_level_property, NULL);
 		return INDIGO_OK;
@@ -747,6 +860,8 @@ static indigo_result change_property(indigo_device *device, indigo_client *clien
 
 static indigo_result detach(indigo_device *device) {
 	assert(device != NULL);
+	indigo_cancel_timer(device, &client_queues_timer);
+	indigo_cancel_timer(device, &timers_timer);
 	indigo_delete_property(device, info_property, NULL);
 	indigo_delete_property(device, drivers_property, NULL);
 	if (servers_property->count > 0)
@@ -756,6 +871,9 @@ static indigo_result detach(indigo_device *device) {
 	indigo_delete_property(device, restart_property, NULL);
 	indigo_delete_property(device, log_level_property, NULL);
 	indigo_delete_property(device, server_features_property, NULL);
+	indigo_delete_property(device, client_queues_property, NULL);
+	indigo_delete_property(device, client_queue_levels_property, NULL);
+	indigo_delete_property(device, timers_property, NULL);
 #ifdef RPI_MANAGEMENT
 	if (use_rpi_management) {
 		indigo_delete_property(device, wifi_ap_property, NULL);
@@ -774,6 +892,9 @@ static indigo_result detach(indigo_device *device) {
 	indigo_release_property(restart_property);
 	indigo_release_property(log_level_property);
 	indigo_release_property(server_features_property);
+	indigo_release_property(client_queues_property);
+	indigo_release_property(client_queue_levels_property);
+	indigo_release_property(timers_property);
 #ifdef RPI_MANAGEMENT
 	indigo_release_property(wifi_ap_property);
 	indigo_release_property(wifi_infrastructure_property);
@@ -889,6 +1010,10 @@ static void server_main() {
 			use_web_apps = false;
 		} else if (!strcmp(server_argv[i], "-u-") || !strcmp(server_argv[i], "--disable-blob-urls")) {
 			indigo_use_blob_urls = false;
+		} else if (!strcmp(server_argv[i], "-q") || !strcmp(server_argv[i], "--enable-client-queues")) {
+			indigo_use_client_queues = true;
+		} else if (!strcmp(server_argv[i], "-t") || !strcmp(server_argv[i], "--enable-timer-stats")) {
+			use_timer_stats = true;
 #ifdef RPI_MANAGEMENT
 		} else if (!strcmp(server_argv[i], "-f") || !strcmp(server_argv[i], "--enable-rpi-management")) {
 			FILE *output = popen("which s_rpi_ctrl.sh", "r");
@@ -1022,9 +1147,10 @@ static void server_main() {
 			#include "resource/data/planets.json.data"
 		};
 		indigo_server_add_resource("/data/planets.json", planets_json, sizeof(planets_json), "application/json; charset=utf-8");
-		star_data = indigo_add_star_json_resource(6);
-		dso_data = indigo_add_dso_json_resource(10);
-		constellation_data = indigo_add_constellations_lines_json_resource();
+		indigo_add_star_json_resource(6);
+		indigo_add_dso_json_resource(10);
+		indigo_add_constellations_lines_json_resource();
+		indigo_add_catalog_query_resources();
 		// INDIGO Guider
 		static unsigned char guider_html[] = {
 			#include "resource/guider.html.data"
@@ -1077,12 +1203,6 @@ static void server_main() {
 	indigo_detach_device(&server_device);
 	indigo_stop();
 	indigo_server_remove_resources();
-	if (star_data)
-		free(star_data);
-	if (dso_data)
-		free(dso_data);
-	if (constellation_data)
-		free(constellation_data);
 	for (int i = 0; i < INDIGO_MAX_DRIVERS; i++) {
 		if (indigo_available_drivers[i].driver) {
 			indigo_remove_driver(&indigo_available_drivers[i]);
@@ -1144,6 +1264,8 @@ int main(int argc, const char * argv[]) {
 			       "       -b  | --bonjour name                  (default: hostname)\n"
 			       "       -b- | --disable-bonjour\n"
 			       "       -u- | --disable-blob-urls\n"
+			       "       -q  | --enable-client-queues\n"
+			       "       -t  | --enable-timer-stats\n"
 			       "       -w- | --disable-web-apps\n"
 			       "       -c- | --disable-control-panel\n"
 #ifdef RPI_MANAGEMENT
@@ -22,8 +22,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <math.h>
 #if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
 #endif
 #if defined(INDIGO_WINDOWS)
 #include <windows.h>
@@ -31,6 +35,10 @@
 #endif
 #include <indigo/indigo_bus.h>
 #include <indigo/indigo_client.h>
+#include <indigo/indigo_client_xml.h>
+#include <indigo/indigo_base64.h>
+#include <indigo/indigo_guider_utils.h>
+#include <indigo/indigo_ccd_driver.h>
 
 #define CCD_SIMULATOR "CCD Imager Simulator @ indigosky"
 
@@ -128,13 +136,483 @@ static indigo_client test = {
 	test_detach
 };
 
+// Benchmarks, run with -b
+
+#define BENCHMARK_DISPATCH_COUNT	100000
+
+static long dispatched = 0;
+
+static indigo_result benchmark_change_property(indigo_device *device, indigo_client *client, indigo_property *property) {
+	dispatched++;
+	return INDIGO_OK;
+}
+
+static void dispatch_benchmark(int device_count) {
+	indigo_device *devices = calloc(device_count, sizeof(indigo_device));
+	for (int i = 0; i < device_count; i++) {
+		sprintf(devices[i].name, "Benchmark device #%d", i);
+		devices[i].version = INDIGO_VERSION_CURRENT;
+		devices[i].change_property = benchmark_change_property;
+		indigo_attach_device(devices + i);
+	}
+	indigo_property *property = indigo_init_number_property(NULL, devices[device_count / 2].name, "BENCHMARK", "Benchmark", "Benchmark", INDIGO_OK_STATE, INDIGO_RW_PERM, 1);
+	indigo_init_number_item(property->items, "VALUE", "Value", 0, 1, 0, 0);
+	dispatched = 0;
+	clock_t start = clock();
+	for (int i = 0; i < BENCHMARK_DISPATCH_COUNT; i++)
+		indigo_change_property(&test, property);
+	double time = (clock() - start) / (double)CLOCKS_PER_SEC;
+	indigo_log("dispatch with %d devices: %ld requests routed, %.0f ns per request", device_count, dispatched, time * 1e9 / BENCHMARK_DISPATCH_COUNT);
+	indigo_release_property(property);
+	for (int i = 0; i < device_count; i++)
+		indigo_detach_device(devices + i);
+	free(devices);
+}
+
+#define BENCHMARK_BASE64_SIZE	(16 * 1024 * 1024)
+#define BENCHMARK_BASE64_COUNT	10
+
+static double base64_decode_benchmark(unsigned char *out, unsigned char *in, long length) {
+	clock_t start = clock();
+	for (int i = 0; i < BENCHMARK_BASE64_COUNT; i++)
+		base64_decode_fast(out, in, length);
+	return (clock() - start) / (double)CLOCKS_PER_SEC;
+}
+
+static void base64_benchmark() {
+	unsigned char *data = malloc(BENCHMARK_BASE64_SIZE);
+	unsigned char *encoded = malloc(BENCHMARK_BASE64_SIZE / 3 * 4 + 8);
+	unsigned char *decoded = malloc(BENCHMARK_BASE64_SIZE + 3);
+	for (long i = 0; i < BENCHMARK_BASE64_SIZE; i++)
+		data[i] = rand();
+	long length = base64_encode(encoded, data, BENCHMARK_BASE64_SIZE);
+	indigo_use_base64_simd = false;
+	double scalar = base64_decode_benchmark(decoded, encoded, length);
+	bool scalar_ok = memcmp(data, decoded, BENCHMARK_BASE64_SIZE) == 0;
+	indigo_use_base64_simd = true;
+	double simd = base64_decode_benchmark(decoded, encoded, length);
+	bool simd_ok = memcmp(data, decoded, BENCHMARK_BASE64_SIZE) == 0;
+	double megabytes = BENCHMARK_BASE64_COUNT * (double)BENCHMARK_BASE64_SIZE / (1024 * 1024);
+	indigo_log("base64 decode: scalar %.0f MB/s%s, SIMD %.0f MB/s%s", megabytes / scalar, scalar_ok ? "" : " (FAILED)", megabytes / simd, simd_ok ? "" : " (FAILED)");
+	free(data);
+	free(encoded);
+	free(decoded);
+}
+
+// Previous recursive FFT implementation of donuts digest and drift, used as a reference
+
+#define BENCHMARK_DONUTS_SIZE		4096
+#define BENCHMARK_DONUTS_COUNT	5
+#define BENCHMARK_DRIFT_COUNT		1000
+#define BENCHMARK_DONUTS_BG_RADIUS	5
+
+#define RE (0)
+#define IM (1)
+#define PI_2 (6.2831853071795864769252867665590057683943L)
+
+static void reference_fft_step(const int n, const int offset, const int delta, const double (*x)[2], double (*X)[2], double (*_X)[2]) {
+	int n2 = n / 2;
+	if (n != 2) {
+		reference_fft_step(n2, offset, 2 * delta, x, _X, X);
+		reference_fft_step(n2, offset + delta, 2 * delta, x, _X, X);
+		for (int k = 0; k < n2; k++) {
+			int k00 = offset + k * delta;
+			int k01 = k00 + n2 * delta;
+			int k10 = offset + 2 * k * delta;
+			int k11 = k10 + delta;
+			double ccos = cos(PI_2 * k / (double)n);
+			double csin = sin(PI_2 * k / (double)n);
+			double tmp0 = ccos * _X[k11][RE] + csin * _X[k11][IM];
+			double tmp1 = ccos * _X[k11][IM] - csin * _X[k11][RE];
+			X[k01][RE] = _X[k10][RE] - tmp0;
+			X[k01][IM] = _X[k10][IM] - tmp1;
+			X[k00][RE] = _X[k10][RE] + tmp0;
+			X[k00][IM] = _X[k10][IM] + tmp1;
+		}
+	} else {
+		int k00 = offset;
+		int k01 = k00 + delta;
+		X[k01][RE] = x[k00][RE] - x[k01][RE];
+		X[k01][IM] = x[k00][IM] - x[k01][IM];
+		X[k00][RE] = x[k00][RE] + x[k01][RE];
+		X[k00][IM] = x[k00][IM] + x[k01][IM];
+	}
+}
+
+static void reference_fft(const int n, const double (*x)[2], double (*X)[2]) {
+	double (*_X)[2] = malloc(2 * n * sizeof(double));
+	reference_fft_step(n, 0, 1, x, X, _X);
+	free(_X);
+}
+
+static void reference_ifft(const int n, const double (*X)[2], double (*x)[2]) {
+	int n2 = n / 2;
+	reference_fft(n, X, x);
+	x[0][RE] = x[0][RE] / n;
+	x[0][IM] = x[0][IM] / n;
+	x[n2][RE] = x[n2][RE] / n;
+	x[n2][IM] = x[n2][IM] / n;
+	for (int i = 1; i < n2; i++) {
+		double tmp0 = x[i][RE] / n;
+		double tmp1 = x[i][IM] / n;
+		x[i][RE] = x[n - i][RE] / n;
+		x[i][IM] = x[n - i][IM] / n;
+		x[n - i][RE] = tmp0;
+		x[n - i][IM] = tmp1;
+	}
+}
+
+static double reference_distance(const int n, const double (*X1)[2], const double (*X2)[2]) {
+	double (*C)[2] = malloc(2 * n * sizeof(double));
+	double (*c)[2] = malloc(2 * n * sizeof(double));
+	for (int i = 0; i < n; i++) {
+		C[i][RE] = X1[i][RE] * X2[i][RE] + X1[i][IM] * X2[i][IM];
+		C[i][IM] = X1[i][IM] * X2[i][RE] - X1[i][RE] * X2[i][IM];
+	}
+	reference_ifft(n, (const double (*)[2])C, c);
+	const int n2 = n / 2;
+	int max = 0, prev, next;
+	for (int i = 0; i < n; i++)
+		max = (c[i][RE] > c[max][RE]) ? i : max;
+	if ((max == 0) || (max == n2)) {
+		prev = n - 1;
+		next = 1;
+	} else if (max == (n - 1)) {
+		prev = n - 2;
+		next = 0;
+	} else {
+		prev = max - 1;
+		next = max + 1;
+	}
+	double max_subp = (c[next][RE] - c[prev][RE]) / (2 * (2 * c[max][RE] - c[next][RE] - c[prev][RE]));
+	free(C);
+	free(c);
+	if (max == n2)
+		return max_subp;
+	return max > n2 ? (max - n) + max_subp : max + max_subp;
+}
+
+static double reference_calibrate(double (*vector)[2], int size) {
+	int first = BENCHMARK_DONUTS_BG_RADIUS + 1, last = size - BENCHMARK_DONUTS_BG_RADIUS - 1;
+	double *mins = malloc(size * sizeof(double));
+	for (int i = first; i <= last; i++) {
+		double min = vector[i - BENCHMARK_DONUTS_BG_RADIUS][RE];
+		for (int j = -BENCHMARK_DONUTS_BG_RADIUS + 1; j <= BENCHMARK_DONUTS_BG_RADIUS; j++) {
+			if (vector[i + j][RE] < min)
+				min = vector[i + j][RE];
+		}
+		mins[i] = min;
+	}
+	for (int i = 0; i < first; i++)
+		vector[i][RE] = 0;
+	for (int i = last + 1; i < size; i++)
+		vector[i][RE] = 0;
+	double avg = 0;
+	int count = last - first + 1;
+	for (int i = first; i <= last; i++) {
+		vector[i][RE] -= mins[i];
+		avg += vector[i][RE];
+	}
+	free(mins);
+	avg /= count;
+	double stddev = 0;
+	for (int i = first; i <= last; i++)
+		stddev += (vector[i][RE] - avg) * (vector[i][RE] - avg);
+	stddev /= count;
+	double threshold = avg + sqrt(stddev);
+	double signal_ms = 0, noise_ms = 0;
+	int signal_count = 0, noise_count = 0;
+	for (int i = first; i <= last; i++) {
+		double value = vector[i][RE];
+		if (value > threshold) {
+			signal_ms += value * value;
+			signal_count++;
+		} else {
+			noise_ms += value * value;
+			noise_count++;
+		}
+	}
+	return (signal_ms / signal_count) / (noise_ms / noise_count);
+}
+
+static void reference_digest(const uint16_t *data, const int size, indigo_frame_digest *c) {
+	double (*col_x)[2] = calloc(2 * size * sizeof(double), 1);
+	double (*col_y)[2] = calloc(2 * size * sizeof(double), 1);
+	c->width = c->height = size;
+	c->fft_x = malloc(2 * size * sizeof(double));
+	c->fft_y = malloc(2 * size * sizeof(double));
+	for (int i = 0; i < size * size; i++) {
+		col_x[i % size][RE] += data[i];
+		col_y[i / size][RE] += data[i];
+	}
+	c->snr = (reference_calibrate(col_x, size) + reference_calibrate(col_y, size)) / 2;
+	reference_fft(size, (const double (*)[2])col_x, c->fft_x);
+	reference_fft(size, (const double (*)[2])col_y, c->fft_y);
+	c->algorithm = donuts;
+	free(col_x);
+	free(col_y);
+}
+
+static void donuts_benchmark_frame(uint16_t *data, const int size, double dx, double dy) {
+	srand(1);
+	for (int i = 0; i < size * size; i++)
+		data[i] = 100 + rand() % 20;
+	for (int star = 0; star < 40; star++) {
+		double cx = 64 + rand() % (size - 128) + dx, cy = 64 + rand() % (size - 128) + dy;
+		for (int y = (int)cy - 24; y <= (int)cy + 24; y++) {
+			for (int x = (int)cx - 24; x <= (int)cx + 24; x++) {
+				double r = sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy)) - 12;
+				data[y * size + x] += 3000 * exp(-r * r / 18);
+			}
+		}
+	}
+}
+
+static double donuts_spectrum_error(const int n, const double (*X)[2], const double (*R)[2]) {
+	double error = 0, magnitude = 0;
+	for (int i = 0; i < n; i++) {
+		error = fmax(error, fmax(fabs(X[i][RE] - R[i][RE]), fabs(X[i][IM] - R[i][IM])));
+		magnitude = fmax(magnitude, hypot(R[i][RE], R[i][IM]));
+	}
+	return error / magnitude;
+}
+
+static void donuts_benchmark() {
+	const int size = BENCHMARK_DONUTS_SIZE;
+	uint16_t *frame1 = malloc(size * size * sizeof(uint16_t));
+	uint16_t *frame2 = malloc(size * size * sizeof(uint16_t));
+	donuts_benchmark_frame(frame1, size, 0, 0);
+	donuts_benchmark_frame(frame2, size, 1.37, -2.61);
+	indigo_frame_digest digest1 = { 0 }, digest2 = { 0 }, reference1 = { 0 }, reference2 = { 0 };
+	clock_t start = clock();
+	for (int i = 0; i < BENCHMARK_DONUTS_COUNT; i++) {
+		indigo_delete_frame_digest(&digest1);
+		indigo_donuts_frame_digest(INDIGO_RAW_MONO16, frame1, size, size, &digest1);
+	}
+	double digest_time = (clock() - start) / (double)CLOCKS_PER_SEC / BENCHMARK_DONUTS_COUNT;
+	start = clock();
+	for (int i = 0; i < BENCHMARK_DONUTS_COUNT; i++) {
+		indigo_delete_frame_digest(&reference1);
+		reference_digest(frame1, size, &reference1);
+	}
+	double reference_digest_time = (clock() - start) / (double)CLOCKS_PER_SEC / BENCHMARK_DONUTS_COUNT;
+	indigo_donuts_frame_digest(INDIGO_RAW_MONO16, frame2, size, size, &digest2);
+	reference_digest(frame2, size, &reference2);
+	double drift_x = 0, drift_y = 0, reference_x = 0, reference_y = 0;
+	start = clock();
+	for (int i = 0; i < BENCHMARK_DRIFT_COUNT; i++)
+		indigo_calculate_drift(&digest1, &digest2, &drift_x, &drift_y);
+	double drift_time = (clock() - start) / (double)CLOCKS_PER_SEC / BENCHMARK_DRIFT_COUNT;
+	start = clock();
+	for (int i = 0; i < BENCHMARK_DRIFT_COUNT; i++) {
+		reference_x = -reference_distance(size, (const double (*)[2])reference1.fft_x, (const double (*)[2])reference2.fft_x);
+		reference_y = reference_distance(size, (const double (*)[2])reference1.fft_y, (const double (*)[2])reference2.fft_y);
+	}
+	double reference_drift_time = (clock() - start) / (double)CLOCKS_PER_SEC / BENCHMARK_DRIFT_COUNT;
+	double spectrum_error = fmax(donuts_spectrum_error(size, (const double (*)[2])digest2.fft_x, (const double (*)[2])reference2.fft_x), donuts_spectrum_error(size, (const double (*)[2])digest2.fft_y, (const double (*)[2])reference2.fft_y));
+	double drift_error = fmax(fabs(drift_x - reference_x), fabs(drift_y - reference_y));
+	bool ok = spectrum_error < 1e-12 && drift_error < 1e-9 && fabs(digest2.snr - reference2.snr) < 1e-9 * reference2.snr;
+	indigo_log("donuts %dx%d: digest %.2f ms (recursive FFT %.2f ms), drift %.3f ms (recursive FFT %.3f ms)", size, size, digest_time * 1e3, reference_digest_time * 1e3, drift_time * 1e3, reference_drift_time * 1e3);
+	indigo_log("donuts drift %.9f, %.9f px (recursive FFT %.9f, %.9f px), max spectrum error %.1e%s", drift_x, drift_y, reference_x, reference_y, spectrum_error, ok ? "" : " (FAILED)");
+	indigo_delete_frame_digest(&digest1);
+	indigo_delete_frame_digest(&digest2);
+	indigo_delete_frame_digest(&reference1);
+	indigo_delete_frame_digest(&reference2);
+	free(frame1);
+	free(frame2);
+}
+
+#define BENCHMARK_JPEG_WIDTH	4096
+#define BENCHMARK_JPEG_HEIGHT	3072
+#define BENCHMARK_JPEG_COUNT	3
+
+static indigo_result jpeg_benchmark_attach(indigo_device *device) {
+	return indigo_ccd_attach(device, INDIGO_VERSION_CURRENT);
+}
+
+static void jpeg_benchmark() {
+	static indigo_device device = INDIGO_DEVICE_INITIALIZER("JPEG benchmark", jpeg_benchmark_attach, NULL, NULL, NULL, indigo_ccd_detach);
+	indigo_attach_device(&device);
+	long pixels = (long)BENCHMARK_JPEG_WIDTH * BENCHMARK_JPEG_HEIGHT;
+	unsigned char *data = malloc(FITS_HEADER_SIZE + pixels * 6);
+	srand(1);
+	for (long i = 0; i < pixels * 6; i++)
+		data[FITS_HEADER_SIZE + i] = i % 2 ? rand() % 32 : rand();
+	static int bpps[] = { 8, 16, 24, 48 };
+	for (int i = 0; i < 4; i++) {
+		void *jpeg = NULL;
+		unsigned long size = 0;
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (int j = 0; j < BENCHMARK_JPEG_COUNT; j++) {
+			if (jpeg)
+				free(jpeg);
+			indigo_raw_to_jpeg(&device, data, BENCHMARK_JPEG_WIDTH, BENCHMARK_JPEG_HEIGHT, bpps[i], true, true, &jpeg, &size);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+		indigo_log("raw to JPEG %d bpp %dx%d: %.1f ms/MP, %lu bytes", bpps[i], BENCHMARK_JPEG_WIDTH, BENCHMARK_JPEG_HEIGHT, elapsed * 1e3 * 1e6 / (BENCHMARK_JPEG_COUNT * pixels), size);
+		free(jpeg);
+	}
+	free(data);
+	indigo_detach_device(&device);
+}
+
+static int benchmark() {
+	indigo_start();
+	indigo_set_log_level(INDIGO_LOG_INFO);
+	dispatch_benchmark(5);
+	dispatch_benchmark(200);
+	base64_benchmark();
+	donuts_benchmark();
+	jpeg_benchmark();
+	indigo_stop();
+	return 0;
+}
+
+#if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
+
+// XML parser tests, run with -t
+
+#define PARSER_TEST_DEVICE "Parser test"
+
+static unsigned char *parser_test_blob = NULL;
+static long parser_test_blob_size = 0;
+static int parser_test_updates = 0;
+static int parser_test_messages = 0;
+static bool parser_test_blob_ok = false;
+
+static indigo_result parser_test_update_property(indigo_client *client, indigo_device *device, indigo_property *property, const char *message) {
+	if (!strcmp(property->name, "BLOB") && property->type == INDIGO_BLOB_VECTOR) {
+		parser_test_updates++;
+		indigo_item *item = property->items;
+		parser_test_blob_ok = item->blob.size == parser_test_blob_size && item->blob.value && !memcmp(item->blob.value, parser_test_blob, parser_test_blob_size);
+	}
+	return INDIGO_OK;
+}
+
+static indigo_result parser_test_send_message(indigo_client *client, indigo_device *device, const char *message) {
+	if (message && strstr(message, "marker"))
+		parser_test_messages++;
+	return INDIGO_OK;
+}
+
+static indigo_client parser_test_client = {
+	"Parser test", false, NULL, INDIGO_OK, INDIGO_VERSION_CURRENT, NULL,
+	NULL,
+	NULL,
+	parser_test_update_property,
+	NULL,
+	parser_test_send_message,
+	NULL
+};
+
+typedef struct {
+	int handle;
+	char *chunks[3];
+	long lengths[3];
+} parser_test_feed;
+
+static void *parser_test_writer(void *data) {
+	parser_test_feed *feed = data;
+	for (int i = 0; i < 3; i++) {
+		for (long written = 0; written < feed->lengths[i];) {
+			long count = write(feed->handle, feed->chunks[i] + written, feed->lengths[i] - written);
+			if (count <= 0)
+				break;
+			written += count;
+		}
+		// let the parser consume each chunk by a separate read()
+		indigo_usleep(200000);
+	}
+	close(feed->handle);
+	return NULL;
+}
+
+/* BLOB 2.0 data are base64 encoded without line breaks and read directly from the input buffer, if the part already
+ * in the buffer is not a multiple of 4 characters, the parser reads the missing 1-3 characters and must terminate
+ * the buffer behind them, otherwise it parses stale data left there by the previous read() again.
+ */
+static bool parser_test(long blob_size, int split) {
+	char *header = malloc(4096);
+	char *data;
+	parser_test_feed feed;
+	int input[2], output;
+	parser_test_blob_size = blob_size;
+	parser_test_blob = malloc(blob_size);
+	for (long i = 0; i < blob_size; i++)
+		parser_test_blob[i] = rand();
+	data = malloc(blob_size / 3 * 4 + 1024);
+	// first read: protocol switch, definition and a marker message far behind the end of the second read
+	long length = sprintf(header, "<switchProtocol version='2.0'/>\n<defBLOBVector device='%s' name='BLOB' label='BLOB' group='Test' state='Idle' perm='ro'>\n<defBLOB name='IMAGE' label='Image'/>\n</defBLOBVector>\n", PARSER_TEST_DEVICE);
+	memset(header + length, ' ', 2048 - length);
+	length = 2048 + sprintf(header + 2048, "<message device='%s' message='marker'/>\n", PARSER_TEST_DEVICE);
+	feed.chunks[0] = header;
+	feed.lengths[0] = length;
+	// second read: BLOB header and first 'split' characters of base64 data
+	length = sprintf(data, "<setBLOBVector device='%s' name='BLOB' state='Ok'>\n<oneBLOB name='IMAGE' format='.raw' size='%ld'>", PARSER_TEST_DEVICE, blob_size);
+	feed.chunks[1] = data;
+	feed.lengths[1] = length + split;
+	length += base64_encode((unsigned char *)data + length, parser_test_blob, blob_size);
+	length += sprintf(data + length, "</oneBLOB>\n</setBLOBVector>\n");
+	// third read: the rest
+	feed.chunks[2] = feed.chunks[1] + feed.lengths[1];
+	feed.lengths[2] = length - feed.lengths[1];
+	parser_test_updates = parser_test_messages = 0;
+	parser_test_blob_ok = false;
+	pipe(input);
+	output = open("/dev/null", O_WRONLY);
+	feed.handle = input[1];
+	pthread_t writer;
+	pthread_create(&writer, NULL, parser_test_writer, &feed);
+	indigo_device *adapter = indigo_xml_client_adapter("Parser test adapter", "", input[0], output);
+	indigo_attach_device(adapter);
+	indigo_xml_parse(adapter, NULL);
+	indigo_detach_device(adapter);
+	indigo_release_xml_client_adapter(adapter);
+	pthread_join(writer, NULL);
+	close(input[0]);
+	close(output);
+	bool result = parser_test_updates == 1 && parser_test_blob_ok && parser_test_messages == 1;
+	indigo_log("BLOB %ld bytes, %d base64 characters in first read: %s (updates %d, messages %d)", blob_size, split, result ? "passed" : "FAILED", parser_test_updates, parser_test_messages);
+	free(header);
+	free(data);
+	free(parser_test_blob);
+	return result;
+}
+
+static int parser_tests() {
+	static const long sizes[] = { 1, 2, 3, 100, 1000, 1000000 };
+	bool result = true;
+	indigo_start();
+	indigo_set_log_level(INDIGO_LOG_INFO);
+	indigo_attach_client(&parser_test_client);
+	for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (int split = 1; split <= 5; split++) {
+			if (split < (sizes[i] + 2) / 3 * 4)
+				result = parser_test(sizes[i], split) && result;
+		}
+	}
+	indigo_detach_client(&parser_test_client);
+	indigo_stop();
+	return result ? 0 : 1;
+}
+
+#endif
+
 int main(int argc, const char * argv[]) {
 	indigo_main_argc = argc;
 	indigo_main_argv = argv;
 #if defined(INDIGO_WINDOWS)
 	//freopen("indigo.log", "w", stderr);
 #endif
-	
+	if (argc > 1 && !strcmp(argv[1], "-b"))
+		return benchmark();
+#if defined(INDIGO_LINUX) || defined(INDIGO_MACOS)
+	if (argc > 1 && !strcmp(argv[1], "-t"))
+		return parser_tests();
+#endif
+
 	indigo_start();
 	indigo_set_log_level(INDIGO_LOG_DEBUG);
 	